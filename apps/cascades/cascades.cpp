@@ -5,18 +5,40 @@
 
 double infection_chance;
 double recovery_chance;
+uint64_t simulation_seed;
 
 enum Status {INFECTED, SUSCEPTIBLE, RECOVERED};
 
-// The vertex data is its status (S, I, or R) 
-typedef Status vertex_data_type;
+// Number of independent cascades packed into one machine word in the
+// bit-parallel simulation
+const size_t SIMS_PER_PASS = 64;
+
+// The vertex data is its status (S, I, or R). For the bit-parallel
+// independent cascade simulation it also holds one bit per cascade of
+// the current pass, and the number of simulations (over all passes) in
+// which the vertex was reached.
+struct vertex_data_type {
+  Status status;
+  uint64_t infected;
+  uint32_t infected_count;
+  vertex_data_type(Status status = SUSCEPTIBLE)
+    : status(status), infected(0), infected_count(0) { }
+
+  void save(graphlab::oarchive& oarc) const {
+    oarc << status << infected << infected_count;
+  }
+
+  void load(graphlab::iarchive& iarc) {
+    iarc >> status >> infected >> infected_count;
+  }
+};
 
 // infected_status counts the number of infected neighbors, since
 // the number of infected neighbors determines how likely a susceptible node is
 // to be infected
 struct infected_status: public graphlab::IS_POD_TYPE {
   int value;
-  vertex_data_type status;
+  Status status;
 
   infected_status() {
     value = 0;
@@ -34,6 +56,16 @@ struct infected_status: public graphlab::IS_POD_TYPE {
 
 
 typedef infected_status gather_type;
+
+// The union of the cascades (one bit each) arriving over live edges
+struct sim_mask: public graphlab::IS_POD_TYPE {
+  uint64_t bits;
+  sim_mask(uint64_t bits = 0) : bits(bits) { }
+  sim_mask& operator+=(const sim_mask& other) {
+    bits |= other.bits;
+    return *this;
+  }
+};
  
 // The graph type is determined by the vertex and edge data types
 typedef graphlab::distributed_graph<vertex_data_type, graphlab::empty> graph_type;
@@ -49,7 +81,7 @@ bool line_parser(graph_type& graph, const std::string& filename, const std::stri
   // next entry is their status (S, I, or R)
   strm >> label;
 
-  vertex_data_type statusLabel;
+  Status statusLabel;
   if (label == 'S') {
     statusLabel = SUSCEPTIBLE;
   } else if (label == 'I') {
@@ -60,7 +92,7 @@ bool line_parser(graph_type& graph, const std::string& filename, const std::stri
 
   
   // insert this vertex with its label 
-  graph.add_vertex(vid, statusLabel);
+  graph.add_vertex(vid, vertex_data_type(statusLabel));
 
   // while there are elements in the line, continue to read until we fail
   while(1) {
@@ -87,7 +119,7 @@ class cascades:
     gather_type gather(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
       // figure out which data to get from the edge.
       bool isEdgeSource = (vertex.id() == edge.source().id());
-      vertex_data_type neighbor_status = isEdgeSource ? edge.target().data() : edge.source().data();
+      Status neighbor_status = isEdgeSource ? edge.target().data().status : edge.source().data().status;
 
       // create infected_status and add neighbor's status to it. 
 
@@ -99,9 +131,9 @@ class cascades:
     }
 
     void apply(icontext_type& context, vertex_type& vertex, const gather_type& total) {
-      vertex_data_type old_data = vertex.data();
+      Status old_data = vertex.data().status;
 
-      vertex_data_type result = old_data;
+      Status result = old_data;
       double random_value;
 
       // if vertex.data == RECOVERED, don't do anything
@@ -128,7 +160,7 @@ class cascades:
         }
       }
 
-      vertex.data() = result;
+      vertex.data().status = result;
 
       if (result == INFECTED) {
         context.signal(vertex);
@@ -140,11 +172,116 @@ class cascades:
     }
   };
 
+/**
+ * A 64 bit finalizer (splitmix64) used to derive the per edge random
+ * bits from the edge endpoints, the pass and the simulation seed. This
+ * makes the live-edge sample of an edge identical on every machine and
+ * independent of the order in which edges are visited.
+ */
+inline uint64_t mix64(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+// Bits of precision used when comparing against infection_chance
+const size_t LIVE_EDGE_PRECISION = 16;
+
+/**
+ * Returns a word in which each bit is independently set with
+ * probability infection_chance (to within 2^-LIVE_EDGE_PRECISION): bit i
+ * tells whether the edge is live in cascade i of this pass. The 64
+ * uniform draws are compared against the threshold bit-sliced, from the
+ * most significant bit down, so a mask costs LIVE_EDGE_PRECISION hashes
+ * rather than 64.
+ */
+inline uint64_t live_edge_mask(graphlab::vertex_id_type source,
+                               graphlab::vertex_id_type target,
+                               size_t pass) {
+  const uint64_t threshold =
+    (uint64_t)(infection_chance * (1ULL << LIVE_EDGE_PRECISION));
+  if (threshold >= (1ULL << LIVE_EDGE_PRECISION)) return ~0ULL;
+  const uint64_t key = mix64(mix64(mix64(simulation_seed ^ pass) ^ source) ^ target);
+  uint64_t less = 0;
+  uint64_t equal = ~0ULL;
+  for (size_t b = LIVE_EDGE_PRECISION; b > 0; --b) {
+    const uint64_t rbits = mix64(key + b);
+    const uint64_t tbits = ((threshold >> (b - 1)) & 1) ? ~0ULL : 0;
+    less |= equal & ~rbits & tbits;
+    equal &= ~(rbits ^ tbits);
+  }
+  return less;
+}
+
+// The pass of SIMS_PER_PASS cascades currently being simulated
+size_t current_pass = 0;
+
+/**
+ * Simulates SIMS_PER_PASS independent cascades of the independent
+ * cascade model at once. Each edge is live in each cascade with
+ * probability infection_chance (live-edge sampling), and a vertex is
+ * infected in a cascade iff it is reachable from an initially infected
+ * vertex over live edges. Since only reachability matters, a vertex may
+ * gather the full infected set of its neighbors rather than only the
+ * newly infected frontier.
+ */
+class parallel_cascades:
+  public graphlab::ivertex_program<graph_type, sim_mask>,
+  public graphlab::IS_POD_TYPE {
+    bool changed;
+
+  public:
+    edge_dir_type gather_edges(icontext_type& context, const vertex_type& vertex) const {
+      return graphlab::ALL_EDGES;
+    }
+
+    sim_mask gather(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
+      const vertex_type other = edge.source().id() == vertex.id() ?
+        edge.target() : edge.source();
+      return sim_mask(other.data().infected &
+                      live_edge_mask(edge.source().id(), edge.target().id(),
+                                     current_pass));
+    }
+
+    void apply(icontext_type& context, vertex_type& vertex, const sim_mask& total) {
+      const uint64_t newly_infected = total.bits & ~vertex.data().infected;
+      vertex.data().infected |= newly_infected;
+      changed = newly_infected != 0;
+    }
+
+    edge_dir_type scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+      return changed ? graphlab::ALL_EDGES : graphlab::NO_EDGES;
+    }
+
+    void scatter(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
+      const vertex_type other = edge.source().id() == vertex.id() ?
+        edge.target() : edge.source();
+      // only signal neighbors to which some cascade actually spreads
+      if (vertex.data().infected & ~other.data().infected &
+          live_edge_mask(edge.source().id(), edge.target().id(), current_pass)) {
+        context.signal(other);
+      }
+    }
+  };
+
+void reset_pass(graph_type::vertex_type& vertex) {
+  vertex.data().infected = vertex.data().status == INFECTED ? ~0ULL : 0;
+}
+
+void accumulate_pass(graph_type::vertex_type& vertex) {
+  vertex.data().infected_count += __builtin_popcountll(vertex.data().infected);
+}
+
+size_t pass_reach(const graph_type::vertex_type& vertex) {
+  return __builtin_popcountll(vertex.data().infected);
+}
+
 struct cascades_writer{
   std::string save_vertex(graph_type::vertex_type v) {
     std::stringstream strm;
 
-    Status status = v.data();
+    Status status = v.data().status;
     char vertex_data;
     
     // Convert the status back into a char
@@ -155,7 +292,9 @@ struct cascades_writer{
     } else {
       vertex_data = 'R';
     }
-    strm << v.id() << "\t" << vertex_data << "\n";
+    strm << v.id() << "\t" << vertex_data;
+    if (v.data().infected_count > 0) strm << "\t" << v.data().infected_count;
+    strm << "\n";
     return strm.str();
   }
   std::string save_edge (graph_type::edge_type e) { return ""; }
@@ -176,6 +315,8 @@ int main(int argc, char** argv) {
   double recovery = -1;
   double infection = -1;
   size_t iterations = -1;
+  size_t parallel_sims = 0;
+  simulation_seed = time(0);
 
   clopts.attach_option("graph", graph_dir, "The graph file. Required ");
   clopts.add_positional("graph");
@@ -191,6 +332,9 @@ int main(int argc, char** argv) {
 
   clopts.attach_option("iterations", iterations, "If set, will force the use of synchronous engine overriding any engine option set by the --engine parameter. Runs cascades for a fixed number of iterations. Also overrides the max_iterations option in the engine.");
 
+  clopts.attach_option("parallel_sims", parallel_sims, "If set, runs this many independent cascades of the independent cascade model (rounded up to a multiple of 64) using bit-parallel live-edge simulation instead of the SIR model. Each vertex is then saved with the number of simulations which reached it.");
+  clopts.attach_option("seed", simulation_seed, "Random seed for the live-edge sampling of --parallel_sims.");
+
   if(!clopts.parse(argc, argv)) {
     dc.cout() << "Error in parsing command line arguments." << std::endl;
     return EXIT_FAILURE;
@@ -200,7 +344,7 @@ int main(int argc, char** argv) {
     return EXIT_FAILURE;
   }
 
-  if (recovery == -1) {
+  if (recovery == -1 && parallel_sims == 0) {
     dc.cout() << "Recovery chance not specified. Cannot continue";
     return EXIT_FAILURE;
   }
@@ -212,7 +356,9 @@ int main(int argc, char** argv) {
 
   infection_chance = infection;
   recovery_chance = recovery;
-  
+  // all machines must sample the same live-edge graphs in a pass
+  dc.broadcast(simulation_seed, dc.procid() == 0);
+
   if (iterations != -1) {
     // make sure this is the synchronous engine
     dc.cout() << "--iterations set. Forcing Synchronous engine, and running for "
@@ -230,13 +376,33 @@ int main(int argc, char** argv) {
 
   dc.cout() << "#vertices: " << graph.num_vertices() << " #edges:" << graph.num_edges() << std::endl;
 
-  graphlab::omni_engine<cascades> engine(dc, graph, execution_type, clopts);
+  if (parallel_sims > 0) {
+    const size_t num_passes = (parallel_sims + SIMS_PER_PASS - 1) / SIMS_PER_PASS;
+    graphlab::omni_engine<parallel_cascades> engine(dc, graph, execution_type, clopts);
+    graphlab::timer ti;
+    double total_reach = 0;
+    for (current_pass = 0; current_pass < num_passes; ++current_pass) {
+      graph.transform_vertices(reset_pass);
+      engine.signal_all();
+      engine.start();
+      graph.transform_vertices(accumulate_pass);
+      total_reach += graph.map_reduce_vertices<size_t>(pass_reach);
+    }
+    const double runtime = ti.current_time();
+    const size_t num_sims = num_passes * SIMS_PER_PASS;
+    dc.cout() << "Finished " << num_sims << " simulations in " << runtime
+              << " seconds (" << num_sims / runtime << " simulations per second)."
+              << std::endl;
+    dc.cout() << "Average cascade size: " << total_reach / num_sims << std::endl;
+  } else {
+    graphlab::omni_engine<cascades> engine(dc, graph, execution_type, clopts);
 
-  engine.signal_all();
-  engine.start();
+    engine.signal_all();
+    engine.start();
 
-  const float runtime = engine.elapsed_seconds();
-  dc.cout() << "Finished Running engine in " << runtime << " seconds." << std::endl;
+    const float runtime = engine.elapsed_seconds();
+    dc.cout() << "Finished Running engine in " << runtime << " seconds." << std::endl;
+  }
 
   if (saveprefix != "") {
     graph.save(saveprefix, cascades_writer(),
@@ -1,36 +1,9 @@
 #include <graphlab.hpp>
+#include "label_propagation.hpp"
 
-struct label_counter {
-  std::map<std::string, int> label_count;
-
-  label_counter() {
-  }
-    
-  label_counter& operator+=(const label_counter& other) { 
-    for ( std::map<std::string, int>::const_iterator iter = other.label_count.begin();
-              iter != other.label_count.end(); ++iter ) {
-            label_count[iter->first] += iter->second;
-    }
-
-    return *this; 
-  }
-
-  void save(graphlab::oarchive& oarc) const {
-    oarc << label_count;
-  }
-
-  void load(graphlab::iarchive& iarc) {
-    iarc >> label_count;
-  }
-};
-
-// The vertex data is its label 
-typedef std::string vertex_data_type;
-
-typedef label_counter gather_type;
- 
-// The graph type is determined by the vertex and edge data types
-typedef graphlab::distributed_graph<std::string, graphlab::empty> graph_type;
+size_t SKETCH_SIZE = 0;
+size_t STABLE_ROUNDS = 0;
+graphlab::atomic<size_t> SKIPPED_GATHERS;
 
 bool line_parser(graph_type& graph, const std::string& filename, const std::string& textline) {
   std::stringstream strm(textline);
@@ -40,7 +13,7 @@ bool line_parser(graph_type& graph, const std::string& filename, const std::stri
   strm >> vid;
   strm >> label;
   // insert this vertex with its label 
-  graph.add_vertex(vid, label);
+  graph.add_vertex(vid, vertex_data_type(label));
   // while there are elements in the line, continue to read until we fail
   while(1){
     graphlab::vertex_id_type other_vid;
@@ -53,77 +26,10 @@ bool line_parser(graph_type& graph, const std::string& filename, const std::stri
   return true;
 }
 
-class labelpropagation :
-  public graphlab::ivertex_program<graph_type, gather_type>,
-  public graphlab::IS_POD_TYPE {
-    bool changed;
-
-  public:
-    edge_dir_type gather_edges(icontext_type& context, const vertex_type& vertex) const {
-      return graphlab::ALL_EDGES;
-    }
-
-    gather_type gather(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
-      // figure out which data to get from the edge.
-      bool isEdgeSource = (vertex.id() == edge.source().id());
-      std::string neighbor_label = isEdgeSource ? edge.target().data() : edge.source().data();
-
-      // make a label_counter and place the neighbor data in it
-      label_counter counter;
-      counter.label_count[neighbor_label] = 1;
-
-
-      // gather_type is a label counter, so += will add neighbor counts to the
-      // label_count map.
-      return counter;
-    }
-
-    void apply(icontext_type& context, vertex_type& vertex, const gather_type& total) {
-
-      int maxCount = 0;
-
-      std::string maxLabel = vertex.data();
-
-      // Figure out which label of the vertex's neighbors' labels is most common
-      for ( std::map<std::string, int>::const_iterator iter = total.label_count.begin();
-                iter != total.label_count.end(); ++iter ) {
-              if (iter->second > maxCount) {
-                maxCount = iter->second;
-                maxLabel = iter->first;
-              }
-      }
-
-      
-      // if maxLabel differs to vertex data, mark vertex as changed and update
-      // its data.
-      if ((vertex.data()).compare(maxLabel) != 0) {
-        changed = true;
-        vertex.data() = maxLabel;
-      } else {
-        changed = false;
-      }
-    }
-
-    edge_dir_type scatter_edges(icontext_type& context, const vertex_type& vertex) const {
-      // if vertex data changes, scatter to all edges.
-      if (changed) {
-        return graphlab::ALL_EDGES;
-      } else {
-        return graphlab::NO_EDGES;
-      }
-    }
-
-    void scatter(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
-      bool isEdgeSource = (vertex.id() == edge.source().id());
-
-      context.signal(isEdgeSource ? edge.target() : edge.source()); 
-    }
-  };
-
 struct labelpropagation_writer {
   std::string save_vertex(graph_type::vertex_type v) {
     std::stringstream strm;
-    strm << v.id() << "\t" << v.data() << "\n";
+    strm << v.id() << "\t" << v.data().label << "\n";
     return strm.str();
   }
   std::string save_edge (graph_type::edge_type e) { return ""; }
@@ -144,6 +50,15 @@ int main(int argc, char** argv) {
   clopts.add_positional("graph");
   clopts.attach_option("execution", execution_type, "Execution type (synchronous or asynchronous)");
 
+  clopts.attach_option("sketch_size", SKETCH_SIZE,
+                       "If positive, bound the number of labels tracked per "
+                       "gather to this many heavy hitters (Space-Saving). "
+                       "0 uses exact label counts.");
+  clopts.attach_option("stable_rounds", STABLE_ROUNDS,
+                       "If positive, a vertex which kept its label for this "
+                       "many consecutive updates skips the gather while its "
+                       "neighbors' changes cannot overtake its label.");
+
   std::string saveprefix;
   clopts.attach_option("saveprefix", saveprefix,
                        "If set, will save the resultant pagerank to a "
@@ -166,6 +81,7 @@ int main(int argc, char** argv) {
   graph.finalize();
 
   dc.cout() << "#vertices: " << graph.num_vertices() << " #edges:" << graph.num_edges() << std::endl;
+  graphlab::memory_info::log_usage("Finished loading graph");
 
   graphlab::omni_engine<labelpropagation> engine(dc, graph, execution_type, clopts);
 
@@ -174,6 +90,23 @@ int main(int argc, char** argv) {
 
   const float runtime = engine.elapsed_seconds();
   dc.cout() << "Finished Running engine in " << runtime << " seconds." << std::endl;
+  if (engine.iteration() > 0) {
+    dc.cout() << "Iterations: " << engine.iteration() << ", "
+              << runtime / engine.iteration() << " seconds per iteration."
+              << std::endl;
+  }
+  if (STABLE_ROUNDS > 0) {
+    dc.cout() << "Stable vertices: "
+              << graph.map_reduce_vertices<size_t>(count_stable) << std::endl;
+    size_t skipped = SKIPPED_GATHERS.value;
+    dc.all_reduce(skipped);
+    dc.cout() << "Edge gathers skipped: " << skipped << std::endl;
+  }
+  if (graphlab::memory_info::available()) {
+    dc.cout() << "Heap bytes: " << graphlab::memory_info::heap_bytes()
+              << ", allocated bytes: " << graphlab::memory_info::allocated_bytes()
+              << std::endl;
+  }
 
   if (saveprefix != "") {
     graph.save(saveprefix, labelpropagation_writer(),
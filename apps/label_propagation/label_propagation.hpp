@@ -0,0 +1,304 @@
+#ifndef LABEL_PROPAGATION_HPP
+#define LABEL_PROPAGATION_HPP
+
+#include <graphlab.hpp>
+#include <graphlab/parallel/atomic.hpp>
+
+/**
+ * Maximum number of distinct labels tracked per gather. 0 keeps the
+ * exact label->count map. A positive value bounds every gather to a
+ * Space-Saving heavy hitter summary of at most SKETCH_SIZE labels, so
+ * hub vertices and the partial gathers shipped between mirrors stay
+ * small regardless of degree.
+ */
+extern size_t SKETCH_SIZE;
+
+/**
+ * Number of consecutive updates in which a vertex kept its label
+ * before it is considered stable and no longer gathers. 0 disables.
+ */
+extern size_t STABLE_ROUNDS;
+
+/**
+ * The count of a label, together with the maximum amount by which the
+ * count may over-estimate the true count (always 0 in exact mode).
+ */
+struct label_entry {
+  uint32_t count;
+  uint32_t error;
+  label_entry() : count(0), error(0) { }
+};
+
+struct label_counter {
+  typedef std::map<std::string, label_entry> map_type;
+  map_type label_count;
+
+  label_counter() {
+  }
+
+  /**
+   * Merges two counters. In exact mode this is a plain sum of counts.
+   * In sketch mode it is the mergeable Space-Saving combine: a label
+   * missing from a full summary could have had up to its minimum count,
+   * so that minimum is added to both count and error, and then only the
+   * SKETCH_SIZE heaviest labels are retained.
+   */
+  label_counter& operator+=(const label_counter& other) {
+    if (SKETCH_SIZE == 0) {
+      for (map_type::const_iterator iter = other.label_count.begin();
+           iter != other.label_count.end(); ++iter) {
+        label_count[iter->first].count += iter->second.count;
+      }
+      return *this;
+    }
+    const uint32_t mymin = full() ? min_count() : 0;
+    const uint32_t othermin = other.full() ? other.min_count() : 0;
+    for (map_type::iterator iter = label_count.begin();
+         iter != label_count.end(); ++iter) {
+      if (other.label_count.count(iter->first) == 0) {
+        iter->second.count += othermin;
+        iter->second.error += othermin;
+      }
+    }
+    for (map_type::const_iterator iter = other.label_count.begin();
+         iter != other.label_count.end(); ++iter) {
+      map_type::iterator mine = label_count.find(iter->first);
+      if (mine == label_count.end()) {
+        label_entry& entry = label_count[iter->first];
+        entry.count = iter->second.count + mymin;
+        entry.error = iter->second.error + mymin;
+      } else {
+        mine->second.count += iter->second.count;
+        mine->second.error += iter->second.error;
+      }
+    }
+    truncate();
+    return *this;
+  }
+
+  /// Returns true if the counter is a sketch which has reached capacity
+  bool full() const {
+    return SKETCH_SIZE > 0 && label_count.size() >= SKETCH_SIZE;
+  }
+
+  uint32_t min_count() const {
+    uint32_t ret = (uint32_t)(-1);
+    for (map_type::const_iterator iter = label_count.begin();
+         iter != label_count.end(); ++iter) {
+      ret = std::min(ret, iter->second.count);
+    }
+    return ret;
+  }
+
+  /// Drops the lightest labels until at most SKETCH_SIZE remain
+  void truncate() {
+    if (SKETCH_SIZE == 0 || label_count.size() <= SKETCH_SIZE) return;
+    std::vector<uint32_t> counts;
+    counts.reserve(label_count.size());
+    for (map_type::const_iterator iter = label_count.begin();
+         iter != label_count.end(); ++iter) {
+      counts.push_back(iter->second.count);
+    }
+    // the SKETCH_SIZE'th largest count is the threshold to survive
+    std::nth_element(counts.begin(), counts.begin() + (SKETCH_SIZE - 1),
+                     counts.end(), std::greater<uint32_t>());
+    const uint32_t threshold = counts[SKETCH_SIZE - 1];
+    // entries strictly above the threshold always survive; ties at the
+    // threshold fill the remaining slots
+    size_t num_above = 0;
+    for (size_t i = 0; i < counts.size(); ++i) num_above += counts[i] > threshold;
+    size_t ties_left = SKETCH_SIZE - num_above;
+    map_type::iterator iter = label_count.begin();
+    while (iter != label_count.end()) {
+      if (iter->second.count > threshold ||
+          (iter->second.count == threshold && ties_left > 0)) {
+        if (iter->second.count == threshold) --ties_left;
+        ++iter;
+      } else {
+        label_count.erase(iter++);
+      }
+    }
+  }
+
+  /**
+   * Compact serialization: the error column is only written in sketch
+   * mode, and counts are 32 bit.
+   */
+  void save(graphlab::oarchive& oarc) const {
+    oarc << label_count.size();
+    for (map_type::const_iterator iter = label_count.begin();
+         iter != label_count.end(); ++iter) {
+      oarc << iter->first << iter->second.count;
+      if (SKETCH_SIZE > 0) oarc << iter->second.error;
+    }
+  }
+
+  void load(graphlab::iarchive& iarc) {
+    label_count.clear();
+    size_t len = 0;
+    iarc >> len;
+    // the map is sorted on save, so insert with a hint at the end
+    for (size_t i = 0; i < len; ++i) {
+      std::string label;
+      label_entry entry;
+      iarc >> label >> entry.count;
+      if (SKETCH_SIZE > 0) iarc >> entry.error;
+      label_count.insert(label_count.end(), std::make_pair(label, entry));
+    }
+  }
+};
+
+/**
+ * The vertex data is its label, the number of consecutive updates in
+ * which the label did not change, and the slack of the label: how far
+ * the neighbor count of the label is ahead of the runner up, less the
+ * neighbor changes seen since it was counted.
+ */
+struct vertex_data_type {
+  std::string label;
+  uint32_t stable_rounds;
+  uint32_t slack;
+  vertex_data_type(const std::string& label = "")
+    : label(label), stable_rounds(0), slack(0) { }
+
+  bool is_stable() const {
+    return STABLE_ROUNDS > 0 && stable_rounds >= STABLE_ROUNDS;
+  }
+
+  void save(graphlab::oarchive& oarc) const {
+    oarc << label << stable_rounds << slack;
+  }
+
+  void load(graphlab::iarchive& iarc) {
+    iarc >> label >> stable_rounds >> slack;
+  }
+};
+
+typedef label_counter gather_type;
+
+/**
+ * Signals carry the number of edges along which a neighbor changed its
+ * label. Every such change moves the count of at most two labels by
+ * one, so it shrinks the lead of the current label by at most two.
+ */
+struct label_message : public graphlab::IS_POD_TYPE {
+  uint32_t num_changed;
+  explicit label_message(uint32_t num_changed = 0)
+    : num_changed(num_changed) { }
+  label_message& operator+=(const label_message& other) {
+    num_changed += other.num_changed;
+    return *this;
+  }
+};
+ 
+// The graph type is determined by the vertex and edge data types
+typedef graphlab::distributed_graph<vertex_data_type, graphlab::empty> graph_type;
+
+/// The number of edge gathers skipped by stable vertices
+extern graphlab::atomic<size_t> SKIPPED_GATHERS;
+
+class labelpropagation :
+  public graphlab::ivertex_program<graph_type, gather_type, label_message>,
+  public graphlab::IS_POD_TYPE {
+    bool changed;
+    uint32_t num_changed;
+
+    /**
+     * A stable vertex skips the update while the neighbor changes since
+     * its last gather cannot have overtaken its label. In sketch mode the
+     * slack comes from estimated counts, so the skip is as approximate
+     * as the gather.
+     */
+    bool frozen(const vertex_type& vertex) const {
+      return vertex.data().is_stable() &&
+        2 * uint64_t(num_changed) < vertex.data().slack;
+    }
+
+  public:
+    void init(icontext_type& context, const vertex_type& vertex,
+              const message_type& msg) {
+      num_changed = msg.num_changed;
+    }
+
+    edge_dir_type gather_edges(icontext_type& context, const vertex_type& vertex) const {
+      // stable vertices keep their label and skip the gather entirely
+      if (frozen(vertex)) return graphlab::NO_EDGES;
+      return graphlab::ALL_EDGES;
+    }
+
+    gather_type gather(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
+      // figure out which data to get from the edge.
+      bool isEdgeSource = (vertex.id() == edge.source().id());
+      const std::string& neighbor_label =
+        isEdgeSource ? edge.target().data().label : edge.source().data().label;
+
+      // make a label_counter and place the neighbor data in it
+      label_counter counter;
+      counter.label_count[neighbor_label].count = 1;
+
+
+      // gather_type is a label counter, so += will add neighbor counts to the
+      // label_count map.
+      return counter;
+    }
+
+    void apply(icontext_type& context, vertex_type& vertex, const gather_type& total) {
+      if (frozen(vertex)) {
+        changed = false;
+        vertex.data().slack -= 2 * num_changed;
+        SKIPPED_GATHERS.inc(vertex.num_in_edges() + vertex.num_out_edges());
+        return;
+      }
+
+      uint32_t maxCount = 0;
+      uint32_t runnerUpCount = 0;
+
+      std::string maxLabel = vertex.data().label;
+
+      // Figure out which label of the vertex's neighbors' labels is most common
+      for (label_counter::map_type::const_iterator iter = total.label_count.begin();
+           iter != total.label_count.end(); ++iter) {
+        if (iter->second.count > maxCount) {
+          runnerUpCount = maxCount;
+          maxCount = iter->second.count;
+          maxLabel = iter->first;
+        } else {
+          runnerUpCount = std::max(runnerUpCount, iter->second.count);
+        }
+      }
+      vertex.data().slack = maxCount - runnerUpCount;
+      
+      // if maxLabel differs to vertex data, mark vertex as changed and update
+      // its data.
+      if (vertex.data().label.compare(maxLabel) != 0) {
+        changed = true;
+        vertex.data().label = maxLabel;
+        vertex.data().stable_rounds = 0;
+      } else {
+        changed = false;
+        ++vertex.data().stable_rounds;
+      }
+    }
+
+    edge_dir_type scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+      // if vertex data changes, scatter to all edges.
+      if (changed) {
+        return graphlab::ALL_EDGES;
+      } else {
+        return graphlab::NO_EDGES;
+      }
+    }
+
+    void scatter(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
+      bool isEdgeSource = (vertex.id() == edge.source().id());
+
+      context.signal(isEdgeSource ? edge.target() : edge.source(),
+                     label_message(1));
+    }
+  };
+
+inline size_t count_stable(const graph_type::vertex_type& vertex) {
+  return vertex.data().is_stable();
+}
+
+#endif
@@ -0,0 +1,153 @@
+#include <vector>
+#include <iostream>
+#include <graphlab.hpp>
+#include "label_propagation.hpp"
+
+/**
+ * Runs label propagation on a synthetic power law graph with and
+ * without --stable_rounds. Both runs update the same vertices, so each
+ * edge gather the stable run does not do must have been skipped by a
+ * stable vertex, and the labels must come out the same. The
+ * Space-Saving sketch of --sketch_size is checked on its own against
+ * exact label counts, and on the graph with room for every label.
+ */
+
+size_t SKETCH_SIZE = 0;
+size_t STABLE_ROUNDS = 0;
+graphlab::atomic<size_t> SKIPPED_GATHERS;
+
+/// Counts the edge gathers of label propagation
+graphlab::atomic<size_t> NUM_GATHERS;
+
+class counting_labelpropagation : public labelpropagation {
+public:
+  gather_type gather(icontext_type& context, const vertex_type& vertex,
+                     edge_type& edge) const {
+    NUM_GATHERS.inc();
+    return labelpropagation::gather(context, vertex, edge);
+  }
+};
+
+void init_label(graph_type::vertex_type& vertex) {
+  vertex.data() = vertex_data_type(
+      boost::lexical_cast<std::string>(vertex.id() * 2654435761u % 5));
+}
+
+struct label_collector {
+  std::vector<std::string>* labels;
+  void operator()(const graph_type::vertex_type& vertex) {
+    (*labels)[vertex.id()] = vertex.data().label;
+  }
+};
+
+size_t run(graphlab::distributed_control& dc, graph_type& graph,
+           size_t stable_rounds, size_t sketch_size,
+           std::vector<std::string>& labels) {
+  STABLE_ROUNDS = stable_rounds;
+  SKETCH_SIZE = sketch_size;
+  NUM_GATHERS.value = 0;
+  SKIPPED_GATHERS.value = 0;
+  graph.transform_vertices(init_label);
+  graphlab::graphlab_options opts;
+  // exact label propagation can oscillate, so stop it early
+  opts.get_engine_args().set_option("max_iterations", 20);
+  graphlab::synchronous_engine<counting_labelpropagation> engine(dc, graph,
+                                                                 opts);
+  engine.signal_all();
+  engine.start();
+  labels.resize(graph.num_vertices());
+  label_collector collector;
+  collector.labels = &labels;
+  graph.transform_vertices(collector);
+  return engine.num_updates();
+}
+
+/**
+ * Counts a stream in which label "a" is a third of the items and the
+ * rest spread over 50 labels, one item per counter as the gather does,
+ * into several partial sums which are then merged, as the partial
+ * gathers of the mirrors are.
+ */
+void test_sketch() {
+  SKETCH_SIZE = 8;
+  const size_t n = 3000;
+  std::map<std::string, uint32_t> truth;
+  std::vector<label_counter> partials(4);
+  for (size_t i = 0; i < n; ++i) {
+    const std::string label = i % 3 == 0 ? "a" :
+        boost::lexical_cast<std::string>(i * 2654435761u % 50);
+    ++truth[label];
+    label_counter item;
+    item.label_count[label].count = 1;
+    partials[i % partials.size()] += item;
+  }
+  label_counter total;
+  for (size_t i = 0; i < partials.size(); ++i) total += partials[i];
+
+  // the dominant label survives every truncation
+  ASSERT_EQ(total.label_count.size(), SKETCH_SIZE);
+  ASSERT_EQ(total.label_count.count("a"), 1);
+  // each count over-estimates the true count by at most its error,
+  // which is at most n / SKETCH_SIZE
+  for (label_counter::map_type::const_iterator iter =
+         total.label_count.begin(); iter != total.label_count.end(); ++iter) {
+    ASSERT_GE(iter->second.count, truth[iter->first]);
+    ASSERT_LE(iter->second.count - iter->second.error, truth[iter->first]);
+    ASSERT_LE(iter->second.error, n / SKETCH_SIZE);
+  }
+
+  // the compact serialization keeps counts and errors
+  std::stringstream strm;
+  graphlab::oarchive oarc(strm);
+  oarc << total;
+  strm.flush();
+  graphlab::iarchive iarc(strm);
+  label_counter loaded;
+  iarc >> loaded;
+  ASSERT_EQ(loaded.label_count.size(), total.label_count.size());
+  for (label_counter::map_type::const_iterator iter =
+         total.label_count.begin(); iter != total.label_count.end(); ++iter) {
+    ASSERT_EQ(loaded.label_count[iter->first].count, iter->second.count);
+    ASSERT_EQ(loaded.label_count[iter->first].error, iter->second.error);
+  }
+  SKETCH_SIZE = 0;
+  std::cout << "Space-Saving sketch: " << total.label_count["a"].count
+            << " counted for " << truth["a"] << " occurrences of a"
+            << std::endl;
+}
+
+int main(int argc, char** argv) {
+  graphlab::mpi_tools::init(argc, argv);
+  graphlab::distributed_control dc;
+  global_logger().set_log_level(LOG_WARNING);
+
+  graph_type graph(dc);
+  graph.load_synthetic_powerlaw(20000);
+  graph.finalize();
+
+  test_sketch();
+
+  std::vector<std::string> exact_labels, stable_labels, sketch_labels;
+  const size_t exact_updates = run(dc, graph, 0, 0, exact_labels);
+  const size_t exact_gathers = NUM_GATHERS.value;
+  ASSERT_EQ(SKIPPED_GATHERS.value, 0);
+
+  const size_t stable_updates = run(dc, graph, 1, 0, stable_labels);
+  const size_t stable_gathers = NUM_GATHERS.value;
+  std::cout << "Edge gathers: " << exact_gathers << " exact, "
+            << stable_gathers << " with stable_rounds=1, "
+            << SKIPPED_GATHERS.value << " skipped" << std::endl;
+  ASSERT_EQ(stable_updates, exact_updates);
+  ASSERT_GT(SKIPPED_GATHERS.value, 0);
+  ASSERT_EQ(stable_gathers + SKIPPED_GATHERS.value, exact_gathers);
+  ASSERT_TRUE(stable_labels == exact_labels);
+
+  // there are only 5 labels, so a sketch of 5 must count them exactly
+  const size_t sketch_updates = run(dc, graph, 0, 5, sketch_labels);
+  ASSERT_EQ(sketch_updates, exact_updates);
+  ASSERT_TRUE(sketch_labels == exact_labels);
+
+  std::cout << "Done" << std::endl;
+  graphlab::mpi_tools::finalize();
+  return EXIT_SUCCESS;
+}
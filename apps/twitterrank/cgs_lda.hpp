@@ -392,12 +392,34 @@ bool vertex_line_parser(graph_type& graph,
   return true;
 }
 
+/**
+ * \brief Documents are stored at the negated ids -(docid + 2) and
+ * therefore occupy the upper half of the vertex id space, while words
+ * keep their (non-negative) word ids.  Classifying vertices by id
+ * rather than by edge direction allows the same vertex program to run
+ * on graphs that carry additional (non-token) edges between documents,
+ * see shared_graph.hpp.
+ */
+inline bool is_doc_id(graphlab::vertex_id_type vid) {
+  return vid >= (graphlab::vertex_id_type(1) << 31);
+}
+
+template <typename VertexType>
+inline bool is_word_vertex(const VertexType& vertex) {
+  return !is_doc_id(vertex.id()) && vertex.num_in_edges() > 0;
+}
+
+template <typename VertexType>
+inline bool is_doc_vertex(const VertexType& vertex) {
+  return is_doc_id(vertex.id()) && vertex.num_out_edges() > 0;
+}
+
 inline bool is_word(const graph_type::vertex_type& vertex) {
-  return vertex.num_in_edges() > 0 ? 1 : 0;
+  return is_word_vertex(vertex);
 }
 
 inline bool is_doc(const graph_type::vertex_type& vertex) {
-  return vertex.num_out_edges() > 0 ? 1 : 0;
+  return is_doc_vertex(vertex);
 }
 
 size_t right_emit_key (const graph_type::vertex_type& vertex) {
@@ -415,9 +437,10 @@ inline size_t count_tokens(const graph_type::edge_type& edge) {
   return edge.data().assignment.size();
 }
 
-inline graph_type::vertex_type
-get_other_vertex(const graph_type::edge_type& edge,
-                 const graph_type::vertex_type& vertex) {
+template <typename EdgeType, typename VertexType>
+inline VertexType
+get_other_vertex(const EdgeType& edge,
+                 const VertexType& vertex) {
   return vertex.id() == edge.source().id()? edge.target() : edge.source();
 }
 
@@ -578,13 +601,23 @@ struct gather_type {
  * \brief The collapsed Gibbs sampler vertex program updates the topic
  * counts for the center vertex and then draws new topic assignments
  * for each edge durring the scatter phase.
- * 
+ *
+ * The program is templated over the graph type so that it can also
+ * run on a graph whose vertex and edge data extend \ref vertex_data
+ * and \ref edge_data (see shared_graph.hpp). Edges without tokens are
+ * ignored by the sampler.
  */
-class cgs_lda_vertex_program :
-  public graphlab::ivertex_program<graph_type, gather_type>,
+template <typename GraphType>
+class basic_cgs_lda_vertex_program :
+  public graphlab::ivertex_program<GraphType, gather_type>,
   public graphlab::IS_POD_TYPE
    {
 public:
+  typedef graphlab::ivertex_program<GraphType, gather_type> base_type;
+  typedef typename base_type::icontext_type icontext_type;
+  typedef typename base_type::vertex_type vertex_type;
+  typedef typename base_type::edge_type edge_type;
+  typedef typename base_type::edge_dir_type edge_dir_type;
 
   /**
    * \brief At termination we want to disable sampling to allow the
@@ -629,7 +662,7 @@ public:
     vdata.nupdates++;
     vdata.nchanges = sum.nchanges;
     vdata.factor = sum.factor;
-    if (is_doc(vertex)) {
+    if (is_doc_vertex(vertex)) {
       float MIMNO_R = 0.0;
       for (size_t i = 0;i < vdata.factor.size(); ++i) {
         MIMNO_R += vdata.factor[i] * BETA / (BETA * NWORDS + GLOBAL_TOPIC_COUNT[i]);
@@ -653,7 +686,7 @@ public:
     vdata.nupdates++;
     vdata.nchanges = sum.nchanges;
     vdata.factor = sumfactor;
-    if (is_doc(vertex)) {
+    if (is_doc_vertex(vertex)) {
       float MIMNO_R = 0.0;
       for (size_t i = 0;i < vdata.factor.size(); ++i) {
         MIMNO_R += vdata.factor[i] * BETA / (BETA * (NWORDS - LOCKED_WORDS_PER_TOPIC[i]) +
@@ -694,18 +727,18 @@ public:
   /*
   void scatter(icontext_type& context, const vertex_type& vertex,
                edge_type& edge) const {
-    factor_type& doc_topic_count =  is_doc(edge.source()) ?
+    factor_type& doc_topic_count =  is_doc_vertex(edge.source()) ?
       edge.source().data().factor : edge.target().data().factor;
-    factor_type& word_topic_count = is_word(edge.source()) ?
+    factor_type& word_topic_count = is_word_vertex(edge.source()) ?
       edge.source().data().factor : edge.target().data().factor;
     ASSERT_EQ(doc_topic_count.size(), NTOPICS);
     ASSERT_EQ(word_topic_count.size(), NTOPICS);
-    float MIMNO_R = is_doc(edge.source()) ? edge.source().data().MIMNO_R :
+    float MIMNO_R = is_doc_vertex(edge.source()) ? edge.source().data().MIMNO_R :
                       edge.target().data().MIMNO_R;
     float MIMNO_Q = 0.0;
     std::vector<float> MIMNO_Q_CACHE(NTOPICS);
     
-    size_t wordid = is_word(edge.source()) ? edge.source().id() : edge.target().id();
+    size_t wordid = is_word_vertex(edge.source()) ? edge.source().id() : edge.target().id();
 
     for (size_t t = 0; t < NTOPICS; ++t) {
       const float n_wt  =
@@ -817,21 +850,23 @@ public:
 
 void scatter(icontext_type& context, const vertex_type& vertex,
                edge_type& edge) const {
-    factor_type& doc_topic_count =  is_doc(edge.source()) ?
+    // skip edges which carry no tokens
+    if (edge.data().assignment.empty()) return;
+    factor_type& doc_topic_count =  is_doc_vertex(edge.source()) ?
       edge.source().data().factor : edge.target().data().factor;
-    factor_type& word_topic_count = is_word(edge.source()) ?
+    factor_type& word_topic_count = is_word_vertex(edge.source()) ?
       edge.source().data().factor : edge.target().data().factor;
     size_t LOCAL_NTOPICS = NTOPICS;
     if (doc_topic_count.size() != LOCAL_NTOPICS) doc_topic_count.resize(LOCAL_NTOPICS);
     if (word_topic_count.size() != LOCAL_NTOPICS) word_topic_count.resize(LOCAL_NTOPICS);
     //ASSERT_EQ(doc_topic_count.size(), NTOPICS);
     //ASSERT_EQ(word_topic_count.size(), NTOPICS);
-    float MIMNO_R = is_doc(edge.source()) ? edge.source().data().MIMNO_R :
+    float MIMNO_R = is_doc_vertex(edge.source()) ? edge.source().data().MIMNO_R :
                       edge.target().data().MIMNO_R;
     float MIMNO_Q = 0.0;
     std::vector<float> MIMNO_Q_CACHE(LOCAL_NTOPICS);
 
-    size_t wordid = is_word(edge.source()) ? edge.source().id() : edge.target().id();
+    size_t wordid = is_word_vertex(edge.source()) ? edge.source().id() : edge.target().id();
 
     for (size_t t = 0; t < LOCAL_NTOPICS; ++t) {
       const float n_wt  =
@@ -975,10 +1010,12 @@ void scatter(icontext_type& context, const vertex_type& vertex,
   } // end of scatter function
 
 
-}; // end of cgs_lda_vertex_program
+}; // end of basic_cgs_lda_vertex_program
 
+template <typename GraphType>
+bool basic_cgs_lda_vertex_program<GraphType>::DISABLE_SAMPLING = false;
 
-bool cgs_lda_vertex_program::DISABLE_SAMPLING = false;
+typedef basic_cgs_lda_vertex_program<graph_type> cgs_lda_vertex_program;
 
 
 /**
@@ -1100,6 +1137,16 @@ struct global_counts_aggregator {
   } // end of map function
 
   static void finalize(icontext_type& context, const factor_type& total) {
+    const size_t sum = set_global_counts(total);
+    context.cout() << "Total Tokens: " << sum << std::endl;
+  } // end of finalize
+
+  /**
+   * \brief Sets \ref GLOBAL_TOPIC_COUNT and \ref MIMNO_S from the sum
+   * of the word and document topic counts and returns the total
+   * number of tokens.
+   */
+  static size_t set_global_counts(const factor_type& total) {
     size_t sum = 0;
     float NEW_MIMNO_S = 0;
     for(size_t t = 0; t < total.size(); ++t) {
@@ -1109,8 +1156,8 @@ struct global_counts_aggregator {
       NEW_MIMNO_S += ALPHA * BETA / (BETA * NWORDS + (GLOBAL_TOPIC_COUNT[t] > 0 ? GLOBAL_TOPIC_COUNT[t] : 0));
     }
     MIMNO_S = NEW_MIMNO_S;
-    context.cout() << "Total Tokens: " << sum << std::endl;
-  } // end of finalize
+    return sum;
+  } // end of set_global_counts
 }; // end of global_counts_aggregator struct
 
 
@@ -0,0 +1,375 @@
+// Requires pagerank.hpp and cgs_lda.hpp to be included first.
+#include <graphlab.hpp>
+#include <vector>
+#include <algorithm>
+#include <graphlab/util/memory_info.hpp>
+#include <graphlab/macros_def.hpp>
+
+/**
+ * Co-scheduled TwitterRank: a single distributed_graph holding both the
+ * LDA token graph and the follower graph.
+ *
+ * Users are the LDA documents and are stored at the LDA document ids
+ * -(userid + 2). Words keep their word ids. The graph therefore has two
+ * kinds of edges:
+ *   - token edges doc -> word, carrying the topic assignments, and
+ *   - follow edges user -> user, carrying no tokens.
+ *
+ * The LDA sampler (lda::basic_cgs_lda_vertex_program) skips edges without
+ * tokens and the PageRank programs below skip edges with tokens, so both
+ * run over the same ingress, partitioning and mirror structures without
+ * a vertex join. A user's topic distribution is read directly from its
+ * LDA topic counts, so the only rank state kept per vertex is the rank
+ * and the per-topic out normalizer (empty for words).
+ */
+namespace shared {
+
+struct vertex_data : public lda::vertex_data {
+  float rank;
+  std::vector<float> out_normalizer;
+  ///! The number of tokens of a user, 0 for words
+  uint32_t ntokens;
+  vertex_data() : rank(1.0), ntokens(0) { }
+  vertex_data(size_t join_key) : lda::vertex_data(join_key), rank(1.0), ntokens(0) { }
+  void save(graphlab::oarchive& arc) const {
+    lda::vertex_data::save(arc);
+    arc << rank << out_normalizer << ntokens;
+  }
+  void load(graphlab::iarchive& arc) {
+    lda::vertex_data::load(arc);
+    arc >> rank >> out_normalizer >> ntokens;
+  }
+}; // end of vertex_data
+
+typedef lda::edge_data edge_data;
+
+typedef graphlab::distributed_graph<vertex_data, edge_data> graph_type;
+
+typedef lda::basic_cgs_lda_vertex_program<graph_type> lda_program;
+
+inline graphlab::vertex_id_type user_vid(graphlab::vertex_id_type userid) {
+  return -(userid + 2);
+}
+
+inline bool is_follow_edge(const graph_type::edge_type& edge) {
+  return edge.data().assignment.empty();
+}
+
+inline bool is_word(const graph_type::vertex_type& vertex) {
+  return lda::is_word_vertex(vertex);
+}
+
+inline bool is_user(const graph_type::vertex_type& vertex) {
+  return lda::is_doc_id(vertex.id());
+}
+
+/**
+ * \brief Users with tokens are the LDA documents. Users with only follow
+ * edges also have out edges, so lda::is_doc_vertex cannot tell them
+ * apart.
+ */
+inline bool is_doc(const graph_type::vertex_type& vertex) {
+  return is_user(vertex) && vertex.data().ntokens > 0;
+}
+
+inline size_t count_tokens(const graph_type::edge_type& edge) {
+  return edge.data().assignment.size();
+}
+
+inline lda::factor_type topic_counts(const graph_type::vertex_type& vertex) {
+  return vertex.data().factor;
+}
+
+inline float topic_count_sum(const vertex_data& vdata) {
+  float sum = 0;
+  for (size_t i = 0; i < vdata.factor.size() && i < size_t(pagerank::NTOPICS); ++i) {
+    sum += std::max(vdata.factor[i], lda::count_type(0));
+  }
+  return sum;
+}
+
+/**
+ * \brief The probability of topic k for a user, normalized from its LDA
+ * topic counts (sum is topic_count_sum()). Users without tokens have a
+ * uniform distribution.
+ */
+inline float user_topic(const vertex_data& vdata, size_t k, float sum) {
+  if (sum == 0) return 1.0 / pagerank::NTOPICS;
+  return k < vdata.factor.size() ?
+    std::max(vdata.factor[k], lda::count_type(0)) / sum : 0;
+}
+
+/**
+ * \brief Parses "<userid> <wordid> <count>" token lines, as in
+ * lda::edge_line_parser.
+ */
+bool token_line_parser(graph_type& graph, const std::string& fname,
+                       const std::string& line) {
+  std::stringstream strm(line);
+  graphlab::vertex_id_type userid(-1), wordid(-1);
+  size_t count = 0;
+  strm >> userid;
+  strm.ignore(1, ',');
+  strm >> wordid;
+  strm.ignore(1, ',');
+  strm >> count;
+  if (strm.fail()) return false;
+  count = std::min(count, lda::MAX_COUNT);
+  // an edge without tokens would be taken for a follow edge
+  if (count == 0) return true;
+  wordid -= lda::WORDID_OFFSET;
+  ASSERT_FALSE(lda::is_doc_id(wordid));
+  graph.add_edge(user_vid(userid), wordid, edge_data(count));
+  return true;
+}
+
+/**
+ * \brief Parses "<source> <target>" follow edges (snap format).
+ */
+bool follow_line_parser(graph_type& graph, const std::string& fname,
+                        const std::string& line) {
+  if (line.empty() || line[0] == '#') return true;
+  std::stringstream strm(line);
+  graphlab::vertex_id_type source(-1), target(-1);
+  strm >> source >> target;
+  if (strm.fail()) return false;
+  if (source != target) {
+    graph.add_edge(user_vid(source), user_vid(target), edge_data(0));
+  }
+  return true;
+}
+
+template <typename ContextType>
+graphlab::empty signal_docs(ContextType& context,
+                            const graph_type::vertex_type& vertex) {
+  if (is_doc(vertex)) context.signal(vertex);
+  return graphlab::empty();
+}
+
+template <typename ContextType>
+graphlab::empty signal_users(ContextType& context,
+                             const graph_type::vertex_type& vertex) {
+  if (is_user(vertex)) context.signal(vertex);
+  return graphlab::empty();
+}
+
+/**
+ * \brief Counts the tokens of each user along its token edges.
+ */
+class count_user_tokens :
+  public graphlab::ivertex_program<graph_type, size_t>,
+  public graphlab::IS_POD_TYPE {
+public:
+  edge_dir_type gather_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::OUT_EDGES;
+  }
+  size_t gather(icontext_type& context, const vertex_type& vertex,
+                edge_type& edge) const {
+    return count_tokens(edge);
+  }
+  void apply(icontext_type& context, vertex_type& vertex, const size_t& total) {
+    vertex.data().ntokens = total;
+  }
+  edge_dir_type scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+}; // end of count_user_tokens
+
+bool load_and_initialize_graph(graphlab::distributed_control& dc,
+                               graph_type& graph,
+                               const std::string& token_dir,
+                               const std::string& follow_dir) {
+  dc.cout() << "Loading shared graph." << std::endl;
+  graphlab::timer timer; timer.start();
+  graph.load(token_dir, token_line_parser);
+  graph.load(follow_dir, follow_line_parser);
+  graph.finalize();
+  dc.cout() << "Loading and finalizing shared graph. Finished in "
+            << timer.current_time() << " seconds." << std::endl;
+  dc.cout() << " #vertices: " << graph.num_vertices()
+            << " #edges:" << graph.num_edges() << std::endl;
+
+  graphlab::omni_engine<count_user_tokens> token_engine(dc, graph, "synchronous");
+  token_engine.map_reduce_vertices<graphlab::empty>
+    (signal_users<count_user_tokens::icontext_type>);
+  token_engine.start();
+
+  lda::NWORDS = graph.map_reduce_vertices<size_t>(is_word);
+  lda::NDOCS = graph.map_reduce_vertices<size_t>(is_doc);
+  lda::NTOKENS = graph.map_reduce_edges<size_t>(count_tokens);
+  pagerank::NPAGES = graph.map_reduce_vertices<size_t>(is_user);
+  dc.cout() << "Number of words:     " << lda::NWORDS  << std::endl;
+  dc.cout() << "Number of docs:      " << lda::NDOCS   << std::endl;
+  dc.cout() << "Number of tokens:    " << lda::NTOKENS << std::endl;
+  dc.cout() << "Number of users:     " << pagerank::NPAGES << std::endl;
+  return true;
+}
+
+
+/**
+ * \brief The sum of the topic distributions of the follow neighbors.
+ * Token edges contribute an empty vector, so that they cost no
+ * allocation.
+ */
+struct topic_sum {
+  std::vector<float> topics;
+  topic_sum& operator+=(const topic_sum& other) {
+    if (other.topics.empty()) return *this;
+    if (topics.empty()) {
+      topics = other.topics;
+    } else {
+      for (size_t k = 0; k < topics.size(); ++k) topics[k] += other.topics[k];
+    }
+    return *this;
+  }
+  void save(graphlab::oarchive& arc) const { arc << topics; }
+  void load(graphlab::iarchive& arc) { arc >> topics; }
+};
+
+/**
+ * \brief Computes the per-topic out normalizer of each user from the
+ * topic distributions of its neighbors along follow edges. Users
+ * without follow edges get an empty normalizer.
+ */
+class compute_transit_prob :
+  public graphlab::ivertex_program<graph_type, topic_sum>,
+  public graphlab::IS_POD_TYPE {
+public:
+  edge_dir_type gather_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
+  }
+
+  topic_sum gather(icontext_type& context, const vertex_type& vertex,
+                   edge_type& edge) const {
+    topic_sum ret;
+    if (!is_follow_edge(edge)) return ret;
+    const vertex_type other = lda::get_other_vertex(edge, vertex);
+    const float sum = topic_count_sum(other.data());
+    ret.topics.resize(pagerank::NTOPICS);
+    for (size_t k = 0; k < ret.topics.size(); ++k) {
+      ret.topics[k] = user_topic(other.data(), k, sum);
+    }
+    return ret;
+  }
+
+  void apply(icontext_type& context, vertex_type& vertex,
+             const topic_sum& total) {
+    vertex.data().out_normalizer = total.topics;
+  }
+
+  edge_dir_type scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+}; // end of compute_transit_prob
+
+
+/**
+ * \brief The personalized TwitterRank update of pagerank::compute_pagerank
+ * restricted to follow edges.
+ */
+class compute_pagerank :
+  public graphlab::ivertex_program<graph_type, float>,
+  public graphlab::IS_POD_TYPE {
+public:
+  edge_dir_type gather_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
+  }
+
+  float gather(icontext_type& context, const vertex_type& vertex,
+               edge_type& edge) const {
+    if (!is_follow_edge(edge)) return 0;
+    const vertex_type other = lda::get_other_vertex(edge, vertex);
+    const std::vector<float>& normalizer = other.data().out_normalizer;
+    const float sum = topic_count_sum(vertex.data());
+    float pij = 0;
+    for (size_t k = 0; k < normalizer.size(); ++k) {
+      if (normalizer[k] > 0) {
+        pij += pagerank::w_personal[k] * user_topic(vertex.data(), k, sum) /
+          normalizer[k];
+      }
+    }
+    return (1.0 - pagerank::RESET_PROB) * pij * other.data().rank;
+  }
+
+  void apply(icontext_type& context, vertex_type& vertex, const float& total) {
+    const double newval = total + pagerank::RESET_PROB;
+    vertex.data().rank = std::isnan(newval) ? 1 : newval;
+    context.signal(vertex);
+  }
+
+  edge_dir_type scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+}; // end of compute_pagerank
+
+
+struct top_rank {
+  std::vector<std::pair<float, graphlab::vertex_id_type> > top;
+  top_rank& operator+=(const top_rank& other) {
+    top.insert(top.end(), other.top.begin(), other.top.end());
+    std::sort(top.rbegin(), top.rend());
+    if (top.size() > pagerank::TOPK) top.resize(pagerank::TOPK);
+    return *this;
+  }
+  void save(graphlab::oarchive& arc) const { arc << top; }
+  void load(graphlab::iarchive& arc) { arc >> top; }
+};
+
+inline top_rank map_top_rank(const graph_type::vertex_type& vertex) {
+  top_rank ret;
+  if (is_user(vertex)) {
+    // report the original user id
+    ret.top.push_back(std::make_pair(vertex.data().rank,
+                                     graphlab::vertex_id_type(-vertex.id() - 2)));
+  }
+  return ret;
+}
+
+
+/**
+ * \brief Runs rounds of LDA sweeps followed by TwitterRank iterations
+ * on the shared graph, and reports the total wall time and heap usage.
+ */
+void run(graphlab::distributed_control& dc, graph_type& graph,
+         size_t rounds, size_t lda_sweeps, size_t pagerank_iterations) {
+  graphlab::timer timer; timer.start();
+  graphlab::graphlab_options lda_opts;
+  lda_opts.get_engine_args().set_option("max_iterations", lda_sweeps);
+  graphlab::omni_engine<lda_program> lda_engine(dc, graph, "synchronous", lda_opts);
+  graphlab::omni_engine<compute_transit_prob> transit_engine(dc, graph, "synchronous");
+  graphlab::graphlab_options pr_opts;
+  pr_opts.get_engine_args().set_option("max_iterations", pagerank_iterations);
+  graphlab::omni_engine<compute_pagerank> pagerank_engine(dc, graph, "synchronous", pr_opts);
+
+  lda_program::DISABLE_SAMPLING = false;
+  for (size_t i = 0; i < rounds; ++i) {
+    lda::factor_type total = graph.map_reduce_vertices<lda::factor_type>(topic_counts);
+    lda::global_counts_aggregator::set_global_counts(total);
+    lda_engine.map_reduce_vertices<graphlab::empty>
+      (signal_docs<lda_program::icontext_type>);
+    lda_engine.start();
+
+    transit_engine.map_reduce_vertices<graphlab::empty>
+      (signal_users<compute_transit_prob::icontext_type>);
+    transit_engine.start();
+    pagerank_engine.map_reduce_vertices<graphlab::empty>
+      (signal_users<compute_pagerank::icontext_type>);
+    pagerank_engine.start();
+    dc.cout() << "Round " << i << " finished at " << timer.current_time()
+              << " seconds." << std::endl;
+  }
+
+  const top_rank top = graph.map_reduce_vertices<top_rank>(map_top_rank);
+  for (size_t i = 0; i < top.top.size(); ++i) {
+    dc.cout() << top.top[i].second << ": " << top.top[i].first << "\n";
+  }
+  dc.cout() << "Shared graph TwitterRank finished in " << timer.current_time()
+            << " seconds." << std::endl;
+  if (graphlab::memory_info::available()) {
+    dc.cout() << "Heap bytes: " << graphlab::memory_info::heap_bytes()
+              << std::endl;
+  }
+}
+
+} // end of namespace shared
+#include <graphlab/macros_undef.hpp>
@@ -3,6 +3,7 @@
 #include <boost/functional/hash.hpp>
 #include "pagerank.hpp"
 #include "cgs_lda.hpp"
+#include "shared_graph.hpp"
 
 size_t NTOPICS = 20;
 int JOIN_INTERVAL = 5;
@@ -167,6 +168,15 @@ int main(int argc, char** argv) {
   clopts.attach_option("join_on_id", JOIN_ON_ID, "If true, use the vertex id as join key. Otherwise, use vertex data as join key, so the vertex input for both graph must be provided.");
   clopts.attach_option("has_doc_count", pagerank::HAS_DOC_COUNT, "Whether or not the pagerank vertex data has a field for document count. This could be true for author-topic graph, depending on the input data.");
 
+  bool shared_graph = false;
+  size_t shared_rounds = 10;
+  size_t lda_sweeps = 5;
+  size_t pagerank_iterations = 5;
+  clopts.attach_option("shared_graph", shared_graph, "Load the lda and pagerank edges into a single graph and alternate LDA sweeps and TwitterRank iterations on it (batch mode, joins on id).");
+  clopts.attach_option("shared_rounds", shared_rounds, "Number of rounds of LDA sweeps and TwitterRank iterations with --shared_graph.");
+  clopts.attach_option("lda_sweeps", lda_sweeps, "LDA sweeps per round with --shared_graph.");
+  clopts.attach_option("pagerank_iterations", pagerank_iterations, "TwitterRank iterations per round with --shared_graph.");
+
   bool pagerank_only = false;
   bool lda_only = false;
   clopts.attach_option("pagerank_only", pagerank_only, "Run pagerank only.");
@@ -216,6 +226,22 @@ int main(int argc, char** argv) {
   pagerank::JOIN_ON_ID = JOIN_ON_ID;
   lda::JOIN_ON_ID = JOIN_ON_ID;
 
+  if (shared_graph) {
+    if (pagerank_edges == "" || lda_edges == "") {
+      dc.cout() << "--shared_graph requires both pagerank_edges and lda_edges";
+      return EXIT_FAILURE;
+    }
+    init_personal_weight(w_personal);
+    lda::initialize_global();
+    shared::graph_type graph(dc);
+    shared::load_and_initialize_graph(dc, graph, lda_edges, pagerank_edges);
+    // also sizes the word locks read by the sampler
+    lda::load_dictionary(lda_dictionary);
+    shared::run(dc, graph, shared_rounds, lda_sweeps, pagerank_iterations);
+    graphlab::mpi_tools::finalize();
+    return EXIT_SUCCESS;
+  }
+
 
   // Build the pagerank (left) graph ----------------------------------------------------------
   // The global pagerank_graph points to lgraph 
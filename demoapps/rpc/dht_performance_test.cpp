@@ -5,9 +5,26 @@
 #include <graphlab/rpc/dc.hpp>
 #include <graphlab/rpc/dc_init_from_mpi.hpp>    
 #include <graphlab/rpc/dht.hpp>
+#include <graphlab/rpc/delta_dht.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/logger/logger.hpp>
+#include <boost/bind.hpp>
 using namespace graphlab;
 
+typedef delta_dht<size_t, double> delta_dht_type;
+const size_t NUMKEYS = 100000;
+const size_t DELTAS_PER_THREAD = 1000000;
+
+// parameter server style access: read a value, then add to it. Each
+// key is used by a run of 8 consecutive updates.
+void delta_worker(delta_dht_type* ddht, size_t seed) {
+  for (size_t i = 0;i < DELTAS_PER_THREAD; ++i) {
+    const size_t key = ((i / 8) * 7919 + seed) % NUMKEYS;
+    if (i % 3 == 0) (*ddht)[key];
+    ddht->apply_delta(key, 1.0);
+  }
+}
+
 std::string randstring(size_t len) {
   std::string str;
   str.resize(len);
@@ -74,5 +91,36 @@ int main(int argc, char ** argv) {
   }
   dc.barrier();
   testdht.print_stats();
+
+  // delta dht throughput with all threads of all machines updating
+  {
+    delta_dht_type ddht(dc, 4096);
+    const size_t nthreads = thread::cpu_count();
+    timer ti;
+    ti.start();
+    thread_group group;
+    for (size_t i = 0;i < nthreads; ++i) {
+      group.launch(boost::bind(delta_worker, &ddht, 
+                               dc.procid() * nthreads + i));
+    }
+    group.join();
+    ddht.barrier_flush();
+    const double elapsed = ti.current_time();
+    if (dc.procid() == 0) {
+      std::cout << nthreads * DELTAS_PER_THREAD << " deltas per machine from "
+                << nthreads << " threads in " << elapsed << " s: "
+                << nthreads * DELTAS_PER_THREAD / elapsed 
+                << " deltas/s per machine" << std::endl;
+    }
+    ddht.print_stats(std::cout);
+    // every delta is accounted for once flushed
+    double total = 0;
+    for (size_t i = dc.procid();i < NUMKEYS; i += dc.numprocs()) {
+      total += ddht.get_master(i);
+    }
+    dc.all_reduce(total);
+    ASSERT_EQ(size_t(total), nthreads * DELTAS_PER_THREAD * dc.numprocs());
+    dc.barrier();
+  }
   mpi_tools::finalize();
 }
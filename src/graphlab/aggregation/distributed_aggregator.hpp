@@ -28,6 +28,7 @@
 #include <omp.h>
 #endif
 
+#include <algorithm>
 #include <map>
 #include <set>
 #include <string>
@@ -75,6 +76,12 @@ namespace graphlab {
    * simultaneously within the same engine execution . For details on their 
    * usage, see their respective documentation.
    * 
+   * Incremental vertex aggregators (add_incremental_vertex_aggregator())
+   * avoid the scan over all vertices on every tick. If
+   * has_incremental_aggregators() is true, the engine must call
+   * retract_vertex() before and contribute_vertex() after every apply,
+   * and a tick then only merges the changes reported by each thread into
+   * a running total. aggregate_now() still performs a full recompute.
    */
   template<typename Graph, typename IContext>
   class distributed_aggregator {
@@ -286,8 +293,148 @@ namespace graphlab {
     };
     
 
+    /**
+     * \internal
+     * The type-free interface of the running state of an incremental
+     * vertex aggregator. The state holds the local reduction over all
+     * owned vertices as of the last tick, and a pair of accumulators per
+     * engine thread collecting the contributions retracted and
+     * re-added by vertex changes since.
+     */
+    struct iincremental_state_base {
+      /** \brief Sets the number of threads reporting changes and drops
+                 all pending changes */
+      virtual void resize(size_t nthreads) = 0;
+
+      /** \brief Retracts the current contribution of the vertex. Called
+                 on thread thread_id before the vertex data changes */
+      virtual void retract_vertex(size_t thread_id, icontext_type&,
+                                  vertex_type&) = 0;
+
+      /** \brief Adds the current contribution of the vertex. Called on
+                 thread thread_id after the vertex data changed */
+      virtual void contribute_vertex(size_t thread_id, icontext_type&,
+                                     vertex_type&) = 0;
+
+      /** \brief Folds the pending changes of thread thread_id into the
+                 running total. Must not race with changes reported by
+                 the same thread. */
+      virtual void merge_thread(size_t thread_id) = 0;
+
+      /** \brief Replaces the running total with a freshly computed
+                 accumulator (as returned by
+                 imap_reduce_base::get_accumulator) and drops all pending
+                 changes */
+      virtual void set_total(const any& acc) = 0;
+
+      /** \brief Returns the running total stored in an any */
+      virtual any get_total() const = 0;
+
+      /** \brief Returns true if the running total is up to date with a
+                 full recompute and all changes reported since */
+      virtual bool has_total() const = 0;
+
+      /** \brief Forgets the running total, forcing a full recompute on
+                 the next tick */
+      virtual void invalidate() = 0;
+
+      virtual ~iincremental_state_base() { }
+    };
+
+    /**
+     * \internal
+     * A templated implementation of iincremental_state_base.
+     * The retracted contributions are kept apart from the added ones so
+     * that only ReductionType::operator-= between two actual values is
+     * needed, and the default constructed ReductionType does not have to
+     * be an additive identity.
+     */
+    template <typename ReductionType, typename VertexMapperType>
+    struct incremental_state : public iincremental_state_base {
+      struct thread_delta {
+        conditional_addition_wrapper<ReductionType> added;
+        conditional_addition_wrapper<ReductionType> retracted;
+        // threads update their deltas on every apply. Keep them apart.
+        char padding[64];
+      };
+      VertexMapperType map_vtx_function;
+      std::vector<thread_delta> deltas;
+      conditional_addition_wrapper<ReductionType> total;
+      bool valid;
+      mutex lock;
+
+      incremental_state(VertexMapperType map_vtx_function)
+        : map_vtx_function(map_vtx_function), valid(false) { }
+
+      void resize(size_t nthreads) {
+        deltas.clear();
+        deltas.resize(nthreads);
+      }
+
+      void retract_vertex(size_t thread_id, icontext_type& context,
+                          vertex_type& vertex) {
+        ASSERT_LT(thread_id, deltas.size());
+        deltas[thread_id].retracted += map_vtx_function(context, vertex);
+      }
+
+      void contribute_vertex(size_t thread_id, icontext_type& context,
+                             vertex_type& vertex) {
+        ASSERT_LT(thread_id, deltas.size());
+        deltas[thread_id].added += map_vtx_function(context, vertex);
+      }
+
+      void merge_thread(size_t thread_id) {
+        thread_delta& delta = deltas[thread_id];
+        lock.lock();
+        total += delta.added;
+        /**
+         * A compiler error on this line is typically due to the
+         * ReductionType of an incremental aggregator not having an
+         * operator-=.  Ensure that the following is available:
+         *
+         *   ReductionType& operator-=(ReductionType& lvalue,
+         *                             const ReductionType& rvalue);
+         */
+        if (total.has_value && delta.retracted.has_value) {
+          total.value -= delta.retracted.value;
+        }
+        lock.unlock();
+        delta.added.clear();
+        delta.retracted.clear();
+      }
+
+      void set_total(const any& acc) {
+        lock.lock();
+        total = acc.as<conditional_addition_wrapper<ReductionType> >();
+        valid = true;
+        lock.unlock();
+        for (size_t i = 0; i < deltas.size(); ++i) {
+          deltas[i].added.clear();
+          deltas[i].retracted.clear();
+        }
+      }
+
+      any get_total() const {
+        return any(total);
+      }
+
+      bool has_total() const {
+        return valid;
+      }
+
+      void invalidate() {
+        valid = false;
+        total.clear();
+      }
+    };
+
     std::map<std::string, imap_reduce_base*> aggregators;
     std::map<std::string, float> aggregate_period;
+    /// The running state of the incremental aggregators. The map reduce
+    /// spec of each is also in aggregators, and is used for full
+    /// recomputes
+    std::map<std::string, iincremental_state_base*> incremental_state_map;
+    std::vector<iincremental_state_base*> incremental_states;
 
     struct async_aggregator_state {
       /// Performs reduction of all local threads. On machine 0, also
@@ -310,6 +457,8 @@ namespace graphlab {
     mutable_queue<std::string, float> schedule;
     mutex schedule_lock;
     size_t ncpus;
+    /// The number of engine threads reporting vertex changes
+    size_t nthreads;
 
     template <typename ReductionType, typename F>
     static void test_vertex_mapper_type(std::string key = "") {
@@ -385,7 +534,7 @@ namespace graphlab {
                            graph_type& graph, 
                            icontext_type* context):
                             rmi(dc, this), graph(graph), 
-                            context(context), ncpus(0) { }
+                            context(context), ncpus(0), nthreads(0) { }
 
     /**
      * \copydoc graphlab::iengine::add_vertex_aggregator
@@ -449,6 +598,58 @@ namespace graphlab {
     }
 #endif
 
+    /**
+     * \copydoc graphlab::iengine::add_incremental_vertex_aggregator
+     */
+    template <typename ReductionType,
+              typename VertexMapperType,
+              typename FinalizerType>
+    bool add_incremental_vertex_aggregator(const std::string& key,
+                                           VertexMapperType map_function,
+                                           FinalizerType finalize_function) {
+      if (!add_vertex_aggregator<ReductionType>(key, map_function,
+                                                finalize_function)) {
+        return false;
+      }
+      iincremental_state_base* state =
+          new incremental_state<ReductionType, VertexMapperType>(map_function);
+      incremental_state_map[key] = state;
+      incremental_states.push_back(state);
+      return true;
+    }
+
+    /**
+     * Returns true if there are incremental aggregators. If there are,
+     * the engine must bracket every change to the data of a master
+     * vertex with retract_vertex() and contribute_vertex().
+     */
+    bool has_incremental_aggregators() const {
+      return !incremental_states.empty();
+    }
+
+    /**
+     * Called by the engine thread thread_id before it modifies the data
+     * of a master vertex (i.e. before apply). Retracts the contribution
+     * of the vertex from all incremental aggregators.
+     * thread_id must be less than the nthreads passed to start().
+     */
+    void retract_vertex(size_t thread_id, vertex_type& vertex) {
+      for (size_t i = 0; i < incremental_states.size(); ++i) {
+        incremental_states[i]->retract_vertex(thread_id, *context, vertex);
+      }
+    }
+
+    /**
+     * Called by the engine thread thread_id after it modified the data
+     * of a master vertex. Adds the new contribution of the vertex to all
+     * incremental aggregators.
+     */
+    void contribute_vertex(size_t thread_id, vertex_type& vertex) {
+      for (size_t i = 0; i < incremental_states.size(); ++i) {
+        incremental_states[i]->contribute_vertex(thread_id, *context, vertex);
+      }
+    }
+
     /**
      * \copydoc graphlab::iengine::add_edge_aggregator
      */
@@ -561,7 +762,47 @@ namespace graphlab {
         }
         delete localmr;
       }
-      
+
+      // restart the running total of an incremental aggregator
+      typename std::map<std::string, iincremental_state_base*>::iterator
+          inc = incremental_state_map.find(key);
+      if (inc != incremental_state_map.end()) {
+        inc->second->set_total(mr->get_accumulator());
+      }
+      reduce_and_finalize(mr);
+      return true;
+    }
+
+
+    /**
+     * Performs one periodic aggregation of the key. An incremental
+     * aggregator with a valid running total only folds in the changes
+     * reported since the last tick. All other aggregators perform a full
+     * aggregate_now(). Must be called on all machines simultaneously,
+     * while no thread is reporting vertex changes.
+     */
+    bool aggregate_tick(const std::string& key) {
+      typename std::map<std::string, iincremental_state_base*>::iterator
+          inc = incremental_state_map.find(key);
+      if (inc == incremental_state_map.end() || !inc->second->has_total()) {
+        return aggregate_now(key);
+      }
+      iincremental_state_base* state = inc->second;
+      imap_reduce_base* mr = aggregators[key];
+      for (size_t i = 0; i < nthreads; ++i) state->merge_thread(i);
+      any total = state->get_total();
+      mr->clear_accumulator();
+      mr->set_accumulator_any(total);
+      reduce_and_finalize(mr);
+      return true;
+    }
+
+  private:
+    /**
+     * Combines the local accumulators of mr across all machines and
+     * calls finalize with the result on every machine.
+     */
+    void reduce_and_finalize(imap_reduce_base* mr) {
       std::vector<any> gathervec(rmi.numprocs());
       gathervec[rmi.procid()] = mr->get_accumulator();
       
@@ -585,8 +826,9 @@ namespace graphlab {
       mr->finalize(*context);
       mr->clear_accumulator();
       gathervec.clear();
-      return true;
     }
+
+  public:
     
     
     /**
@@ -623,8 +865,11 @@ namespace graphlab {
      *
      * \param [in] cpus Number of engine threads used. This is only necessary
      *                  if the asynchronous form is used.
+     * \param [in] nthreads Number of engine threads which report vertex
+     *                      changes to the incremental aggregators.
+     *                      Defaults to ncpus.
      */
-    void start(size_t ncpus = 0) {
+    void start(size_t ncpus = 0, size_t nthreads = 0) {
       rmi.barrier();
       schedule.clear();
       start_time = timer::approx_time_seconds();
@@ -637,6 +882,10 @@ namespace graphlab {
         ++iter;
       }
       this->ncpus = ncpus;
+      this->nthreads = std::max(ncpus, nthreads);
+      for (size_t i = 0; i < incremental_states.size(); ++i) {
+        incremental_states[i]->resize(this->nthreads);
+      }
 
       // now initialize the asyncronous reduction states
       if(ncpus > 0) {
@@ -708,8 +957,15 @@ namespace graphlab {
       ASSERT_GT(iter->second.per_thread_aggregation.size(), cpuid);
       
       imap_reduce_base* localmr = iter->second.per_thread_aggregation[cpuid];
+      typename std::map<std::string, iincremental_state_base*>::iterator
+          inc = incremental_state_map.find(key);
       // perform the reduction using the local mr
-      if (localmr->is_vertex_map()) {
+      if (inc != incremental_state_map.end()) {
+        // the running total was set by aggregate_all_periodic() on start.
+        // Only fold in the changes made by this thread.
+        ASSERT_TRUE(inc->second->has_total());
+        inc->second->merge_thread(cpuid);
+      } else if (localmr->is_vertex_map()) {
         for (int i = cpuid;i < (int)graph.num_local_vertices(); i+=ncpus) {
           local_vertex_type lvertex = graph.l_vertex(i);
           if (lvertex.owner() == rmi.procid()) {
@@ -741,6 +997,10 @@ namespace graphlab {
           iter->second.per_thread_aggregation[i]->clear_accumulator();
         }
         iter->second.local_count_down = ncpus;
+        if (inc != incremental_state_map.end()) {
+          any total = inc->second->get_total();
+          iter->second.root_reducer->add_accumulator_any(total);
+        }
         
         if (rmi.procid() != 0) {
           // ok we need to signal back to the the root to perform finalization
@@ -874,7 +1134,7 @@ namespace graphlab {
       std::vector<std::pair<std::string, float> > next_schedule;
       while(!schedule.empty() && -schedule.top().second <= curtime) {
         std::string key = schedule.top().first;
-        aggregate_now(key);
+        aggregate_tick(key);
         schedule.pop();
         // when is the next time we start. 
         // time is as an offset to start_time
@@ -904,6 +1164,11 @@ namespace graphlab {
           ++iter;
         }
       }
+      // the graph may change between engine runs. The next run of an
+      // incremental aggregator must start with a full recompute.
+      for (size_t i = 0; i < incremental_states.size(); ++i) {
+        incremental_states[i]->invalidate();
+      }
       // clear the asynchronous state
       {
         typename std::map<std::string, async_aggregator_state>::iterator
@@ -0,0 +1,181 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_ACTIVE_BATCH_CONTROLLER_HPP
+#define GRAPHLAB_ACTIVE_BATCH_CONTROLLER_HPP
+
+#include <algorithm>
+#include <graphlab/serialization/is_pod.hpp>
+
+namespace graphlab {
+
+  /**
+   * \internal
+   * \brief What the semi synchronous engine measured over one
+   * super-step, summed over all machines.
+   */
+  struct active_batch_measurement : public IS_POD_TYPE {
+    /// Wall time of the activation, gather, apply and scatter phases
+    double compute_time;
+    /// Wall time of the message exchange, barriers and aggregators
+    double overhead_time;
+    /// Bytes waiting in the send queues at the end of the super-step
+    double send_queue_bytes;
+    /// Vertex programs executed
+    double applies;
+    /// Signals raised by the vertex programs
+    double signals;
+    /// Vertex programs which could have run had the batch been larger
+    double backlog;
+    active_batch_measurement() :
+      compute_time(0), overhead_time(0), send_queue_bytes(0),
+      applies(0), signals(0), backlog(0) { }
+    active_batch_measurement&
+    operator+=(const active_batch_measurement& other) {
+      compute_time += other.compute_time;
+      overhead_time += other.overhead_time;
+      send_queue_bytes += other.send_queue_bytes;
+      applies += other.applies;
+      signals += other.signals;
+      backlog += other.backlog;
+      return *this;
+    }
+  }; // end of active_batch_measurement
+
+
+  /**
+   * \internal
+   * \brief Chooses the number of vertices the semi synchronous engine
+   * activates on each machine in the next super-step.
+   *
+   * A larger batch amortizes the fixed cost of a super-step (the
+   * barriers, the thread launches of every phase, the message
+   * exchange and the aggregators) over more vertex programs, while a
+   * smaller batch lets every vertex program see more recent values of
+   * its neighbors, which usually means fewer updates to converge. The
+   * controller increases and decreases the batch multiplicatively
+   * between these two forces:
+   *
+   * \li If the send queues hold more than max_queue_bytes per machine
+   *     the network is the bottleneck: the batch is halved.
+   * \li If the fixed cost exceeds overhead_fraction of the super-step
+   *     the batch is doubled.
+   * \li If the number of signals raised per apply grew by more than
+   *     convergence_tolerance over its recent average, the vertex
+   *     programs are working on stale values: the batch is shrunk by
+   *     a quarter.
+   *
+   * The fixed cost is the intercept of a least squares fit of the
+   * super-step time against the number of applies, weighted towards
+   * the recent super-steps. Until the batch has varied enough to fit
+   * a line, the measured time outside the vertex program phases is
+   * used instead.
+   *
+   * The batch is only adjusted while it actually limits the
+   * activations, i.e. while vertices are left waiting in the
+   * scheduler. Every machine applies the same rule to the same summed
+   * measurements, so all machines scale their batches alike.
+   */
+  class active_batch_controller {
+  public:
+    active_batch_controller(size_t initial_batch = 1000,
+                            size_t min_batch = 100,
+                            size_t max_batch = size_t(-1)) :
+      batch(initial_batch), min_batch(min_batch), max_batch(max_batch),
+      overhead_fraction(0.2), max_queue_bytes(64 * 1024 * 1024),
+      convergence_tolerance(0.25), average_signal_rate(-1),
+      sw(0), sx(0), sy(0), sxx(0), sxy(0) {
+      batch = std::min(std::max(batch, min_batch), max_batch);
+    }
+
+    /// The current batch size per machine
+    size_t batch_size() const { return batch; }
+
+    void set_overhead_fraction(double f) { overhead_fraction = f; }
+    void set_max_queue_bytes(double b) { max_queue_bytes = b; }
+    void set_convergence_tolerance(double t) { convergence_tolerance = t; }
+
+    /**
+     * Updates the batch size from the measurements of the last
+     * super-step summed over nprocs machines, and returns it.
+     */
+    size_t update(const active_batch_measurement& m, size_t nprocs) {
+      const double signal_rate = m.applies > 0 ? m.signals / m.applies : 0;
+      const double step_time = m.compute_time + m.overhead_time;
+      const double fixed_time = fit_fixed_time(m.applies, step_time,
+                                               m.overhead_time);
+      double scale = 1.0;
+      if (m.backlog > 0) {
+        if (m.send_queue_bytes > max_queue_bytes * nprocs) {
+          scale = 0.5;
+        } else if (step_time > 0 && fixed_time > overhead_fraction * step_time) {
+          scale = 2.0;
+        } else if (average_signal_rate > 0 && signal_rate >
+                   average_signal_rate * (1 + convergence_tolerance)) {
+          scale = 0.75;
+        }
+      }
+      average_signal_rate = average_signal_rate < 0 ? signal_rate :
+          decay() * average_signal_rate + (1 - decay()) * signal_rate;
+      const double next = std::max(double(batch) * scale, 1.0);
+      batch = next >= double(max_batch) ? max_batch : size_t(next);
+      batch = std::max(batch, min_batch);
+      return batch;
+    }
+
+  private:
+    /// The weight of the history in the running averages
+    static double decay() { return 0.8; }
+
+    size_t batch;
+    size_t min_batch;
+    size_t max_batch;
+    double overhead_fraction;
+    double max_queue_bytes;
+    double convergence_tolerance;
+    double average_signal_rate;
+    /// The decayed sums of the fit of step time (y) against applies (x)
+    double sw, sx, sy, sxx, sxy;
+
+    /**
+     * Adds the super-step to the fit and returns the estimated fixed
+     * cost of a super-step, which is at least the measured overhead.
+     */
+    double fit_fixed_time(double applies, double step_time,
+                          double overhead_time) {
+      sw = decay() * sw + 1;
+      sx = decay() * sx + applies;
+      sy = decay() * sy + step_time;
+      sxx = decay() * sxx + applies * applies;
+      sxy = decay() * sxy + applies * step_time;
+      const double det = sw * sxx - sx * sx;
+      // the batch has not varied enough to separate the two costs
+      if (!(det > 1e-6 * sw * sxx)) return overhead_time;
+      const double slope = std::max((sw * sxy - sx * sy) / det, 0.0);
+      const double intercept = (sy - slope * sx) / sw;
+      return std::max(intercept, overhead_time);
+    }
+  }; // end of active_batch_controller
+
+} // end of namespace graphlab
+
+#endif
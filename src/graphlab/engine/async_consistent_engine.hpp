@@ -42,6 +42,7 @@
 
 #include <graphlab/util/tracepoint.hpp>
 #include <graphlab/util/memory_info.hpp>
+#include <graphlab/util/slab_allocator.hpp>
 #include <graphlab/rpc/distributed_event_log.hpp>
 #include <graphlab/rpc/async_consensus.hpp>
 #include <graphlab/engine/fake_chandy_misra.hpp>
@@ -681,6 +682,13 @@ namespace graphlab {
         engine_start_time(timer::approx_time_seconds()), force_stop(false),
         vdata_exchange(dc),thread_barrier(opts.get_ncpus()) {
       rmi.barrier();
+      // gathers are in flight for as long as the engine runs, so there
+      // is no point at which the superstep_arena could be released
+      if (superstep_scoped<gather_type>::value) {
+        logstream(LOG_FATAL) << "The asynchronous engine cannot be used "
+                             << "with a superstep scoped gather type."
+                             << std::endl;
+      }
 
       // set default values
       max_clean_fraction = 1.0;
@@ -819,6 +827,10 @@ namespace graphlab {
       consensus = new async_consensus(rmi.dc(), ncpus);
 
       // if cache is enabled, allocate the cache
+      if (use_cache && !cacheable_gather<gather_type>::value) {
+        logstream(LOG_FATAL) << "Gather caching cannot be used with this "
+                             << "gather type." << std::endl;
+      }
       if (use_cache) cache.resize(graph.num_local_vertices());
       
       // finally, the thread local queues
@@ -1061,28 +1073,46 @@ namespace graphlab {
                     const message_type& message = message_type(),
                     const std::string& order = "shuffle") {
       logstream(LOG_DEBUG) << rmi.procid() << ": Schedule All" << std::endl;
-      // allocate a vector with all the local owned vertices
-      // and schedule all of them. 
-      std::vector<vertex_id_type> vtxs;
-      vtxs.reserve(graph.num_local_own_vertices());
-      for(lvid_type lvid = 0; 
-          lvid < graph.get_local_graph().num_vertices(); 
-          ++lvid) {
-        if (graph.l_vertex(lvid).owner() == rmi.procid() && 
-            vset.l_contains(lvid)) {
-          vtxs.push_back(lvid);        
-        }
-      } 
-      
       if(order == "shuffle") {
+        // collect the owned vertices in the set and schedule them in
+        // random order
+        std::vector<lvid_type> vtxs;
+        signal_visitor collector(this, message, &vtxs);
+        vset.for_each_lvid(graph, collector);
         graphlab::random::shuffle(vtxs.begin(), vtxs.end());
-      }
-      foreach(lvid_type lvid, vtxs) {
-        scheduler_ptr->schedule(lvid, message);    
+        foreach(lvid_type lvid, vtxs) {
+          scheduler_ptr->schedule(lvid, message);    
+        }
+      } else {
+        signal_visitor visitor(this, message, NULL);
+        vset.for_each_lvid(graph, visitor);
       }
       rmi.barrier();
     }
 
+  private:
+    /**
+     * Passed to vertex_set::for_each_lvid() by signal_vset(); skips
+     * mirrors. Schedules each owned vertex, or appends it to vtxs if
+     * set.
+     */
+    struct signal_visitor {
+      async_consistent_engine* engine;
+      const message_type& message;
+      std::vector<lvid_type>* vtxs;
+      signal_visitor(async_consistent_engine* engine,
+                     const message_type& message,
+                     std::vector<lvid_type>* vtxs) :
+        engine(engine), message(message), vtxs(vtxs) { }
+      void operator()(lvid_type lvid) {
+        if (engine->graph.l_vertex(lvid).owner() != engine->rmi.procid()) {
+          return;
+        }
+        if (vtxs != NULL) vtxs->push_back(lvid);
+        else engine->scheduler_ptr->schedule(lvid, message);
+      }
+    };
+
 /**************************************************************************
  *                         Computation Processing                         *
  * Internal vertex program scheduling. The functions are arranged roughly *
@@ -1426,7 +1456,7 @@ namespace graphlab {
      * the gathered values stored in the vertex_state.
      * Locks should be acquired.
      */
-    void do_apply(lvid_type lvid) { 
+    void do_apply(lvid_type lvid, size_t threadid) { 
       BEGIN_TRACEPOINT(disteng_evalfac);
       context_type context(*this, graph);
       
@@ -1434,9 +1464,13 @@ namespace graphlab {
       
       logstream(LOG_DEBUG) << rmi.procid() << ": Apply On " << vertex.id() << std::endl;   
       vstate[lvid].d_lock();
+      const bool incremental_aggregation =
+        aggregator.has_incremental_aggregators();
+      if (incremental_aggregation) aggregator.retract_vertex(threadid, vertex);
       vstate[lvid].vertex_program.apply(context, 
                                         vertex, 
                                         vstate[lvid].combined_gather.value);
+      if (incremental_aggregation) aggregator.contribute_vertex(threadid, vertex);
       vstate[lvid].d_unlock();
       vstate[lvid].combined_gather.clear();
 
@@ -1574,7 +1608,7 @@ EVAL_INTERNAL_TASK_RE_EVAL_STATE:
           logstream(LOG_DEBUG) << rmi.procid() << ": Internal Task: " 
                               << graph.global_vid(lvid) << ": APPLYING" << std::endl;
 
-          do_apply(lvid);
+          do_apply(lvid, threadid);
           vstate[lvid].state = SCATTERING;
           master_broadcast_scattering(lvid,
                                       vstate[lvid].vertex_program,
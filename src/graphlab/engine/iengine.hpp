@@ -550,6 +550,74 @@ namespace graphlab {
     } // end of add vertex aggregator
 
 #endif
+
+
+    /**
+     * \brief Creates an incremental vertex aggregator. Returns true on
+     *        success. Returns false if an aggregator of the same name
+     *        already exists.
+     *
+     * An incremental aggregator computes the same value as an
+     * aggregator created with add_vertex_aggregator(), but its
+     * periodic evaluation (see aggregate_periodic()) does not scan the
+     * graph. Instead, the engine evaluates the map function on every
+     * vertex both before and after each apply, and keeps a running sum
+     * of the differences on each thread. A periodic evaluation merges
+     * these differences into the total of the previous evaluation,
+     * making its cost independent of the size of the graph. A call to
+     * aggregate_now() always performs a full recompute.
+     *
+     * This is only correct if the reduction is invertible: the
+     * ReductionType must have an operator-= which undoes operator+=
+     * (for instance integer and floating point sums, or vectors
+     * of those). In addition, the map function must depend only on the
+     * data of the vertex, since only changes made by apply are tracked.
+     * Since floating point sums are not exactly invertible, an
+     * occasional aggregate_now() may be used to discard accumulated
+     * rounding errors.
+     *
+     * For instance, to keep track of the number of converged vertices:
+     * \code
+     * size_t is_converged(engine_type::icontext_type& context,
+     *                     const graph_type::vertex_type& vertex) {
+     *   return vertex.data().converged;
+     * }
+     *
+     * engine.add_incremental_vertex_aggregator<size_t>("converged",
+     *                                                  is_converged,
+     *                                                  print_finalize);
+     * engine.aggregate_periodic("converged", 1.0);
+     * \endcode
+     *
+     * \tparam ReductionType The output of the map function. Must have
+     *                        operator+= and operator-= defined, and must
+     *                        be \ref sec_serializable.
+     *
+     * \param [in] key The name of this aggregator. Must be unique.
+     * \param [in] map_function The Map function to use. As in
+     *                          add_vertex_aggregator().
+     * \param [in] finalize_function The Finalize function to use. As in
+     *                               add_vertex_aggregator().
+     */
+    template <typename ReductionType,
+              typename VertexMapType,
+              typename FinalizerType>
+    bool add_incremental_vertex_aggregator(const std::string& key,
+                                           VertexMapType map_function,
+                                           FinalizerType finalize_function) {
+      BOOST_CONCEPT_ASSERT((graphlab::Serializable<ReductionType>));
+      BOOST_CONCEPT_ASSERT((graphlab::OpPlusEq<ReductionType>));
+
+      aggregator_type* aggregator = get_aggregator();
+      if(aggregator == NULL) {
+        logstream(LOG_FATAL) << "Aggregation not supported by this engine!" 
+                             << std::endl;
+        return false; // does not return
+      }
+      return aggregator->template add_incremental_vertex_aggregator
+        <ReductionType>(key, map_function, finalize_function);
+    } // end of add incremental vertex aggregator
+
    
 
     /** 
@@ -26,7 +26,10 @@
 #define GRAPHLAB_SEMI_SYNCHRONOUS_ENGINE_HPP
 
 #include <deque>
+#include <cmath>
+#include <limits>
 #include <algorithm>
+#include <functional>
 #include <boost/bind.hpp>
 
 #include <graphlab/engine/iengine.hpp>
@@ -36,6 +39,8 @@
 #include <graphlab/vertex_program/context.hpp>
 
 #include <graphlab/engine/execution_status.hpp>
+#include <graphlab/engine/active_batch_controller.hpp>
+#include <graphlab/scheduler/get_message_priority.hpp>
 #include <graphlab/options/graphlab_options.hpp>
 
 
@@ -46,6 +51,7 @@
 #include <graphlab/parallel/lockfree_push_back.hpp>
 #include <graphlab/util/tracepoint.hpp>
 #include <graphlab/util/memory_info.hpp>
+#include <graphlab/util/slab_allocator.hpp>
 
 #include <graphlab/rpc/dc_dist_object.hpp>
 #include <graphlab/rpc/distributed_event_log.hpp>
@@ -196,6 +202,41 @@ namespace graphlab {
    * or update (\ref icontext::post_delta) the cache values of 
    * neighboring vertices during the scatter phase.
    *
+   * \li <b>max_active_vertices</b>: (default: 10% of the local
+   * vertices, at least 1000) The maximum number of vertices each
+   * machine activates in a super-step.
+   *
+   * \li <b>max_active_fraction</b>: Sets max_active_vertices as a
+   * fraction of the local vertices. A value of 0 or less removes the
+   * limit.
+   *
+   * \li <b>adaptive_active_vertices</b>: (default: false) Tune the
+   * number of vertices activated in each super-step with a feedback
+   * controller (\ref graphlab::active_batch_controller), starting
+   * from max_active_vertices. The batch grows while the fixed cost of
+   * a super-step dominates, and shrinks when the send queues back up
+   * or when the vertex programs signal more per update than in the
+   * previous super-step. The chosen sizes are reported by the
+   * "Active Batch Size" event and by active_vertices_history().
+   *
+   * \li <b>min_active_vertices</b>: (default: 100) The smallest batch
+   * the adaptive controller may choose.
+   *
+   * \li <b>priority_selection</b>: (default: false) Activate the
+   * vertices whose messages have the highest priority
+   * (\c message_type::priority()) instead of those which come first
+   * in the scheduler order. All the scheduled vertices are drawn from
+   * the scheduler at the start of each super-step and the machines
+   * agree on a priority threshold admitting about max_active_vertices
+   * vertices per machine, using a histogram of the priorities summed
+   * by an all-reduce. Each machine then activates the vertices above
+   * the threshold, at most max_active_vertices of them, and returns
+   * the others to the scheduler. Residual based algorithms such as
+   * residual belief propagation then converge in fewer updates and
+   * super-steps. Since every scheduled vertex is drawn and returned in
+   * each super-step, this pays off when the super-steps themselves
+   * are expensive, as on many machines.
+   *
    * \li \b snapshot_interval If set to a positive value, a snapshot
    * is taken every this number of iterations. If set to 0, a snapshot
    * is taken before the first iteration. If set to a negative value,
@@ -404,10 +445,76 @@ namespace graphlab {
 
 
     /**
-     * \brief the minimum number of active vertices per round
+     * \brief the maximum number of active vertices per round
      */
     size_t max_active_vertices;
 
+    /**
+     * \brief If set, max_active_vertices is chosen by batch_controller
+     * after every super-step.
+     */
+    bool adaptive_active_vertices;
+
+    active_batch_controller batch_controller;
+
+    /**
+     * \brief The value of max_active_vertices used in each super-step
+     * of the last run.
+     */
+    std::vector<size_t> active_vertices_trace;
+
+    /**
+     * \brief The number of signals raised during the super-step.
+     * Only counted when adaptive_active_vertices is set.
+     */
+    atomic<size_t> num_signals;
+
+    /**
+     * \brief The number of threads which stopped activating vertices
+     * because they reached their share of max_active_vertices rather
+     * than because the scheduler ran empty.
+     */
+    atomic<size_t> num_saturated_threads;
+
+    /**
+     * \brief If set, the vertices with the highest priority messages
+     * are activated in each super-step.
+     */
+    bool priority_selection;
+
+    /// A scheduled vertex considered by priority_selection
+    struct candidate_type {
+      lvid_type lvid;
+      message_type message;
+      double priority;
+    };
+
+    /// The scheduled vertices drawn by each thread
+    std::vector<std::vector<candidate_type> > candidates;
+
+    /// The number of buckets of priority_histogram
+    static const size_t PRIORITY_BUCKETS = 128;
+
+    /**
+     * \brief The number of scheduled vertices in each priority bucket.
+     * Bucket 0 holds the priorities <= 0 and each other bucket half a
+     * power of two.
+     */
+    struct priority_histogram : public IS_POD_TYPE {
+      size_t counts[PRIORITY_BUCKETS];
+      priority_histogram() { std::fill(counts, counts + PRIORITY_BUCKETS, 0); }
+      priority_histogram& operator+=(const priority_histogram& other) {
+        for (size_t i = 0; i < PRIORITY_BUCKETS; ++i) counts[i] += other.counts[i];
+        return *this;
+      }
+    };
+
+    /// Candidates in a bucket below this one are not activated
+    size_t selection_bucket;
+
+    /// Candidates with a priority below this one are not activated
+    double selection_cutoff;
+
     /**
      * \brief The vertex locks protect access to vertex specific
      * data-structures including 
@@ -590,6 +697,7 @@ namespace graphlab {
     DECLARE_EVENT(EVENT_GATHERS);
     DECLARE_EVENT(EVENT_SCATTERS);
     DECLARE_EVENT(EVENT_ACTIVE_CPUS);
+    DECLARE_EVENT(EVENT_ACTIVE_BATCH);
   public:
 
     /**
@@ -626,6 +734,7 @@ namespace graphlab {
 
 
     ~semi_synchronous_engine() {
+      FREE_CALLBACK_EVENT(EVENT_ACTIVE_BATCH);
       delete scheduler_ptr;
     }
 
@@ -690,8 +799,20 @@ namespace graphlab {
      */
     aggregator_type* get_aggregator();
 
+    /**
+     * \brief Returns the maximum number of vertices each machine
+     * activated in every super-step of the last run. The values only
+     * change between super-steps when adaptive_active_vertices is set.
+     */
+    const std::vector<size_t>& active_vertices_history() const {
+      return active_vertices_trace;
+    }
+
   private:
 
+    /// Returns max_active_vertices for the event log
+    double active_batch_size() const { return double(max_active_vertices); }
+
     /**
      * \brief This internal stop function is called by the \ref graphlab::context to
      * terminate execution of the engine.
@@ -715,6 +836,20 @@ namespace graphlab {
     void internal_signal(const vertex_type& vertex,
                          const message_type& message = message_type()); 
 
+    /// Passed to vertex_set::for_each_lvid() by signal_vset(); skips mirrors
+    struct signal_visitor {
+      semi_synchronous_engine* engine;
+      const message_type& message;
+      signal_visitor(semi_synchronous_engine* engine, const message_type& message) :
+        engine(engine), message(message) { }
+      void operator()(lvid_type lvid) {
+        if(engine->graph.l_is_master(lvid)) {
+          engine->internal_signal(vertex_type(engine->graph.l_vertex(lvid)),
+                                  message);
+        }
+      }
+    };
+
     /**
      * \brief Called by the context to signal an arbitrary vertex.
      * This must be done by finding the owner of that vertex. 
@@ -828,6 +963,38 @@ namespace graphlab {
      */
     void transfer_scheduler_to_active(size_t thread_id);
 
+    /**
+     * \brief Activates the vertex: initializes its vertex program with
+     * the message and marks it for the gather.
+     */
+    void activate_vertex(context_type& context, size_t thread_id,
+                         lvid_type lvid, const message_type& msg);
+
+    /**
+     * \brief Moves all the vertices in the scheduler to candidates
+     * for priority_selection.
+     */
+    void drain_scheduler(size_t thread_id);
+
+    /**
+     * \brief Chooses selection_bucket and selection_cutoff from the
+     * candidates of all the machines.
+     */
+    void choose_priority_threshold();
+
+    static size_t priority_bucket(double priority) {
+      if (!(priority > 0)) return 0;
+      const double bucket = std::floor(2 * std::log(priority) / std::log(2.0))
+          + double(PRIORITY_BUCKETS / 2);
+      return size_t(std::min(std::max(bucket, 1.0),
+                             double(PRIORITY_BUCKETS - 1)));
+    }
+
+    bool is_selected(double priority) const {
+      return priority_bucket(priority) >= selection_bucket &&
+          priority >= selection_cutoff;
+    }
+
 
     /** 
      * \brief Execute the \ref graphlab::ivertex_program::gather function on all 
@@ -995,6 +1162,8 @@ namespace graphlab {
     max_iterations(-1), snapshot_interval(-1), iteration_counter(0),
     started(false), timeout(0),
     max_active_vertices(1000),
+    adaptive_active_vertices(false),
+    priority_selection(false),
     scheduler_ptr(NULL),
     active_superstep(128),
     active_superstep_pushback(active_superstep, 0), 
@@ -1009,6 +1178,7 @@ namespace graphlab {
     std::vector<std::string> keys = opts.get_engine_args().get_option_keys();
     per_thread_compute_time.resize(opts.get_ncpus());
     bool use_cache = false;
+    size_t min_active_vertices = 100;
 
     graph.finalize();
 
@@ -1060,10 +1230,34 @@ namespace graphlab {
           logstream(LOG_EMPH) << "Engine Option: max_active_fraction = " 
                               << max_active_fraction << std::endl;
         }
+      } else if (opt == "adaptive_active_vertices") {
+        opts.get_engine_args().get_option("adaptive_active_vertices",
+                                          adaptive_active_vertices);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: adaptive_active_vertices = " 
+                              << adaptive_active_vertices << std::endl;
+      } else if (opt == "priority_selection") {
+        opts.get_engine_args().get_option("priority_selection",
+                                          priority_selection);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: priority_selection = " 
+                              << priority_selection << std::endl;
+      } else if (opt == "min_active_vertices") {
+        opts.get_engine_args().get_option("min_active_vertices",
+                                          min_active_vertices);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: min_active_vertices = " 
+                              << min_active_vertices << std::endl;
       } else {
         logstream(LOG_FATAL) << "Unexpected Engine Option: " << opt << std::endl;
       }
     }
+    if (adaptive_active_vertices) {
+      batch_controller = active_batch_controller(
+          max_active_vertices, std::max<size_t>(min_active_vertices, 1),
+          std::max<size_t>(graph.num_local_vertices(), min_active_vertices));
+      max_active_vertices = batch_controller.batch_size();
+    }
 
     if (snapshot_interval >= 0 && snapshot_path.length() == 0) {
       logstream(LOG_FATAL) 
@@ -1074,6 +1268,9 @@ namespace graphlab {
     ADD_CUMULATIVE_EVENT(EVENT_GATHERS , "Gathers", "Calls");
     ADD_CUMULATIVE_EVENT(EVENT_SCATTERS , "Scatters", "Calls");
     ADD_INSTANTANEOUS_EVENT(EVENT_ACTIVE_CPUS, "Active Threads", "Threads");
+    ADD_INSTANTANEOUS_CALLBACK_EVENT(EVENT_ACTIVE_BATCH, "Active Batch Size",
+        "Vertices", boost::bind(&semi_synchronous_engine::active_batch_size,
+                                this));
 
     // Finalize the graph
     memory_info::log_usage("Before Engine Initialization");
@@ -1082,6 +1279,7 @@ namespace graphlab {
     active_minorstep.resize(2 * max_active_vertices);
     vlocks.resize(graph.num_local_vertices());
     vertex_programs.resize(graph.num_local_vertices());
+    candidates.resize(opts.get_ncpus());
     has_remote_message.resize(graph.num_local_vertices());
     has_remote_message.clear();
     // allocate the edge locks
@@ -1092,6 +1290,14 @@ namespace graphlab {
     has_gather_accum.clear();
     // If caching is used then allocate cache data-structures
     if (use_cache) {
+      if (superstep_scoped<gather_type>::value) {
+        logstream(LOG_FATAL) << "Gather caching cannot be used with a "
+                             << "superstep scoped gather type." << std::endl;
+      }
+      if (!cacheable_gather<gather_type>::value) {
+        logstream(LOG_FATAL) << "Gather caching cannot be used with this "
+                             << "gather type." << std::endl;
+      }
       gather_cache.resize(graph.num_local_vertices(), gather_type());
       has_cache.resize(graph.num_local_vertices());
       has_cache.clear();
@@ -1167,11 +1373,8 @@ namespace graphlab {
   void semi_synchronous_engine<VertexProgram>::
   signal_vset(const vertex_set& vset,
              const message_type& message, const std::string& order) {
-    for(lvid_type lvid = 0; lvid < graph.num_local_vertices(); ++lvid) {
-      if(graph.l_is_master(lvid) && vset.l_contains(lvid)) {
-        internal_signal(vertex_type(graph.l_vertex(lvid)), message);
-      }
-    }
+    signal_visitor visitor(this, message);
+    vset.for_each_lvid(graph, visitor);
   } // end of signal all
  
 
@@ -1185,6 +1388,8 @@ namespace graphlab {
       has_remote_message.set_bit(lvid);
     }
     else {
+      // every signal reaches the master exactly once
+      if (adaptive_active_vertices) num_signals.inc();
       if (started) {
         scheduler_ptr->schedule_from_execution_thread(thread::thread_id(),
                                                       lvid, message);
@@ -1287,8 +1492,9 @@ namespace graphlab {
     start_time = timer::approx_time_seconds();
     iteration_counter = 0;
     force_abort = false;
+    active_vertices_trace.clear();
     execution_status::status_enum termination_reason = execution_status::UNSET; 
-    aggregator.start();
+    aggregator.start(0, threads.size());
     scheduler_ptr->start();
     started = true;
 
@@ -1323,6 +1529,9 @@ namespace graphlab {
         last_print = elapsed_seconds();
       }
 
+      graphlab::timer step_timer; step_timer.start();
+      num_signals = 0;
+      num_saturated_threads = 0;
       run_synchronous( &semi_synchronous_engine::exchange_messages);
       has_remote_message.clear();
 
@@ -1339,9 +1548,16 @@ namespace graphlab {
       num_active_vertices = 0;
 
       rmi.barrier();
+      // activating the vertices is per vertex work, not fixed cost
+      double overhead_time = step_timer.current_time();
+      step_timer.start();
       // Exchange Messages --------------------------------------------------
       // Exchange any messages in the local message vectors
       // if (rmi.procid() == 0) std::cout << "Exchange messages..." << std::endl;
+      if (priority_selection) {
+        run_synchronous( &semi_synchronous_engine::drain_scheduler);
+        choose_priority_threshold();
+      }
       run_synchronous( &semi_synchronous_engine::transfer_scheduler_to_active);
 
       /**
@@ -1372,6 +1588,7 @@ namespace graphlab {
         termination_reason = execution_status::TASK_DEPLETION;
         break;
       }
+      active_vertices_trace.push_back(max_active_vertices);
 
       // Execute gather operations-------------------------------------------
       // Execute the gather operation for all vertices that are active
@@ -1406,6 +1623,8 @@ namespace graphlab {
        *      masters and mirrors) and the vertex program has been
        *      synchronized with the mirrors.         
        */
+      // The gathers of this batch have all been applied
+      if (superstep_scoped<gather_type>::value) superstep_arena::release();
 
 
       // Execute Scatter Operations -----------------------------------------
@@ -1414,6 +1633,8 @@ namespace graphlab {
 
 
       run_synchronous( &semi_synchronous_engine::execute_scatters );
+      const double compute_time = step_timer.current_time();
+      step_timer.start();
 
       /**
        * Post conditions:
@@ -1423,6 +1644,24 @@ namespace graphlab {
         logstream(LOG_EMPH) << "\t Running Aggregators" << std::endl;
       // probe the aggregator
       aggregator.tick_synchronous();
+
+      // Choose the number of vertices to activate next ----------------------
+      if (adaptive_active_vertices) {
+        overhead_time += step_timer.current_time();
+        active_batch_measurement measurement;
+        measurement.compute_time = compute_time;
+        measurement.overhead_time = overhead_time;
+        measurement.send_queue_bytes = rmi.dc().send_queue_length();
+        measurement.applies = num_active_vertices.value;
+        measurement.signals = num_signals.value;
+        measurement.backlog = num_saturated_threads.value;
+        rmi.all_reduce(measurement);
+        max_active_vertices = batch_controller.update(measurement,
+                                                      rmi.numprocs());
+        if (rmi.procid() == 0 && print_this_round)
+          logstream(LOG_EMPH) << "\t Active batch size: "
+                              << max_active_vertices << std::endl;
+      }
       
       ++iteration_counter;
       
@@ -1512,6 +1751,93 @@ namespace graphlab {
 
 
 
+  template<typename VertexProgram>
+  void semi_synchronous_engine<VertexProgram>::
+  drain_scheduler(const size_t thread_id) {
+    std::vector<candidate_type>& local_candidates = candidates[thread_id];
+    local_candidates.clear();
+    candidate_type candidate;
+    while (scheduler_ptr->get_next(thread_id, candidate.lvid,
+                                   candidate.message) != sched_status::EMPTY) {
+      candidate.priority =
+          scheduler_impl::get_message_priority(candidate.message);
+      local_candidates.push_back(candidate);
+    }
+  } // end of drain_scheduler
+
+
+
+  template<typename VertexProgram>
+  void semi_synchronous_engine<VertexProgram>::
+  choose_priority_threshold() {
+    priority_histogram local_histogram;
+    foreach(const std::vector<candidate_type>& local_candidates, candidates) {
+      foreach(const candidate_type& candidate, local_candidates) {
+        ++local_histogram.counts[priority_bucket(candidate.priority)];
+      }
+    }
+    priority_histogram histogram = local_histogram;
+    rmi.all_reduce(histogram);
+    // the lowest bucket such that the buckets above it hold at least
+    // max_active_vertices per machine
+    const size_t target = max_active_vertices >= size_t(-1) / rmi.numprocs() ?
+        size_t(-1) : max_active_vertices * rmi.numprocs();
+    size_t total = 0;
+    selection_bucket = 0;
+    for (size_t b = PRIORITY_BUCKETS; b > 0; --b) {
+      total += histogram.counts[b - 1];
+      if (total >= target) { selection_bucket = b - 1; break; }
+    }
+    // never activate more than max_active_vertices on this machine
+    const size_t limit = std::max<size_t>(max_active_vertices, 1);
+    selection_cutoff = -std::numeric_limits<double>::max();
+    size_t nselected = 0;
+    for (size_t b = selection_bucket; b < PRIORITY_BUCKETS; ++b) {
+      nselected += local_histogram.counts[b];
+    }
+    if (nselected > limit) {
+      std::vector<double> priorities;
+      priorities.reserve(nselected);
+      foreach(const std::vector<candidate_type>& local_candidates, candidates) {
+        foreach(const candidate_type& candidate, local_candidates) {
+          if (priority_bucket(candidate.priority) >= selection_bucket) {
+            priorities.push_back(candidate.priority);
+          }
+        }
+      }
+      std::nth_element(priorities.begin(),
+                       priorities.begin() + (limit - 1),
+                       priorities.end(), std::greater<double>());
+      selection_cutoff = priorities[limit - 1];
+    }
+  } // end of choose_priority_threshold
+
+
+
+  template<typename VertexProgram>
+  void semi_synchronous_engine<VertexProgram>::
+  activate_vertex(context_type& context, const size_t thread_id,
+                  const lvid_type lvid, const message_type& msg) {
+    // if the vertex is not local and has a message send the
+    // message and clear the bit
+    ASSERT_TRUE(graph.l_is_master(lvid));
+    // The vertex becomes active for this superstep 
+    // Pass the message to the vertex program
+    active_superstep_pushback.push_back(lvid);
+    vertex_type vertex = vertex_type(graph.l_vertex(lvid));
+    vertex_programs[lvid].init(context, vertex, msg);
+    // Determine if the gather should be run
+    const vertex_program_type& const_vprog = vertex_programs[lvid];
+    const vertex_type const_vertex = vertex;
+    if(const_vprog.gather_edges(context, const_vertex) != 
+       graphlab::NO_EDGES) {
+      active_minorstep_pushback.push_back(lvid);
+      sync_vertex_program(lvid, thread_id);
+    }  
+  } // end of activate_vertex
+
+
+
   template<typename VertexProgram>
   void semi_synchronous_engine<VertexProgram>::
   transfer_scheduler_to_active(const size_t thread_id) {
@@ -1522,30 +1848,36 @@ namespace graphlab {
     size_t curthread_num_to_activate = num_to_activate / threads.size();
     curthread_num_to_activate += (curthread_num_to_activate == 0);
     size_t nactive_inc = 0;
-    while (nactive_inc < curthread_num_to_activate) {
+    if (priority_selection) {
+      // activate the selected candidates and return the rest to the
+      // scheduler
+      bool has_backlog = false;
+      foreach(const candidate_type& candidate, candidates[thread_id]) {
+        if (is_selected(candidate.priority)) {
+          activate_vertex(context, thread_id, candidate.lvid,
+                          candidate.message);
+          nactive_inc++;
+          if (++vcount % TRY_RECV_MOD == 0) {
+            recv_vertex_programs(thread_id, TRY_TO_RECV);
+          }
+        } else {
+          scheduler_ptr->schedule(candidate.lvid, candidate.message);
+          has_backlog = true;
+        }
+      }
+      candidates[thread_id].clear();
+      // the activations are limited by the threshold instead
+      curthread_num_to_activate = has_backlog ? nactive_inc : nactive_inc + 1;
+    }
+    while (!priority_selection && nactive_inc < curthread_num_to_activate) {
       lvid_type lvid;
       message_type msg;
       sched_status::status_enum stat =
           scheduler_ptr->get_next(thread_id, lvid, msg);
       bool has_sched_msg = stat != sched_status::EMPTY;
       if (has_sched_msg) {
-        // if the vertex is not local and has a message send the
-        // message and clear the bit
-        ASSERT_TRUE(graph.l_is_master(lvid));
         nactive_inc++;
-        // The vertex becomes active for this superstep 
-        // Pass the message to the vertex program
-        active_superstep_pushback.push_back(lvid);
-        vertex_type vertex = vertex_type(graph.l_vertex(lvid));
-        vertex_programs[lvid].init(context, vertex, msg);
-        // Determine if the gather should be run
-        const vertex_program_type& const_vprog = vertex_programs[lvid];
-        const vertex_type const_vertex = vertex;
-        if(const_vprog.gather_edges(context, const_vertex) != 
-           graphlab::NO_EDGES) {
-          active_minorstep_pushback.push_back(lvid);
-          sync_vertex_program(lvid, thread_id);
-        }  
+        activate_vertex(context, thread_id, lvid, msg);
         if (++vcount % TRY_RECV_MOD == 0) {
           // to avoid popping the same task multiple times, it is
           // of critical importance that we do not recv_message here.
@@ -1559,6 +1891,7 @@ namespace graphlab {
     } // end of loop over vertices to send messages
     vprog_exchange.partial_flush(thread_id);
     num_active_vertices.inc(nactive_inc); 
+    if (nactive_inc >= curthread_num_to_activate) num_saturated_threads.inc();
     // Finish sending and receiving all messages
     rmi.dc().start_handler_threads(thread_id, threads.size());
     thread_barrier.wait();
@@ -1669,6 +2002,8 @@ namespace graphlab {
   void semi_synchronous_engine<VertexProgram>::
   execute_applys(const size_t thread_id) {
     context_type context(*this, graph);
+    const bool incremental_aggregation =
+      aggregator.has_incremental_aggregators();
     const bool TRY_TO_RECV = true;
     const size_t TRY_RECV_MOD = 1000;
     size_t vcount = 0;
@@ -1686,11 +2021,20 @@ namespace graphlab {
       // the gather_accum was not set during the gather.
       const gather_type& accum = gather_accum[lvid];
       INCREMENT_EVENT(EVENT_APPLIES, 1);
+      if (incremental_aggregation) aggregator.retract_vertex(thread_id, vertex);
       vertex_programs[lvid].apply(context, vertex, accum);
+      if (incremental_aggregation) aggregator.contribute_vertex(thread_id, vertex);
       // record an apply as a completed task
       ++completed_applys;
-      // Clear the accumulator to save some memory
-      gather_accum[lvid] = gather_type();
+      // Clear the accumulator to save some memory. An arena backed
+      // accumulator is rebuilt instead, since assigning would keep its
+      // buffers as capacity past the release of the arena.
+      if (superstep_scoped<gather_type>::value) {
+        gather_accum[lvid].~gather_type();
+        new (&gather_accum[lvid]) gather_type();
+      } else {
+        gather_accum[lvid] = gather_type();
+      }
       // synchronize the changed vertex data with all mirrors
       sync_vertex_data(lvid, thread_id);  
       // determine if a scatter operation is needed
@@ -0,0 +1,517 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_STREAMING_ENGINE_HPP
+#define GRAPHLAB_STREAMING_ENGINE_HPP
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include <graphlab/engine/execution_status.hpp>
+#include <graphlab/graph/streaming_graph.hpp>
+#include <graphlab/options/graphlab_options.hpp>
+#include <graphlab/vertex_program/ivertex_program.hpp>
+#include <graphlab/vertex_program/icontext.hpp>
+#include <graphlab/vertex_program/context.hpp>
+#include <graphlab/util/dense_bitset.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/logger.hpp>
+
+#include <graphlab/macros_def.hpp>
+namespace graphlab {
+
+  /**
+   * \ingroup engines
+   *
+   * \brief The streaming engine executes vertex programs synchronously
+   * on a \ref graphlab::streaming_graph, reading the edges from disk
+   * sequentially in every super-step.
+   *
+   * \tparam VertexProgram The user defined vertex program which
+   * should implement the \ref graphlab::ivertex_program interface,
+   * with a \ref graphlab::streaming_graph as its graph type.
+   *
+   * The engine is meant for occasional jobs whose edges do not fit in
+   * the memory of one machine. It has the execution semantics of the
+   * \ref graphlab::synchronous_engine, but is edge-centric: instead of
+   * visiting the edges of each active vertex, each phase streams all
+   * the edges of the graph, one streaming partition after another,
+   * and calls the vertex program of whichever endpoint wants the edge:
+   *
+   * \li Receive: \ref graphlab::ivertex_program::init is invoked on
+   * every vertex with a message.
+   * \li Gather: the edges are streamed and the gather of each active
+   * endpoint is invoked. Contributions to vertices of the partition
+   * being streamed are summed directly. Contributions to other
+   * partitions are appended to per partition update buffers, which
+   * are summed one partition at a time (shuffled) when they fill up,
+   * so that the accumulators are updated with good locality. The sum
+   * is therefore accumulated in an arbitrary order, which is only
+   * correct for programs whose gather is a commutative sum.
+   * \li Apply: \ref graphlab::ivertex_program::apply is invoked on
+   * every active vertex.
+   * \li Scatter: if any vertex scatters, the edges are streamed again
+   * and the scatter of each scattering endpoint is invoked.
+   *
+   * Each phase which modifies edge data writes the blocks it changed
+   * back in place. A phase is skipped when no vertex needs it, so a
+   * super-step reads the edges at most twice. The vertex data, messages,
+   * vertex programs and gather accumulators stay in memory.
+   *
+   * The engine runs on one machine with a single thread, since the
+   * super-steps are bound by the disk bandwidth. It does not support
+   * aggregators, gather caching or \ref graphlab::vertex_set.
+   *
+   * \code
+   * typedef graphlab::streaming_graph<float, graphlab::empty> graph_type;
+   * // pagerank derives from ivertex_program<graph_type, float>
+   * graphlab::streaming_engine<pagerank> engine(dc, graph, clopts);
+   * engine.signal_all();
+   * engine.start();
+   * \endcode
+   *
+   * <a name=engineopts>Engine Options</a>
+   * =====================
+   * \li <b>max_iterations</b>: (default: infinity) The maximum number
+   * of iterations (super-steps) to run.
+   *
+   * \li <b>timeout</b>: (default: infinity) The maximum time in
+   * seconds that the engine may run. When the time runs out the
+   * current iteration is completed and then the engine terminates.
+   *
+   * \li <b>block_size</b>: (default: 4194304) The number of bytes of
+   * edges read from disk at a time.
+   *
+   * \li <b>update_buffer_size</b>: (default: 1048576) The number of
+   * gather contributions to other partitions buffered before they are
+   * summed.
+   *
+   * \see graphlab::streaming_graph
+   * \see graphlab::synchronous_engine
+   */
+  template<typename VertexProgram>
+  class streaming_engine {
+  public:
+    typedef VertexProgram vertex_program_type;
+    typedef typename VertexProgram::gather_type gather_type;
+    typedef typename VertexProgram::message_type message_type;
+    typedef typename VertexProgram::vertex_data_type vertex_data_type;
+    typedef typename VertexProgram::edge_data_type edge_data_type;
+    typedef typename VertexProgram::graph_type graph_type;
+    typedef typename graph_type::vertex_id_type vertex_id_type;
+    typedef typename graph_type::vertex_type vertex_type;
+    typedef typename graph_type::edge_type edge_type;
+    typedef typename VertexProgram::icontext_type icontext_type;
+    typedef context<streaming_engine> context_type;
+    friend class context<streaming_engine>;
+
+  private:
+    graph_type& graph;
+
+    size_t max_iterations;
+    float timeout;
+    size_t block_size;
+    size_t update_buffer_size;
+
+    int iteration_counter;
+    float start_time;
+    bool force_abort;
+    size_t completed_applys;
+    /// The number of edge records read over all the passes
+    size_t edges_streamed;
+
+    /// The vertex program of each vertex active in this super-step
+    std::vector<vertex_program_type> vertex_programs;
+
+    std::vector<message_type> messages;
+    dense_bitset has_message;
+
+    std::vector<gather_type> gather_accum;
+    dense_bitset has_gather_accum;
+
+    /// The vertices active in this super-step
+    std::vector<vertex_id_type> active_vertices;
+
+    /**
+     * The gather and scatter edge directions of each vertex in this
+     * super-step, NO_EDGES if it is inactive.
+     */
+    std::vector<unsigned char> gather_dirs, scatter_dirs;
+
+    /// The gather contributions buffered for each streaming partition
+    std::vector<std::vector<std::pair<vertex_id_type, gather_type> > > updates;
+    size_t num_buffered_updates;
+
+    /// The partition being streamed
+    size_t current_partition;
+
+    struct gather_visitor {
+      streaming_engine& engine;
+      context_type& context;
+      void operator()(edge_type& edge) { engine.gather_edge(context, edge); }
+    };
+
+    struct scatter_visitor {
+      streaming_engine& engine;
+      context_type& context;
+      void operator()(edge_type& edge) { engine.scatter_edge(context, edge); }
+    };
+
+  public:
+    /**
+     * \brief Constructs a streaming engine for the graph. The graph
+     * must be finalized.
+     */
+    streaming_engine(distributed_control& dc, graph_type& graph,
+                     const graphlab_options& opts = graphlab_options());
+
+    /**
+     * \brief Runs the engine until no vertex has a message, the
+     * maximum number of iterations or the timeout is reached, or a
+     * vertex program calls stop.
+     */
+    execution_status::status_enum start();
+
+    /// \brief Sends the message to the vertex
+    void signal(vertex_id_type vid,
+                const message_type& message = message_type());
+
+    /// \brief Sends the message to every vertex
+    void signal_all(const message_type& message = message_type(),
+                    const std::string& order = "shuffle");
+
+    /// \brief Returns the number of applies executed
+    size_t num_updates() const { return completed_applys; }
+
+    /// \brief Returns the seconds elapsed since start was called
+    float elapsed_seconds() const {
+      return timer::approx_time_seconds() - start_time;
+    }
+
+    /// \brief Returns the current iteration
+    int iteration() const { return iteration_counter; }
+
+    /// \brief Returns the number of edges read from disk over all passes
+    size_t num_edges_streamed() const { return edges_streamed; }
+
+  private:
+    void internal_stop() { force_abort = true; }
+
+    void internal_signal(const vertex_type& vertex,
+                         const message_type& message = message_type()) {
+      signal(vertex.id(), message);
+    }
+
+    void internal_signal_broadcast(vertex_id_type vid,
+                                   const message_type& message = message_type()) {
+      signal(vid, message);
+    }
+
+    /// Without gather caching there is nothing to update
+    void internal_post_delta(const vertex_type& vertex,
+                             const gather_type& delta) { }
+
+    void internal_clear_gather_cache(const vertex_type& vertex) { }
+
+    /// Invokes init on every vertex with a message
+    void receive_messages(context_type& context);
+
+    /// Streams every partition through the visitor
+    template <typename Visitor>
+    void stream_edges(Visitor& visitor);
+
+    void gather_edge(context_type& context, edge_type& edge);
+
+    void scatter_edge(context_type& context, edge_type& edge);
+
+    /// Adds the gather contribution to the accumulator of the vertex
+    void accumulate(vertex_id_type vid, const gather_type& value) {
+      if (has_gather_accum.get(vid)) {
+        gather_accum[vid] += value;
+      } else {
+        gather_accum[vid] = value;
+        has_gather_accum.set_bit(vid);
+      }
+    }
+
+    /// Sums the buffered gather contributions one partition at a time
+    void shuffle_updates();
+
+    void execute_applys(context_type& context, size_t& nscatters);
+  }; // end of class streaming_engine
+
+
+
+  template<typename VertexProgram>
+  streaming_engine<VertexProgram>::
+  streaming_engine(distributed_control& dc, graph_type& graph,
+                   const graphlab_options& opts) :
+    graph(graph), max_iterations(-1), timeout(0),
+    block_size(4 << 20), update_buffer_size(1 << 20),
+    iteration_counter(0), start_time(0), force_abort(false),
+    completed_applys(0), edges_streamed(0), num_buffered_updates(0),
+    current_partition(0) {
+    ASSERT_EQ(dc.numprocs(), 1);
+    std::vector<std::string> keys = opts.get_engine_args().get_option_keys();
+    foreach(std::string opt, keys) {
+      if (opt == "max_iterations") {
+        opts.get_engine_args().get_option("max_iterations", max_iterations);
+        logstream(LOG_EMPH) << "Engine Option: max_iterations = "
+                            << max_iterations << std::endl;
+      } else if (opt == "timeout") {
+        opts.get_engine_args().get_option("timeout", timeout);
+        logstream(LOG_EMPH) << "Engine Option: timeout = "
+                            << timeout << std::endl;
+      } else if (opt == "block_size") {
+        opts.get_engine_args().get_option("block_size", block_size);
+        logstream(LOG_EMPH) << "Engine Option: block_size = "
+                            << block_size << std::endl;
+      } else if (opt == "update_buffer_size") {
+        opts.get_engine_args().get_option("update_buffer_size",
+                                          update_buffer_size);
+        logstream(LOG_EMPH) << "Engine Option: update_buffer_size = "
+                            << update_buffer_size << std::endl;
+      } else {
+        logstream(LOG_FATAL) << "Unexpected Engine Option: " << opt << std::endl;
+      }
+    }
+    graph.finalize();
+    const size_t nverts = graph.num_vertices();
+    vertex_programs.resize(nverts);
+    messages.resize(nverts, message_type());
+    has_message.resize(nverts);
+    has_message.clear();
+    gather_accum.resize(nverts, gather_type());
+    has_gather_accum.resize(nverts);
+    has_gather_accum.clear();
+    gather_dirs.resize(nverts, NO_EDGES);
+    scatter_dirs.resize(nverts, NO_EDGES);
+    updates.resize(graph.num_partitions());
+  } // end of streaming engine
+
+
+
+  template<typename VertexProgram>
+  void streaming_engine<VertexProgram>::
+  signal(vertex_id_type vid, const message_type& message) {
+    ASSERT_LT(vid, messages.size());
+    if (has_message.get(vid)) {
+      messages[vid] += message;
+    } else {
+      messages[vid] = message;
+      has_message.set_bit(vid);
+    }
+  } // end of signal
+
+
+
+  template<typename VertexProgram>
+  void streaming_engine<VertexProgram>::
+  signal_all(const message_type& message, const std::string& order) {
+    for (vertex_id_type vid = 0; vid < messages.size(); ++vid) {
+      signal(vid, message);
+    }
+  } // end of signal_all
+
+
+
+  template<typename VertexProgram>
+  execution_status::status_enum streaming_engine<VertexProgram>::start() {
+    start_time = timer::approx_time_seconds();
+    iteration_counter = 0;
+    force_abort = false;
+    execution_status::status_enum termination_reason =
+      execution_status::UNSET;
+    context_type context(*this, graph);
+    float last_print = -5;
+    logstream(LOG_EMPH) << "Iteration counter will only output every 5 seconds."
+                        << std::endl;
+    while(size_t(iteration_counter) < max_iterations && !force_abort) {
+      if(timeout != 0 && timeout < elapsed_seconds()) {
+        termination_reason = execution_status::TIMEOUT;
+        break;
+      }
+      const bool print_this_round = (elapsed_seconds() - last_print) >= 5;
+      if(print_this_round) {
+        logstream(LOG_EMPH) << "Starting iteration: " << iteration_counter
+                            << std::endl;
+        last_print = elapsed_seconds();
+      }
+
+      // Receive Messages ---------------------------------------------------
+      receive_messages(context);
+      if (print_this_round) {
+        logstream(LOG_EMPH) << "\tActive vertices: " << active_vertices.size()
+                            << std::endl;
+      }
+      if (active_vertices.empty()) {
+        termination_reason = execution_status::TASK_DEPLETION;
+        break;
+      }
+
+      // Stream the edges through the gathers -------------------------------
+      bool has_gather = false;
+      foreach(vertex_id_type vid, active_vertices) {
+        has_gather = has_gather || gather_dirs[vid] != NO_EDGES;
+      }
+      if (has_gather) {
+        gather_visitor visitor = {*this, context};
+        stream_edges(visitor);
+        shuffle_updates();
+      }
+
+      // Execute Apply Operations -------------------------------------------
+      size_t nscatters = 0;
+      execute_applys(context, nscatters);
+
+      // Stream the edges through the scatters ------------------------------
+      if (nscatters > 0) {
+        scatter_visitor visitor = {*this, context};
+        stream_edges(visitor);
+      }
+      foreach(vertex_id_type vid, active_vertices) {
+        scatter_dirs[vid] = NO_EDGES;
+        vertex_programs[vid] = vertex_program_type();
+      }
+      ++iteration_counter;
+    }
+    logstream(LOG_EMPH) << iteration_counter
+                        << " iterations completed." << std::endl;
+    graph.dc().cout() << "Updates: " << completed_applys << "\n";
+    return termination_reason;
+  } // end of start
+
+
+
+  template<typename VertexProgram>
+  void streaming_engine<VertexProgram>::
+  receive_messages(context_type& context) {
+    active_vertices.clear();
+    foreach(size_t vid, has_message) {
+      active_vertices.push_back(vid);
+      const vertex_type vertex(graph, vid);
+      vertex_programs[vid].init(context, vertex, messages[vid]);
+      // clear the message to save memory
+      messages[vid] = message_type();
+      const vertex_program_type& const_vprog = vertex_programs[vid];
+      gather_dirs[vid] = const_vprog.gather_edges(context, vertex);
+      if (gather_dirs[vid] != NO_EDGES) {
+        const_vprog.pre_local_gather(gather_accum[vid]);
+      }
+    }
+    has_message.clear();
+  } // end of receive_messages
+
+
+
+  template<typename VertexProgram>
+  template <typename Visitor>
+  void streaming_engine<VertexProgram>::stream_edges(Visitor& visitor) {
+    for (size_t p = 0; p < graph.num_partitions(); ++p) {
+      current_partition = p;
+      graph.stream_partition(p, visitor, true, block_size);
+      edges_streamed += graph.num_partition_edges(p);
+    }
+  } // end of stream_edges
+
+
+
+  template<typename VertexProgram>
+  void streaming_engine<VertexProgram>::
+  gather_edge(context_type& context, edge_type& edge) {
+    // the source is in the partition being streamed
+    const vertex_id_type source = edge.record.source;
+    const vertex_id_type target = edge.record.target;
+    if (gather_dirs[source] & OUT_EDGES) {
+      const vertex_type vertex(graph, source);
+      accumulate(source, vertex_programs[source].gather(context, vertex, edge));
+    }
+    if (gather_dirs[target] & IN_EDGES) {
+      const vertex_type vertex(graph, target);
+      const size_t partition = graph.partition_of(target);
+      if (partition == current_partition) {
+        accumulate(target, vertex_programs[target].gather(context, vertex, edge));
+      } else {
+        updates[partition].push_back(
+            std::make_pair(target,
+                           vertex_programs[target].gather(context, vertex, edge)));
+        if (++num_buffered_updates >= update_buffer_size) shuffle_updates();
+      }
+    }
+  } // end of gather_edge
+
+
+
+  template<typename VertexProgram>
+  void streaming_engine<VertexProgram>::shuffle_updates() {
+    for (size_t p = 0; p < updates.size(); ++p) {
+      for (size_t i = 0; i < updates[p].size(); ++i) {
+        accumulate(updates[p][i].first, updates[p][i].second);
+      }
+      updates[p].clear();
+    }
+    num_buffered_updates = 0;
+  } // end of shuffle_updates
+
+
+
+  template<typename VertexProgram>
+  void streaming_engine<VertexProgram>::
+  execute_applys(context_type& context, size_t& nscatters) {
+    foreach(vertex_id_type vid, active_vertices) {
+      vertex_type vertex(graph, vid);
+      vertex_program_type& vprog = vertex_programs[vid];
+      if (gather_dirs[vid] != NO_EDGES) vprog.post_local_gather(gather_accum[vid]);
+      vprog.apply(context, vertex, gather_accum[vid]);
+      ++completed_applys;
+      // Clear the accumulator to save some memory
+      gather_accum[vid] = gather_type();
+      gather_dirs[vid] = NO_EDGES;
+      const vertex_type const_vertex = vertex;
+      scatter_dirs[vid] = vprog.scatter_edges(context, const_vertex);
+      nscatters += (scatter_dirs[vid] != NO_EDGES);
+    }
+    has_gather_accum.clear();
+  } // end of execute_applys
+
+
+
+  template<typename VertexProgram>
+  void streaming_engine<VertexProgram>::
+  scatter_edge(context_type& context, edge_type& edge) {
+    const vertex_id_type source = edge.record.source;
+    const vertex_id_type target = edge.record.target;
+    if (scatter_dirs[source] & OUT_EDGES) {
+      const vertex_type vertex(graph, source);
+      vertex_programs[source].scatter(context, vertex, edge);
+    }
+    if (scatter_dirs[target] & IN_EDGES) {
+      const vertex_type vertex(graph, target);
+      vertex_programs[target].scatter(context, vertex, edge);
+    }
+  } // end of scatter_edge
+
+} // end of namespace graphlab
+#include <graphlab/macros_undef.hpp>
+
+#endif
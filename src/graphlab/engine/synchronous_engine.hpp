@@ -44,6 +44,9 @@
 #include <graphlab/parallel/atomic_add_vector.hpp>
 #include <graphlab/util/tracepoint.hpp>
 #include <graphlab/util/memory_info.hpp>
+#include <graphlab/util/slab_allocator.hpp>
+#include <graphlab/util/huge_page_allocator.hpp>
+#include <graphlab/util/file_backed_allocator.hpp>
 
 #include <graphlab/rpc/dc_dist_object.hpp>
 #include <graphlab/rpc/distributed_event_log.hpp>
@@ -188,6 +191,22 @@ namespace graphlab {
    * or update (\ref icontext::post_delta) the cache values of 
    * neighboring vertices during the scatter phase.
    *
+   * \li <b>pull_activation</b>: (default: false) Replaces the scatter
+   * phase for vertex programs whose scatter only signals neighbors.
+   * The \ref graphlab::ivertex_program::scatter function is never
+   * called. Instead a vertex whose
+   * \ref graphlab::ivertex_program::scatter_edges returns edges after
+   * the apply is marked as changed, and the changed marks are sent to
+   * its mirrors. Every vertex with a changed neighbor along those edges
+   * is then signaled with the default message and runs in the next
+   * super-step, exactly as if the scatter had signaled it. Each
+   * machine finds these vertices by checking the neighbors of its
+   * local vertices, so no per edge signals are generated or exchanged.
+   * When few vertices changed, the local edges of the changed vertices
+   * are followed instead of checking every vertex. Cannot be combined
+   * with use_cache, since without a scatter nothing clears or updates
+   * the cached gathers.
+   *
    * \li \b snapshot_interval If set to a positive value, a snapshot
    * is taken every this number of iterations. If set to 0, a snapshot
    * is taken before the first iteration. If set to a negative value,
@@ -389,6 +408,12 @@ namespace graphlab {
      */
     bool sched_allv;
 
+    /**
+     * \brief Derives the next active set from the changed vertices
+     * instead of running the scatter phase
+     */
+    bool pull_activation;
+
     /**
      * \brief Used to stop the engine prematurely
      */
@@ -400,7 +425,8 @@ namespace graphlab {
      * \ref graphlab::synchronous_engine::gather_accum
      * and \ref graphlab::synchronous_engine::messages.
      */
-    std::vector<simple_spinlock> vlocks;
+    std::vector<simple_spinlock,
+                huge_page_allocator<simple_spinlock> > vlocks;
 
 
     /**
@@ -418,12 +444,14 @@ namespace graphlab {
      * \brief The vertex programs associated with each vertex on this
      * machine.
      */
-    std::vector<vertex_program_type> vertex_programs;
+    std::vector<vertex_program_type,
+                huge_page_allocator<vertex_program_type> > vertex_programs;
 
     /**
      * \brief Vector of messages associated with each vertex.
      */
-    std::vector<message_type> messages;
+    std::vector<message_type,
+                huge_page_allocator<message_type> > messages;
 
     /**
      * \brief Bit indicating whether a message is present for each vertex.
@@ -440,7 +468,8 @@ namespace graphlab {
      * once and therefore must be guarded by a vertex locks in 
      * \ref graphlab::synchronous_engine::vlocks
      */
-    std::vector<gather_type>  gather_accum;
+    std::vector<gather_type,
+                huge_page_allocator<gather_type> > gather_accum;
     
     /**
      * \brief Bit indicating if the gather has accumulator contains any
@@ -462,7 +491,8 @@ namespace graphlab {
      * Caching is done locally and therefore a high-degree vertex may
      * have multiple caches (one per machine).
      */
-    std::vector<gather_type>  gather_cache;
+    std::vector<gather_type,
+                huge_page_allocator<gather_type> > gather_cache;
 
     /**
      * \brief A bit indicating if the local gather for that vertex is
@@ -488,6 +518,19 @@ namespace graphlab {
      */
     dense_bitset active_minorstep;      
 
+    /**
+     * \brief Bits indicating (for all vertices) that the vertex changed
+     * in this super-step and signals its out neighbors (changed_out)
+     * or in neighbors (changed_in).  Only used with pull_activation.
+     */
+    dense_bitset changed_out, changed_in;
+
+    /**
+     * \brief The number of local vertices (masters and mirrors) marked
+     * as changed in this super-step
+     */
+    atomic<size_t> num_changed;
+
     /**
      * \brief A counter measuring the number of applys that have been completed
      */
@@ -565,6 +608,21 @@ namespace graphlab {
      */
     message_exchange_type message_exchange;
 
+    /**
+     * \brief The pair type used to send the changed marks to mirrors
+     */
+    typedef std::pair<vertex_id_type, edge_dir_type> vid_dir_pair_type;
+
+    /**
+     * \brief The type of the exchange used to send the changed marks
+     */
+    typedef buffered_exchange<vid_dir_pair_type> changed_exchange_type;
+
+    /**
+     * \brief The distributed exchange used to send the changed marks
+     */
+    changed_exchange_type changed_exchange;
+
 
     /**
      * \brief The distributed aggregator used to manage background
@@ -626,6 +684,25 @@ namespace graphlab {
      */
     execution_status::status_enum start();
 
+    /**
+     * \brief Prepares the engine for a new run of start().
+     *
+     * start() may be called again on the same engine, which then
+     * resumes with the signals left by the last run. reset() instead
+     * drops those signals, the gather cache and the update count, so
+     * that the next start() behaves like the first start() of a new
+     * engine, without allocating the per vertex state and constructing
+     * the exchanges (each with a barrier) again. Pipelines that run a
+     * vertex program in several phases, e.g. a chain of GAS operations
+     * told apart by their messages, should reuse one engine this way.
+     *
+     * If the graph changed since the engine was constructed, the per
+     * vertex state is allocated again for its new size.
+     *
+     * Like start(), reset() must be called on all machines.
+     */
+    void reset();
+
     // documentation inherited from iengine
     size_t num_updates() const;
 
@@ -674,6 +751,13 @@ namespace graphlab {
 
   private:
 
+    /**
+     * \brief Sizes the per vertex state of the engine to the local
+     * vertices of the graph, with no vertex signaled, and the gather
+     * cache too if use_cache is set.
+     */
+    void allocate_vertex_state(bool use_cache);
+
     /**
      * \brief This internal stop function is called by the \ref graphlab::context to
      * terminate execution of the engine.
@@ -697,6 +781,20 @@ namespace graphlab {
     void internal_signal(const vertex_type& vertex,
                          const message_type& message = message_type()); 
 
+    /// Signals each master of a vertex set. Used by signal_vset()
+    struct signal_visitor {
+      synchronous_engine* engine;
+      const message_type& message;
+      signal_visitor(synchronous_engine* engine, const message_type& message) :
+        engine(engine), message(message) { }
+      void operator()(lvid_type lvid) {
+        if(engine->graph.l_is_master(lvid)) {
+          engine->internal_signal(vertex_type(engine->graph.l_vertex(lvid)),
+                                  message);
+        }
+      }
+    };
+
     /**
      * \brief Called by the context to signal an arbitrary vertex.
      * This must be done by finding the owner of that vertex. 
@@ -847,6 +945,45 @@ namespace graphlab {
      */
     void execute_scatters(size_t thread_id);
 
+    /**
+     * \brief Reads ahead the file backed edge data of the active
+     * vertices of a block, on the edges each of them will gather (or
+     * scatter) on, so that the reads of the whole block are issued at
+     * once rather than a page fault at a time.
+     *
+     * @param lvid_block_start the first vertex of the block
+     * @param local_bitset the active vertices of the block
+     * @param gather true for the gather directions, false for the
+     * scatter directions
+     */
+    void prefetch_edge_data(lvid_type lvid_block_start,
+                            const fixed_dense_bitset<sizeof(size_t)>& local_bitset,
+                            bool gather, context_type& context);
+
+    /**
+     * \brief Signal every vertex with a changed neighbor.  Replaces
+     * execute_scatters when pull_activation is set.
+     *
+     * @param thread_id the thread to run this as which determines
+     * which vertices to process.
+     */
+    void execute_pulls(size_t thread_id);
+
+    /**
+     * \brief Signal the neighbors of the changed vertices.  Used
+     * instead of execute_pulls when few vertices changed.
+     *
+     * @param thread_id the thread to run this as which determines
+     * which vertices to process.
+     */
+    void execute_pushes(size_t thread_id);
+
+    /**
+     * \brief Signal the vertex with the default message unless it
+     * already has a message.
+     */
+    void signal_default(lvid_type lvid);
+
     // Data Synchronization ===================================================
     /**
      * \brief Send the vertex program for the local vertex id to all
@@ -922,6 +1059,25 @@ namespace graphlab {
      */
     void recv_messages(const bool try_to_recv = false);
 
+    /**
+     * \brief Mark the vertex as changed in the given direction and
+     * send the mark to all of its mirrors.
+     *
+     * @param [in] lvid the vertex to mark. This machine must be the
+     * master of that vertex.
+     */
+    void sync_changed(lvid_type lvid, edge_dir_type dir, size_t thread_id);
+
+    /**
+     * \brief Receive the changed marks from the buffered exchange.
+     */
+    void recv_changed(const bool try_to_recv = false);
+
+    /**
+     * \brief Set the changed bits of the vertex for the direction.
+     */
+    void set_changed(lvid_type lvid, edge_dir_type dir);
+
 
   }; // end of class synchronous engine
 
@@ -977,11 +1133,12 @@ namespace graphlab {
     threads(opts.get_ncpus()), 
     thread_barrier(opts.get_ncpus()),
     max_iterations(-1), snapshot_interval(-1), iteration_counter(0),
-    timeout(0), sched_allv(false),
+    timeout(0), sched_allv(false), pull_activation(false),
     vprog_exchange(dc, opts.get_ncpus(), 65536), 
     vdata_exchange(dc, opts.get_ncpus(), 65536), 
     gather_exchange(dc, opts.get_ncpus(), 65536), 
     message_exchange(dc, opts.get_ncpus(), 65536),
+    changed_exchange(dc, opts.get_ncpus(), 65536),
     aggregator(dc, graph, new context_type(*this, graph)) {
     // Process any additional options
     std::vector<std::string> keys = opts.get_engine_args().get_option_keys();
@@ -1018,6 +1175,11 @@ namespace graphlab {
         if (rmi.procid() == 0)
           logstream(LOG_EMPH) << "Engine Option: sched_allv = " 
             << sched_allv << std::endl;
+      } else if (opt == "pull_activation") {
+        opts.get_engine_args().get_option("pull_activation", pull_activation);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: pull_activation = " 
+            << pull_activation << std::endl;
       } else {
         logstream(LOG_FATAL) << "Unexpected Engine Option: " << opt << std::endl;
       }
@@ -1036,21 +1198,67 @@ namespace graphlab {
     // Finalize the graph
     graph.finalize();
     memory_info::log_usage("Before Engine Initialization");
+    allocate_vertex_state(use_cache);
+    // Print memory usage after initialization
+    memory_info::log_usage("After Engine Initialization");
+    rmi.barrier();
+  } // end of synchronous engine
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::reset() {
+    rmi.barrier();
+    graph.finalize();
+    if (vertex_programs.size() != graph.num_local_vertices()) {
+      // The graph changed since the engine was constructed
+      allocate_vertex_state(!gather_cache.empty());
+    } else {
+      // Drop the signals and cached gathers left over by the last run
+      foreach(size_t lvid, has_message) messages[lvid] = message_type();
+      has_message.clear();
+      foreach(size_t lvid, has_cache) gather_cache[lvid] = gather_type();
+      has_cache.clear();
+    }
+    completed_applys = 0;
+    std::fill(per_thread_compute_time.begin(), per_thread_compute_time.end(), 0);
+    iteration_counter = 0;
+    rmi.barrier();
+  } // end of reset
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  allocate_vertex_state(bool use_cache) {
     // Allocate vertex locks and vertex programs
     vlocks.resize(graph.num_local_vertices());
     vertex_programs.resize(graph.num_local_vertices());
     // allocate the edge locks
     //elocks.resize(graph.num_local_edges());
     // Allocate messages and message bitset
+    messages.clear();
     messages.resize(graph.num_local_vertices(), message_type());
     has_message.resize(graph.num_local_vertices()); 
     has_message.clear();
     // Allocate gather accumulators and accumulator bitset
+    gather_accum.clear();
     gather_accum.resize(graph.num_local_vertices(), gather_type());
     has_gather_accum.resize(graph.num_local_vertices());
     has_gather_accum.clear();
     // If caching is used then allocate cache data-structures
     if (use_cache) {
+      if (superstep_scoped<gather_type>::value) {
+        logstream(LOG_FATAL) << "Gather caching cannot be used with a "
+                             << "superstep scoped gather type." << std::endl;
+      }
+      if (pull_activation) {
+        logstream(LOG_FATAL) << "Gather caching cannot be used with "
+                             << "pull_activation." << std::endl;
+      }
+      if (!cacheable_gather<gather_type>::value) {
+        logstream(LOG_FATAL) << "Gather caching cannot be used with this "
+                             << "gather type." << std::endl;
+      }
+      gather_cache.clear();
       gather_cache.resize(graph.num_local_vertices(), gather_type());
       has_cache.resize(graph.num_local_vertices());
       has_cache.clear();
@@ -1060,10 +1268,13 @@ namespace graphlab {
     active_superstep.clear();
     active_minorstep.resize(graph.num_local_vertices());
     active_minorstep.clear();
-    // Print memory usage after initialization
-    memory_info::log_usage("After Engine Initialization");
-    rmi.barrier();
-  } // end of synchronous engine
+    if (pull_activation) {
+      changed_out.resize(graph.num_local_vertices());
+      changed_out.clear();
+      changed_in.resize(graph.num_local_vertices());
+      changed_in.clear();
+    }
+  } // end of allocate_vertex_state
   
 
 
@@ -1116,11 +1327,8 @@ namespace graphlab {
   void synchronous_engine<VertexProgram>::
   signal_vset(const vertex_set& vset,
              const message_type& message, const std::string& order) {
-    for(lvid_type lvid = 0; lvid < graph.num_local_vertices(); ++lvid) {
-      if(graph.l_is_master(lvid) && vset.l_contains(lvid)) {
-        internal_signal(vertex_type(graph.l_vertex(lvid)), message);
-      }
-    }
+    signal_visitor visitor(this, message);
+    vset.for_each_lvid(graph, visitor);
   } // end of signal all
  
 
@@ -1238,7 +1446,7 @@ namespace graphlab {
     //   // Initialize all vertex programs
     //   run_synchronous( &synchronous_engine::initialize_vertex_programs );
     // }
-    aggregator.start();
+    aggregator.start(0, threads.size());
     rmi.barrier();
     if (snapshot_interval == 0) {
       graph.save_binary(snapshot_path);
@@ -1349,11 +1557,25 @@ namespace graphlab {
        *      masters and mirrors) and the vertex program has been
        *      synchronized with the mirrors.         
        */
+      // Gather values are all dead, so an arena backed gather type
+      // can have its memory recycled for the next super-step
+      if (superstep_scoped<gather_type>::value) superstep_arena::release();
 
 
       // Execute Scatter Operations -----------------------------------------
       // Execute each of the scatters on all minor-step active vertices.
-      run_synchronous( &synchronous_engine::execute_scatters );
+      if (pull_activation) {
+        // checking every vertex only pays off when many changed
+        if (num_changed * 20 > graph.num_local_vertices()) {
+          run_synchronous( &synchronous_engine::execute_pulls );
+        } else {
+          run_synchronous( &synchronous_engine::execute_pushes );
+        }
+        changed_out.clear(); changed_in.clear();
+        num_changed = 0;
+      } else {
+        run_synchronous( &synchronous_engine::execute_scatters );
+      }
       /**
        * Post conditions:
        *   1) NONE
@@ -1536,6 +1758,9 @@ namespace graphlab {
       // initialize a word sized bitfield 
       local_bitset.clear();
       local_bitset.initialize_from_mem(&lvid_bit_block, sizeof(size_t));
+      if (file_backed_memory::has_mappings()) {
+        prefetch_edge_data(lvid_block_start, local_bitset, true, context);
+      }
 
       foreach(size_t lvid_block_offset, local_bitset) {
         lvid_type lvid = lvid_block_start + lvid_block_offset; 
@@ -1622,6 +1847,8 @@ namespace graphlab {
   void synchronous_engine<VertexProgram>::
   execute_applys(const size_t thread_id) {
     context_type context(*this, graph);
+    const bool incremental_aggregation =
+      aggregator.has_incremental_aggregators();
     const bool TRY_TO_RECV = true;
     const size_t TRY_RECV_MOD = 1000;
     size_t vcount = 0;
@@ -1652,17 +1879,34 @@ namespace graphlab {
         // the gather_accum was not set during the gather.
         const gather_type& accum = gather_accum[lvid];
         INCREMENT_EVENT(EVENT_APPLIES, 1);
+        if (incremental_aggregation) aggregator.retract_vertex(thread_id, vertex);
         vertex_programs[lvid].apply(context, vertex, accum);
+        if (incremental_aggregation) aggregator.contribute_vertex(thread_id, vertex);
         // record an apply as a completed task
         ++completed_applys;
-        // Clear the accumulator to save some memory
-        gather_accum[lvid] = gather_type();
+        // Clear the accumulator to save some memory. An arena backed
+        // accumulator is rebuilt instead, since assigning would keep its
+        // buffers as capacity past the release of the arena.
+        if (superstep_scoped<gather_type>::value) {
+          gather_accum[lvid].~gather_type();
+          new (&gather_accum[lvid]) gather_type();
+        } else {
+          gather_accum[lvid] = gather_type();
+        }
         // synchronize the changed vertex data with all mirrors
         sync_vertex_data(lvid, thread_id);  
         // determine if a scatter operation is needed
         const vertex_program_type& const_vprog = vertex_programs[lvid];
         const vertex_type const_vertex = vertex;
-        if(const_vprog.scatter_edges(context, const_vertex) != 
+        if (pull_activation) {
+          // the neighbors pull the activation instead of a scatter
+          const edge_dir_type scatter_dir = 
+            const_vprog.scatter_edges(context, const_vertex);
+          if (scatter_dir != graphlab::NO_EDGES) {
+            sync_changed(lvid, scatter_dir, thread_id);
+          }
+          vertex_programs[lvid] = vertex_program_type();
+        } else if(const_vprog.scatter_edges(context, const_vertex) != 
            graphlab::NO_EDGES) {
           active_minorstep.set_bit(lvid);
           sync_vertex_program(lvid, thread_id);
@@ -1673,6 +1917,7 @@ namespace graphlab {
         if(++vcount % TRY_RECV_MOD == 0) {
           recv_vertex_programs(TRY_TO_RECV);
           recv_vertex_data(TRY_TO_RECV); 
+          if (pull_activation) recv_changed(TRY_TO_RECV);
         }
       }
     } // end of loop over vertices to run apply
@@ -1680,12 +1925,17 @@ namespace graphlab {
     per_thread_compute_time[thread_id] += ti.current_time();
     vprog_exchange.partial_flush(thread_id);
     vdata_exchange.partial_flush(thread_id);
+    if (pull_activation) changed_exchange.partial_flush(thread_id);
       // Finish sending and receiving all changes due to apply operations
     thread_barrier.wait();
-    if(thread_id == 0) { vprog_exchange.flush(); vdata_exchange.flush(); }
+    if(thread_id == 0) { 
+      vprog_exchange.flush(); vdata_exchange.flush(); 
+      if (pull_activation) changed_exchange.flush();
+    }
     thread_barrier.wait();
     recv_vertex_programs();
     recv_vertex_data();
+    if (pull_activation) recv_changed();
 
   } // end of execute_applys
 
@@ -1711,6 +1961,9 @@ namespace graphlab {
       // initialize a word sized bitfield 
       local_bitset.clear();
       local_bitset.initialize_from_mem(&lvid_bit_block, sizeof(size_t));
+      if (file_backed_memory::has_mappings()) {
+        prefetch_edge_data(lvid_block_start, local_bitset, false, context);
+      }
       foreach(size_t lvid_block_offset, local_bitset) {
         lvid_type lvid = lvid_block_start + lvid_block_offset; 
         if (lvid >= graph.num_local_vertices()) break;
@@ -1750,6 +2003,122 @@ namespace graphlab {
   } // end of execute_scatters
 
 
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  prefetch_edge_data(const lvid_type lvid_block_start,
+                     const fixed_dense_bitset<sizeof(size_t)>& local_bitset,
+                     const bool gather, context_type& context) {
+    size_t in_active = 0, out_active = 0;
+    foreach(size_t lvid_block_offset, local_bitset) {
+      const lvid_type lvid = lvid_block_start + lvid_block_offset;
+      if (lvid >= graph.num_local_vertices()) break;
+      const vertex_program_type& vprog = vertex_programs[lvid];
+      const vertex_type vertex(graph.l_vertex(lvid));
+      const edge_dir_type dir = gather ? vprog.gather_edges(context, vertex) :
+                                         vprog.scatter_edges(context, vertex);
+      const size_t bit = size_t(1) << lvid_block_offset;
+      if (dir == IN_EDGES || dir == ALL_EDGES) in_active |= bit;
+      if (dir == OUT_EDGES || dir == ALL_EDGES) out_active |= bit;
+    }
+    if (in_active == 0 && out_active == 0) return;
+    graph.get_local_graph().prefetch_edge_data(lvid_block_start,
+                                               in_active, out_active);
+  } // end of prefetch_edge_data
+
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  execute_pulls(const size_t thread_id) {
+    timer ti;
+    while (1) {
+      // increment by a word at a time 
+      lvid_type lvid_block_start = 
+                  shared_lvid_counter.inc_ret_last(8 * sizeof(size_t));
+      if (lvid_block_start >= graph.num_local_vertices()) break;
+      const lvid_type lvid_block_end = 
+        std::min<size_t>(lvid_block_start + 8 * sizeof(size_t),
+                         graph.num_local_vertices());
+      for (lvid_type lvid = lvid_block_start; lvid < lvid_block_end; ++lvid) {
+        // already signaled during the apply
+        if (has_message.get(lvid)) continue;
+        local_vertex_type local_vertex = graph.l_vertex(lvid);
+        // check the in neighbors which signal their out neighbors and
+        // then the out neighbors which signal their in neighbors
+        bool has_changed_neighbor = false;
+        foreach(local_edge_type local_edge, local_vertex.in_edges()) {
+          if (changed_out.get(local_edge.source().id())) {
+            has_changed_neighbor = true;
+            break;
+          }
+        }
+        if (!has_changed_neighbor) {
+          foreach(local_edge_type local_edge, local_vertex.out_edges()) {
+            if (changed_in.get(local_edge.target().id())) {
+              has_changed_neighbor = true;
+              break;
+            }
+          }
+        }
+        if (has_changed_neighbor) signal_default(lvid);
+      }
+    } // end of loop over vertices to pull the activation
+    per_thread_compute_time[thread_id] += ti.current_time();
+  } // end of execute_pulls
+
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  execute_pushes(const size_t thread_id) {
+    timer ti;
+    fixed_dense_bitset<sizeof(size_t)> local_bitset;
+    while (1) {
+      // increment by a word at a time 
+      lvid_type lvid_block_start = 
+                  shared_lvid_counter.inc_ret_last(8 * sizeof(size_t));
+      if (lvid_block_start >= graph.num_local_vertices()) break;
+      // get the bit field from the changed bits in either direction
+      size_t lvid_bit_block = changed_out.containing_word(lvid_block_start) |
+                              changed_in.containing_word(lvid_block_start);
+      if (lvid_bit_block == 0) continue;
+      // initialize a word sized bitfield 
+      local_bitset.clear();
+      local_bitset.initialize_from_mem(&lvid_bit_block, sizeof(size_t));
+      foreach(size_t lvid_block_offset, local_bitset) {
+        lvid_type lvid = lvid_block_start + lvid_block_offset; 
+        if (lvid >= graph.num_local_vertices()) break;
+        local_vertex_type local_vertex = graph.l_vertex(lvid);
+        if (changed_out.get(lvid)) {
+          foreach(local_edge_type local_edge, local_vertex.out_edges()) {
+            signal_default(local_edge.target().id());
+          }
+        }
+        if (changed_in.get(lvid)) {
+          foreach(local_edge_type local_edge, local_vertex.in_edges()) {
+            signal_default(local_edge.source().id());
+          }
+        }
+      }
+    } // end of loop over the changed vertices
+    per_thread_compute_time[thread_id] += ti.current_time();
+  } // end of execute_pushes
+
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  signal_default(lvid_type lvid) {
+    // Messages at mirrors are sent to the master by the next exchange
+    vlocks[lvid].lock();
+    if (!has_message.get(lvid)) {
+      messages[lvid] = message_type();
+      has_message.set_bit(lvid);
+    }
+    vlocks[lvid].unlock();
+  } // end of signal_default
+
+
 
   // Data Synchronization ===================================================
   template<typename VertexProgram>
@@ -1890,6 +2259,46 @@ namespace graphlab {
 
 
 
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  set_changed(lvid_type lvid, edge_dir_type dir) {
+    if (dir == OUT_EDGES || dir == ALL_EDGES) changed_out.set_bit(lvid);
+    if (dir == IN_EDGES || dir == ALL_EDGES) changed_in.set_bit(lvid);
+    num_changed.inc();
+  } // end of set_changed
+
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  sync_changed(lvid_type lvid, edge_dir_type dir, const size_t thread_id) {
+    ASSERT_TRUE(graph.l_is_master(lvid));
+    set_changed(lvid, dir);
+    const vertex_id_type vid = graph.global_vid(lvid);
+    local_vertex_type vertex = graph.l_vertex(lvid);
+    foreach(const procid_t& mirror, vertex.mirrors()) {
+      changed_exchange.send(mirror, std::make_pair(vid, dir), thread_id);
+    }
+  } // end of sync_changed
+
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  recv_changed(const bool try_to_recv) {
+    procid_t procid(-1);
+    typename changed_exchange_type::buffer_type buffer;
+    while(changed_exchange.recv(procid, buffer, try_to_recv)) {
+      foreach(const vid_dir_pair_type& pair, buffer) {
+        const lvid_type lvid = graph.local_vid(pair.first);
+        ASSERT_FALSE(graph.l_is_master(lvid));
+        set_changed(lvid, pair.second);
+      }
+    }
+  } // end of recv_changed
+
+
+
 
 
 
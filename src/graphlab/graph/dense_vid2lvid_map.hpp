@@ -0,0 +1,154 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_DENSE_VID2LVID_MAP_HPP
+#define GRAPHLAB_DENSE_VID2LVID_MAP_HPP
+
+#include <vector>
+#include <algorithm>
+#include <graphlab/graph/graph_basic_types.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+
+  /**
+   * \internal
+   * \brief A two-level dense table from global vertex ids to local
+   * vertex ids.
+   *
+   * The id range spanned by the local vertices is cut into blocks of
+   * 2^BLOCK_BITS ids. Only the blocks holding at least one local vertex
+   * are allocated, so a lookup is two array reads, and the table stays
+   * small as long as the local ids are clustered. The table is built
+   * once from the vertex records of a finalized graph and is read-only
+   * afterwards.
+   */
+  class dense_vid2lvid_map {
+  public:
+    /// Returned by find() for ids without a local vertex
+    static const lvid_type NO_LVID = lvid_type(-1);
+
+  private:
+    static const size_t BLOCK_BITS = 10;
+    static const size_t BLOCK_SIZE = size_t(1) << BLOCK_BITS;
+    static const size_t BLOCK_MASK = BLOCK_SIZE - 1;
+    static const uint32_t NO_BLOCK = uint32_t(-1);
+
+    /// The first id covered by the table
+    size_t base;
+    /// The position of each block in lvids, or NO_BLOCK
+    std::vector<uint32_t> blocks;
+    /// The allocated blocks, one after the other
+    std::vector<lvid_type> lvids;
+
+  public:
+    dense_vid2lvid_map() : base(0) { }
+
+    /**
+     * Returns the number of bytes the table would take for the given
+     * vertex records, without building it.
+     */
+    template <typename RecordVector>
+    static size_t estimate_bytes(const RecordVector& records) {
+      size_t min_vid, num_blocks;
+      std::vector<bool> used;
+      const size_t num_used = mark_blocks(records, min_vid, num_blocks, used);
+      return num_blocks * sizeof(uint32_t) +
+          num_used * BLOCK_SIZE * sizeof(lvid_type);
+    }
+
+    /**
+     * Builds the table from the vertex records of a graph, where
+     * records[lvid].gvid is the global id of local vertex lvid.
+     */
+    template <typename RecordVector>
+    void build(const RecordVector& records) {
+      clear();
+      size_t num_blocks;
+      std::vector<bool> used;
+      const size_t num_used = mark_blocks(records, base, num_blocks, used);
+      blocks.resize(num_blocks, uint32_t(NO_BLOCK));
+      lvids.resize(num_used * BLOCK_SIZE, lvid_type(NO_LVID));
+      uint32_t next_block = 0;
+      for (size_t b = 0; b < num_blocks; ++b) {
+        if (used[b]) blocks[b] = next_block++;
+      }
+      for (size_t i = 0; i < records.size(); ++i) {
+        const size_t offset = size_t(records[i].gvid) - base;
+        lvids[(size_t(blocks[offset >> BLOCK_BITS]) << BLOCK_BITS) |
+              (offset & BLOCK_MASK)] = lvid_type(i);
+      }
+    }
+
+    /// Returns the local id of vid, or NO_LVID if vid is not local
+    inline lvid_type find(const vertex_id_type vid) const {
+      // ids below base wrap around to a block past the end
+      const size_t offset = size_t(vid) - base;
+      const size_t b = offset >> BLOCK_BITS;
+      if (b >= blocks.size() || blocks[b] == NO_BLOCK) return NO_LVID;
+      return lvids[(size_t(blocks[b]) << BLOCK_BITS) | (offset & BLOCK_MASK)];
+    }
+
+    /// Returns the number of bytes used by the table
+    size_t memory_bytes() const {
+      return blocks.size() * sizeof(uint32_t) + lvids.size() * sizeof(lvid_type);
+    }
+
+    bool empty() const { return blocks.empty(); }
+
+    void clear() {
+      base = 0;
+      std::vector<uint32_t>().swap(blocks);
+      std::vector<lvid_type>().swap(lvids);
+    }
+
+  private:
+    /**
+     * Finds the first id and the number of blocks spanned by the
+     * records, marks the blocks holding a record and returns their count.
+     */
+    template <typename RecordVector>
+    static size_t mark_blocks(const RecordVector& records, size_t& min_vid,
+                              size_t& num_blocks, std::vector<bool>& used) {
+      min_vid = 0; num_blocks = 0;
+      if (records.empty()) return 0;
+      size_t max_vid = records[0].gvid;
+      min_vid = records[0].gvid;
+      for (size_t i = 1; i < records.size(); ++i) {
+        min_vid = std::min<size_t>(min_vid, records[i].gvid);
+        max_vid = std::max<size_t>(max_vid, records[i].gvid);
+      }
+      min_vid &= ~BLOCK_MASK;
+      num_blocks = ((max_vid - min_vid) >> BLOCK_BITS) + 1;
+      used.assign(num_blocks, false);
+      size_t num_used = 0;
+      for (size_t i = 0; i < records.size(); ++i) {
+        const size_t b = (size_t(records[i].gvid) - min_vid) >> BLOCK_BITS;
+        if (!used[b]) { used[b] = true; ++num_used; }
+      }
+      return num_used;
+    }
+  }; // end of dense_vid2lvid_map
+
+} // end of namespace graphlab
+
+#endif
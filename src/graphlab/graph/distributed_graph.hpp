@@ -63,6 +63,9 @@
 #include <graphlab/util/random.hpp>
 #include <graphlab/util/branch_hints.hpp>
 #include <graphlab/util/generics/conditional_addition_wrapper.hpp>
+#include <graphlab/util/generics/fused_reduction.hpp>
+#include <graphlab/util/huge_page_allocator.hpp>
+#include <graphlab/util/file_backed_allocator.hpp>
 
 #include <graphlab/options/graphlab_options.hpp>
 #include <graphlab/serialization/serialization_includes.hpp>
@@ -87,6 +90,7 @@
 #include <graphlab/graph/builtin_parsers.hpp>
 #include <graphlab/graph/json_parser.hpp>
 #include <graphlab/graph/vertex_set.hpp>
+#include <graphlab/graph/dense_vid2lvid_map.hpp>
 
 #include <graphlab/macros_def.hpp>
 namespace graphlab { 
@@ -557,6 +561,20 @@ namespace graphlab {
      *                worst partitions, while "batch" takes longer, but produces
      *                a significantly better result. Improved partitioning
      *                has direct impacts on GraphLab runtime performance.
+     * \li \c hugepages Where to place the large arrays of the local graph
+     *                and of the synchronous engine. May be "none",
+     *                "transparent" or "explicit". "transparent" backs them
+     *                with transparent huge pages and "explicit" with the
+     *                hugetlbfs pool, falling back to transparent huge
+     *                pages, which reduces TLB misses on large graphs.
+     *                Defaults to "none". See \ref huge_pages.
+     * \li \c edgestore A directory in which to place the edge data of
+     *                the local graph as memory mapped files, so that the
+     *                edge data may exceed the memory. Defaults to "",
+     *                which keeps it in memory. See \ref file_backed_memory.
+     * \li \c readahead The readahead of the edgestore files. May be
+     *                "normal", "sequential" or "random". Defaults to
+     *                "random".
      * \li \c userecent An optimization that can decrease memory utilization
      *                of oblivious and batch quite significantly (especially
      *                when there are a large number of machines) at a small
@@ -575,6 +593,7 @@ namespace graphlab {
     distributed_graph(distributed_control& dc, 
                       const graphlab_options& opts = graphlab_options() ) : 
       rpc(dc, this), finalized(false), vid2lvid(-1),
+      vid2lvid_method("auto"), use_dense_vid2lvid(false),
       nverts(0), nedges(0), local_own_nverts(0), nreplicas(0),
       ingress_ptr(NULL), vertex_exchange(dc), vset_exchange(dc) {
       rpc.barrier();
@@ -610,6 +629,42 @@ namespace graphlab {
            if (rpc.procid() == 0) 
             logstream(LOG_EMPH) << "Graph Option: userecent = " 
               << userecent << std::endl;
+       } else if (opt == "hugepages") {
+          std::string policy_name;
+          opts.get_graph_args().get_option("hugepages", policy_name);
+          huge_pages::policy_type policy;
+          if (!huge_pages::parse_policy(policy_name, policy)) {
+            logstream(LOG_FATAL) << "Unknown hugepages policy: "
+                                 << policy_name << std::endl;
+          }
+          huge_pages::set_policy(policy);
+          if (rpc.procid() == 0)
+            logstream(LOG_EMPH) << "Graph Option: hugepages = "
+              << policy_name << std::endl;
+       } else if (opt == "edgestore") {
+          std::string directory;
+          opts.get_graph_args().get_option("edgestore", directory);
+          file_backed_memory::set_directory(directory);
+          if (rpc.procid() == 0)
+            logstream(LOG_EMPH) << "Graph Option: edgestore = "
+              << directory << std::endl;
+       } else if (opt == "readahead") {
+          std::string readahead_name;
+          opts.get_graph_args().get_option("readahead", readahead_name);
+          file_backed_memory::readahead_type readahead;
+          if (!file_backed_memory::parse_readahead(readahead_name, readahead)) {
+            logstream(LOG_FATAL) << "Unknown readahead: "
+                                 << readahead_name << std::endl;
+          }
+          file_backed_memory::set_readahead(readahead);
+          if (rpc.procid() == 0)
+            logstream(LOG_EMPH) << "Graph Option: readahead = "
+              << readahead_name << std::endl;
+       } else if (opt == "vid2lvid") {
+          opts.get_graph_args().get_option("vid2lvid", vid2lvid_method);
+          if (rpc.procid() == 0)
+            logstream(LOG_EMPH) << "Graph Option: vid2lvid = "
+              << vid2lvid_method << std::endl;
        } else {
           logstream(LOG_ERROR) << "Unexpected Graph Option: " << opt << std::endl;
         }
@@ -638,6 +693,7 @@ namespace graphlab {
       ingress_ptr->finalize();
       rpc.barrier(); delete ingress_ptr; ingress_ptr = NULL;
       finalized = true;
+      choose_vid2lvid_map();
     }
    
     /// \brief Returns true if the graph is finalized. 
@@ -831,7 +887,12 @@ namespace graphlab {
     * the compiler regarding the return type of the mapfunction.
     *
     * The optional argument vset can be used to restrict he set of vertices
-    * map-reduced over.
+    * map-reduced over. Only the members of vset are visited, a machine word
+    * of the set at a time, so map reducing over a small set is
+    * proportionally cheaper than over the whole graph.
+    *
+    * Several reductions can be computed in a single pass with
+    * graphlab::fuse_maps().
     *
     * ### Relations
     * This function is similar to 
@@ -867,49 +928,13 @@ namespace graphlab {
       }
 
       rpc.barrier();
-      bool global_result_set = false;
-      ReductionType global_result = ReductionType();
-#ifdef _OPENMP
-#pragma omp parallel
-#endif
-      {
-        bool result_set = false;
-        ReductionType result = ReductionType();
-#ifdef _OPENMP
-        #pragma omp for
-#endif
-        for (int i = 0; i < (int)local_graph.num_vertices(); ++i) {
-          if (lvid2record[i].owner == rpc.procid() && 
-              vset.l_contains((lvid_type)i)) {
-            if (!result_set) {
-              const vertex_type vtx(l_vertex(i));
-              result = mapfunction(vtx);
-              result_set = true;
-            }
-            else if (result_set){
-              const vertex_type vtx(l_vertex(i));
-              const ReductionType tmp = mapfunction(vtx);
-              result += tmp;
-            }
-          }
-        }
-#ifdef _OPENMP
-        #pragma omp critical
-#endif
-        {
-          if (result_set) {
-            if (!global_result_set) {
-              global_result = result;
-              global_result_set = true;
-            }
-            else {
-              global_result += result;
-            }
-          }
-        }
-      }
-      conditional_addition_wrapper<ReductionType> 
-        wrapper(global_result, global_result_set);
+      std::vector<vertex_map_visitor<ReductionType, MapFunctionType> >
+        visitors(num_visitor_threads(),
+                 vertex_map_visitor<ReductionType, MapFunctionType>(this, 
+                                                                    mapfunction));
+      for_each_in_vertex_set(vset, true, visitors);
+      tree_merge(visitors);
+      conditional_addition_wrapper<ReductionType> wrapper = visitors[0].acc;
       rpc.all_reduce(wrapper);
       return wrapper.value;
     } // end of map_reduce_vertices
@@ -995,67 +1020,14 @@ namespace graphlab {
       }
 
       rpc.barrier();
-      bool global_result_set = false;
-      ReductionType global_result = ReductionType();
-#ifdef _OPENMP
-#pragma omp parallel
-#endif
-      {
-        bool result_set = false;
-        ReductionType result = ReductionType();
-#ifdef _OPENMP
-        #pragma omp for
-#endif
-        for (int i = 0; i < (int)local_graph.num_vertices(); ++i) {
-          if (vset.l_contains((lvid_type)i)) {
-            if (edir == IN_EDGES || edir == ALL_EDGES) {
-              foreach(const local_edge_type& e, l_vertex(i).in_edges()) {
-                if (!result_set) {
-                  edge_type edge(e);
-                  result = mapfunction(edge);
-                  result_set = true;
-                }
-                else if (result_set){
-                  edge_type edge(e);
-                  const ReductionType tmp = mapfunction(edge); 
-                  result += tmp;
-                }
-              }
-            }
-            if (edir == OUT_EDGES || edir == ALL_EDGES) {
-              foreach(const local_edge_type& e, l_vertex(i).out_edges()) {
-                if (!result_set) {
-                  edge_type edge(e);
-                  result = mapfunction(edge);
-                  result_set = true;
-                }
-                else if (result_set){
-                  edge_type edge(e);
-                  const ReductionType tmp = mapfunction(edge); 
-                  result += tmp;
-                }
-              }
-            }
-          }
-        }
-#ifdef _OPENMP
-        #pragma omp critical
-#endif
-        {
-          if (result_set) {
-            if (!global_result_set) {
-              global_result = result;
-              global_result_set = true;
-            }
-            else {
-              global_result += result;
-            }
-          }
-        }
-      }
-
-      conditional_addition_wrapper<ReductionType> 
-        wrapper(global_result, global_result_set);
+      std::vector<edge_map_visitor<ReductionType, MapFunctionType> >
+        visitors(num_visitor_threads(),
+                 edge_map_visitor<ReductionType, MapFunctionType>(this,
+                                                                  mapfunction,
+                                                                  edir));
+      for_each_in_vertex_set(vset, false, visitors);
+      tree_merge(visitors);
+      conditional_addition_wrapper<ReductionType> wrapper = visitors[0].acc;
       rpc.all_reduce(wrapper);
       return wrapper.value;
    } // end of map_reduce_edges
@@ -1122,16 +1094,11 @@ namespace graphlab {
       }      
 
       rpc.barrier();
-#ifdef _OPENMP
-      #pragma omp parallel for
-#endif
-      for (int i = 0; i < (int)local_graph.num_vertices(); ++i) {
-        if (lvid2record[i].owner == rpc.procid() && 
-            vset.l_contains((lvid_type)i)) {
-          vertex_type vtx(l_vertex(i));
-          transform_functor(vtx);
-        }
-      }
+      std::vector<vertex_transform_visitor<TransformType> >
+        visitors(num_visitor_threads(),
+                 vertex_transform_visitor<TransformType>(this, 
+                                                         transform_functor));
+      for_each_in_vertex_set(vset, true, visitors);
       rpc.barrier();
       synchronize();
     }
@@ -1204,25 +1171,11 @@ namespace graphlab {
           << std::endl;
       }      
       rpc.barrier();
-#ifdef _OPENMP
-      #pragma omp parallel for
-#endif
-      for (int i = 0; i < (int)local_graph.num_vertices(); ++i) {
-        if (vset.l_contains((lvid_type)i)) {
-          if (edir == IN_EDGES || edir == ALL_EDGES) {
-            foreach(const local_edge_type& e, l_vertex(i).in_edges()) {
-              edge_type edge(e);
-              transform_functor(edge);
-            }
-          }
-          if (edir == OUT_EDGES || edir == ALL_EDGES) {
-            foreach(const local_edge_type& e, l_vertex(i).out_edges()) {
-              edge_type edge(e);
-              transform_functor(edge);
-            }
-          }
-        }
-      }
+      std::vector<edge_transform_visitor<TransformType> >
+        visitors(num_visitor_threads(),
+                 edge_transform_visitor<TransformType>(this, transform_functor,
+                                                       edir));
+      for_each_in_vertex_set(vset, false, visitors);
       rpc.barrier();
     }
 
@@ -1302,6 +1255,9 @@ namespace graphlab {
           >> lvid2record
           >> local_graph;
       finalized = true;
+      use_dense_vid2lvid = false;
+      dense_vid2lvid.clear();
+      choose_vid2lvid_map();
       // check the graph condition
     } // end of load
 
@@ -1319,9 +1275,18 @@ namespace graphlab {
           << nedges 
           << local_own_nverts 
           << nreplicas 
-          << begin_eid
-          << vid2lvid
-          << lvid2record
+          << begin_eid;
+      if (use_dense_vid2lvid) {
+        // the map was released for the dense table, rebuild it
+        cuckoo_map_type map(-1);
+        for (size_t i = 0; i < lvid2record.size(); ++i) {
+          map[lvid2record[i].gvid] = lvid_type(i);
+        }
+        arc << map;
+      } else {
+        arc << vid2lvid;
+      }
+      arc << lvid2record
           << local_graph;
     } // end of save
 
@@ -1333,6 +1298,8 @@ namespace graphlab {
         vrec.clear();
       lvid2record.clear();
       vid2lvid.clear();
+      dense_vid2lvid.clear();
+      use_dense_vid2lvid = false;
       finalized=false;
     }
 
@@ -2005,8 +1972,9 @@ namespace graphlab {
       logstream(LOG_INFO) << "constructing pdf" << std::endl;
       for(size_t i = 0; i < prob.size(); ++i)
         prob[i] = std::pow(double(i+1), -alpha);
-      logstream(LOG_INFO) << "constructing cdf" << std::endl;
-      random::pdf2cdf(prob);
+      logstream(LOG_INFO) << "constructing alias table" << std::endl;
+      const random::alias_table degree_table(prob);
+      const uint64_t degree_seed = random::counter_seed();
       logstream(LOG_INFO) << "Building graph" << std::endl;
       size_t target_index = rpc.procid();
       size_t addedvtx = 0;
@@ -2015,7 +1983,9 @@ namespace graphlab {
       const size_t HASH_OFFSET = 2654435761;
       for(size_t source = rpc.procid(); source < nverts;
           source += rpc.numprocs()) {
-        const size_t out_degree = random::multinomial_cdf(prob) + 1;
+        // the degree of a vertex depends only on the seed and its id
+        random::counter_generator gen(degree_seed, source);
+        const size_t out_degree = degree_table.sample(gen.rand01()) + 1;
         for(size_t i = 0; i < out_degree; ++i) {
           target_index = (target_index + HASH_OFFSET)  % nverts;
           while (source == target_index) {
@@ -2120,17 +2090,40 @@ namespace graphlab {
      // foreach master bit which is set, set its corresponding mirror
      // synchronize master to mirrors
      vertex_set ret(empty_set());
-     ret.make_explicit(*this);
-
-     foreach(size_t lvid, cur.get_lvid_bitset(*this)) {
-       if (edir == IN_EDGES || edir == ALL_EDGES) {
-         foreach(local_edge_type e, l_vertex(lvid).in_edges()) {
-           ret.set_lvid_unsync(e.source().id());
+     if (!cur.lazy && cur.sparse) {
+       // a sparse frontier usually has a sparse neighborhood. Collect the
+       // neighbors in a list. The synchronization below makes the set
+       // dense again if the neighborhood turns out to be large.
+       std::vector<lvid_type> nbrs;
+       foreach(lvid_type lvid, cur.sparse_lvids) {
+         if (edir == IN_EDGES || edir == ALL_EDGES) {
+           foreach(local_edge_type e, l_vertex(lvid).in_edges()) {
+             nbrs.push_back(e.source().id());
+           }
+         }
+         if (edir == OUT_EDGES || edir == ALL_EDGES) {
+           foreach(local_edge_type e, l_vertex(lvid).out_edges()) {
+             nbrs.push_back(e.target().id());
+           }
          }
        }
-       if (edir == OUT_EDGES || edir == ALL_EDGES) {
-         foreach(local_edge_type e, l_vertex(lvid).out_edges()) {
-           ret.set_lvid_unsync(e.target().id());
+       std::vector<lvid_type> empty;
+       ret.assign_sparse(empty, num_local_vertices());
+       ret.merge_sparse(nbrs);
+     }
+     else {
+       ret.make_explicit(*this);
+       // walk a dense frontier through its bitset
+       foreach(size_t lvid, cur.get_lvid_bitset(*this)) {
+         if (edir == IN_EDGES || edir == ALL_EDGES) {
+           foreach(local_edge_type e, l_vertex(lvid).in_edges()) {
+             ret.set_lvid_unsync(e.source().id());
+           }
+         }
+         if (edir == OUT_EDGES || edir == ALL_EDGES) {
+           foreach(local_edge_type e, l_vertex(lvid).out_edges()) {
+             ret.set_lvid_unsync(e.target().id());
+           }
          }
        }
      }
@@ -2180,18 +2173,16 @@ namespace graphlab {
    vertex_set select(FunctionType select_functor,
                      const vertex_set& vset = complete_set()) {
      vertex_set ret(empty_set());
-
-     ret.make_explicit(*this);
-#ifdef _OPENMP
-        #pragma omp for
-#endif
-     for (int i = 0; i < (int)local_graph.num_vertices(); ++i) {
-       if (lvid2record[i].owner == rpc.procid() && 
-           vset.l_contains((lvid_type)i)) {
-         const vertex_type vtx(l_vertex(i));
-         if (select_functor(vtx)) ret.set_lvid(i);
-       }
+     std::vector<select_visitor<FunctionType> > 
+       visitors(num_visitor_threads(),
+                select_visitor<FunctionType>(this, select_functor));
+     for_each_in_vertex_set(vset, true, visitors);
+     std::vector<lvid_type> selected;
+     for (size_t i = 0; i < visitors.size(); ++i) {
+       selected.insert(selected.end(), visitors[i].selected.begin(),
+                       visitors[i].selected.end());
      }
+     ret.assign_lvids(*this, selected);
      ret.synchronize_master_to_mirrors(*this, vset_exchange);
      return ret; 
    }
@@ -2209,11 +2200,10 @@ namespace graphlab {
     * will always evaluate to graph.num_vertices();
     */
    size_t vertex_set_size(const vertex_set& vset) {
-     size_t count = 0;
-     for (int i = 0; i < (int)local_graph.num_vertices(); ++i) {
-        count += (lvid2record[i].owner == rpc.procid() && 
-                  vset.l_contains((lvid_type)i));
-     }
+     std::vector<count_visitor> visitors(num_visitor_threads());
+     for_each_in_vertex_set(vset, true, visitors);
+     tree_merge(visitors);
+     size_t count = visitors[0].acc;
      rpc.all_reduce(count);
      return count; 
    }
@@ -2228,10 +2218,231 @@ namespace graphlab {
    bool vertex_set_empty(const vertex_set& vset) {
      if (vset.lazy) return !vset.is_complete_set;
 
-     size_t count = vset.get_lvid_bitset(*this).empty();
+     size_t count = vset.local_empty();
      rpc.all_reduce(count);
      return count == rpc.numprocs(); 
    }
+  private:
+    /**
+     * \internal
+     * Accumulates a vertex map function over the vertices passed to
+     * operator(). Used by map_reduce_vertices().
+     */
+    template <typename ReductionType, typename MapFunctionType>
+    struct vertex_map_visitor {
+      distributed_graph* graph;
+      MapFunctionType mapfunction;
+      conditional_addition_wrapper<ReductionType> acc;
+      vertex_map_visitor(distributed_graph* graph,
+                         MapFunctionType mapfunction) :
+        graph(graph), mapfunction(mapfunction) { }
+      void operator()(lvid_type lvid) {
+        const vertex_type vtx(graph->l_vertex(lvid));
+        const ReductionType tmp = mapfunction(vtx);
+        acc += tmp;
+      }
+    };
+
+    /**
+     * \internal
+     * Accumulates an edge map function over the edges in direction edir
+     * of the vertices passed to operator(). Used by map_reduce_edges().
+     */
+    template <typename ReductionType, typename MapFunctionType>
+    struct edge_map_visitor {
+      distributed_graph* graph;
+      MapFunctionType mapfunction;
+      edge_dir_type edir;
+      conditional_addition_wrapper<ReductionType> acc;
+      edge_map_visitor(distributed_graph* graph,
+                       MapFunctionType mapfunction, edge_dir_type edir) :
+        graph(graph), mapfunction(mapfunction), edir(edir) { }
+      void operator()(lvid_type lvid) {
+        local_vertex_type lvertex(graph->l_vertex(lvid));
+        if (edir == IN_EDGES || edir == ALL_EDGES) {
+          foreach(const local_edge_type& e, lvertex.in_edges()) {
+            edge_type edge(e);
+            const ReductionType tmp = mapfunction(edge);
+            acc += tmp;
+          }
+        }
+        if (edir == OUT_EDGES || edir == ALL_EDGES) {
+          foreach(const local_edge_type& e, lvertex.out_edges()) {
+            edge_type edge(e);
+            const ReductionType tmp = mapfunction(edge);
+            acc += tmp;
+          }
+        }
+      }
+    };
+
+    /// Counts the vertices passed to operator()
+    struct count_visitor {
+      size_t acc;
+      count_visitor() : acc(0) { }
+      void operator()(lvid_type lvid) { ++acc; }
+    };
+
+    /**
+     * \internal
+     * Collects the vertices passed to operator() which pass the select
+     * functor. Used by select().
+     */
+    template <typename FunctionType>
+    struct select_visitor {
+      distributed_graph* graph;
+      FunctionType select_functor;
+      std::vector<lvid_type> selected;
+      select_visitor(distributed_graph* graph, FunctionType select_functor) :
+        graph(graph), select_functor(select_functor) { }
+      void operator()(lvid_type lvid) {
+        const vertex_type vtx(graph->l_vertex(lvid));
+        if (select_functor(vtx)) selected.push_back(lvid);
+      }
+    };
+
+    /**
+     * \internal
+     * Calls a transform functor on the vertices passed to operator().
+     * Used by transform_vertices().
+     */
+    template <typename TransformType>
+    struct vertex_transform_visitor {
+      distributed_graph* graph;
+      TransformType transform_functor;
+      vertex_transform_visitor(distributed_graph* graph,
+                               TransformType transform_functor) :
+        graph(graph), transform_functor(transform_functor) { }
+      void operator()(lvid_type lvid) {
+        vertex_type vtx(graph->l_vertex(lvid));
+        transform_functor(vtx);
+      }
+    };
+
+    /**
+     * \internal
+     * Calls a transform functor on the edges in direction edir of the 
+     * vertices passed to operator(). Used by transform_edges().
+     */
+    template <typename TransformType>
+    struct edge_transform_visitor {
+      distributed_graph* graph;
+      TransformType transform_functor;
+      edge_dir_type edir;
+      edge_transform_visitor(distributed_graph* graph,
+                             TransformType transform_functor,
+                             edge_dir_type edir) :
+        graph(graph), transform_functor(transform_functor), edir(edir) { }
+      void operator()(lvid_type lvid) {
+        local_vertex_type lvertex(graph->l_vertex(lvid));
+        if (edir == IN_EDGES || edir == ALL_EDGES) {
+          foreach(const local_edge_type& e, lvertex.in_edges()) {
+            edge_type edge(e);
+            transform_functor(edge);
+          }
+        }
+        if (edir == OUT_EDGES || edir == ALL_EDGES) {
+          foreach(const local_edge_type& e, lvertex.out_edges()) {
+            edge_type edge(e);
+            transform_functor(edge);
+          }
+        }
+      }
+    };
+
+    /// The number of visitors for_each_in_vertex_set() may use
+    static size_t num_visitor_threads() {
+#ifdef _OPENMP
+      return omp_get_max_threads();
+#else
+      return 1;
+#endif
+    }
+
+    /**
+     * \internal
+     * Calls one of the visitors on each local vertex in vset. If
+     * masters_only is set, only the vertices owned by this machine are
+     * visited. A sparse set is scanned through its list of members. A
+     * dense set is scanned a machine word at a time, skipping words
+     * without members. Each thread works on a private copy of its own
+     * visitor which is written back at the end. visitors must have
+     * num_visitor_threads() entries.
+     */
+    template <typename VisitorType>
+    void for_each_in_vertex_set(const vertex_set& vset, bool masters_only,
+                                std::vector<VisitorType>& visitors) const {
+      static const size_t WORD_BITS = 8 * sizeof(size_t);
+      if (vset.lazy && !vset.is_complete_set) return;
+      const bool complete = vset.lazy;
+      const bool sparse = !vset.lazy && vset.sparse;
+      const std::vector<lvid_type>& lvids = vset.sparse_lvids;
+      const dense_bitset& bits = vset.localvset;
+      const size_t nverts = complete ? local_graph.num_vertices() :
+          std::min<size_t>(local_graph.num_vertices(), bits.size());
+      const size_t nwords = (nverts + WORD_BITS - 1) / WORD_BITS;
+      const procid_t procid = rpc.procid();
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+      {
+#ifdef _OPENMP
+        const size_t threadid = omp_get_thread_num();
+#else
+        const size_t threadid = 0;
+#endif
+        VisitorType visitor = visitors[threadid];
+        if (sparse) {
+#ifdef _OPENMP
+          #pragma omp for schedule(guided)
+#endif
+          for (int i = 0; i < (int)lvids.size(); ++i) {
+            const lvid_type lvid = lvids[i];
+            if (masters_only && lvid2record[lvid].owner != procid) continue;
+            visitor(lvid);
+          }
+        }
+        else {
+#ifdef _OPENMP
+          #pragma omp for schedule(guided)
+#endif
+          for (int w = 0; w < (int)nwords; ++w) {
+            const size_t base = size_t(w) * WORD_BITS;
+            size_t word = complete ? size_t(-1) : bits.containing_word(base);
+            while (word) {
+              const size_t lvid = base + __builtin_ctzl(word);
+              word &= word - 1;
+              if (lvid >= nverts) break;
+              if (masters_only && lvid2record[lvid].owner != procid) continue;
+              visitor(lvid);
+            }
+          }
+        }
+        visitors[threadid] = visitor;
+      }
+    }
+
+    /**
+     * \internal
+     * Sums the accumulators of the visitors into visitors[0].acc,
+     * combining pairs of accumulators in parallel at each level of a
+     * binary tree.
+     */
+    template <typename VisitorType>
+    static void tree_merge(std::vector<VisitorType>& visitors) {
+      const int n = visitors.size();
+      for (int stride = 1; stride < n; stride *= 2) {
+#ifdef _OPENMP
+        #pragma omp parallel for if(n > 4)
+#endif
+        for (int i = 0; i < n - stride; i += 2 * stride) {
+          visitors[i].acc += visitors[i + stride].acc;
+        }
+      }
+    }
+
+  public:
+
 /****************************************************************************
  *                       Internal Functions                                 *
  *                     ----------------------                               *
@@ -2315,6 +2526,7 @@ namespace graphlab {
     /** \internal
      *\brief Convert a global vid to a local vid */
     lvid_type local_vid (const vertex_id_type vid) const {
+      if (use_dense_vid2lvid) return dense_vid2lvid.find(vid);
       // typename boost::unordered_map<vertex_id_type, lvid_type>::
       //   const_iterator iter = vid2lvid.find(vid);
       typename cuckoo_map_type::const_iterator iter = vid2lvid.find(vid);
@@ -2393,6 +2605,11 @@ namespace graphlab {
      * \brief Returns the internal vertex record of a given global vertex ID
      */
     const vertex_record& get_vertex_record(vertex_id_type vid) const {
+      if (use_dense_vid2lvid) {
+        const lvid_type lvid = dense_vid2lvid.find(vid);
+        ASSERT_NE(lvid, dense_vid2lvid_map::NO_LVID);
+        return lvid2record[lvid];
+      }
       // typename boost::unordered_map<vertex_id_type, lvid_type>::
       //   const_iterator iter = vid2lvid.find(vid);
       typename cuckoo_map_type::const_iterator iter = vid2lvid.find(vid);
@@ -2421,6 +2638,10 @@ namespace graphlab {
      *        master vertex on this machine and false otherwise.
      */
     bool is_master(vertex_id_type vid) const {
+      if (use_dense_vid2lvid) {
+        const lvid_type lvid = dense_vid2lvid.find(vid);
+        return lvid != dense_vid2lvid_map::NO_LVID && l_is_master(lvid);
+      }
       typename cuckoo_map_type::const_iterator iter = vid2lvid.find(vid);
       return (iter != vid2lvid.end()) && l_is_master(iter->second);
     }
@@ -2750,6 +2971,19 @@ namespace graphlab {
 
     cuckoo_map_type vid2lvid;
 
+    /**
+     * The dense table from global vertex ids to local vertex ids, used
+     * instead of vid2lvid once the graph is finalized if the local ids
+     * are dense enough. See choose_vid2lvid_map().
+     */
+    dense_vid2lvid_map dense_vid2lvid;
+
+    /** "auto", "dense" or "hash": how to choose the vid2lvid map */
+    std::string vid2lvid_method;
+
+    /** True if dense_vid2lvid replaces vid2lvid */
+    bool use_dense_vid2lvid;
+
         
     /** The global number of vertices and edges */
     size_t nverts, nedges;
@@ -2772,6 +3006,53 @@ namespace graphlab {
     /** Buffered Exchange used by vertex sets */
     buffered_exchange<vertex_id_type> vset_exchange;
 
+    /**
+     * \internal
+     * Chooses between the cuckoo map and the dense table to translate
+     * global vertex ids once the graph is finalized. With the "auto"
+     * method, the dense table is used if it takes no more memory than
+     * the cuckoo map, in which case the cuckoo map is released. The
+     * memory and lookup cost of both are logged.
+     */
+    void choose_vid2lvid_map() {
+      if (vid2lvid_method == "hash" || use_dense_vid2lvid) return;
+      const size_t cuckoo_bytes = vid2lvid.size() == 0 ? 0 :
+          size_t(vid2lvid.size() / vid2lvid.load_factor()) *
+          sizeof(typename cuckoo_map_type::value_type);
+      const size_t dense_bytes = dense_vid2lvid_map::estimate_bytes(lvid2record);
+      bool use_dense = vid2lvid_method == "dense" || dense_bytes <= cuckoo_bytes;
+      if (use_dense) {
+        dense_vid2lvid.build(lvid2record);
+        // time a sample of lookups in both
+        const size_t num_lookups = std::min<size_t>(lvid2record.size(), 1 << 20);
+        const size_t stride = std::max<size_t>(1, lvid2record.size() / (num_lookups + 1));
+        size_t checksum = 0;
+        timer ti; ti.start();
+        for (size_t i = 0; i < num_lookups; ++i) {
+          checksum += vid2lvid.find(lvid2record[i * stride].gvid)->second;
+        }
+        const double cuckoo_time = ti.current_time();
+        ti.start();
+        for (size_t i = 0; i < num_lookups; ++i) {
+          checksum -= dense_vid2lvid.find(lvid2record[i * stride].gvid);
+        }
+        const double dense_time = ti.current_time();
+        ASSERT_EQ(checksum, 0);
+        const double scale = num_lookups == 0 ? 0 : 1.0e9 / num_lookups;
+        logstream(LOG_INFO)
+          << "vid2lvid: cuckoo map " << cuckoo_bytes << " bytes, "
+          << cuckoo_time * scale << " ns/lookup; dense table "
+          << dense_bytes << " bytes, " << dense_time * scale
+          << " ns/lookup. Using the dense table." << std::endl;
+        cuckoo_map_type(-1).swap(vid2lvid);
+        use_dense_vid2lvid = true;
+      } else {
+        logstream(LOG_INFO)
+          << "vid2lvid: cuckoo map " << cuckoo_bytes << " bytes; dense table "
+          << dense_bytes << " bytes. Using the cuckoo map." << std::endl;
+      }
+    } // end of choose_vid2lvid_map
+
     void set_ingress_method(const std::string& method,
         size_t bufsize = 50000, bool usehash = false, bool userecent = false) {
 
@@ -559,21 +559,24 @@ namespace graphlab {
      * \brief Returns the column index of CSR stored in the 
      * internal local_graph storage.
      */
-    const std::vector<lvid_type>& get_out_index_storage() const {
+    const typename gstore_type::edge_id_array_type&
+    get_out_index_storage() const {
       return gstore.get_csr_src();
     }
     /** \internal
      * \brief Returns the row index of CSC stored in the 
      * internal local_graph storage.
      */
-    const std::vector<lvid_type>& get_in_index_storage() const {
+    const typename gstore_type::edge_id_array_type&
+    get_in_index_storage() const {
       return gstore.get_csc_dst(); 
     }
     /** \internal
      * \brief Returns the row pointer of CSR stored in the 
      * internal local_graph storage.
      */
-    const std::vector<lvid_type>& get_out_edge_storage() const {
+    const typename gstore_type::lvid_array_type&
+    get_out_edge_storage() const {
       return gstore.get_csr_dst();
     }
 
@@ -581,14 +584,16 @@ namespace graphlab {
      * \brief Returns the column pointer of CSC stored in the 
      * internal local_graph storage.
      */
-    const std::vector<lvid_type>& get_in_edge_storage() const {
+    const typename gstore_type::lvid_array_type&
+    get_in_edge_storage() const {
       return gstore.get_csc_src();
     }
     /** \internal
      * \brief Returns the reference of edge data list stored in the
      * internal local_graph storage.
      */
-    const std::vector<EdgeData> & get_edge_data_storage() const {
+    const typename gstore_type::edge_data_array_type&
+    get_edge_data_storage() const {
       return gstore.get_edge_data();
     }
 
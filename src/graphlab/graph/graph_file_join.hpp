@@ -0,0 +1,311 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_GRAPH_FILE_JOIN_HPP
+#define GRAPHLAB_GRAPH_FILE_JOIN_HPP
+#include <string>
+#include <vector>
+#include <fstream>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/filesystem.hpp>
+#include <graphlab/util/hopscotch_map.hpp>
+#include <graphlab/util/fs_util.hpp>
+#include <graphlab/util/hdfs.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/graph/distributed_graph.hpp>
+#include <graphlab/rpc/dc_dist_object.hpp>
+#include <graphlab/rpc/buffered_exchange.hpp>
+namespace graphlab {
+
+
+/**
+ * \brief Joins the vertices of a graph against the records of an
+ * external key/value file, without loading the file into a second
+ * graph.
+ *
+ * \tparam Graph Type of the graph
+ *
+ * Like the injective join of \ref graph_vertex_join, each vertex emits
+ * an integer key (or (size_t)(-1) to not participate), and keys must be
+ * unique within the graph:
+ * \code
+ * graph_file_join<graph_type> fjoin(dc, graph);
+ * fjoin.prepare(emit_key);
+ * \endcode
+ * where emit_key has the prototype
+ * \code
+ * size_t emit_key(const graph_type::vertex_type& vertex);
+ * \endcode
+ *
+ * The file is then streamed with:
+ * \code
+ * fjoin.join<value_type>("features/part", parser, join_op);
+ * \endcode
+ * where parser turns a line into a key and a value, and join_op
+ * applies a value to the vertex which emitted the matching key:
+ * \code
+ * bool parser(const std::string& line, size_t& key, value_type& value);
+ * void join_op(graph_type::vertex_type& vertex, const value_type& value);
+ * \endcode
+ *
+ * Files matching the prefix are divided among the machines as in
+ * \ref distributed_graph::load(). Records are hash partitioned by key to
+ * the machine controlling the key (key % numprocs), which forwards them
+ * to the machine owning the vertex. Both hops go through a
+ * buffered_exchange which is drained while the files are still being
+ * read, also by the machines which have no (or no more) files to read,
+ * so only a bounded amount of the file is held in memory at any time.
+ * Records whose key does not match any vertex are dropped, and if a key
+ * appears several times in the file join_op is called once per record.
+ *
+ * prepare() only needs to be called once, after which join() may be
+ * called any number of times. Both must be called by all machines.
+ */
+template <typename Graph>
+class graph_file_join {
+  public:
+    /// Type of the graph
+    typedef Graph graph_type;
+    /// Vertex Type of the graph
+    typedef typename graph_type::vertex_type vertex_type;
+    /// Local Vertex Type of the graph
+    typedef typename graph_type::local_vertex_type local_vertex_type;
+
+    dc_dist_object<graph_file_join<Graph> > rmi;
+
+  private:
+    /// Reference to the graph
+    graph_type& graph;
+
+    /// Keys emitted by the local vertices owned by this machine
+    hopscotch_map<size_t, lvid_type> key_to_vtx;
+
+    /// Owner of each key controlled by this machine
+    hopscotch_map<size_t, procid_t> key_directory;
+
+    /// Number of machines which finished reading their files
+    atomic<size_t> num_finished;
+
+    /// Number of lines read between draining the exchanges
+    static const size_t DRAIN_INTERVAL = 100000;
+
+  public:
+    graph_file_join(distributed_control& dc, graph_type& graph) :
+        rmi(dc, this), graph(graph) { }
+
+    /**
+     * \brief Associates each vertex with a key and builds the
+     * directory of keys. Must be called by all machines.
+     */
+    template <typename EmitKey>
+    void prepare(EmitKey emit_key) {
+      key_to_vtx.clear();
+      key_directory.clear();
+      std::vector<std::vector<size_t> > keys(rmi.numprocs());
+      for(lvid_type v = 0; v < graph.num_local_vertices(); ++v) {
+        local_vertex_type lv = graph.l_vertex(v);
+        if (lv.owned()) {
+          vertex_type vtx(lv);
+          const size_t key = emit_key(vtx);
+          if (key == (size_t)(-1)) continue;
+          if (key_to_vtx.count(key) > 0) {
+            logstream(LOG_ERROR) << "Duplicate key in graph" << std::endl;
+            logstream(LOG_ERROR) << "Duplicate keys not permitted" << std::endl;
+            throw "Duplicate Key in Join";
+          }
+          key_to_vtx.insert(std::make_pair(key, v));
+          keys[key % rmi.numprocs()].push_back(key);
+        }
+      }
+      rmi.all_to_all(keys);
+      for (size_t p = 0; p < keys.size(); ++p) {
+        for (size_t i = 0; i < keys[p].size(); ++i) {
+          ASSERT_MSG(key_directory.count(keys[p][i]) == 0,
+                     "Duplicate keys not permitted in file join");
+          key_directory.insert(std::make_pair(keys[p][i], (procid_t)p));
+        }
+      }
+    }
+
+    /**
+     * \brief Streams all files matching prefix (on the local filesystem
+     * or on HDFS), and calls join_op on the vertex matching each record.
+     * Returns the total number of records joined. Must be called by all
+     * machines.
+     */
+    template <typename ValueType, typename LineParser, typename JoinOp>
+    size_t join(const std::string& prefix, LineParser parser, JoinOp join_op) {
+      typedef buffered_exchange<std::pair<size_t, ValueType> > exchange_type;
+      exchange_type to_directory(rmi.dc());
+      exchange_type to_owner(rmi.dc());
+      size_t num_joined = 0;
+      num_finished.value = 0;
+      rmi.barrier();
+
+      bool is_hdfs = false;
+      std::vector<std::string> files = list_files(prefix, is_hdfs);
+      for (size_t i = 0; i < files.size(); ++i) {
+        if (i % rmi.numprocs() != rmi.procid()) continue;
+        logstream(LOG_EMPH) << "Joining against file: " << files[i] << std::endl;
+        const bool gzip = boost::ends_with(files[i], ".gz");
+        boost::iostreams::filtering_stream<boost::iostreams::input> fin;
+        if (gzip) fin.push(boost::iostreams::gzip_decompressor());
+        if (is_hdfs) {
+          graphlab::hdfs::fstream in_file(hdfs::get_hdfs(), files[i]);
+          fin.push(in_file);
+          stream_file(files[i], fin, parser, join_op,
+                      to_directory, to_owner, num_joined);
+          fin.pop();
+        } else {
+          std::ifstream in_file(files[i].c_str(),
+                                std::ios_base::in | std::ios_base::binary);
+          fin.push(in_file);
+          stream_file(files[i], fin, parser, join_op,
+                      to_directory, to_owner, num_joined);
+          fin.pop();
+        }
+        if (gzip) fin.pop();
+      }
+      // keep draining both hops until all machines are done reading,
+      // then complete the first hop, forward everything, and complete
+      // the second hop
+      to_directory.partial_flush(0);
+      for (procid_t p = 0; p < rmi.numprocs(); ++p) {
+        rmi.remote_call(p, &graph_file_join::finished_reading);
+      }
+      while (num_finished.value < rmi.numprocs()) {
+        const bool received = !to_directory.empty() || !to_owner.empty();
+        drain_directory(to_directory, to_owner, true);
+        drain_owner(to_owner, join_op, num_joined, true);
+        if (!received) timer::sleep_ms(1);
+      }
+      to_directory.flush();
+      drain_directory(to_directory, to_owner, false);
+      to_owner.flush();
+      drain_owner(to_owner, join_op, num_joined, false);
+      graph.synchronize();
+      rmi.all_reduce(num_joined);
+      return num_joined;
+    }
+
+  private:
+    void finished_reading() { num_finished.inc(); }
+
+    std::vector<std::string> list_files(const std::string& prefix,
+                                        bool& is_hdfs) {
+      std::vector<std::string> files;
+      is_hdfs = boost::starts_with(prefix, "hdfs://");
+      if (is_hdfs) {
+        std::string path = prefix;
+        if (path.length() > 0 && path[path.length() - 1] != '/') path = path + "/";
+        if(!hdfs::has_hadoop()) {
+          logstream(LOG_FATAL)
+            << "\n\tAttempting to join against files on HDFS but GraphLab"
+            << "\n\twas built without HDFS."
+            << std::endl;
+        }
+        files = hdfs::get_hdfs().list_files(path);
+      } else {
+        boost::filesystem::path path(prefix);
+        std::string directory_name;
+        std::string search_prefix;
+        if (boost::filesystem::is_directory(path)) {
+          directory_name = path.native();
+        } else {
+          directory_name = path.parent_path().native();
+          search_prefix = path.filename().native();
+          directory_name = (directory_name.empty() ? "." : directory_name);
+        }
+        fs_util::list_files_with_prefix(directory_name, search_prefix, files);
+      }
+      if (files.size() == 0) {
+        logstream(LOG_WARNING) << "No files found matching " << prefix << std::endl;
+      }
+      return files;
+    }
+
+    template <typename Stream, typename LineParser, typename JoinOp,
+              typename ExchangeType>
+    void stream_file(const std::string& fname, Stream& fin,
+                     LineParser& parser, JoinOp& join_op,
+                     ExchangeType& to_directory, ExchangeType& to_owner,
+                     size_t& num_joined) {
+      typename ExchangeType::buffer_type::value_type record;
+      std::string line;
+      size_t linecount = 0;
+      while(fin.good() && !fin.eof()) {
+        std::getline(fin, line);
+        if (fin.fail()) break;
+        if (line.empty()) continue;
+        if (!parser(line, record.first, record.second)) {
+          logstream(LOG_FATAL)
+            << "\n\tError parsing file: " << fname
+            << "\n\tLine: " << line << std::endl;
+        }
+        to_directory.send(record.first % rmi.numprocs(), record);
+        if (++linecount % DRAIN_INTERVAL == 0) {
+          drain_directory(to_directory, to_owner, true);
+          drain_owner(to_owner, join_op, num_joined, true);
+        }
+      }
+    }
+
+    /// Forwards records received on the first hop to the vertex owner
+    template <typename ExchangeType>
+    void drain_directory(ExchangeType& to_directory, ExchangeType& to_owner,
+                         bool try_lock) {
+      procid_t proc;
+      typename ExchangeType::buffer_type buffer;
+      while(to_directory.recv(proc, buffer, try_lock)) {
+        for (size_t i = 0; i < buffer.size(); ++i) {
+          hopscotch_map<size_t, procid_t>::const_iterator iter =
+              key_directory.find(buffer[i].first);
+          if (iter != key_directory.end()) to_owner.send(iter->second, buffer[i]);
+        }
+      }
+    }
+
+    /// Applies the records received on the second hop
+    template <typename ExchangeType, typename JoinOp>
+    void drain_owner(ExchangeType& to_owner, JoinOp& join_op,
+                     size_t& num_joined, bool try_lock) {
+      procid_t proc;
+      typename ExchangeType::buffer_type buffer;
+      while(to_owner.recv(proc, buffer, try_lock)) {
+        for (size_t i = 0; i < buffer.size(); ++i) {
+          hopscotch_map<size_t, lvid_type>::const_iterator iter =
+              key_to_vtx.find(buffer[i].first);
+          ASSERT_TRUE(iter != key_to_vtx.end());
+          vertex_type vtx(graph.l_vertex(iter->second));
+          join_op(vtx, buffer[i].second);
+          ++num_joined;
+        }
+      }
+    }
+};
+
+} // namespace graphlab
+
+#endif
@@ -64,6 +64,8 @@
 
 #include <graphlab/util/random.hpp>
 #include <graphlab/util/generics/shuffle.hpp>
+#include <graphlab/util/huge_page_allocator.hpp>
+#include <graphlab/util/file_backed_allocator.hpp>
 #include <graphlab/graph/graph_basic_types.hpp>
 
 
@@ -98,6 +100,19 @@ namespace graphlab {
      * */
     typedef std::pair<size_t, size_t>  edge_range_type;
 
+    /** \internal
+     * \brief The array types of the storage. Their placement on huge
+     * pages is selected by the huge_pages policy. The edge data may
+     * instead be placed in a memory mapped file, see
+     * \ref file_backed_memory.
+     */
+    typedef std::vector<edge_id_type, huge_page_allocator<edge_id_type> >
+        edge_id_array_type;
+    typedef std::vector<lvid_type, huge_page_allocator<lvid_type> >
+        lvid_array_type;
+    typedef std::vector<EdgeData, file_backed_allocator<EdgeData> >
+        edge_data_array_type;
+
     friend class json_parser<VertexData, EdgeData>;
 
 
@@ -108,9 +123,9 @@ namespace graphlab {
     // Edge class for temporary storage. Will be finalized into the CSR+CSC form.
     class edge_info {
     public:
-      std::vector<EdgeData> data;
-      std::vector<lvid_type> source_arr;
-      std::vector<lvid_type> target_arr;
+      edge_data_array_type data;
+      lvid_array_type source_arr;
+      lvid_array_type target_arr;
     public:
       edge_info () {}
       void reserve_edge_space(size_t n) {
@@ -134,9 +149,9 @@ namespace graphlab {
       }
       // \brief Remove all contents in the storage. 
       void clear() {
-        std::vector<EdgeData>().swap(data);
-        std::vector<lvid_type>().swap(source_arr);
-        std::vector<lvid_type>().swap(target_arr);
+        edge_data_array_type().swap(data);
+        lvid_array_type().swap(source_arr);
+        lvid_array_type().swap(target_arr);
       }
       // \brief Return the size of the storage.
       size_t size() const {
@@ -401,6 +416,60 @@ namespace graphlab {
                             c2r_map[edge._edge_id]];
     }
 
+    /**
+     * \brief Asks the kernel to read ahead the file backed edge data of
+     * the active vertices of the block of 64 vertices starting at
+     * begin: the in edges of vertex begin + i if bit i of in_active is
+     * set, and its out edges if bit i of out_active is set.
+     *
+     * The data of the out edges of a vertex is contiguous in CSR order.
+     * The data of the in edges is scattered by the CSC order. The pages
+     * holding the data are collected and read ahead as runs of nearby
+     * pages. Does nothing unless some memory is file backed.
+     */
+    void prefetch_edge_data(lvid_type begin, size_t in_active,
+                            size_t out_active) const {
+      if (!file_backed_memory::has_mappings() || num_edges == 0) return;
+      const size_t page_size = 4096;
+      // runs of pages closer than this are read as one range, reading
+      // a few unused pages to save a system call per run
+      const size_t max_gap = 64;
+      const char* base = reinterpret_cast<const char*>(&edge_data_list[0]);
+      // (first page, last page) of each run
+      std::vector<std::pair<size_t, size_t> > runs;
+      for (size_t bits = out_active; bits != 0; bits &= bits - 1) {
+        const lvid_type v = begin + __builtin_ctzl(bits);
+        if (v >= num_vertices) break;
+        std::pair<bool, edge_range_type> range = outEdgeRange(v);
+        if (!range.first) continue;
+        runs.push_back(std::make_pair(
+            range.second.first * sizeof(EdgeData) / page_size,
+            range.second.second * sizeof(EdgeData) / page_size));
+      }
+      for (size_t bits = in_active; bits != 0; bits &= bits - 1) {
+        const lvid_type v = begin + __builtin_ctzl(bits);
+        if (v >= num_vertices) break;
+        std::pair<bool, edge_range_type> range = inEdgeRange(v);
+        if (!range.first) continue;
+        for (size_t e = range.second.first; e <= range.second.second; ++e) {
+          const size_t page = c2r_map[e] * sizeof(EdgeData) / page_size;
+          runs.push_back(std::make_pair(page, page));
+        }
+      }
+      std::sort(runs.begin(), runs.end());
+      for (size_t i = 0; i < runs.size(); ) {
+        size_t last = runs[i].second;
+        size_t j = i + 1;
+        while (j < runs.size() && runs[j].first <= last + max_gap) {
+          last = std::max(last, runs[j].second);
+          ++j;
+        }
+        file_backed_memory::prefetch(base + runs[i].first * page_size,
+                                     (last - runs[i].first + 1) * page_size);
+        i = j;
+      }
+    } // end of prefetch_edge_data
+
     /** \brief Returns a list of in edges of a vertex. */
     edge_list in_edges(const lvid_type v) const {
       if (v >= num_vertices)
@@ -488,7 +557,7 @@ namespace graphlab {
       num_edges = edges.size();
 
       // Permute_index, alias of c2r_map. Confusing but efficient.
-      std::vector<edge_id_type>& permute_index = c2r_map;
+      edge_id_array_type& permute_index = c2r_map;
       permute_index.reserve(num_edges); 
 
       // Counter_index.
@@ -751,14 +820,14 @@ namespace graphlab {
 
     /** \brief Reset the storage and free the reserved memory. */
     void clear_reserve() {
-      std::vector<edge_id_type>().swap(CSR_src);
-      std::vector<lvid_type>().swap(CSR_dst);
-      std::vector<lvid_type>().swap(CSC_src);
-      std::vector<edge_id_type>().swap(CSC_dst);
-      std::vector<edge_id_type>().swap(c2r_map);
-      std::vector<EdgeData>().swap(edge_data_list);
-      std::vector<edge_id_type>().swap(CSR_src_skip);
-      std::vector<edge_id_type>().swap(CSC_dst_skip);
+      edge_id_array_type().swap(CSR_src);
+      lvid_array_type().swap(CSR_dst);
+      lvid_array_type().swap(CSC_src);
+      edge_id_array_type().swap(CSC_dst);
+      edge_id_array_type().swap(c2r_map);
+      edge_data_array_type().swap(edge_data_list);
+      edge_id_array_type().swap(CSR_src_skip);
+      edge_id_array_type().swap(CSC_dst_skip);
     }
 
     size_t estimate_sizeof() const {
@@ -826,11 +895,11 @@ namespace graphlab {
     size_t num_edges;
 
     /** Array of edge data sorted by source vid. */
-    std::vector<EdgeData> edge_data_list;
+    edge_data_array_type edge_data_list;
 
     /** \internal 
      * Row index of CSR, corresponding to the source vertices. */
-    std::vector<edge_id_type> CSR_src;
+    edge_id_array_type CSR_src;
 
     /** 
      * \internal 
@@ -840,19 +909,19 @@ namespace graphlab {
      * is used to jump to the prev/next valid vertex in CSR_src.  
      * Optional.
      */
-    std::vector<edge_id_type> CSR_src_skip;
+    edge_id_array_type CSR_src_skip;
 
     /** \internal 
      * Col index of CSR, corresponding to the target vertices. */
-    std::vector<lvid_type> CSR_dst;
+    lvid_array_type CSR_dst;
 
     /** \internal 
      * Map the sort-by-col edge id to sort-by-row edge id */
-    std::vector<edge_id_type> c2r_map;
+    edge_id_array_type c2r_map;
 
     /** \internal
      * Row index of CSC, corresponding to the target vertices. */
-    std::vector<edge_id_type> CSC_dst;
+    edge_id_array_type CSC_dst;
 
     /* 
      * \internal 
@@ -862,10 +931,10 @@ namespace graphlab {
      * is used to jump to the prev/next valid vertex in CSC_dst.  
      * Optional.
      */
-    std::vector<edge_id_type> CSC_dst_skip;
+    edge_id_array_type CSC_dst_skip;
     /** \internal
      * Col index of CSC, corresponding to the source vertices. */
-    std::vector<lvid_type> CSC_src;
+    lvid_array_type CSC_src;
 
     /** Graph storage traits. */
     bool use_skip_list;
@@ -922,8 +991,9 @@ namespace graphlab {
      *  Compare functor of any type*/
     template <typename anyvalue>
     struct cmp_by_any_functor {
-      const std::vector<anyvalue>& vec;
-      cmp_by_any_functor(const std::vector<anyvalue>& _vec) : vec(_vec) { }
+      const std::vector<anyvalue, huge_page_allocator<anyvalue> >& vec;
+      cmp_by_any_functor(const std::vector<anyvalue,
+                         huge_page_allocator<anyvalue> >& _vec) : vec(_vec) { }
       bool operator()(size_t me, size_t other) const {
         return (vec[me] < vec[other]);
       }
@@ -933,7 +1003,7 @@ namespace graphlab {
      *  Counting sort vector in ascending order and 
      *  fill the counting array and permute index array. */
     template <typename valuetype>
-    void counting_sort(const std::vector<valuetype>& value_array, std::vector< atomic<int> >& counter_array, std::vector<edge_id_type>& permute_index) {
+    void counting_sort(const std::vector<valuetype, huge_page_allocator<valuetype> >& value_array, std::vector< atomic<int> >& counter_array, edge_id_array_type& permute_index) {
       counter_array.assign(counter_array.size(), 0);
       permute_index.assign(permute_index.size(), 0);
 #ifdef _OPENMP
@@ -959,7 +1029,7 @@ namespace graphlab {
     /** \internal
      *  Binary search vfind in a vector of lvid_type 
      *  within range [start, end]. Returns (size_t)(-1) if not found. */
-    size_t binary_search(const std::vector<lvid_type>& vec, 
+    size_t binary_search(const lvid_array_type& vec, 
                          size_t start, size_t end, 
                          lvid_type vfind) const {
       ASSERT_LT(vfind, num_vertices);
@@ -1044,7 +1114,7 @@ namespace graphlab {
      * This function is useful in binary search where the middle is not
      * assumed to be valid. */
     inline lvid_type 
-    nextValid(const std::vector<edge_id_type>& vertex_array, 
+    nextValid(const edge_id_array_type& vertex_array, 
               lvid_type curv, bool use_skip_list) const {
 
       if (curv == num_vertices-1) return num_vertices;
@@ -1065,7 +1135,7 @@ namespace graphlab {
      * Return num_vertices if there is no valid vertex previous to the curent vertex.
      */
     inline lvid_type 
-    prevValid(const std::vector<lvid_type>& vertex_array, 
+    prevValid(const edge_id_array_type& vertex_array, 
               lvid_type curv, bool use_skip_list) const {
       if (curv == 0) return -1;
 
@@ -1083,27 +1153,27 @@ namespace graphlab {
 
     /** \internal
      * Returns a reference of CSR_src.*/
-    const std::vector<lvid_type>& get_csr_src() const {
+    const edge_id_array_type& get_csr_src() const {
       return CSR_src;
     }
     /** \internal
      * Returns a reference of CSR_dst.*/
-    const std::vector<edge_id_type>& get_csr_dst() const {
+    const lvid_array_type& get_csr_dst() const {
       return CSR_dst;
     }
     /** \internal
      * Returns a reference of CSC_src.*/
-    const std::vector<edge_id_type>& get_csc_src() const {
+    const lvid_array_type& get_csc_src() const {
       return CSC_src;
     }
     /** \internal
      * Returns a reference of CSC_dst.*/
-    const std::vector<lvid_type>& get_csc_dst() const {
+    const edge_id_array_type& get_csc_dst() const {
       return CSC_dst;
     }
     /** \internal
      * Returns a reference of edge_data_list.*/
-    const std::vector<EdgeData>& get_edge_data() const {
+    const edge_data_array_type& get_edge_data() const {
       return edge_data_list;
     }
 
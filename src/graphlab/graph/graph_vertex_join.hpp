@@ -23,8 +23,10 @@
 #ifndef GRAPHLAB_GRAPH_JOIN_HPP
 #define GRAPHLAB_GRAPH_JOIN_HPP
 #include <utility>
+#include <algorithm>
 #include <boost/unordered_map.hpp>
 #include <graphlab/util/hopscotch_map.hpp>
+#include <graphlab/util/dense_bitset.hpp>
 #include <graphlab/graph/distributed_graph.hpp>
 #include <graphlab/rpc/dc_dist_object.hpp>
 namespace graphlab {
@@ -166,6 +168,20 @@ namespace graphlab {
  * ## Right Injective Join
  * The right injective join is similar to the left injective join, but
  * with types reversed.
+ *
+ * ## Reusing the Join Index
+ * The join index built by prepare_injective_join() is kept, and each
+ * machine remembers, for every other machine, the ordered list of its
+ * local vertices matched against vertices on that machine. A join
+ * therefore only ships vertex data (no keys) in that order, and the
+ * receiver applies it positionally without any hash lookups.
+ *
+ * If the emitted keys of some vertices change (or vertices stop or start
+ * participating), refresh_injective_join() updates the index by
+ * exchanging only the keys which changed, rather than re-shuffling every
+ * key as prepare_injective_join() does. For this, every machine keeps
+ * the directory entries of the keys it controls
+ * (key % numprocs == procid).
  */
 template <typename LeftGraph, typename RightGraph> 
 class graph_vertex_join {
@@ -200,10 +216,35 @@ class graph_vertex_join {
       hopscotch_map<size_t, vertex_id_type> key_to_vtx;
       // we use -1 here to indicate that the vertex is not participating
       std::vector<procid_t> opposing_join_proc;
+      // matched_by_proc[p] lists the local vertices matched with a
+      // vertex on machine p, in increasing order of key. Both sides of
+      // the join agree on this order, so vertex data can be exchanged
+      // without keys.
+      std::vector<std::vector<lvid_type> > matched_by_proc;
+      // the machine in whose matched_by_proc list each vertex currently
+      // is, -1 if none
+      std::vector<procid_t> matched_proc;
+      // vertices whose key or opposing machine changed since the
+      // matched_by_proc lists were last updated
+      std::vector<lvid_type> dirty;
+
+      void clear() {
+        std::vector<size_t>().swap(vtx_to_key);
+        key_to_vtx.clear();
+        std::vector<procid_t>().swap(opposing_join_proc);
+        std::vector<std::vector<lvid_type> >().swap(matched_by_proc);
+        std::vector<procid_t>().swap(matched_proc);
+        std::vector<lvid_type>().swap(dirty);
+      }
     };
 
     injective_join_index left_inj_index, right_inj_index;
 
+    // For each key controlled by this machine, the machines holding the
+    // left and right vertices which emitted it (-1 if none).
+    typedef std::pair<procid_t, procid_t> directory_entry;
+    hopscotch_map<size_t, directory_entry> key_directory;
+
   public:
     graph_vertex_join(distributed_control& dc,
                       left_graph_type& left,
@@ -254,7 +295,6 @@ class graph_vertex_join {
     template <typename LeftEmitKey, typename RightEmitKey>
     void prepare_injective_join(LeftEmitKey left_emit_key, 
                                 RightEmitKey right_emit_key) {
-      typedef std::pair<size_t, vertex_id_type> key_vertex_pair;
       // Basically, what we are trying to do is to figure out, for each vertex
       // on one side of the graph, which vertices for the other graph
       // (and on on which machines) emitted the same key.
@@ -265,21 +305,58 @@ class graph_vertex_join {
       //                          graph which emitted the same key
       // key_to_vtx[key] Mapping of keys to vertices. 
       
-      // resize the left index
-      // resize the right index
+      //
+      // This is the same as refreshing an empty index.
+      left_inj_index.clear();
+      right_inj_index.clear();
+      key_directory.clear();
+      refresh_injective_join(left_emit_key, right_emit_key);
+    }
 
-      reset_and_fill_injective_index(left_inj_index, 
-                                     left_graph, 
-                                     left_emit_key, "left graph");    
 
-      reset_and_fill_injective_index(right_inj_index, 
-                                     right_graph, 
-                                     right_emit_key, "right graph");    
-      rmi.barrier(); 
-      // now, we need cross join across all machines to figure out the 
-      // opposing join proc
-      // we need to do this twice. Once for left, and once for right. 
-      compute_injective_join();
+    /**
+      * \brief Updates the join index after the keys emitted by some
+      * vertices have changed.
+      *
+      * Takes the same arguments as prepare_injective_join(), which must
+      * have been called before. Keys are recomputed locally, and only
+      * the keys which changed are sent to the machines controlling them,
+      * and the changed vertices are merged into the per machine matched
+      * lists. The cost is a local pass over the vertices, plus the number
+      * of changed keys, plus a linear pass over the matched lists of the
+      * machines which gained or lost a match. This function must be
+      * called by all machines.
+      */
+    template <typename LeftEmitKey, typename RightEmitKey>
+    void refresh_injective_join(LeftEmitKey left_emit_key,
+                                RightEmitKey right_emit_key) {
+      std::vector<std::vector<size_t> > left_removed(rmi.numprocs());
+      std::vector<std::vector<size_t> > left_added(rmi.numprocs());
+      std::vector<std::vector<size_t> > right_removed(rmi.numprocs());
+      std::vector<std::vector<size_t> > right_added(rmi.numprocs());
+      update_injective_index(left_inj_index, left_graph, left_emit_key,
+                             left_removed, left_added, "left graph");
+      update_injective_index(right_inj_index, right_graph, right_emit_key,
+                             right_removed, right_added, "right graph");
+      rmi.all_to_all(left_removed);
+      rmi.all_to_all(left_added);
+      rmi.all_to_all(right_removed);
+      rmi.all_to_all(right_added);
+      // update the directory and tell both sides of every touched key
+      // about their (new) opposing machine
+      std::vector<std::vector<std::pair<size_t, procid_t> > >
+          left_match(rmi.numprocs());
+      std::vector<std::vector<std::pair<size_t, procid_t> > >
+          right_match(rmi.numprocs());
+      update_directory(left_removed, left_added,
+                       right_removed, right_added,
+                       left_match, right_match);
+      rmi.all_to_all(left_match);
+      rmi.all_to_all(right_match);
+      apply_matches(left_inj_index, left_match);
+      apply_matches(right_inj_index, right_match);
+      update_matched_by_proc(left_inj_index);
+      update_matched_by_proc(right_inj_index);
     }
 
     /**
@@ -334,141 +411,200 @@ class graph_vertex_join {
     }
 
   private:
+    /**
+     * Recomputes the key of every owned vertex. Keys which are no longer
+     * emitted are appended to removed[controlling proc] and new keys to
+     * added[controlling proc].
+     */
     template <typename Graph, typename EmitKey>
-    void reset_and_fill_injective_index(injective_join_index& idx,
-                                        Graph& graph,
-                                        EmitKey& emit_key,
-                                        const char* message) {
-      // clear the data
-      idx.vtx_to_key.resize(graph.num_local_vertices());
-      idx.key_to_vtx.clear(); 
+    void update_injective_index(injective_join_index& idx,
+                                Graph& graph,
+                                EmitKey& emit_key,
+                                std::vector<std::vector<size_t> >& removed,
+                                std::vector<std::vector<size_t> >& added,
+                                const char* message) {
+      idx.vtx_to_key.resize(graph.num_local_vertices(), (size_t)(-1));
       idx.opposing_join_proc.resize(graph.num_local_vertices(), (procid_t)(-1));
-      // loop through vertices, get the key and fill vtx_to_key and key_to_vtx
+      idx.matched_proc.resize(graph.num_local_vertices(), (procid_t)(-1));
+      std::vector<lvid_type> changed;
+      // first pass: remove all old keys, so that keys may move between
+      // vertices
       for(lvid_type v = 0; v < graph.num_local_vertices(); ++v) {
         typename Graph::local_vertex_type lv = graph.l_vertex(v);
         if (lv.owned()) {
           typename Graph::vertex_type vtx(lv);
-          size_t key = emit_key(vtx);
-          idx.vtx_to_key[v] = key;
-          if (key != (size_t)(-1)) {
-            if (idx.key_to_vtx.count(key) > 0) {
-              logstream(LOG_ERROR) << "Duplicate key in " << message << std::endl;
-              logstream(LOG_ERROR) << "Duplicate keys not permitted" << std::endl;
-              throw "Duplicate Key in Join";
-            }
-            idx.key_to_vtx.insert(std::make_pair(key, v));
+          const size_t key = emit_key(vtx);
+          const size_t oldkey = idx.vtx_to_key[v];
+          if (key == oldkey) continue;
+          if (oldkey != (size_t)(-1)) {
+            idx.key_to_vtx.erase(oldkey);
+            removed[oldkey % rmi.numprocs()].push_back(oldkey);
           }
+          idx.vtx_to_key[v] = key;
+          idx.opposing_join_proc[v] = (procid_t)(-1);
+          idx.dirty.push_back(v);
+          if (key != (size_t)(-1)) changed.push_back(v);
+        }
+      }
+      // second pass: insert the new keys
+      for (size_t i = 0; i < changed.size(); ++i) {
+        const size_t key = idx.vtx_to_key[changed[i]];
+        if (idx.key_to_vtx.count(key) > 0) {
+          logstream(LOG_ERROR) << "Duplicate key in " << message << std::endl;
+          logstream(LOG_ERROR) << "Duplicate keys not permitted" << std::endl;
+          throw "Duplicate Key in Join";
         }
+        idx.key_to_vtx.insert(std::make_pair(key, changed[i]));
+        added[key % rmi.numprocs()].push_back(key);
       }
     }
 
-    void compute_injective_join() {
-      std::vector<std::vector<size_t> > left_keys = 
-          get_procs_with_keys(left_inj_index.vtx_to_key, left_graph);
-      std::vector<std::vector<size_t> > right_keys = 
-          get_procs_with_keys(right_inj_index.vtx_to_key, right_graph);
-      // now. for each key on the right, I need to figure out which proc it
-      // belongs in. and vice versa. This is actually kind of annoying.
-      // but since it is one-to-one, I only need to make a hash map of one side.
-      hopscotch_map<size_t, procid_t> left_key_to_procs;
-
-      // construct a hash table of keys to procs
-      // clear frequently to use less memory
-      for (size_t p = 0; p < left_keys.size(); ++p) {
-        for (size_t i = 0; i < left_keys[p].size(); ++i) {
-          ASSERT_MSG(left_key_to_procs.count(left_keys[p][i]) == 0,
+    /**
+     * Applies the removed and added keys received from every machine to
+     * the directory of keys controlled by this machine. For each touched
+     * key which is present on both sides, both machines are told about
+     * each other. A side which lost its partner is told -1.
+     */
+    void update_directory(
+        const std::vector<std::vector<size_t> >& left_removed,
+        const std::vector<std::vector<size_t> >& left_added,
+        const std::vector<std::vector<size_t> >& right_removed,
+        const std::vector<std::vector<size_t> >& right_added,
+        std::vector<std::vector<std::pair<size_t, procid_t> > >& left_match,
+        std::vector<std::vector<std::pair<size_t, procid_t> > >& right_match) {
+      const directory_entry empty_entry((procid_t)(-1), (procid_t)(-1));
+      std::vector<size_t> touched;
+      // removals first, so that a key may move between machines
+      for (size_t p = 0; p < left_removed.size(); ++p) {
+        for (size_t i = 0; i < left_removed[p].size(); ++i) {
+          const size_t key = left_removed[p][i];
+          key_directory[key].first = (procid_t)(-1);
+          touched.push_back(key);
+        }
+      }
+      for (size_t p = 0; p < right_removed.size(); ++p) {
+        for (size_t i = 0; i < right_removed[p].size(); ++i) {
+          const size_t key = right_removed[p][i];
+          key_directory[key].second = (procid_t)(-1);
+          touched.push_back(key);
+        }
+      }
+      for (size_t p = 0; p < left_added.size(); ++p) {
+        for (size_t i = 0; i < left_added[p].size(); ++i) {
+          const size_t key = left_added[p][i];
+          typename hopscotch_map<size_t, directory_entry>::iterator iter =
+              key_directory.find(key);
+          if (iter == key_directory.end()) {
+            iter = key_directory.insert(std::make_pair(key, empty_entry)).first;
+          }
+          ASSERT_MSG(iter->second.first == (procid_t)(-1),
                      "Duplicate keys not permitted for left graph keys in injective join");
-          left_key_to_procs.insert(std::make_pair(left_keys[p][i], p));
+          iter->second.first = p;
+          touched.push_back(key);
         }
-        std::vector<size_t>().swap(left_keys[p]);
       }
-      left_keys.clear();
-     
-      std::vector<
-          std::vector<
-              std::pair<size_t, procid_t> > > left_match(rmi.numprocs());
-      std::vector<
-          std::vector<
-              std::pair<size_t, procid_t> > > right_match(rmi.numprocs());
-
-      // now for each key on the right, find the matching key on the left
-      for (size_t p = 0; p < right_keys.size(); ++p) {
-        for (size_t i = 0; i < right_keys[p].size(); ++i) {
-          size_t key = right_keys[p][i];
-          hopscotch_map<size_t, procid_t>::iterator iter =
-              left_key_to_procs.find(key);
-          if (iter != left_key_to_procs.end()) {
-            ASSERT_MSG(iter->second != (procid_t)(-1),
-                       "Duplicate keys not permitted for right graph keys in injective join");
-            // we have a match
-            procid_t left_proc = iter->second;
-            procid_t right_proc = p;
-            // now. left has to be told about right and right
-            // has to be told about left
-            left_match[left_proc].push_back(std::make_pair(key, right_proc));
-            right_match[right_proc].push_back(std::make_pair(key, left_proc));
-            // set the map entry to -1 
-            // so we know if it is ever reused
-            iter->second = (procid_t)(-1); 
+      for (size_t p = 0; p < right_added.size(); ++p) {
+        for (size_t i = 0; i < right_added[p].size(); ++i) {
+          const size_t key = right_added[p][i];
+          typename hopscotch_map<size_t, directory_entry>::iterator iter =
+              key_directory.find(key);
+          if (iter == key_directory.end()) {
+            iter = key_directory.insert(std::make_pair(key, empty_entry)).first;
           }
+          ASSERT_MSG(iter->second.second == (procid_t)(-1),
+                     "Duplicate keys not permitted for right graph keys in injective join");
+          iter->second.second = p;
+          touched.push_back(key);
         }
-        std::vector<size_t>().swap(right_keys[p]);
       }
-      right_keys.clear();
+      std::sort(touched.begin(), touched.end());
+      touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+      for (size_t i = 0; i < touched.size(); ++i) {
+        typename hopscotch_map<size_t, directory_entry>::iterator iter =
+            key_directory.find(touched[i]);
+        const directory_entry entry = iter->second;
+        if (entry.first != (procid_t)(-1)) {
+          left_match[entry.first].push_back(std::make_pair(touched[i], entry.second));
+        }
+        if (entry.second != (procid_t)(-1)) {
+          right_match[entry.second].push_back(std::make_pair(touched[i], entry.first));
+        }
+        if (entry == empty_entry) key_directory.erase(iter);
+      }
+    }
 
-      rmi.all_to_all(left_match);
-      rmi.all_to_all(right_match);
-      // fill in the index
-      // go through the left match and set up the opposing index to based
-      // on the match result
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-      for (size_t p = 0;p < left_match.size(); ++p) {
-        for (size_t i = 0;i < left_match[p].size(); ++i) {
-          // search for the key in the left index
-          hopscotch_map<size_t, vertex_id_type>::const_iterator iter = 
-              left_inj_index.key_to_vtx.find(left_match[p][i].first);
-          ASSERT_TRUE(iter != left_inj_index.key_to_vtx.end());
+    void apply_matches(injective_join_index& idx,
+                       const std::vector<std::vector<std::pair<size_t, procid_t> > >& match) {
+      for (size_t p = 0;p < match.size(); ++p) {
+        for (size_t i = 0;i < match[p].size(); ++i) {
+          // search for the key in the index
+          hopscotch_map<size_t, vertex_id_type>::const_iterator iter =
+              idx.key_to_vtx.find(match[p][i].first);
+          ASSERT_TRUE(iter != idx.key_to_vtx.end());
           // fill in the match
-          left_inj_index.opposing_join_proc[iter->second] = left_match[p][i].second;
+          idx.opposing_join_proc[iter->second] = match[p][i].second;
+          idx.dirty.push_back(iter->second);
+        }
+      }
+    }
+
+    /**
+     * Moves the dirty vertices to the matched_by_proc list of their new
+     * opposing machine. Each list with changes is rewritten by a single
+     * merge of its remaining vertices, which are already in key order,
+     * with the sorted vertices joining it. Lists without changes are left
+     * alone.
+     */
+    void update_matched_by_proc(injective_join_index& idx) {
+      idx.matched_by_proc.resize(rmi.numprocs());
+      std::sort(idx.dirty.begin(), idx.dirty.end());
+      idx.dirty.erase(std::unique(idx.dirty.begin(), idx.dirty.end()),
+                      idx.dirty.end());
+      dense_bitset leaving(idx.matched_proc.size());
+      leaving.clear();
+      std::vector<std::vector<std::pair<size_t, lvid_type> > >
+          joining(rmi.numprocs());
+      std::vector<char> touched(rmi.numprocs(), false);
+      for (size_t i = 0; i < idx.dirty.size(); ++i) {
+        const lvid_type v = idx.dirty[i];
+        const procid_t oldp = idx.matched_proc[v];
+        const procid_t newp = idx.opposing_join_proc[v];
+        if (oldp < rmi.numprocs()) {
+          leaving.set_bit(v);
+          touched[oldp] = true;
+        }
+        if (newp < rmi.numprocs()) {
+          joining[newp].push_back(std::make_pair(idx.vtx_to_key[v], v));
+          touched[newp] = true;
+          idx.matched_proc[v] = newp;
+        } else {
+          idx.matched_proc[v] = (procid_t)(-1);
         }
       }
-      left_match.clear();
-      // repeat for the right match
+      std::vector<lvid_type>().swap(idx.dirty);
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
-      for (size_t p = 0;p < right_match.size(); ++p) {
-        for (size_t i = 0;i < right_match[p].size(); ++i) {
-          // search for the key in the right index
-          hopscotch_map<size_t, vertex_id_type>::const_iterator iter = 
-              right_inj_index.key_to_vtx.find(right_match[p][i].first);
-          ASSERT_TRUE(iter != right_inj_index.key_to_vtx.end());
-          // fill in the match
-          right_inj_index.opposing_join_proc[iter->second] = right_match[p][i].second;
+      for (size_t p = 0; p < joining.size(); ++p) {
+        if (!touched[p]) continue;
+        std::sort(joining[p].begin(), joining[p].end());
+        std::vector<lvid_type>& matched = idx.matched_by_proc[p];
+        std::vector<lvid_type> merged;
+        merged.reserve(matched.size() + joining[p].size());
+        size_t j = 0;
+        for (size_t i = 0; i < matched.size(); ++i) {
+          if (leaving.get(matched[i])) continue;
+          const size_t key = idx.vtx_to_key[matched[i]];
+          for (; j < joining[p].size() && joining[p][j].first < key; ++j) {
+            merged.push_back(joining[p][j].second);
+          }
+          merged.push_back(matched[i]);
         }
-      }
-      right_match.clear();
-      // ok done.
-    }
-
-    // each key is assigned to a controlling machine, who receives
-    // the partial list of keys every other machine owns.
-    template <typename Graph>
-    std::vector<std::vector<size_t> > 
-        get_procs_with_keys(const std::vector<size_t>& local_key_list, Graph& g) {
-      // this machine will get all keys from each processor where
-      // key = procid mod numprocs
-      std::vector<std::vector<size_t> > procs_with_keys(rmi.numprocs());
-      for (size_t i = 0; i < local_key_list.size(); ++i) {
-        if (g.l_vertex(i).owned() && local_key_list[i] != (size_t)(-1)) {
-          procid_t target_procid = local_key_list[i] % rmi.numprocs();
-          procs_with_keys[target_procid].push_back(local_key_list[i]);
+        for (; j < joining[p].size(); ++j) {
+          merged.push_back(joining[p][j].second);
         }
+        matched.swap(merged);
       }
-      rmi.all_to_all(procs_with_keys);
-      return procs_with_keys;
     }
 
     template <typename TargetGraph, typename SourceGraph, typename JoinOp>
@@ -478,20 +614,14 @@ class graph_vertex_join {
                         SourceGraph& source_graph,
                         JoinOp joinop) {
       // build up the exchange structure.
-      // move right vertex data to left
-      std::vector<
-          std::vector<
-              std::pair<size_t, typename SourceGraph::vertex_data_type> > > 
-            source_data(rmi.numprocs());
-
-      for (size_t i = 0; i < source.opposing_join_proc.size(); ++i) {
-        if (source_graph.l_vertex(i).owned()) {
-          procid_t target_proc = source.opposing_join_proc[i];
-          if (target_proc >= 0 && target_proc < rmi.numprocs()) {
-            source_data[target_proc].push_back(
-                std::make_pair(source.vtx_to_key[i],
-                               source_graph.l_vertex(i).data()));
-          }
+      // move right vertex data to left, in the agreed (key) order
+      std::vector<std::vector<typename SourceGraph::vertex_data_type> >
+          source_data(rmi.numprocs());
+      for (size_t p = 0; p < source.matched_by_proc.size(); ++p) {
+        const std::vector<lvid_type>& matched = source.matched_by_proc[p];
+        source_data[p].reserve(matched.size());
+        for (size_t i = 0; i < matched.size(); ++i) {
+          source_data[p].push_back(source_graph.l_vertex(matched[i]).data());
         }
       }
       // exchange
@@ -501,16 +631,13 @@ class graph_vertex_join {
 #pragma omp parallel for
 #endif
       for (size_t p = 0;p < source_data.size(); ++p) {
+        const std::vector<lvid_type>& matched = target.matched_by_proc[p];
+        ASSERT_EQ(source_data[p].size(), matched.size());
         for (size_t i = 0;i < source_data[p].size(); ++i) {
-          // find the target vertex with the matching key
-          hopscotch_map<size_t, vertex_id_type>::const_iterator iter = 
-              target.key_to_vtx.find(source_data[p][i].first);
-          ASSERT_TRUE(iter != target.key_to_vtx.end());
-          // found it!
           typename TargetGraph::local_vertex_type 
-              lvtx = target_graph.l_vertex(iter->second);
+              lvtx = target_graph.l_vertex(matched[i]);
           typename TargetGraph::vertex_type vtx(lvtx);
-          joinop(vtx, source_data[p][i].second);
+          joinop(vtx, source_data[p][i]);
         }
       }
       target_graph.synchronize();
@@ -29,6 +29,7 @@
 #include <graphlab/graph/ingress/distributed_ingress_base.hpp>
 #include <graphlab/graph/distributed_graph.hpp>
 #include <graphlab/rpc/buffered_exchange.hpp>
+#include <graphlab/util/concurrent_hopscotch_map.hpp>
 #include <graphlab/rpc/distributed_event_log.hpp>
 
 #include <graphlab/macros_def.hpp>
@@ -64,21 +65,20 @@ namespace graphlab {
 
 
     /** distributed hash table stored on local machine */ 
-    std::vector<std::vector<size_t> > dht_degree_table;
-    // must be called with a readlock acquired on dht_degree_table_lock
-    size_t vid_to_dht_entry_with_readlock(vertex_id_type vid) {
-      size_t idx = (vid - rpc.procid()) / rpc.numprocs();
-      if (dht_degree_table.size() <= idx) {
-        dht_degree_table_lock.unlock();
-        dht_degree_table_lock.writelock();
-        size_t newsize = std::max(dht_degree_table.size() * 2, idx + 1);
-        dht_degree_table.resize(newsize, std::vector<size_t>(rpc.numprocs(), 0));
-        dht_degree_table_lock.unlock();
-        dht_degree_table_lock.readlock();
+    concurrent_hopscotch_map<vertex_id_type, std::vector<size_t> > dht_degree_table;
+
+    /** Adds count to the degree of a vertex on one machine */
+    struct add_degree_functor {
+      procid_t pid;
+      size_t numprocs;
+      size_t count;
+      add_degree_functor(procid_t pid, size_t numprocs, size_t count) :
+          pid(pid), numprocs(numprocs), count(count) { }
+      void operator()(std::vector<size_t>& degrees) const {
+        if (degrees.empty()) degrees.resize(numprocs, 0);
+        degrees[pid] += count;
       }
-      return idx;
-    }
-    rwlock dht_degree_table_lock;
+    };
 
     /** Local minibatch buffer */
     size_t num_edges; // number of edges in the current buffer
@@ -224,30 +224,27 @@ namespace graphlab {
     void block_add_degree_counts (procid_t pid, vid2degree_type& degree) {
       BEGIN_TRACEPOINT(batch_ingress_update_degree_table);
       typedef typename vid2degree_type::value_type value_pair_type;
-      dht_degree_table_lock.readlock();
       foreach (value_pair_type& pair, degree) {
         add_degree_counts(pair.first, pid, pair.second);
       }
-      dht_degree_table_lock.unlock();
       END_TRACEPOINT(batch_ingress_update_degree_table);
     }
 
-    // Thread unsafe, used as a subroutine of block add degree counts.
     void add_degree_counts(const vertex_id_type& vid, procid_t pid, 
                            size_t count) {
-      size_t idx = vid_to_dht_entry_with_readlock(vid);
-      __sync_add_and_fetch(&(dht_degree_table[idx][pid]), count);
+      dht_degree_table.update_sync(vid,
+          add_degree_functor(pid, rpc.numprocs(), count));
     } // end of add degree counts
 
     dht_degree_table_type 
     block_get_degree_table(const boost::unordered_set<vertex_id_type>& vid_query) {
       BEGIN_TRACEPOINT(batch_ingress_get_degree_table);
       dht_degree_table_type answer;
-      dht_degree_table_lock.readlock();
       foreach (vertex_id_type qvid, vid_query) {
-        answer[qvid] = dht_degree_table[vid_to_dht_entry_with_readlock(qvid)]; 
+        std::vector<size_t>& degrees = answer[qvid];
+        degrees = dht_degree_table.get_sync(qvid).second;
+        if (degrees.empty()) degrees.resize(rpc.numprocs(), 0);
       }
-      dht_degree_table_lock.unlock();
       END_TRACEPOINT(batch_ingress_get_degree_table);
       return answer;
     }  // end of block get degree table
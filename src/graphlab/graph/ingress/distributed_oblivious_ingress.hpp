@@ -32,7 +32,7 @@
 #include <graphlab/rpc/buffered_exchange.hpp>
 #include <graphlab/rpc/distributed_event_log.hpp>
 #include <graphlab/util/dense_bitset.hpp>
-#include <graphlab/util/cuckoo_map_pow2.hpp>
+#include <graphlab/util/concurrent_hopscotch_map.hpp>
 #include <graphlab/macros_def.hpp>
 namespace graphlab {
   template<typename VertexData, typename EdgeData>
@@ -59,10 +59,23 @@ namespace graphlab {
     typedef fixed_dense_bitset<RPC_MAX_N_PROCS> bin_counts_type; 
 
     /** Type of the degree hash table: 
-     * a map from vertex id to a bitset of length num_procs. */
-    typedef cuckoo_map_pow2<vertex_id_type, bin_counts_type,3,uint32_t> degree_hash_table_type;
+     * a map from vertex id to a bitset of length num_procs. 
+     * Safe for parallel add_edge calls. */
+    typedef concurrent_hopscotch_map<vertex_id_type, bin_counts_type> degree_hash_table_type;
     degree_hash_table_type dht;
 
+    /** Records the machine an edge of a vertex was assigned to */
+    struct record_assignment {
+      procid_t proc;
+      bool userecent;
+      record_assignment(procid_t proc, bool userecent) : 
+          proc(proc), userecent(userecent) { }
+      void operator()(bin_counts_type& bins) const {
+        if (userecent) bins.clear();
+        bins.set_bit(proc);
+      }
+    };
+
     /** Array of number of edges on each proc. */
     std::vector<size_t> proc_num_edges;
 
@@ -73,7 +86,7 @@ namespace graphlab {
   public:
     distributed_oblivious_ingress(distributed_control& dc, graph_type& graph, bool usehash = false, bool userecent = false) :
       base_type(dc, graph),
-      dht(-1),proc_num_edges(dc.numprocs()), usehash(usehash), userecent(userecent) { 
+      proc_num_edges(dc.numprocs()), usehash(usehash), userecent(userecent) { 
 
       INITIALIZE_TRACER(ob_ingress_compute_assignments, "Time spent in compute assignment");
      }
@@ -83,9 +96,13 @@ namespace graphlab {
     /** Add an edge to the ingress object using oblivious greedy assignment. */
     void add_edge(vertex_id_type source, vertex_id_type target,
                   const EdgeData& edata) {
-      dht[source]; dht[target];
+      // decide on copies of the bins, then record the decision atomically
+      bin_counts_type src_bins = dht.get_sync(source).second;
+      bin_counts_type dst_bins = dht.get_sync(target).second;
       const procid_t owning_proc = 
-        base_type::edge_decision.edge_to_proc_greedy(source, target, dht[source], dht[target], proc_num_edges, usehash, userecent);
+        base_type::edge_decision.edge_to_proc_greedy(source, target, src_bins, dst_bins, proc_num_edges, usehash, userecent);
+      dht.update_sync(source, record_assignment(owning_proc, userecent));
+      dht.update_sync(target, record_assignment(owning_proc, userecent));
       typedef typename base_type::edge_buffer_record edge_buffer_record;
       edge_buffer_record record(source, target, edata);
       base_type::edge_exchange.send(owning_proc, record);
@@ -0,0 +1,195 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <rapidjson/reader.h>
+
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/logger.hpp>
+#include <graphlab/graph/json_sax_handler.hpp>
+
+namespace graphlab {
+
+  /**
+   * Turns the events of the rapidjson reader into calls of a
+   * json_sax_handler, keeping track of the nesting and member names.
+   */
+  class json_reader_events : public rapidjson::BaseReaderHandler<> {
+  public:
+    json_reader_events(json_sax_handler& handler,
+                       const rapidjson::InsituStringStream& stream) :
+      handler(handler), stream(stream) { }
+
+    void Null() { handler.null(); after_value(); }
+    void Bool(bool b) {
+      handler.string(b ? "true" : "false", b ? 4 : 5);
+      after_value();
+    }
+    void Int(int i) { Int64(i); }
+    void Uint(unsigned i) { Uint64(i); }
+    void Int64(int64_t i) {
+      char* end;
+      const char* text = number_head();
+      if (strtoll(text, &end, 10) != i || end != text_end) {
+        snprintf(printed, sizeof(printed), "%lld", (long long)i);
+        use_printed();
+      }
+      handler.integer(i);
+      after_value();
+    }
+    void Uint64(uint64_t i) {
+      char* end;
+      const char* text = number_head();
+      if (strtoull(text, &end, 10) != i || end != text_end) {
+        snprintf(printed, sizeof(printed), "%llu", (unsigned long long)i);
+        use_printed();
+      }
+      handler.integer(int64_t(i));
+      after_value();
+    }
+    void Double(double d) {
+      char* end;
+      const char* text = number_head();
+      if (strtod(text, &end) != d || end != text_end) {
+        snprintf(printed, sizeof(printed), "%.17g", d);
+        use_printed();
+      }
+      handler.real(d);
+      after_value();
+    }
+    void String(const char* str, rapidjson::SizeType length, bool copy) {
+      std::vector<json_sax_handler::level_type>& levels = handler.levels;
+      if (!levels.empty() && levels.back().expect_key) {
+        levels.back().key = str;
+        levels.back().key_length = length;
+        levels.back().expect_key = false;
+      } else {
+        handler.string(str, length);
+        after_value();
+      }
+    }
+    void StartObject() {
+      push(true);
+      handler.start_object();
+    }
+    void EndObject(rapidjson::SizeType) {
+      handler.end_object();
+      handler.levels.pop_back();
+      after_value();
+    }
+    void StartArray() {
+      push(false);
+      handler.start_array();
+    }
+    void EndArray(rapidjson::SizeType) {
+      handler.levels.pop_back();
+      after_value();
+    }
+
+  private:
+    json_sax_handler& handler;
+    const rapidjson::InsituStringStream& stream;
+    const char* text_end;
+    char printed[32];
+
+    /**
+     * Points the handler at the text of the number being reported,
+     * which this reader has not moved the stream past yet, and returns
+     * it. The callers check that the text reads back as the reported
+     * value, and print the value instead if it does not, so that a
+     * reader reporting numbers later cannot hand out the wrong text.
+     */
+    const char* number_head() {
+      const char* begin = stream.src_;
+      const char* e = begin;
+      while (*e != '\0' && *e != ',' && *e != ']' && *e != '}' &&
+             *e != ' ' && *e != '\t' && *e != '\r' && *e != '\n') {
+        ++e;
+      }
+      text_end = e;
+      handler.number = begin;
+      handler.number_length = e - begin;
+      return begin;
+    }
+
+    void use_printed() {
+      handler.number = printed;
+      handler.number_length = strlen(printed);
+    }
+
+    void push(bool is_object) {
+      json_sax_handler::level_type l;
+      l.is_object = is_object; l.expect_key = is_object;
+      l.key = NULL; l.key_length = 0;
+      handler.levels.push_back(l);
+    }
+
+    /// The next string of an object after a value is the next member name
+    void after_value() {
+      if (!handler.levels.empty() && handler.levels.back().is_object) {
+        handler.levels.back().expect_key = true;
+      }
+    }
+  }; // end of json_reader_events
+
+
+  bool json_sax_handler::parse_stream(std::istream& fin,
+                                      const std::string& filename) {
+    size_t linecount = 0;
+    timer ti; ti.start();
+    std::string line;
+    rapidjson::Reader reader;
+    while(fin.good() && !fin.eof()) {
+      std::getline(fin, line);
+      if(line.empty()) continue;
+      if(fin.fail()) break;
+      levels.clear();
+      rapidjson::InsituStringStream stream(&line[0]);
+      json_reader_events events(*this, stream);
+      reader.Parse<rapidjson::kParseInsituFlag>(stream, events);
+      if (reader.HasParseError() || !good) {
+        logstream(LOG_WARNING)
+          << "Error parsing line " << linecount << " in "
+          << filename << ": "
+          << (reader.HasParseError() ? reader.GetParseError() : "")
+          << std::endl;
+        return false;
+      }
+      ++linecount;
+      if (ti.current_time() > 5.0) {
+        logstream(LOG_INFO) << linecount << " Lines read" << std::endl;
+        ti.start();
+      }
+    }
+    return true;
+  } // end of parse_stream
+
+
+  void json_sax_handler::unknown_key(const char* what, size_t level) {
+    logstream(LOG_ERROR) << "Error parsing json into " << what
+                         << ". Unknown json node name:"
+                         << (key(level) == NULL ? "" : key(level)) << std::endl;
+  }
+
+} // namespace graphlab
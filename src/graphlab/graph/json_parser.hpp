@@ -22,28 +22,21 @@
 #ifndef GRAPHLAB_GRAPH_JSON_PARSER_HPP
 #define GRAPHLAB_GRAPH_JSON_PARSER_HPP
 
+#include <cstring>
 #include <string>
 #include <sstream>
 #include <iostream>
 #include <vector>
 
-#if defined(__clang) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 6)))
-#pragma GCC diagnostic push
-#endif
-
-#pragma GCC diagnostic ignored "-Wreorder"
-#include <libjson/libjson.h>
-
-#if defined(__clang) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 6)))
-#pragma GCC diagnostic pop
-#endif
-
 #include <boost/functional.hpp>
 #include <graphlab/util/stl_util.hpp>
 #include <graphlab/util/hdfs.hpp>
+#include <graphlab/util/timer.hpp>
 #include <graphlab/logger/logger.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/serialization/serialization_includes.hpp>
 #include <graphlab/graph/distributed_graph.hpp>
+#include <graphlab/graph/json_sax_handler.hpp>
 #include <graphlab/graph/ingress/distributed_identity_ingress.hpp>
 
 namespace graphlab {
@@ -67,6 +60,18 @@ template<typename VertexData, typename EdgeData>
 class distributed_graph;
 
 
+/**
+ * \brief Loads a graph from the JSON dump of its local graphs.
+ *
+ * Each machine reads four files: the graph structure (the CSR and CSC
+ * arrays of its local graph), its vid2lvid map, its edge data list and
+ * its vertex records, one record per line. The files are read by a
+ * thread each, and parsed with the rapidjson SAX reader straight into
+ * the arrays of the local graph, without building a document tree.
+ * The vertex records need the vid2lvid map and the number of
+ * vertices, so they are parsed into a list and added to the graph once
+ * all the files are read.
+ */
 template <typename VertexData, typename EdgeData>
 class json_parser {
 
@@ -80,7 +85,9 @@ class json_parser {
 
     typedef boost::function<bool(edge_data_type&, const std::string&)> edge_parser_type;
     typedef boost::function<bool(vertex_data_type&, const std::string&)> vertex_parser_type;
-    typedef boost::function<bool(graph_type&, const std::string&)> line_parser_type;
+
+    typedef typename graph_type::local_graph_type local_graph_type;
+    typedef typename local_graph_type::gstore_type gstore_type;
 
 
   public:
@@ -92,21 +99,51 @@ class json_parser {
 
 
   bool load() {
-    line_parser_type graph_structure_parser = parse_graph_structure_from_json;
-    line_parser_type vid2lvid_parser = parse_vid2lvid_from_json;
-    line_parser_type edata_parser = boost::bind(parse_edatalist_from_json, _1, _2, edge_parser);
-    line_parser_type vrecord_parser = boost::bind(parse_vrecord_from_json, _1, _2, vertex_parser);
-
-    bool success = parse_by_line(graphfilename(), graph_structure_parser);
-    success = success & parse_by_line(vid2lvidfilename(), vid2lvid_parser); 
-    success = success & parse_by_line(edatafilename(), edata_parser); 
-    success = success & parse_by_line(vrecordfilename(), vrecord_parser);
-
-    if (!success) {
+    local_graph_type& local_graph = graph.get_local_graph();
+    structure_handler structure(local_graph.gstore);
+    vid2lvid_handler vid2lvid(graph);
+    edata_handler edata(local_graph.gstore.edge_data_list, edge_parser);
+    vrecord_handler vrecords(vertex_parser);
+
+    // the four files are independent until the vertex records are added
+    bool success[4] = {false, false, false, false};
+    thread_group threads;
+    threads.launch(boost::bind(&json_parser::parse_file<structure_handler>,
+                               this, graphfilename(), &structure, &success[0]));
+    threads.launch(boost::bind(&json_parser::parse_file<vid2lvid_handler>,
+                               this, vid2lvidfilename(), &vid2lvid, &success[1]));
+    threads.launch(boost::bind(&json_parser::parse_file<edata_handler>,
+                               this, edatafilename(), &edata, &success[2]));
+    threads.launch(boost::bind(&json_parser::parse_file<vrecord_handler>,
+                               this, vrecordfilename(), &vrecords, &success[3]));
+    threads.join();
+
+    if (!(success[0] && success[1] && success[2] && success[3])) {
       logstream(LOG_FATAL) << "Fail parsing graph json" << std::endl;
       return false;
     }
 
+    ASSERT_EQ(local_graph.gstore.num_edges, local_graph.gstore.c2r_map.size());
+    ASSERT_EQ(local_graph.gstore.num_edges, local_graph.gstore.CSR_dst.size());
+    ASSERT_EQ(local_graph.gstore.num_edges, local_graph.gstore.CSC_src.size());
+
+    graph.lvid2record.resize(local_graph.gstore.num_vertices);
+    local_graph.reserve(local_graph.gstore.num_vertices);
+    for (size_t i = 0; i < vrecords.records.size(); ++i) {
+      const typename graph_type::vertex_record& vrecord =
+        vrecords.records[i].first;
+      if (graph.vid2lvid.find(vrecord.gvid) == graph.vid2lvid.end()) {
+        // Check if this a singlton node
+        // ignore for now
+        logstream(LOG_WARNING) << "Singleton node detected: gvid = " << vrecord.gvid << ". Ignored" << std::endl;
+      } else {
+        lvid_type lvid = graph.vid2lvid[vrecord.gvid];
+        graph.lvid2record[lvid] = vrecord;
+        local_graph.add_vertex(lvid, vrecords.records[i].second);
+        if (vrecord.owner == graph.procid()) ++graph.local_own_nverts;
+      }
+    }
+
     graph.local_graph.finalized = true;
 
     
@@ -132,10 +169,18 @@ class json_parser {
 
 
     graph.finalized = true;
-    return success;
+    return true;
   }
 
-  bool parse_by_line (const std::string& srcfilename, line_parser_type line_parser) {
+  /// Parses the file srcfilename of the prefix with the handler
+  template <typename Handler>
+  void parse_file(const std::string& srcfilename, Handler* handler,
+                  bool* success) {
+    *success = parse_by_line(srcfilename, *handler);
+  }
+
+  template <typename Handler>
+  bool parse_by_line (const std::string& srcfilename, Handler& handler) {
     std::string fname;
     //check for "/" ending in directory"
     if(!boost::ends_with(prefix,"/"))
@@ -145,6 +190,7 @@ class json_parser {
 
     logstream(LOG_INFO) << "Load graph json from " << fname << std::endl;
 
+    bool success = false;
     boost::iostreams::filtering_stream<boost::iostreams::input> fin;
     // loading from hdfs
     if (boost::starts_with(prefix, "hdfs://")) {
@@ -163,7 +209,7 @@ class json_parser {
         return false;
       }
 
-      load_from_stream(fname, fin, line_parser);
+      success = handler.parse_stream(fin, fname);
 
       if (gzip) fin.pop();
       fin.pop();
@@ -184,237 +230,192 @@ class json_parser {
         return false;
       }
 
-      load_from_stream(fname, fin, line_parser);
+      success = handler.parse_stream(fin, fname);
 
       if (gzip) fin.pop();
       fin.pop();
     }
 
 
-    return true;
+    return success;
   }
-    /**
-       \internal
-       This internal function is used to load a single line from an input stream
-     */
-    template<typename Fstream>
-    bool load_from_stream(std::string filename, Fstream& fin,
-                          line_parser_type& line_parser) {
-      size_t linecount = 0;
-      timer ti; ti.start();
-      while(fin.good() && !fin.eof()) {
-        std::string line;
-        std::getline(fin, line);
-        if(line.empty()) continue;
-        if(fin.fail()) break;
-        const bool success = line_parser(graph, line);
-        if (!success) {
-          logstream(LOG_WARNING)
-            << "Error parsing line " << linecount << " in "
-            << filename << ": " << std::endl
-            << "\t\"" << line << "\"" << std::endl;
-          return false;
-        }
-        ++linecount;
-        if (ti.current_time() > 5.0) {
-          logstream(LOG_INFO) << linecount << " Lines read" << std::endl;
-          ti.start();
-        }
-      }
-      return true;
-    } // end of load from stream
 
 
 
-  /* Parse the graph structure from json */
-  static bool parse_graph_structure_from_json (graph_type& graph, const std::string& str) {
-    JSONNode n = libjson::parse(str);
-    JSONNode::const_iterator i = n.begin();
-    typedef typename graph_type::local_graph_type local_graph_type;
-    local_graph_type& local_graph = graph.get_local_graph();
-    while(i != n.end()) {
-      if (i->name() == "numEdges") {
-        local_graph.gstore.num_edges = i->as_int();
-      } else if (i->name() == "numVertices") {
-        local_graph.gstore.num_vertices= i->as_int();
-      } else if (i->name() == "csr") {
-        // parse rowIndex -> graph.local_graph.gstore.csr_source
-        // parse colIndex -> graph.local_graph.gstore.csr_target
-        JSONNode csr = *i;
-        JSONNode::const_iterator j = csr.begin();
-        while (j != csr.end()) {
-          if (j->name() == "rowIndex") {
-              parse_vid_array (local_graph.gstore.CSR_src, *j);
-          } else if (j->name() == "colIndex") {
-              parse_vid_array (local_graph.gstore.CSR_dst, *j);
-          } else {
-              logstream(LOG_ERROR) << "Error parsing json into graph. Unknown json node name:"
-                << "CSR:" << j->name() << std::endl;
-          }
-          ++j;
-        }
-      } else if (i->name() == "csc") {
-        // parse rowIndex -> graph.local_graph.gstore.csc_target
-        // parse colIndex -> graph.local_graph.gstore.csc_source
-        JSONNode csc = *i;
-        JSONNode::const_iterator j = csc.begin();
-
-        while (j != csc.end()) {
-          if (j->name() == "rowIndex") {
-              parse_vid_array (local_graph.gstore.CSC_dst, *j);
-          } else if (j->name() == "colIndex") {
-              parse_vid_array (local_graph.gstore.CSC_src, *j);
-          } else {
-              logstream(LOG_ERROR) << "Error parsing json into graph. Unknown json node name:"
-                << "CSC:"<<j->name() << std::endl;
-          }
-          ++j;
-        }
-      } else if (i->name() == "c2rMap") {
-        parse_vid_array (local_graph.gstore.c2r_map, *i);
+  /**
+   * Parses the graph structure:
+   * {"numEdges": E, "numVertices": V,
+   *  "csr": {"rowIndex": [...], "colIndex": [...]},
+   *  "csc": {"rowIndex": [...], "colIndex": [...]},
+   *  "c2rMap": [...]}
+   * appending the arrays straight to the graph storage.
+   */
+  struct structure_handler : public json_sax_handler {
+    gstore_type& gstore;
+    typename gstore_type::edge_id_array_type* eid_target;
+    typename gstore_type::lvid_array_type* lvid_target;
+    structure_handler(gstore_type& gstore) :
+      gstore(gstore), eid_target(NULL), lvid_target(NULL) { }
+
+    void start_array() {
+      eid_target = NULL; lvid_target = NULL;
+      if (this->depth() == 2 && this->key_is(1, "c2rMap")) {
+        eid_target = &gstore.c2r_map;
+      } else if (this->depth() == 3 && this->key_is(1, "csr")) {
+        if (this->key_is(2, "rowIndex")) eid_target = &gstore.CSR_src;
+        else if (this->key_is(2, "colIndex")) lvid_target = &gstore.CSR_dst;
+        else this->unknown_key("CSR", 2);
+      } else if (this->depth() == 3 && this->key_is(1, "csc")) {
+        if (this->key_is(2, "rowIndex")) eid_target = &gstore.CSC_dst;
+        else if (this->key_is(2, "colIndex")) lvid_target = &gstore.CSC_src;
+        else this->unknown_key("CSC", 2);
       } else {
-        logstream(LOG_ERROR) << "Error parsing json into graph. Unknown json node name:" <<
-          i->name() << std::endl;
+        this->unknown_key("graph", 1);
       }
-      ++i;
-    } // end while
-
-
-    ASSERT_EQ(local_graph.gstore.num_edges, local_graph.gstore.c2r_map.size());
-    ASSERT_EQ(local_graph.gstore.num_edges, local_graph.gstore.CSR_dst.size());
-    ASSERT_EQ(local_graph.gstore.num_edges, local_graph.gstore.CSC_src.size());
-
-    graph.lvid2record.reserve(local_graph.gstore.num_vertices);
-    graph.lvid2record.resize(local_graph.gstore.num_vertices);
-    local_graph.reserve(local_graph.gstore.num_vertices);
-    // local_graph.finalized = true;
-    return true;
-  }
-
-  /* Parse the vid2lvid map from json */
-  static bool parse_vid2lvid_from_json (graph_type& graph, const std::string& str) {
-    JSONNode n = libjson::parse(str);
-    JSONNode::const_iterator i = n.begin();
-    typedef typename graph_type::local_graph_type local_graph_type;
-    while(i != n.end()) {
-      if (i->name() == "vid2lvid") {
-        JSONNode::const_iterator j = i->begin();
-        typename graph_type::vid2lvid_map_type & map = graph.vid2lvid;
-        map.clear();
-        while(j != i->end()) {
-          graph.vid2lvid[boost::lexical_cast<vertex_id_type>(j->name())] = (boost::lexical_cast<lvid_type>)(j->as_int());
-          ++j;
-        }
-      } else {
-        // report error
-        return false;
+      // the counts come first in the dump: reserve the arrays
+      if (eid_target != NULL) {
+        eid_target->clear();
+        eid_target->reserve(eid_target == &gstore.c2r_map ?
+                            gstore.num_edges : gstore.num_vertices);
+      }
+      if (lvid_target != NULL) {
+        lvid_target->clear();
+        lvid_target->reserve(gstore.num_edges);
       }
-      ++i;
     }
-    return true;
-  }
-
-  /* Parse the edata list from json */
-  static bool parse_edatalist_from_json (graph_type& graph, const std::string& str,
-      edge_parser_type edge_parser) {
-    JSONNode n = libjson::parse(str);
-    JSONNode::const_iterator i = n.begin();
-    typedef typename graph_type::local_graph_type local_graph_type;
-    local_graph_type& local_graph = graph.get_local_graph();
-    while(i != n.end()) {
-       if (i->name() == "edataList") {
-        // parse  edatalist -> graph.local_graph.gstore.edata
-        JSONNode edatanode= *i;
-        JSONNode::const_iterator j = edatanode.begin();
-        std::vector<edge_data_type>& edatalist = local_graph.gstore.edge_data_list;
-        edatalist.clear();
-        edatalist.reserve(local_graph.gstore.num_edges);
-        edge_data_type e;
-        while (j != edatanode.end()) {
-          edge_parser(e, j->as_string());
-          edatalist.push_back(e);
-          ++j;
-        }
-       } else {
-         return false;
-         // report error
-       }
-      ++i;
+    void integer(int64_t value) {
+      if (eid_target != NULL) {
+        eid_target->push_back(value);
+      } else if (lvid_target != NULL) {
+        lvid_target->push_back(value);
+      } else if (this->depth() == 1 && this->key_is(1, "numEdges")) {
+        gstore.num_edges = value;
+      } else if (this->depth() == 1 && this->key_is(1, "numVertices")) {
+        gstore.num_vertices = value;
+      } else {
+        this->unknown_key("graph", this->depth());
+      }
     }
-    return true;
-  }
+  }; // end of structure_handler
 
 
-  /* Parse the vertex record list from json */
-  static bool parse_vrecord_from_json (graph_type& graph, const std::string& str,
-      vertex_parser_type vertex_parser) {
-
-    typedef typename graph_type::local_graph_type local_graph_type;
-    local_graph_type& local_graph = graph.get_local_graph();
-
-    JSONNode n = libjson::parse(str);
-    JSONNode::const_iterator i = n.begin();
+  /// Parses {"vid2lvid": {"<vid>": lvid, ...}} into the vid2lvid map
+  struct vid2lvid_handler : public json_sax_handler {
+    graph_type& graph;
+    vid2lvid_handler(graph_type& graph) : graph(graph) { }
 
+    void start_object() {
+      if (this->depth() == 2) {
+        if (this->key_is(1, "vid2lvid")) graph.vid2lvid.clear();
+        else this->good = false;
+      }
+    }
+    void integer(int64_t value) {
+      if (this->depth() == 2) {
+        const vertex_id_type vid = strtoul(this->key(2), NULL, 10);
+        graph.vid2lvid[vid] = lvid_type(value);
+      }
+    }
+  }; // end of vid2lvid_handler
+
+
+  /// Parses {"edataList": [...]} into the edge data of the graph storage
+  struct edata_handler : public json_sax_handler {
+    typename gstore_type::edge_data_array_type& edatalist;
+    edge_parser_type& edge_parser;
+    edge_data_type e;
+    std::string value;
+    edata_handler(typename gstore_type::edge_data_array_type& edatalist,
+                  edge_parser_type& edge_parser) :
+      edatalist(edatalist), edge_parser(edge_parser) { }
+
+    void start_array() {
+      if (this->depth() == 2 && this->key_is(1, "edataList")) edatalist.clear();
+      else this->good = false;
+    }
+    void add(const char* str, size_t length) {
+      if (this->depth() != 2) return;
+      value.assign(str, length);
+      edge_parser(e, value);
+      edatalist.push_back(e);
+    }
+    void string(const char* str, size_t length) { add(str, length); }
+    void number() {
+      size_t length;
+      const char* str = this->number_text(length);
+      add(str, length);
+    }
+    void integer(int64_t) { number(); }
+    void real(double) { number(); }
+    void null() { add("", 0); }
+  }; // end of edata_handler
+
+
+  /**
+   * Parses the vertex records, one object per line:
+   * {"gvid": vid, "owner": proc, "inEdges": n, "outEdges": n,
+   *  "mirrors": [...], "VertexData": ...}
+   */
+  struct vrecord_handler : public json_sax_handler {
+    typedef typename graph_type::vertex_record vertex_record_type;
+    vertex_parser_type& vertex_parser;
+    std::vector<std::pair<vertex_record_type, vertex_data_type> > records;
+    vertex_record_type vrecord;
     vertex_data_type vdata;
-    typename graph_type::vertex_record vrecord;
-
-    while (i != n.end()) {
-      if (i->name() == "mirrors") {
-        JSONNode::const_iterator j = (*i).begin();
-        while (j != (*i).end()) {
-          int mirror = j->as_int();
-          vrecord._mirrors.set_bit((procid_t)mirror);
-          ++j;
-        }
-      } else if (i->name() == "inEdges") {
-        vrecord.num_in_edges = i->as_int();
-      } else if (i->name() == "outEdges") {
-        vrecord.num_out_edges = i->as_int();
-      } else if (i->name() == "gvid") {
-        // Check unsafe
-        vrecord.gvid = boost::lexical_cast<vertex_id_type>(i->as_int());
-      } else if (i->name() == "owner") {
-        vrecord.owner = (procid_t)i->as_int();
-      } else if (i->name() == "VertexData") {
-        if (!(i->type() == JSON_NULL))
-          vertex_parser(vdata, i->as_string());
-      } else {
-        logstream(LOG_ERROR) << "Error parsing json into vrecord. Unknown json node name:" <<
-          i->name() << std::endl;
+    std::string value;
+    vrecord_handler(vertex_parser_type& vertex_parser) :
+      vertex_parser(vertex_parser) { }
+
+    void start_object() {
+      if (this->depth() == 1) {
+        vrecord = vertex_record_type();
+        vdata = vertex_data_type();
       }
-      ++i;
     }
-
-      if (graph.vid2lvid.find(vrecord.gvid) == graph.vid2lvid.end()) {
-        // Check if this a singlton node
-        // ignore for now
-        logstream(LOG_WARNING) << "Singleton node detected: gvid = " << vrecord.gvid << ". Ignored" << std::endl;
+    void end_object() {
+      if (this->depth() == 1) records.push_back(std::make_pair(vrecord, vdata));
+    }
+    void start_array() {
+      if (!this->key_is(1, "mirrors") && !this->key_is(1, "VertexData")) {
+        this->unknown_key("vrecord", 1);
+      }
+    }
+    void integer(int64_t v) {
+      if (this->depth() == 2) {
+        if (this->key_is(1, "mirrors")) vrecord._mirrors.set_bit((procid_t)v);
+      } else if (this->key_is(1, "inEdges")) {
+        vrecord.num_in_edges = v;
+      } else if (this->key_is(1, "outEdges")) {
+        vrecord.num_out_edges = v;
+      } else if (this->key_is(1, "gvid")) {
+        vrecord.gvid = vertex_id_type(v);
+      } else if (this->key_is(1, "owner")) {
+        vrecord.owner = (procid_t)v;
+      } else if (this->key_is(1, "VertexData")) {
+        number();
       } else {
-        lvid_type lvid = graph.vid2lvid[vrecord.gvid];
-        graph.lvid2record[lvid] = vrecord;
-        local_graph.add_vertex(lvid, vdata);
-        if (vrecord.owner == graph.procid()) ++graph.local_own_nverts;
+        this->unknown_key("vrecord", 1);
       }
-
-    return true;
-  }
+    }
+    void real(double v) {
+      if (this->key_is(1, "VertexData")) number();
+      else this->unknown_key("vrecord", 1);
+    }
+    void string(const char* str, size_t length) {
+      if (this->key_is(1, "VertexData")) data(value.assign(str, length));
+      else this->unknown_key("vrecord", 1);
+    }
+    void number() {
+      size_t length;
+      const char* str = this->number_text(length);
+      data(value.assign(str, length));
+    }
+    void data(const std::string& str) { vertex_parser(vdata, str); }
+  }; // end of vrecord_handler
 
 
   /*  Helper function starts here  */
   private:
-  /* Parse an json integer array and copy to a int vector */
-  static bool parse_vid_array (std::vector<vertex_id_type>& to, const JSONNode& n) {
-    if (n.type() != JSON_ARRAY) return false;
-    to.clear();
-    JSONNode::const_iterator i = n.begin();
-    while (i != n.end()) {
-      to.push_back(i->as_int());
-      ++i;
-    }
-    return true;
-  }
-
-
   std::string zeropadding(const std::string& s, int width) {
       ASSERT_LE(s.length(), width);
       std::ostringstream ss;
@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+#ifndef GRAPHLAB_GRAPH_JSON_SAX_HANDLER_HPP
+#define GRAPHLAB_GRAPH_JSON_SAX_HANDLER_HPP
+
+#include <cstring>
+#include <string>
+#include <iostream>
+#include <vector>
+#include <stdint.h>
+
+namespace graphlab {
+
+/**
+ * \internal
+ * \brief Base of the SAX handlers of the json_parser.
+ *
+ * parse_stream() parses each line of a stream in place with the
+ * rapidjson SAX reader, which only json_parser.cpp includes. It tracks
+ * the nesting of the objects and arrays, and the member name of the
+ * value at each level, and turns the reader events into calls of:
+ * \li start_object() and start_array() when a container is opened, with
+ *     its member name already on the stack,
+ * \li end_object() when an object is closed,
+ * \li integer(), real(), string() and null() for the scalar values.
+ * Strings are not copied: they point into the line being parsed and
+ * are null terminated.
+ */
+class json_sax_handler {
+public:
+  json_sax_handler() : good(true), number(NULL), number_length(0) { }
+  virtual ~json_sax_handler() { }
+
+  /**
+   * Parses each line of fin as a JSON document. Returns false at the
+   * first line which is not valid JSON or which the handler does not
+   * understand.
+   */
+  bool parse_stream(std::istream& fin, const std::string& filename);
+
+  /// False once the handler met something it does not understand
+  bool good;
+
+  // Default actions, which ignore the value
+  virtual void start_object() { }
+  virtual void end_object() { }
+  virtual void start_array() { }
+  virtual void integer(int64_t) { }
+  virtual void real(double) { }
+  virtual void string(const char*, size_t) { }
+  virtual void null() { }
+
+protected:
+  /// The number of open objects and arrays
+  size_t depth() const { return levels.size(); }
+
+  /**
+   * Returns true if the member name of the value at level is name.
+   * Level 1 is the outermost object; the value being reported is at
+   * level depth().
+   */
+  bool key_is(size_t level, const char* name) const {
+    const level_type& l = levels[level - 1];
+    return l.key != NULL && l.key_length == strlen(name) &&
+           memcmp(l.key, name, l.key_length) == 0;
+  }
+  const char* key(size_t level) const { return levels[level - 1].key; }
+
+  /**
+   * Returns the text of the number being reported, for the string
+   * parsers. It is the text of the line when the reader gives it back,
+   * and the number printed otherwise.
+   */
+  const char* number_text(size_t& length) const {
+    length = number_length;
+    return number;
+  }
+
+  /// Reports a member name the handler does not know
+  void unknown_key(const char* what, size_t level);
+
+private:
+  friend class json_reader_events;
+
+  struct level_type {
+    bool is_object;
+    bool expect_key;
+    const char* key;
+    size_t key_length;
+  };
+  std::vector<level_type> levels;
+  const char* number;
+  size_t number_length;
+}; // end of json_sax_handler
+
+} // namespace graphlab
+#endif
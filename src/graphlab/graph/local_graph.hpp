@@ -53,6 +53,7 @@
 
 #include <graphlab/util/random.hpp>
 #include <graphlab/graph/graph_storage.hpp>
+#include <graphlab/util/huge_page_allocator.hpp>
 #include <graphlab/macros_def.hpp>
 
 
@@ -70,6 +71,12 @@ namespace graphlab {
     /** \internal
      * \brief The type of the graph structure storage of the local_graph. */
     typedef graph_storage<VertexData, EdgeData> gstore_type;
+
+    /** \internal
+     * \brief The vertex data array, placed like the arrays of the
+     * graph storage. */
+    typedef std::vector<VertexData, huge_page_allocator<VertexData> >
+        vertex_data_array_type;
   public:
     
     /** The type of the vertex data stored in the local_graph. */
@@ -225,7 +232,7 @@ namespace graphlab {
     void clear_reserve() {
       clear();
       edges_tmp.clear();
-      std::vector<VertexData>().swap(vertices);
+      vertex_data_array_type().swap(vertices);
       gstore.clear_reserve();
     }
     
@@ -560,21 +567,24 @@ namespace graphlab {
      * \brief Returns the column index of CSR stored in the 
      * internal local_graph storage.
      */
-    const std::vector<lvid_type>& get_out_index_storage() const {
+    const typename gstore_type::edge_id_array_type&
+    get_out_index_storage() const {
       return gstore.get_csr_src();
     }
     /** \internal
      * \brief Returns the row index of CSC stored in the 
      * internal local_graph storage.
      */
-    const std::vector<lvid_type>& get_in_index_storage() const {
+    const typename gstore_type::edge_id_array_type&
+    get_in_index_storage() const {
       return gstore.get_csc_dst(); 
     }
     /** \internal
      * \brief Returns the row pointer of CSR stored in the 
      * internal local_graph storage.
      */
-    const std::vector<lvid_type>& get_out_edge_storage() const {
+    const typename gstore_type::lvid_array_type&
+    get_out_edge_storage() const {
       return gstore.get_csr_dst();
     }
 
@@ -582,17 +592,29 @@ namespace graphlab {
      * \brief Returns the column pointer of CSC stored in the 
      * internal local_graph storage.
      */
-    const std::vector<lvid_type>& get_in_edge_storage() const {
+    const typename gstore_type::lvid_array_type&
+    get_in_edge_storage() const {
       return gstore.get_csc_src();
     }
     /** \internal
      * \brief Returns the reference of edge data list stored in the
      * internal local_graph storage.
      */
-    const std::vector<EdgeData> & get_edge_data_storage() const {
+    const typename gstore_type::edge_data_array_type&
+    get_edge_data_storage() const {
       return gstore.get_edge_data();
     }
 
+    /** \internal
+     * \brief Reads ahead the file backed edge data of the active
+     * vertices of the block of 64 vertices starting at begin. See
+     * graph_storage::prefetch_edge_data.
+     */
+    void prefetch_edge_data(lvid_type begin, size_t in_active,
+                            size_t out_active) const {
+      gstore.prefetch_edge_data(begin, in_active, out_active);
+    }
+
     /** \internal
      * \brief For debug purpose, returns the largest vertex id in the edges_tmp
      */ 
@@ -615,7 +637,7 @@ namespace graphlab {
  
     // PRIVATE DATA MEMBERS ===================================================>    
     /** The vertex data is simply a vector of vertex data */
-    std::vector<VertexData> vertices;
+    vertex_data_array_type vertices;
 
     /** Stores the edge data and edge relationships. */
     gstore_type gstore;
@@ -0,0 +1,376 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_STREAMING_GRAPH_HPP
+#define GRAPHLAB_STREAMING_GRAPH_HPP
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <boost/static_assert.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/type_traits/is_same.hpp>
+
+#include <graphlab/graph/graph_basic_types.hpp>
+#include <graphlab/serialization/is_pod.hpp>
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/util/empty.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+#include <graphlab/macros_def.hpp>
+namespace graphlab {
+
+  /**
+   * \ingroup group_graph
+   *
+   * \brief A graph which keeps the vertex data in memory and the edges
+   * in files on local disk, for graphs whose edges do not fit in
+   * memory.
+   *
+   * The vertices are divided into streaming partitions of
+   * vertices_per_partition consecutive ids, and each edge is appended
+   * to the file of the partition of its source. The edges are never
+   * held in memory as a whole: the streaming_engine reads each
+   * partition file sequentially in every iteration, in blocks of a
+   * few megabytes. Only the vertex data, the vertex degrees, and the
+   * per vertex state of the engine occupy memory.
+   *
+   * The graph lives on a single machine. The edge data must be a POD
+   * type so that the edges are fixed size records which can be
+   * modified in place on disk.
+   *
+   * \code
+   * typedef graphlab::streaming_graph<float, graphlab::empty> graph_type;
+   * graph_type graph(dc, "/scratch/mygraph");
+   * graph.add_edge(0, 1);
+   * graph.add_edge(1, 2);
+   * graph.finalize();
+   * \endcode
+   *
+   * The partition files are created with the given path prefix,
+   * or in the temporary directory if it is empty, and are removed when
+   * the graph is destroyed.
+   *
+   * \tparam VertexData Type of data stored on vertices.
+   * \tparam EdgeData Type of data stored on edges. Must be POD.
+   */
+  template<typename VertexData, typename EdgeData>
+  class streaming_graph {
+  public:
+    /// The type of the vertex data stored in the graph
+    typedef VertexData vertex_data_type;
+
+    /// The type of the edge data stored in the graph
+    typedef EdgeData edge_data_type;
+
+    typedef graphlab::vertex_id_type vertex_id_type;
+    typedef graphlab::lvid_type lvid_type;
+
+    BOOST_STATIC_ASSERT(gl_is_pod<edge_data_type>::value);
+
+    /// The layout of an edge in the partition files
+    struct edge_record {
+      vertex_id_type source;
+      vertex_id_type target;
+      edge_data_type data;
+    };
+
+    /**
+     * \brief A reference to a vertex of the graph, with the interface
+     * of distributed_graph::vertex_type used by vertex programs.
+     */
+    struct vertex_type {
+      streaming_graph& graph_ref;
+      vertex_id_type vid;
+
+      vertex_type(streaming_graph& graph_ref, vertex_id_type vid) :
+        graph_ref(graph_ref), vid(vid) { }
+
+      bool operator==(vertex_type& v) const { return vid == v.vid; }
+
+      /// \brief Returns a constant reference to the data on the vertex
+      const vertex_data_type& data() const { return graph_ref.vertices[vid]; }
+
+      /// \brief Returns a mutable reference to the data on the vertex
+      vertex_data_type& data() { return graph_ref.vertices[vid]; }
+
+      /// \brief Returns the number of in edges of the vertex
+      size_t num_in_edges() const { return graph_ref.in_degree[vid]; }
+
+      /// \brief Returns the number of out edges of the vertex
+      size_t num_out_edges() const { return graph_ref.out_degree[vid]; }
+
+      /// \brief Returns the vertex ID of the vertex
+      vertex_id_type id() const { return vid; }
+
+      /// \brief Returns the local ID of the vertex, which is its ID
+      lvid_type local_id() const { return vid; }
+    };
+
+    /**
+     * \brief A reference to an edge while it is streamed, with the
+     * interface of distributed_graph::edge_type used by vertex
+     * programs. It is only valid while its block is in memory.
+     */
+    struct edge_type {
+      streaming_graph& graph_ref;
+      edge_record& record;
+
+      edge_type(streaming_graph& graph_ref, edge_record& record) :
+        graph_ref(graph_ref), record(record) { }
+
+      /// \brief Returns the source vertex of the edge
+      vertex_type source() const { return vertex_type(graph_ref, record.source); }
+
+      /// \brief Returns the target vertex of the edge
+      vertex_type target() const { return vertex_type(graph_ref, record.target); }
+
+      /// \brief Returns a constant reference to the data on the edge
+      const edge_data_type& data() const { return record.data; }
+
+      /// \brief Returns a mutable reference to the data on the edge
+      edge_data_type& data() { return record.data; }
+    };
+
+    /**
+     * \brief Creates an empty graph whose partition files are named
+     * with the path prefix, or placed in the temporary directory if
+     * it is empty.
+     *
+     * \param vertices_per_partition The number of consecutive vertex
+     * ids in each streaming partition.
+     */
+    streaming_graph(distributed_control& dc,
+                    const std::string& path_prefix = "",
+                    size_t vertices_per_partition = 1 << 22) :
+      dc_ref(dc), path_prefix(path_prefix),
+      vertices_per_partition(vertices_per_partition), nedges(0),
+      buffer_records(1 << 16) {
+      ASSERT_GT(vertices_per_partition, 0);
+      if (this->path_prefix.empty()) {
+        this->path_prefix = (boost::filesystem::temp_directory_path() /
+            boost::filesystem::unique_path("graphlab_stream_%%%%%%%%")).string();
+      }
+    }
+
+    ~streaming_graph() {
+      for (size_t i = 0; i < partitions.size(); ++i) {
+        std::remove(partition_file(i).c_str());
+      }
+    }
+
+    /// \brief Returns the number of vertices in the graph
+    size_t num_vertices() const { return vertices.size(); }
+
+    /// \brief Returns the number of edges in the graph
+    size_t num_edges() const { return nedges; }
+
+    /// \brief Returns the number of streaming partitions
+    size_t num_partitions() const { return partitions.size(); }
+
+    /// \brief Returns the streaming partition holding the vertex
+    size_t partition_of(vertex_id_type vid) const {
+      return vid / vertices_per_partition;
+    }
+
+    /// \brief Returns the number of edges stored in the partition
+    size_t num_partition_edges(size_t partition) const {
+      return partitions[partition].nedges;
+    }
+
+    /// \brief Returns the name of the file of the partition
+    std::string partition_file(size_t partition) const {
+      std::stringstream strm;
+      strm << path_prefix << ".part" << partition;
+      return strm.str();
+    }
+
+    size_t procid() const { return dc_ref.procid(); }
+    size_t numprocs() const { return dc_ref.numprocs(); }
+    distributed_control& dc() { return dc_ref; }
+
+    /// \brief Returns a reference to the vertex
+    vertex_type vertex(vertex_id_type vid) {
+      ASSERT_LT(vid, vertices.size());
+      return vertex_type(*this, vid);
+    }
+
+    /**
+     * \brief Sets the data of a vertex, creating all the vertices up to
+     * it if they do not exist.
+     */
+    void add_vertex(vertex_id_type vid,
+                    const vertex_data_type& vdata = vertex_data_type()) {
+      resize(vid + 1);
+      vertices[vid] = vdata;
+    }
+
+    /**
+     * \brief Appends an edge, creating its vertices if they do not
+     * exist. The edges are buffered in memory and written to the
+     * partition files in large blocks.
+     */
+    void add_edge(vertex_id_type source, vertex_id_type target,
+                  const edge_data_type& edata = edge_data_type()) {
+      resize(std::max(source, target) + 1);
+      ++out_degree[source];
+      ++in_degree[target];
+      ++nedges;
+      partition_type& partition = partitions[partition_of(source)];
+      edge_record record;
+      record.source = source;
+      record.target = target;
+      record.data = edata;
+      partition.buffer.push_back(record);
+      ++partition.nedges;
+      if (partition.buffer.size() >= buffer_records) {
+        flush_partition(partition_of(source));
+      }
+    }
+
+    /// \brief Writes all the buffered edges to the partition files
+    void finalize() {
+      for (size_t i = 0; i < partitions.size(); ++i) flush_partition(i);
+    }
+
+    /// \brief Applies the function to every vertex
+    template <typename TransformType>
+    void transform_vertices(TransformType transform_functor) {
+      for (size_t i = 0; i < vertices.size(); ++i) {
+        vertex_type vtx(*this, i);
+        transform_functor(vtx);
+      }
+    }
+
+    /// \brief Sums the function over every vertex
+    template <typename ResultType, typename MapFunctionType>
+    ResultType map_reduce_vertices(MapFunctionType mapfunction) {
+      ResultType result = ResultType();
+      for (size_t i = 0; i < vertices.size(); ++i) {
+        const vertex_type vtx(*this, i);
+        if (i == 0) result = mapfunction(vtx);
+        else result += mapfunction(vtx);
+      }
+      return result;
+    }
+
+    /**
+     * \brief Reads the edges of a partition sequentially and calls
+     * visitor(edge) on each of them.
+     *
+     * The file is read in blocks of block_bytes. If write_back is
+     * set, the blocks whose edge data the visitor changed are written
+     * back in place.
+     */
+    template <typename Visitor>
+    void stream_partition(size_t partition, Visitor& visitor,
+                          bool write_back, size_t block_bytes = 4 << 20) {
+      ASSERT_LT(partition, partitions.size());
+      ASSERT_TRUE(partitions[partition].buffer.empty());
+      if (partitions[partition].nedges == 0) return;
+      // only non empty edge data can change
+      write_back = write_back &&
+          !boost::is_same<edge_data_type, graphlab::empty>::value;
+      const size_t block_records =
+          std::max<size_t>(block_bytes / sizeof(edge_record), 1);
+      std::vector<edge_record> block(block_records), original;
+      std::fstream fin(partition_file(partition).c_str(), write_back ?
+                       std::ios::in | std::ios::out | std::ios::binary :
+                       std::ios::in | std::ios::binary);
+      ASSERT_TRUE(fin.good());
+      size_t remaining = partitions[partition].nedges;
+      size_t offset = 0;
+      while (remaining > 0) {
+        const size_t nrecords = std::min(remaining, block_records);
+        const size_t nbytes = nrecords * sizeof(edge_record);
+        fin.seekg(offset);
+        fin.read(reinterpret_cast<char*>(&block[0]), nbytes);
+        ASSERT_TRUE(fin.good());
+        if (write_back) original.assign(block.begin(), block.begin() + nrecords);
+        for (size_t i = 0; i < nrecords; ++i) {
+          edge_type edge(*this, block[i]);
+          visitor(edge);
+        }
+        if (write_back && memcmp(&original[0], &block[0], nbytes) != 0) {
+          fin.seekp(offset);
+          fin.write(reinterpret_cast<const char*>(&block[0]), nbytes);
+          ASSERT_TRUE(fin.good());
+        }
+        offset += nbytes;
+        remaining -= nrecords;
+      }
+    }
+
+  private:
+    struct partition_type {
+      size_t nedges;
+      /// The edges not yet written to the file
+      std::vector<edge_record> buffer;
+      partition_type() : nedges(0) { }
+    };
+
+    distributed_control& dc_ref;
+    std::string path_prefix;
+    size_t vertices_per_partition;
+    size_t nedges;
+    /// The number of edges buffered in a partition before it is written
+    size_t buffer_records;
+    std::vector<vertex_data_type> vertices;
+    std::vector<size_t> in_degree, out_degree;
+    std::vector<partition_type> partitions;
+
+    void resize(size_t nverts) {
+      if (nverts <= vertices.size()) return;
+      vertices.resize(nverts);
+      in_degree.resize(nverts, 0);
+      out_degree.resize(nverts, 0);
+      const size_t npartitions =
+          (nverts + vertices_per_partition - 1) / vertices_per_partition;
+      while (partitions.size() < npartitions) {
+        // create the file so every partition can be opened
+        std::ofstream fout(partition_file(partitions.size()).c_str(),
+                           std::ios::binary | std::ios::trunc);
+        ASSERT_TRUE(fout.good());
+        partitions.push_back(partition_type());
+      }
+    }
+
+    void flush_partition(size_t partition) {
+      std::vector<edge_record>& buffer = partitions[partition].buffer;
+      if (buffer.empty()) return;
+      std::ofstream fout(partition_file(partition).c_str(),
+                         std::ios::binary | std::ios::app);
+      fout.write(reinterpret_cast<const char*>(&buffer[0]),
+                 buffer.size() * sizeof(edge_record));
+      ASSERT_TRUE(fout.good());
+      buffer.clear();
+    }
+  }; // end of class streaming_graph
+
+} // end of namespace graphlab
+#include <graphlab/macros_undef.hpp>
+
+#endif
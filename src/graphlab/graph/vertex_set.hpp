@@ -25,6 +25,9 @@
 #ifndef GRAPHLAB_GRAPH_VERTEX_SET_HPP
 #define GRAPHLAB_GRAPH_VERTEX_SET_HPP
 
+#include <vector>
+#include <algorithm>
+#include <iterator>
 #include <graphlab/util/dense_bitset.hpp>
 #include <graphlab/graph/graph_basic_types.hpp>
 #include <graphlab/rpc/buffered_exchange.hpp>
@@ -67,6 +70,13 @@ namespace graphlab {
  * The size of the vertex set can only be queried through the graph using
  * \ref distributed_graph::vertex_set_size();
  *
+ * Internally, a set which holds only a small fraction of the local
+ * vertices is stored as a sorted list of local vertex ids rather than as a
+ * bitset over all local vertices. Iterating over, synchronizing, and
+ * signalling such a set then costs time proportional to the number of its
+ * members instead of the number of local vertices. The representation is
+ * chosen independently on each machine whenever the set is synchronized,
+ * and is invisible to the user.
  */
 class vertex_set {
   private:
@@ -92,6 +102,34 @@ class vertex_set {
      */
     mutable bool lazy; 
 
+    /**
+     * Used only if \ref lazy is false.
+     * If set, the localvset is empty and not used. Instead, the set
+     * contains exactly the local vertices in \ref sparse_lvids.
+     */
+    mutable bool sparse;
+
+    /**
+     * Used only if \ref sparse is set. The sorted local ids of the
+     * vertices in the set. The mirror / master invariant of localvset
+     * holds here too.
+     */
+    mutable std::vector<lvid_type> sparse_lvids;
+
+    /**
+     * Used only if \ref sparse is set. The number of local vertices, which
+     * is the size of localvset when the set is made dense again.
+     */
+    mutable size_t num_local;
+
+    /**
+     * A set becomes sparse when at most 1 in SPARSE_RATIO local
+     * vertices are in it, and becomes dense again when more than 2 in
+     * SPARSE_RATIO are. This is where the id list takes about as
+     * much memory as the bitset.
+     */
+    static const size_t SPARSE_RATIO = 8 * sizeof(lvid_type);
+
 
     /**
      * \internal
@@ -99,10 +137,109 @@ class vertex_set {
      */
     template <typename DGraphType> 
     const dense_bitset& get_lvid_bitset(const DGraphType& dgraph) const {
-      if (lazy) make_explicit(dgraph);
+      if (lazy || sparse) make_explicit(dgraph);
       return localvset;
     }
 
+    /**
+     * \internal
+     * Returns true if the set has no local vertices.
+     */
+    bool local_empty() const {
+      if (lazy) return !is_complete_set;
+      else if (sparse) return sparse_lvids.empty();
+      else return localvset.empty();
+    }
+
+    /**
+     * \internal
+     * Switches an explicit set to the sparse representation holding the
+     * given sorted list of local ids, out of nlocal local vertices.
+     */
+    void assign_sparse(std::vector<lvid_type>& lvids, size_t nlocal) {
+      lazy = false;
+      sparse = true;
+      num_local = nlocal;
+      sparse_lvids.swap(lvids);
+      localvset.resize(0);
+    }
+
+    /**
+     * \internal
+     * Makes this set hold exactly the local vertices in lvids, which
+     * must not contain duplicates. The representation is picked from the
+     * number of ids, so filling a sparse set costs time proportional to
+     * the number of its members.
+     */
+    template <typename DGraphType>
+    void assign_lvids(const DGraphType& dgraph, std::vector<lvid_type>& lvids) {
+      const size_t nlocal = dgraph.num_local_vertices();
+      if (lvids.size() * SPARSE_RATIO <= nlocal) {
+        std::sort(lvids.begin(), lvids.end());
+        assign_sparse(lvids, nlocal);
+      }
+      else {
+        lazy = false;
+        sparse = false;
+        std::vector<lvid_type>().swap(sparse_lvids);
+        localvset.resize(nlocal);
+        localvset.clear();
+        for (size_t i = 0; i < lvids.size(); ++i) {
+          localvset.set_bit_unsync(lvids[i]);
+        }
+      }
+    }
+
+    /**
+     * \internal
+     * Converts a sparse set to the bitset representation.
+     */
+    void make_dense() const {
+      if (!sparse) return;
+      localvset.resize(num_local);
+      localvset.clear();
+      for (size_t i = 0; i < sparse_lvids.size(); ++i) {
+        localvset.set_bit_unsync(sparse_lvids[i]);
+      }
+      std::vector<lvid_type>().swap(sparse_lvids);
+      sparse = false;
+    }
+
+    /**
+     * \internal
+     * Picks the representation of an explicit set according to the
+     * number of local vertices in it.
+     */
+    template <typename DGraphType>
+    void compact(const DGraphType& dgraph) {
+      if (lazy) return;
+      const size_t nlocal = dgraph.num_local_vertices();
+      if (sparse) {
+        if (sparse_lvids.size() * SPARSE_RATIO > 2 * nlocal) make_dense();
+      }
+      else if (localvset.popcount() * SPARSE_RATIO <= nlocal) {
+        std::vector<lvid_type> lvids;
+        foreach(size_t lvid, localvset) lvids.push_back(lvid);
+        assign_sparse(lvids, nlocal);
+      }
+    }
+
+    /**
+     * \internal
+     * Sorts the ids in lvids, and merges them into the ids of the sparse
+     * set. lvids may contain duplicates.
+     */
+    void merge_sparse(std::vector<lvid_type>& lvids) {
+      ASSERT_TRUE(sparse);
+      std::sort(lvids.begin(), lvids.end());
+      lvids.erase(std::unique(lvids.begin(), lvids.end()), lvids.end());
+      std::vector<lvid_type> merged;
+      merged.reserve(sparse_lvids.size() + lvids.size());
+      std::set_union(sparse_lvids.begin(), sparse_lvids.end(),
+                     lvids.begin(), lvids.end(), std::back_inserter(merged));
+      sparse_lvids.swap(merged);
+    }
+
     
     /**
      * \internal
@@ -136,6 +273,7 @@ class vertex_set {
      */
     template <typename DGraphType> 
     void make_explicit(const DGraphType& dgraph) const {
+      if (sparse) make_dense();
       if (lazy) {
         localvset.resize(dgraph.num_local_vertices());
         if (is_complete_set) {
@@ -160,30 +298,62 @@ class vertex_set {
         make_explicit(dgraph);
         return;
       }
-      foreach(size_t lvid, localvset) {
-        typename DGraphType::local_vertex_type lvtx = dgraph.l_vertex(lvid);
-        if (lvtx.owned()) {
-          // send to mirrors
-          vertex_id_type gvid = lvtx.global_id();
-          foreach(size_t proc, lvtx.mirrors()) {
-            exchange.send(proc, gvid);
+      if (sparse) {
+        // keep only the masters, and send them to their mirrors
+        size_t nkept = 0;
+        for (size_t i = 0; i < sparse_lvids.size(); ++i) {
+          typename DGraphType::local_vertex_type lvtx = 
+            dgraph.l_vertex(sparse_lvids[i]);
+          if (lvtx.owned()) {
+            vertex_id_type gvid = lvtx.global_id();
+            foreach(size_t proc, lvtx.mirrors()) {
+              exchange.send(proc, gvid);
+            }
+            sparse_lvids[nkept++] = sparse_lvids[i];
+          }
+        }
+        sparse_lvids.resize(nkept);
+      }
+      else {
+        foreach(size_t lvid, localvset) {
+          typename DGraphType::local_vertex_type lvtx = dgraph.l_vertex(lvid);
+          if (lvtx.owned()) {
+            // send to mirrors
+            vertex_id_type gvid = lvtx.global_id();
+            foreach(size_t proc, lvtx.mirrors()) {
+              exchange.send(proc, gvid);
+            }
+          } 
+          else {
+            localvset.clear_bit_unsync(lvid);
           }
-        } 
-        else {
-          localvset.clear_bit_unsync(lvid);
         }
       }
       exchange.flush();
+      receive_lvids(dgraph, exchange);
+      compact(dgraph);
+    }
 
+    /**
+     * \internal
+     * Adds all the vertices received through the exchange to the set.
+     */
+    template <typename DGraphType>
+    void receive_lvids(DGraphType& dgraph,
+                       buffered_exchange<vertex_id_type>& exchange) {
       typename buffered_exchange<vertex_id_type>::buffer_type recv_buffer;
       procid_t sending_proc;
+      std::vector<lvid_type> received;
 
       while(exchange.recv(sending_proc, recv_buffer)) {
         foreach(vertex_id_type gvid, recv_buffer) {
-          localvset.set_bit_unsync(dgraph.vertex(gvid).local_id());
+          const lvid_type lvid = dgraph.vertex(gvid).local_id();
+          if (sparse) received.push_back(lvid);
+          else localvset.set_bit_unsync(lvid);
         }
         recv_buffer.clear();
       }
+      if (sparse && !received.empty()) merge_sparse(received);
     }
 
 
@@ -198,25 +368,28 @@ class vertex_set {
         make_explicit(dgraph);
         return;
       }
-      foreach(size_t lvid, localvset) {
-        typename DGraphType::local_vertex_type lvtx = dgraph.l_vertex(lvid);
-        if (!lvtx.owned()) {
-          // send to master 
-          vertex_id_type gvid = lvtx.global_id();
-          exchange.send(lvtx.owner(), gvid);
-        } 
+      if (sparse) {
+        for (size_t i = 0; i < sparse_lvids.size(); ++i) {
+          typename DGraphType::local_vertex_type lvtx = 
+            dgraph.l_vertex(sparse_lvids[i]);
+          if (!lvtx.owned()) {
+            exchange.send(lvtx.owner(), vertex_id_type(lvtx.global_id()));
+          }
+        }
       }
-      exchange.flush();
-
-      typename buffered_exchange<vertex_id_type>::buffer_type recv_buffer;
-      procid_t sending_proc;
-
-      while(exchange.recv(sending_proc, recv_buffer)) {
-        foreach(vertex_id_type gvid, recv_buffer) {
-          localvset.set_bit_unsync(dgraph.vertex(gvid).local_id());
+      else {
+        foreach(size_t lvid, localvset) {
+          typename DGraphType::local_vertex_type lvtx = dgraph.l_vertex(lvid);
+          if (!lvtx.owned()) {
+            // send to master 
+            vertex_id_type gvid = lvtx.global_id();
+            exchange.send(lvtx.owner(), gvid);
+          } 
         }
-        recv_buffer.clear();
       }
+      exchange.flush();
+      receive_lvids(dgraph, exchange);
+      compact(dgraph);
     }
 
     template <typename VertexType, typename EdgeType>
@@ -224,35 +397,91 @@ class vertex_set {
 
   public:
     /// default constructor which constructs an empty set.
-    vertex_set():is_complete_set(false), lazy(true){}
+    vertex_set():is_complete_set(false), lazy(true), sparse(false), 
+                 num_local(0) {}
 
 
     /** Constructs a completely empty, or a completely full vertex set
      * \param complete If set to true, creates a set of all vertices. 
      *                 If set to false, creates an empty set.
      */
-    explicit vertex_set(bool complete):is_complete_set(complete),lazy(true){}
+    explicit vertex_set(bool complete):is_complete_set(complete),lazy(true),
+                                       sparse(false), num_local(0) {}
 
     /// copy constructor
     inline vertex_set(const vertex_set& other):
         localvset(other.localvset), 
         is_complete_set(other.is_complete_set),
-        lazy(other.lazy) {}
+        lazy(other.lazy), sparse(other.sparse), 
+        sparse_lvids(other.sparse_lvids), num_local(other.num_local) {}
 
     /// copyable
     inline vertex_set& operator=(const vertex_set& other) {
       localvset = other.localvset;
       is_complete_set = other.is_complete_set;
       lazy = other.lazy;
+      sparse = other.sparse;
+      sparse_lvids = other.sparse_lvids;
+      num_local = other.num_local;
       return *this;
     }
+
+    /**
+     * \internal
+     * Appends the local ids of all the local vertices (masters and
+     * mirrors) in the set to lvids, in increasing order.
+     */
+    template <typename DGraphType>
+    void get_lvids(const DGraphType& dgraph, 
+                   std::vector<lvid_type>& lvids) const {
+      if (lazy) {
+        if (!is_complete_set) return;
+        for (size_t i = 0; i < dgraph.num_local_vertices(); ++i) {
+          lvids.push_back(i);
+        }
+      }
+      else if (sparse) {
+        lvids.insert(lvids.end(), sparse_lvids.begin(), sparse_lvids.end());
+      }
+      else {
+        foreach(size_t lvid, localvset) lvids.push_back(lvid);
+      }
+    }
   
+    /**
+     * \internal
+     * Calls visitor(lvid) for each local vertex (master or mirror) in the
+     * set, in increasing order. Unlike get_lvids(), a dense set is
+     * walked through its bitset without building a list of its members.
+     */
+    template <typename DGraphType, typename VisitorType>
+    void for_each_lvid(const DGraphType& dgraph, VisitorType& visitor) const {
+      if (lazy) {
+        if (!is_complete_set) return;
+        for (size_t i = 0; i < dgraph.num_local_vertices(); ++i) {
+          visitor(lvid_type(i));
+        }
+      }
+      else if (sparse) {
+        for (size_t i = 0; i < sparse_lvids.size(); ++i) {
+          visitor(sparse_lvids[i]);
+        }
+      }
+      else {
+        foreach(size_t lvid, localvset) visitor(lvid_type(lvid));
+      }
+    }
+
     /**
      * \internal
      * Queries if a local vertex ID is contained within the vertex set
      */ 
     inline bool l_contains(lvid_type lvid) const {
       if (lazy) return is_complete_set;
+      if (sparse) {
+        return std::binary_search(sparse_lvids.begin(), sparse_lvids.end(),
+                                  lvid);
+      }
       if (lvid < localvset.size()) {
         return localvset.get(lvid);
       }
@@ -335,6 +564,18 @@ class vertex_set {
         if (other.is_complete_set) /* no op */; 
         else (*this) = vertex_set(false); 
       }
+      else if (sparse || other.sparse) {
+        // the result is no larger than the sparse operand
+        const vertex_set& small = sparse ? *this : other;
+        const vertex_set& large = sparse ? other : *this;
+        std::vector<lvid_type> lvids;
+        for (size_t i = 0; i < small.sparse_lvids.size(); ++i) {
+          if (large.l_contains(small.sparse_lvids[i])) {
+            lvids.push_back(small.sparse_lvids[i]);
+          }
+        }
+        assign_sparse(lvids, small.num_local);
+      }
       else {
         localvset &= other.localvset;
       }
@@ -360,7 +601,17 @@ class vertex_set {
         if (other.is_complete_set) (*this) = vertex_set(true);
         else /* no op */; 
       }
+      else if (sparse && other.sparse) {
+        std::vector<lvid_type> lvids(other.sparse_lvids);
+        merge_sparse(lvids);
+      }
+      else if (other.sparse) {
+        for (size_t i = 0; i < other.sparse_lvids.size(); ++i) {
+          localvset.set_bit_unsync(other.sparse_lvids[i]);
+        }
+      }
       else {
+        make_dense();
         localvset |= other.localvset;
       }
       return *this;
@@ -390,6 +641,20 @@ class vertex_set {
         if (other.is_complete_set) (*this) = vertex_set(false); 
         else /* no op */; 
       }
+      else if (sparse) {
+        size_t nkept = 0;
+        for (size_t i = 0; i < sparse_lvids.size(); ++i) {
+          if (!other.l_contains(sparse_lvids[i])) {
+            sparse_lvids[nkept++] = sparse_lvids[i];
+          }
+        }
+        sparse_lvids.resize(nkept);
+      }
+      else if (other.sparse) {
+        for (size_t i = 0; i < other.sparse_lvids.size(); ++i) {
+          localvset.clear_bit_unsync(other.sparse_lvids[i]);
+        }
+      }
       else {
         localvset -= other.localvset;
       }
@@ -423,6 +688,7 @@ class vertex_set {
         is_complete_set = !is_complete_set; 
       }
       else {
+        make_dense();
         localvset.invert(); 
       }
     }
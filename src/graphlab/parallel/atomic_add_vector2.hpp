@@ -37,20 +37,89 @@
 
 
 #include <vector>
+#include <cstring>
+#include <stdint.h>
 
+#include <boost/type_traits/is_arithmetic.hpp>
+#include <boost/type_traits/is_same.hpp>
+#include <boost/static_assert.hpp>
 
 #include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/util/lock_free_pool.hpp>
+#include <graphlab/util/empty.hpp>
 
 
 
 namespace graphlab {
 
   /**
-   * \TODO DOCUMENT THIS CLASS
-   */ 
-  
-  template<typename ValueType>
+   * \brief Declares whether messages of type T can be combined without
+   * a lock by atomic_add_vector2<T, true>.
+   *
+   * This holds for arithmetic types (combined by addition) and
+   * graphlab::empty. A POD message type of 1, 2, 4 or 8 bytes whose
+   * operator+= is commutative and associative (a min, a max, a sum...)
+   * can be declared by specializing this trait:
+   * \code
+   * struct min_message {
+   *   double value;
+   *   min_message& operator+=(const min_message& other) {
+   *     value = std::min(value, other.value); return *this;
+   *   }
+   * };
+   * namespace graphlab {
+   *   template <> struct lock_free_combiner<min_message> {
+   *     static const bool value = true;
+   *   };
+   * }
+   * \endcode
+   *
+   * Each slot is a word of twice the size of the message, so 8 byte
+   * messages need a 16 byte compare-and-swap (cmpxchg16b, enabled with
+   * -mcx16). Without it only arithmetic types of up to 4 bytes are
+   * declared here.
+   */
+  template<typename T>
+  struct lock_free_combiner {
+    static const bool value = boost::is_arithmetic<T>::value &&
+                              !boost::is_same<T, bool>::value &&
+#ifdef __GCC_HAVE_SYNC_COMPARE_AND_SWAP_16
+                              sizeof(T) <= 8;
+#else
+                              sizeof(T) <= 4;
+#endif
+  };
+
+  template<>
+  struct lock_free_combiner<empty> {
+    static const bool value = true;
+  };
+
+  /**
+   * \internal
+   * \brief The unsigned word of the given number of bytes.
+   */
+  template<size_t Bytes> struct lock_free_slot_word;
+  template<> struct lock_free_slot_word<2> { typedef uint16_t type; };
+  template<> struct lock_free_slot_word<4> { typedef uint32_t type; };
+  template<> struct lock_free_slot_word<8> { typedef uint64_t type; };
+#ifdef __GCC_HAVE_SYNC_COMPARE_AND_SWAP_16
+  template<> struct lock_free_slot_word<16> {
+    typedef unsigned __int128 type;
+  };
+#endif
+
+  /**
+   * \brief A vector of message slots which combines the messages added
+   * to each slot with operator+= until they are taken out with
+   * test_and_get().
+   *
+   * This generic version protects each slot with a spinlock. The
+   * schedulers pass LockFree = lock_free_combiner<T>::value, so that
+   * the message types declared by \ref lock_free_combiner get the
+   * lock-free version instead.
+   */
+  template<typename ValueType, bool LockFree = false>
   class atomic_add_vector2 {
   public:
     typedef ValueType value_type;
@@ -222,6 +291,157 @@ namespace graphlab {
     
   }; // end of vertex map
 
+
+
+  /**
+   * \brief Lock-free version of atomic_add_vector2, selected with
+   * LockFree = true, for the message types declared by
+   * \ref lock_free_combiner.
+   *
+   * Each slot is a single word holding the combined message in its
+   * low half and an occupancy flag in its high half, so that the
+   * message and the flag always change together. add() combines into
+   * the slot with a compare-and-swap loop, starting a new message when
+   * the flag is clear, and test_and_get() swaps an empty slot in with a
+   * compare-and-swap. Every message taken out therefore holds exactly
+   * the adds made since the previous take, as with the locking version.
+   */
+  template<typename ValueType>
+  class atomic_add_vector2<ValueType, true> {
+  public:
+    typedef ValueType value_type;
+
+  private:
+    BOOST_STATIC_ASSERT(lock_free_combiner<value_type>::value);
+    typedef typename lock_free_slot_word<2 * sizeof(value_type)>::type
+        word_type;
+
+    atomic<size_t> joincounter;
+    std::vector<word_type> slots;
+
+    /** Not assignable */
+    void operator=(const atomic_add_vector2& other) { }
+
+    /** The empty slot. Its value bytes are never read. */
+    static word_type empty_word() { return 0; }
+
+    static word_type to_word(const value_type& value) {
+      word_type word = 0;
+      memcpy(&word, &value, sizeof(value_type));
+      reinterpret_cast<unsigned char*>(&word)[sizeof(value_type)] = 1;
+      return word;
+    }
+
+    static value_type to_value(const word_type& word) {
+      value_type value;
+      memcpy(&value, &word, sizeof(value_type));
+      return value;
+    }
+
+    static bool is_set(const word_type& word) {
+      return reinterpret_cast<const unsigned char*>(&word)
+          [sizeof(value_type)] != 0;
+    }
+
+    /**
+     * May tear for 16 byte words, which only costs the compare-and-swap
+     * it feeds another round.
+     */
+    inline word_type load(const size_t& idx) const {
+      return *reinterpret_cast<const volatile word_type*>(&slots[idx]);
+    }
+
+    /** An untorn read: a compare-and-swap which never changes the slot */
+    inline word_type atomic_load(const size_t& idx) {
+      return __sync_val_compare_and_swap(&slots[idx], empty_word(),
+                                         empty_word());
+    }
+
+  public:
+    /** Initialize the per vertex task set */
+    atomic_add_vector2(size_t num_vertices = 0) :
+      slots(num_vertices, empty_word()) { }
+
+    /**
+     * Resize the internal locks for a different graph
+     */
+    void resize(size_t num_vertices) {
+      slots.resize(num_vertices, empty_word());
+    }
+
+    /** Add a task to the set returning false if the task was already
+        present. */
+    bool add(const size_t& idx,
+             const value_type& val) {
+      value_type new_value;
+      return add(idx, val, new_value);
+    } // end of add task to set
+
+    bool add(const size_t& idx,
+             const value_type& val,
+             value_type& new_value) {
+      ASSERT_LT(idx, slots.size());
+      word_type old_word = load(idx);
+      while(true) {
+        if (is_set(old_word)) {
+          new_value = to_value(old_word);
+          new_value += val;
+        } else {
+          new_value = val;
+        }
+        const word_type prev_word =
+            __sync_val_compare_and_swap(&slots[idx], old_word,
+                                        to_word(new_value));
+        if (prev_word == old_word) return !is_set(old_word);
+        old_word = prev_word;
+      }
+    } // end of add task to set
+
+    bool test_and_get(const size_t& idx,
+                      value_type& ret_val) {
+      ASSERT_LT(idx, slots.size());
+      word_type old_word = load(idx);
+      while(is_set(old_word)) {
+        const word_type prev_word =
+            __sync_val_compare_and_swap(&slots[idx], old_word, empty_word());
+        if (prev_word == old_word) {
+          ret_val = to_value(old_word);
+          return true;
+        }
+        old_word = prev_word;
+      }
+      return false;
+    }
+
+    bool peek(const size_t& idx,
+              value_type& ret_val) {
+      ASSERT_LT(idx, slots.size());
+      const word_type word = atomic_load(idx);
+      if (!is_set(word)) return false;
+      ret_val = to_value(word);
+      return true;
+    }
+
+    bool empty(const size_t& idx) {
+      return !is_set(atomic_load(idx));
+    }
+
+    size_t size() const {
+      return slots.size();
+    }
+
+    size_t num_joins() const {
+      return joincounter.value;
+    }
+
+    void clear() {
+      for (size_t i = 0; i < slots.size(); ++i) clear(i);
+    }
+
+    void clear(size_t i) { value_type val; test_and_get(i, val); }
+
+  }; // end of lock free vertex map
+
 }; // end of namespace graphlab
 
 #undef VALUE_PENDING
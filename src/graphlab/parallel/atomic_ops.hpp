@@ -112,6 +112,26 @@ namespace graphlab {
     return __sync_bool_compare_and_swap(a_ptr, *oldval_ptr, *newval_ptr);
   };
 
+  /**
+   * \ingroup util
+   * \brief Compare and swap on a double through its bit pattern.
+   */
+  template <>
+  inline bool atomic_compare_and_swap(double& a, double oldval, double newval) {
+    return atomic_compare_and_swap(static_cast<volatile double&>(a),
+                                   oldval, newval);
+  };
+
+  /**
+   * \ingroup util
+   * \brief Compare and swap on a float through its bit pattern.
+   */
+  template <>
+  inline bool atomic_compare_and_swap(float& a, float oldval, float newval) {
+    return atomic_compare_and_swap(static_cast<volatile float&>(a),
+                                   oldval, newval);
+  };
+
   /** 
     * \ingroup util
     * \brief Atomically exchanges the values of a and b.
@@ -41,7 +41,10 @@
 
 #include <graphlab/rpc/dc.hpp>
 #include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/util/timer.hpp>
 #include <graphlab/util/cache.hpp>
+#include <graphlab/util/concurrent_hopscotch_map.hpp>
 
 
 
@@ -75,6 +78,25 @@ namespace graphlab {
 
 
 
+  /**
+   * \ingroup rpc
+   * A distributed table of values which are read through a local cache
+   * and updated by adding deltas.
+   *
+   * Each key is owned by one machine (hash(key) % numprocs). Remote
+   * values are cached locally, and deltas applied to a cached value are
+   * accumulated and shipped to the owner once the entry has been used
+   * max_uses times, when it is evicted, or on synchronize(). Deltas for
+   * the same machine are queued and sent in batches of up to
+   * max_batch_size deltas, with the owner answering each batch with the
+   * new master values. Queued deltas which did not fill a batch are sent
+   * by the next update or read once max_batch_delay milliseconds have
+   * passed since the last send of all queues.
+   *
+   * The local data is a concurrent_hopscotch_map, and the cache is split
+   * into stripes by key hash with one lock per stripe, so threads only
+   * contend when they touch keys in the same stripe.
+   */
   template<typename KeyType, typename ValueType,
            typename DeltaType = ValueType>
   class delta_dht {
@@ -85,41 +107,65 @@ namespace graphlab {
 
     typedef size_t    size_type;    
     
-    typedef boost::unordered_map<key_type, value_type> data_map_type;
+    typedef concurrent_hopscotch_map<key_type, value_type> data_map_type;
     
     struct cache_entry {
       value_type value;
       delta_type delta;
       size_t uses;
+      //! deltas sent to the owner which were not acknowledged yet
+      size_t pending;
       cache_entry(const value_type& value = value_type()) : 
-        value(value), uses(0) { }
+        value(value), uses(0), pending(0) { }
     };
 
     typedef cache::lru<key_type, cache_entry> cache_type;
 
+    typedef std::vector<std::pair<key_type, delta_type> > delta_batch_type;
+    typedef std::vector<std::pair<key_type, value_type> > value_batch_type;
+
   private:
 
+    //! A part of the cache with its own lock
+    struct cache_stripe {
+      cache_type cache;
+      mutex lock;
+      char padding[64];
+    };
+
+    //! The deltas waiting to be sent to one machine
+    struct outbox {
+      delta_batch_type deltas;
+      mutex lock;
+      char padding[64];
+    };
+
     //! The remote procedure call manager 
     mutable dc_dist_object<delta_dht> rpc;
 
-
-    //! The data stored locally on this machine
+    //! The data stored locally on this machine. Safe for parallel access.
     data_map_type  data_map;
 
-    //! The lock for the data map
-    mutex data_lock;
+    //! The cache stripes
+    mutable std::vector<cache_stripe> stripes;
 
-    //! The master cache
-    cache_type cache;
-
-    //! The master cash rw lock
-    mutex cache_lock;
+    //! The pending deltas for each machine
+    std::vector<outbox> outboxes;
   
-    //! The maximum cache size
-    size_t max_cache_size;
+    //! The maximum cache size of each stripe
+    size_t max_stripe_size;
 
     size_t max_uses;
 
+    //! The number of deltas at which a batch is sent
+    size_t max_batch_size;
+
+    //! The time after which queued deltas are sent even if no batch is full
+    size_t max_batch_delay;
+
+    //! When all queued deltas were last sent (timer::approx_time_millis())
+    atomic<size_t> last_flush_time;
+
     //! the hash function
     boost::hash<key_type> hash_function;
 
@@ -128,13 +174,51 @@ namespace graphlab {
     mutable atomic<size_t> hits;
     mutable atomic<size_t> misses;
     mutable atomic<size_t> background_updates;
+    //! batches of deltas sent and the deltas in them
+    atomic<size_t> batches;
+    atomic<size_t> deltas;
+
+    //! Adds a delta to a stored value and optionally reads the result
+    struct add_delta_functor {
+      const delta_type& delta;
+      value_type* result;
+      add_delta_functor(const delta_type& delta, value_type* result = NULL) :
+        delta(delta), result(result) { }
+      void operator()(value_type& value) const {
+        value += delta;
+        if(result != NULL) *result = value;
+      }
+    };
+
+    //! Reads a stored value
+    struct read_functor {
+      value_type* result;
+      read_functor(value_type* result) : result(result) { }
+      void operator()(value_type& value) const { *result = value; }
+    };
+
+    //! Reads a local value, inserting a default value for a new key
+    value_type read_local(const key_type& key) {
+      std::pair<bool, value_type> entry = data_map.get_sync(key);
+      if(!entry.first) data_map.update_sync(key, read_functor(&entry.second));
+      return entry.second;
+    }
+
+    //! The stripe caching a key. Uses the hash bits above the owner.
+    cache_stripe& stripe(const key_type& key) const {
+      const size_t hash_value = hash_function(key) / rpc.numprocs();
+      return stripes[hash_value % stripes.size()];
+    }
 
   public:
 
     delta_dht(distributed_control& dc, 
-              size_t max_cache_size = 2056) : 
-      rpc(dc, this), 
-      max_cache_size(max_cache_size), max_uses(10) {
+              size_t max_cache_size = 2056,
+              size_t num_stripes = 16) : 
+      rpc(dc, this), stripes(std::max<size_t>(num_stripes, 1)),
+      outboxes(dc.numprocs()), max_uses(10), max_batch_size(1024),
+      max_batch_delay(100), last_flush_time(timer::approx_time_millis()) {
+      max_stripe_size = std::max<size_t>(max_cache_size / stripes.size(), 1);
       rpc.barrier();
     }
 
@@ -142,22 +226,45 @@ namespace graphlab {
     
     void set_max_uses(size_t max) { max_uses = max; }
 
+    //! Sets the number of queued deltas at which a batch is sent
+    void set_max_batch_size(size_t max) { max_batch_size = std::max<size_t>(max, 1); }
+
+    //! Sets the milliseconds after which queued deltas are always sent
+    void set_max_batch_delay(size_t millis) { max_batch_delay = millis; }
+
     size_t cache_local() const { return local.value; }
     size_t cache_hits() const { return hits.value; }
     size_t cache_misses() const { return misses.value; }
     size_t background_syncs() const { return background_updates.value; }
+    //! The number of delta batches sent by this machine
+    size_t delta_batches() const { return batches.value; }
+    //! The number of deltas sent by this machine
+    size_t deltas_sent() const { return deltas.value; }
+
+    void print_stats(std::ostream& out) const {
+      out << "delta_dht: " << cache_local() << " local reads, "
+          << cache_hits() << " cache hits, "
+          << cache_misses() << " cache misses, "
+          << deltas_sent() << " deltas sent in "
+          << delta_batches() << " batches, "
+          << background_syncs() << " background updates\n";
+    }
 
     size_t cache_size() const { 
-      cache_lock.lock();
-      const size_t ret_val = cache.size(); 
-      cache_lock.unlock();
+      size_t ret_val = 0;
+      for(size_t i = 0; i < stripes.size(); ++i) {
+        stripes[i].lock.lock();
+        ret_val += stripes[i].cache.size(); 
+        stripes[i].lock.unlock();
+      }
       return ret_val;
     }
 
     bool is_cached(const key_type& key) const { 
-      cache_lock.lock();
-      const bool ret_value = cache.contains(key); 
-      cache_lock.unlock();
+      cache_stripe& s = stripe(key);
+      s.lock.lock();
+      const bool ret_value = s.cache.contains(key); 
+      s.lock.unlock();
       return ret_value;
     }
 
@@ -165,74 +272,86 @@ namespace graphlab {
     value_type operator[](const key_type& key) {     
       if(is_local(key)) {
         ++local;
-        data_lock.lock();
-        const value_type value = data_map[key];
-        data_lock.unlock();
-        return value;
+        return read_local(key);
       } else { // on a remote machine check the cache    
         // test for the key in the cache
-        cache_lock.lock();
-        if(cache.contains(key)) {
+        cache_stripe& s = stripe(key);
+        s.lock.lock();
+        if(s.cache.contains(key)) {
           ++hits;
-          const value_type ret_value = cache[key].value;
-          cache_lock.unlock();
+          const value_type ret_value = s.cache[key].value;
+          s.lock.unlock();
+          periodic_flush();
           return ret_value;
-        } else { // need to create a cache entry
-          ++misses;
+        } 
+        // need to create a cache entry. Get the value from the server
+        // without holding the stripe lock.
+        ++misses;
+        s.lock.unlock();
+        const value_type master = get_master(key);
+        s.lock.lock();
+        // another thread may have cached the key in the meantime
+        if(!s.cache.contains(key)) {
           // Free space in the cache if necessary
-          while(cache.size() + 1 > max_cache_size) {
-            ASSERT_GT(cache.size(), 0);
-            const std::pair<key_type, cache_entry> pair = cache.evict();
-            const key_type& key                         = pair.first;
-            const cache_entry& entry                    = pair.second;
-            send_delta(key, entry.delta);
+          while(s.cache.size() + 1 > max_stripe_size) {
+            ASSERT_GT(s.cache.size(), 0);
+            const std::pair<key_type, cache_entry> pair = s.cache.evict();
+            if(pair.second.uses > 0) send_delta(pair.first, pair.second.delta);
           }          
-          // get the new entry from the server
-          const value_type ret_value = (cache[key].value = get_master(key));
-          cache_lock.unlock();
-          return ret_value;
+          s.cache[key].value = master;
         }
+        const value_type ret_value = s.cache[key].value;
+        s.lock.unlock();
+        periodic_flush();
+        return ret_value;
       }
     } // end of operator []
     
 
     void apply_delta(const key_type& key, const delta_type& delta) {
       if(is_local(key)) {
-        data_lock.lock();
-        data_map[key] += delta;
-        data_lock.unlock();
+        data_map.update_sync(key, add_delta_functor(delta));
       } else {
         // update the cache entry if availablable
-        cache_lock.lock();
-        if(cache.contains(key)) {
-          cache_entry& entry = cache[key];
+        cache_stripe& s = stripe(key);
+        s.lock.lock();
+        if(s.cache.contains(key)) {
+          cache_entry& entry = s.cache[key];
           entry.value += delta;
           entry.delta += delta;               
-          if( entry.uses > max_uses ) {
+          if( ++entry.uses > max_uses ) {
             const delta_type accum_delta = entry.delta;
             entry.delta = delta_type();
             entry.uses = 0;
-            cache_lock.unlock();
+            ++entry.pending;
+            s.lock.unlock();
             send_delta(key, accum_delta);
-            return;
+          } else {
+            s.lock.unlock();
           }
+        } else {
+          // not cached: forward the delta to the owner
+          s.lock.unlock();          
+          send_delta(key, delta);
         }
-        cache_lock.unlock();          
+        periodic_flush();
       }
     }
 
 
 
-    //! empty the local cache
+    //! empty the local cache and send all pending deltas
     void flush() {
-      cache_lock.lock();
-      while(cache.size() > 0) {
-        const std::pair<key_type, cache_entry> pair = cache.evict();
-        const key_type& key = pair.first;
-        const cache_entry& entry = pair.second;
-        send_delta(key, entry.delta);
+      for(size_t i = 0; i < stripes.size(); ++i) {
+        cache_stripe& s = stripes[i];
+        s.lock.lock();
+        while(s.cache.size() > 0) {
+          const std::pair<key_type, cache_entry> pair = s.cache.evict();
+          if(pair.second.uses > 0) send_delta(pair.first, pair.second.delta);
+        }
+        s.lock.unlock();
       }
-      cache_lock.unlock();
+      flush_deltas();
     }
 
 
@@ -245,32 +364,47 @@ namespace graphlab {
     
     void synchronize() {
       typedef typename cache_type::pair_type pair_type;
-      cache_lock.lock();
-      foreach(pair_type& pair, cache) {
-        key_type& key = pair.first;
-        cache_entry& entry = pair.second;
-        if(entry.uses > 0) {
-          const delta_type accum_delta = entry.delta;
-          entry.delta = delta_type();
-          entry.uses = 0;
-          send_delta(key, accum_delta);
-        }
-      } // end of foreach
-      cache_lock.unlock();
+      for(size_t i = 0; i < stripes.size(); ++i) {
+        cache_stripe& s = stripes[i];
+        s.lock.lock();
+        foreach(pair_type& pair, s.cache) {
+          key_type& key = pair.first;
+          cache_entry& entry = pair.second;
+          if(entry.uses > 0) {
+            const delta_type accum_delta = entry.delta;
+            entry.delta = delta_type();
+            entry.uses = 0;
+            ++entry.pending;
+            send_delta(key, accum_delta);
+          }
+        } // end of foreach
+        s.lock.unlock();
+      }
+      flush_deltas();
     }
 
 
     void synchronize(const key_type& key) {
       if(is_local(key)) return;
-      cache_lock.lock();
-      if(cache.contains(key)) {
-        cache_entry& entry = cache[key];
+      cache_stripe& s = stripe(key);
+      s.lock.lock();
+      if(s.cache.contains(key)) {
+        cache_entry& entry = s.cache[key];
         const delta_type accum_delta = entry.delta;
         entry.delta = delta_type();
         entry.uses = 0;
-        cache_lock.unlock();
+        ++entry.pending;
+        s.lock.unlock();
         send_delta(key, accum_delta);
-      } else cache_lock.unlock();
+        flush_deltas(owning_cpu(key));
+      } else s.lock.unlock();
+    }
+
+
+    //! Sends the pending deltas to all machines
+    void flush_deltas() {
+      last_flush_time.value = timer::approx_time_millis();
+      for(procid_t p = 0; p < outboxes.size(); ++p) flush_deltas(p);
     }
 
 
@@ -288,23 +422,21 @@ namespace graphlab {
 
     delta_type delta(const key_type& key) const {
       if(!is_local(key)) {
-        cache_lock.lock();
-        if(cache.contains(key)) {
-          const delta_type delta = cache[key].delta;
-          cache_lock.unlock();
+        cache_stripe& s = stripe(key);
+        s.lock.lock();
+        if(s.cache.contains(key)) {
+          const delta_type delta = s.cache[key].delta;
+          s.lock.unlock();
           return delta;
         }
-        cache_lock.unlock();
+        s.lock.unlock();
       }
       return delta_type();
     }
 
 
     size_t local_size() const {
-      data_lock.lock();
-      const size_t result = data_map.size(); 
-      data_lock.unlock();
-      return result;
+      return data_map.size_sync();
     }
 
 
@@ -324,10 +456,7 @@ namespace graphlab {
     value_type get_master(const key_type& key) {
       // If the data is stored locally just read and return
       if(is_local(key)) {
-        data_lock.lock();
-        const value_type ret_value = data_map[key];
-        data_lock.unlock();
-        return ret_value;
+        return read_local(key);
       } else {
         return rpc.remote_request(owning_cpu(key), 
                                   &delta_dht::get_master, key);
@@ -335,63 +464,81 @@ namespace graphlab {
     } // end of direct get
     
   private:
+
+    //! Sends all queued deltas if they were last sent max_batch_delay ago
+    void periodic_flush() {
+      const size_t last = last_flush_time.value;
+      const size_t now = timer::approx_time_millis();
+      // only the thread which moves the flush time forward sends
+      if(now >= last + max_batch_delay && 
+         atomic_compare_and_swap(last_flush_time.value, last, now)) {
+        for(procid_t p = 0; p < outboxes.size(); ++p) flush_deltas(p);
+      }
+    }
     
+    //! Queues a delta for its owner, sending the batch once it is full
     void send_delta(const key_type& key, const delta_type& delta)  {
-      // If the data is stored locally just read and return
       ASSERT_FALSE(is_local(key));
-      const size_t calling_procid = procid();
-      rpc.remote_call(owning_cpu(key), 
-                      &delta_dht::send_delta_rpc, 
-                      calling_procid, key, delta);
-      
+      const procid_t owner = owning_cpu(key);
+      outbox& box = outboxes[owner];
+      delta_batch_type batch;
+      box.lock.lock();
+      box.deltas.push_back(std::make_pair(key, delta));
+      if(box.deltas.size() >= max_batch_size) std::swap(batch, box.deltas);
+      box.lock.unlock();
+      if(!batch.empty()) send_batch(owner, batch);
     } // end of send_delta
+
+    void flush_deltas(procid_t owner) {
+      delta_batch_type batch;
+      outboxes[owner].lock.lock();
+      std::swap(batch, outboxes[owner].deltas);
+      outboxes[owner].lock.unlock();
+      if(!batch.empty()) send_batch(owner, batch);
+    }
+
+    void send_batch(procid_t owner, const delta_batch_type& batch) {
+      ++batches;
+      deltas += batch.size();
+      const size_t calling_procid = procid();
+      rpc.remote_call(owner, &delta_dht::send_deltas_rpc, 
+                      calling_procid, batch);
+    }
     
-    void send_delta_rpc(const size_t& calling_procid, 
-                        const key_type& key, const delta_type& delta)  {
-      // If the data is stored locally just read and return
-      ASSERT_TRUE(is_local(key));
-      data_lock.lock(); 
-      const value_type ret_value = (data_map[key] += delta);
-      data_lock.unlock();
+    void send_deltas_rpc(const size_t& calling_procid, 
+                         const delta_batch_type& batch)  {
+      value_batch_type new_values(batch.size());
+      for(size_t i = 0; i < batch.size(); ++i) {
+        ASSERT_TRUE(is_local(batch[i].first));
+        new_values[i].first = batch[i].first;
+        data_map.update_sync(batch[i].first, 
+                             add_delta_functor(batch[i].second, 
+                                               &new_values[i].second));
+      }
       rpc.remote_call(calling_procid, 
-                      &delta_dht::send_delta_rpc_callback, key, ret_value);      
-      
-    } // end of send_delta_rpc
+                      &delta_dht::send_deltas_rpc_callback, new_values);      
+    } // end of send_deltas_rpc
     
-    void send_delta_rpc_callback(const key_type& key, const value_type& new_value)  {
-      // If the data is stored locally just read and return
-      ASSERT_FALSE(is_local(key));
-      cache_lock.lock();
-      if(cache.contains(key)) {
-        cache_entry& entry = cache[key];
-        entry.value = new_value;
-        entry.value += entry.delta;
+    void send_deltas_rpc_callback(const value_batch_type& new_values)  {
+      for(size_t i = 0; i < new_values.size(); ++i) {
+        const key_type& key = new_values[i].first;
+        ASSERT_FALSE(is_local(key));
+        cache_stripe& s = stripe(key);
+        s.lock.lock();
+        if(s.cache.contains(key)) {
+          cache_entry& entry = s.cache[key];
+          if(entry.pending > 0) --entry.pending;
+          // while newer deltas are on their way the master value lags
+          // behind the cached value, so keep the cached value
+          if(entry.pending == 0) {
+            entry.value = new_values[i].second;
+            entry.value += entry.delta;
+          }
+        }
+        s.lock.unlock();
       }
-      ++background_updates;
-      cache_lock.unlock();
-    } // end of send_delta_rpc_callback  
-
-    
-    // void synchronize(const key_type& key, cache_entry& entry)  {
-    //   const value_type delta = entry.current - entry.old;
-    //   entry.old = synchronize_rpc(key, delta);
-    //   entry.current = entry.old;
-    // } // end of synchronize
-
-    // value_type synchronize_rpc(const key_type& key, const value_type& delta) {
-    //   if(is_local(key)) {
-    //     data_lock.lock();
-    //     typename data_map_type::iterator iter = data_map.find(key);
-    //     ASSERT_TRUE(iter != data_map.end());
-    //     const value_type ret_value = (iter->second += delta);
-    //     data_lock.unlock();
-    //     return ret_value;
-    //   } else {
-    //     return rpc.remote_request(owning_cpu(key), 
-    //                               &delta_dht::synchronize_rpc, 
-    //                               key, delta);
-    //   }
-    // } // end of synchronize_rpc
+      background_updates += new_values.size();
+    } // end of send_deltas_rpc_callback  
 
   }; // end of delta_dht
 
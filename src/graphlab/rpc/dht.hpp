@@ -25,8 +25,7 @@
 #define GRAPHLAB_DHT_HPP
 
 #include <boost/functional/hash.hpp>
-#include <boost/unordered_map.hpp>
-#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/util/concurrent_hopscotch_map.hpp>
 #include <graphlab/rpc/dc_dist_object.hpp>
 
 namespace graphlab {
@@ -39,14 +38,13 @@ namespace graphlab {
   class dht { 
 
   public:
-    typedef boost::unordered_map<size_t, ValueType> storage_type;
+    typedef concurrent_hopscotch_map<size_t, ValueType> storage_type;
   
 
   private:
     mutable dc_dist_object< dht > rpc;
   
     boost::hash<KeyType> hasher;
-    mutex lock;
     storage_type storage;
 
   public:
@@ -72,12 +70,7 @@ namespace graphlab {
       std::pair<bool, ValueType> retval;
       // if it is me, we can return it
       if (owningmachine == rpc.dc().procid()) {
-
-        lock.lock();
-        typename storage_type::const_iterator iter = storage.find(hashvalue);
-        retval.first = iter != storage.end();
-        if (retval.first) retval.second = iter->second;
-        lock.unlock();
+        retval = storage.get_sync(hashvalue);
       } else {
         retval = rpc.remote_request(owningmachine, 
                                          &dht<KeyType,ValueType>::get, 
@@ -96,9 +89,7 @@ namespace graphlab {
  
       // if it is me, set it
       if (owningmachine == rpc.dc().procid()) {
-        lock.lock();
-        storage[hashvalue] = newval;
-        lock.unlock();
+        storage.put_sync(hashvalue, newval);
       } else {
         rpc.remote_call(owningmachine, 
                              &dht<KeyType,ValueType>::set, 
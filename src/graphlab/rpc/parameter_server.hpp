@@ -0,0 +1,434 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_RPC_PARAMETER_SERVER_HPP
+#define GRAPHLAB_RPC_PARAMETER_SERVER_HPP
+
+#include <vector>
+#include <algorithm>
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/rpc/dc_dist_object.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+
+  /**
+   * \ingroup rpc
+   * \brief A dense vector of shared parameters, updated by adding deltas
+   * and read with bounded staleness.
+   *
+   * \tparam T The parameter type. Must be an arithmetic type.
+   *
+   * The vector is split into contiguous ranges, one owned by each
+   * machine. Every machine keeps a full replica of the vector as a
+   * cache which is read by get(). add() applies a delta to the cache
+   * immediately, so that a machine always sees its own updates, and
+   * also accumulates the delta in a write-combining buffer. There are
+   * several buffers, selected by thread id, so that threads on the same
+   * machine rarely contend. The buffered deltas of all threads are
+   * combined and sent to the owners by push() and clock().
+   *
+   * Consistency follows the stale synchronous parallel (SSP) model.
+   * Each machine has a clock which is advanced by clock(). Once clock()
+   * returns the c-th time, the cache contains every update made by any
+   * machine before its (c - staleness)-th clock() call. A machine which
+   * gets more than staleness clocks ahead of the slowest machine waits
+   * in clock() for it to catch up. A staleness of 0 makes clock() a
+   * bulk synchronous step.
+   *
+   * Only the thread calling clock() waits. Threads which read the
+   * cache while another thread clocks should check fresh() first and
+   * put their work aside, without blocking, while it returns false.
+   *
+   * \code
+   * parameter_server<double> ps(dc, num_params, 2);
+   * // from any thread
+   * double w = ps.get(i);
+   * ps.add(i, -step * gradient);
+   * // periodically, from one thread on each machine
+   * ps.clock();
+   * \endcode
+   *
+   * pull() refreshes a range of the cache without waiting, and
+   * synchronize() is a collective which makes all replicas identical.
+   * The parameters are meant to be dense and of modest size, such as
+   * the global topic counts of LDA or a set of cluster centers, since
+   * every machine stores the whole vector once per write buffer.
+   */
+  template <typename T>
+  class parameter_server {
+  public:
+    typedef T value_type;
+
+  private:
+    typedef parameter_server<T> ps_type;
+
+    /// A per-thread buffer of deltas not yet pushed
+    struct write_buffer {
+      simple_spinlock lock;
+      bool dirty;
+      std::vector<T> deltas;
+      char padding[64];
+      write_buffer() : dirty(false) { }
+    };
+
+    /// The answer of an owner to a pull
+    struct range_reply {
+      /// The slowest clock the owner has seen from any machine
+      size_t min_clock;
+      /// The number of pushes of the requester the owner has applied
+      size_t requester_pushes;
+      std::vector<T> values;
+      void save(oarchive& oarc) const {
+        oarc << min_clock << requester_pushes << values;
+      }
+      void load(iarchive& iarc) {
+        iarc >> min_clock >> requester_pushes >> values;
+      }
+    };
+
+    mutable dc_dist_object<ps_type> rmi;
+
+    /// Number of parameters
+    size_t num_params;
+    /// Number of parameters owned by each machine (the last owns fewer)
+    size_t range_size;
+    /// Maximum number of clocks a machine may be ahead of the slowest
+    size_t staleness;
+
+    /// Local replica of all parameters
+    std::vector<atomic<T> > cache;
+    /// Deltas accumulated since the last push
+    std::vector<write_buffer> buffers;
+
+    /// Master values of the range owned by this machine
+    std::vector<T> master;
+    /**
+     * Latest clock of each machine such that all of its pushes up to
+     * that clock have been applied. Pushes may arrive out of order.
+     */
+    std::vector<size_t> sender_clock;
+    /// Number of pushes applied from each machine
+    std::vector<size_t> pushes_applied;
+    /// Largest push sequence number plus one received from each machine
+    std::vector<size_t> pushes_seen;
+    /// Largest clock received from each machine
+    std::vector<size_t> latest_clock;
+    mutex master_lock;
+
+    /// Number of pushes sent to each owner
+    std::vector<size_t> pushes_sent;
+    /// The clock of this machine
+    volatile size_t my_clock;
+    /// Every machine had reached this clock in the last refresh of the cache
+    volatile size_t cache_clock;
+    /// Serializes clock(), push() and pull()
+    mutex clock_lock;
+    /// Set by interrupt() to stop waiting for slow machines
+    volatile bool interrupted;
+
+  public:
+    /**
+     * Creates a parameter vector of num_params zeros. Must be called by
+     * all machines with the same arguments.
+     */
+    parameter_server(distributed_control& dc, size_t num_params,
+                     size_t staleness = 0,
+                     size_t num_buffers = thread::cpu_count()) :
+        rmi(dc, this), num_params(num_params), staleness(staleness),
+        cache(num_params), buffers(std::max<size_t>(num_buffers, 1)),
+        sender_clock(dc.numprocs(), 0), pushes_applied(dc.numprocs(), 0),
+        pushes_seen(dc.numprocs(), 0), latest_clock(dc.numprocs(), 0),
+        pushes_sent(dc.numprocs(), 0), my_clock(0), cache_clock(0),
+        interrupted(false) {
+      range_size = (num_params + dc.numprocs() - 1) / dc.numprocs();
+      for (size_t i = 0; i < buffers.size(); ++i) {
+        buffers[i].deltas.resize(num_params, T());
+      }
+      master.resize(owned_end(rmi.procid()) - owned_begin(rmi.procid()), T());
+      rmi.barrier();
+    }
+
+    ~parameter_server() { rmi.full_barrier(); }
+
+    /// Returns the number of parameters
+    size_t size() const { return num_params; }
+
+    /// Returns the number of clock() calls made by this machine
+    size_t current_clock() const { return my_clock; }
+
+    /**
+     * Returns true if the cache holds every update made by any machine
+     * before its (current_clock() - staleness)-th clock() call. This is
+     * false while clock() waits for a slow machine, and threads other
+     * than the one calling clock() should not read the cache then.
+     * Always true once interrupt() was called.
+     */
+    bool fresh() const {
+      return my_clock <= cache_clock + staleness || interrupted;
+    }
+
+    /// Returns the cached value of parameter i
+    inline T get(size_t i) const {
+      ASSERT_LT(i, num_params);
+      return cache[i].value;
+    }
+
+    /// Copies the cached values of [begin, end) into out
+    void get_range(size_t begin, size_t end, std::vector<T>& out) const {
+      ASSERT_LE(end, num_params);
+      out.resize(end - begin);
+      for (size_t i = begin; i < end; ++i) out[i - begin] = cache[i].value;
+    }
+
+    /// Adds delta to parameter i. Safe to call from any thread.
+    inline void add(size_t i, const T& delta) {
+      ASSERT_LT(i, num_params);
+      write_buffer& buf = buffers[thread::thread_id() % buffers.size()];
+      buf.lock.lock();
+      cache[i] += delta;
+      buf.deltas[i] += delta;
+      buf.dirty = true;
+      buf.lock.unlock();
+    }
+
+    /// Adds deltas[j] to parameter begin + j for every j
+    void add_range(size_t begin, const std::vector<T>& deltas) {
+      ASSERT_LE(begin + deltas.size(), num_params);
+      write_buffer& buf = buffers[thread::thread_id() % buffers.size()];
+      buf.lock.lock();
+      for (size_t j = 0; j < deltas.size(); ++j) {
+        cache[begin + j] += deltas[j];
+        buf.deltas[begin + j] += deltas[j];
+      }
+      buf.dirty = true;
+      buf.lock.unlock();
+    }
+
+    /**
+     * Sends the buffered deltas of this machine to their owners without
+     * advancing the clock.
+     */
+    void push() {
+      clock_lock.lock();
+      push_deltas(my_clock);
+      clock_lock.unlock();
+    }
+
+    /**
+     * Refreshes the cached values of [begin, end) from their owners,
+     * keeping any local deltas which have not been pushed yet. Does not
+     * wait for other machines.
+     */
+    void pull(size_t begin, size_t end) {
+      ASSERT_LE(end, num_params);
+      clock_lock.lock();
+      for (procid_t p = 0; p < rmi.numprocs(); ++p) {
+        const size_t b = std::max(begin, owned_begin(p));
+        const size_t e = std::min(end, owned_end(p));
+        if (b < e) pull_range(p, b, e, 0);
+      }
+      clock_lock.unlock();
+    }
+
+    /**
+     * Ends the current clock of this machine: pushes the buffered
+     * deltas, waits until no machine is more than staleness clocks
+     * behind, and refreshes the cache. Must only be called from one
+     * thread at a time on each machine, and every machine should call
+     * it at about the same rate.
+     */
+    void clock() {
+      clock_lock.lock();
+      ++my_clock;
+      push_deltas(my_clock);
+      const size_t min_clock = my_clock > staleness ? my_clock - staleness : 0;
+      size_t reached = my_clock;
+      for (procid_t p = 0; p < rmi.numprocs(); ++p) {
+        if (owned_begin(p) < owned_end(p)) {
+          reached = std::min(reached, pull_range(p, owned_begin(p),
+                                                 owned_end(p), min_clock));
+        }
+      }
+      cache_clock = reached;
+      clock_lock.unlock();
+    }
+
+    /**
+     * Makes clock() stop waiting for slow machines, for instance when
+     * the computation driving the clock is shutting down. Cleared by
+     * synchronize().
+     */
+    void interrupt() { interrupted = true; }
+
+    /**
+     * Pushes all deltas and makes the cache of every machine equal to
+     * the master values. This is a collective and must be called by all
+     * machines, with no concurrent add().
+     */
+    void synchronize() {
+      clock_lock.lock();
+      push_deltas(my_clock);
+      rmi.full_barrier();
+      // agree on a common clock so that later clock() calls line up
+      size_t max_clock = my_clock;
+      rmi.all_reduce2(max_clock, max_reducer());
+      my_clock = max_clock;
+      master_lock.lock();
+      std::fill(sender_clock.begin(), sender_clock.end(), max_clock);
+      std::fill(latest_clock.begin(), latest_clock.end(), max_clock);
+      master_lock.unlock();
+      for (procid_t p = 0; p < rmi.numprocs(); ++p) {
+        if (owned_begin(p) < owned_end(p)) {
+          pull_range(p, owned_begin(p), owned_end(p), 0);
+        }
+      }
+      cache_clock = max_clock;
+      rmi.barrier();
+      interrupted = false;
+      clock_lock.unlock();
+    }
+
+  private:
+    struct max_reducer {
+      void operator()(size_t& a, const size_t& b) const { a = std::max(a, b); }
+    };
+
+    size_t owned_begin(procid_t p) const {
+      return std::min(num_params, p * range_size);
+    }
+
+    size_t owned_end(procid_t p) const {
+      return std::min(num_params, (p + 1) * range_size);
+    }
+
+    /**
+     * Combines the write buffers and sends each owner its range of
+     * deltas along with the clock of this machine. A message is sent to
+     * every owner, even with no deltas, so that owners learn the clock.
+     * Each push to an owner carries a sequence number, which lets the
+     * owner tell when all earlier pushes have arrived.
+     */
+    void push_deltas(size_t clock) {
+      std::vector<T> combined(num_params, T());
+      bool any_dirty = false;
+      for (size_t i = 0; i < buffers.size(); ++i) {
+        write_buffer& buf = buffers[i];
+        buf.lock.lock();
+        if (buf.dirty) {
+          for (size_t j = 0; j < num_params; ++j) {
+            combined[j] += buf.deltas[j];
+            buf.deltas[j] = T();
+          }
+          buf.dirty = false;
+          any_dirty = true;
+        }
+        buf.lock.unlock();
+      }
+      for (procid_t p = 0; p < rmi.numprocs(); ++p) {
+        const size_t b = owned_begin(p), e = owned_end(p);
+        std::vector<T> deltas;
+        if (any_dirty) deltas.assign(combined.begin() + b, combined.begin() + e);
+        const size_t seq = pushes_sent[p]++;
+        if (p == rmi.procid()) {
+          apply_deltas(rmi.procid(), seq, clock, deltas);
+        } else {
+          rmi.remote_call(p, &ps_type::apply_deltas,
+                          rmi.procid(), seq, clock, deltas);
+        }
+      }
+    }
+
+    /**
+     * Owner side of a push. Empty deltas only carry the clock. The clock
+     * of the sender only advances once all of its earlier pushes have
+     * been applied too.
+     */
+    void apply_deltas(procid_t sender, size_t seq, size_t clock,
+                      const std::vector<T>& deltas) {
+      master_lock.lock();
+      for (size_t j = 0; j < deltas.size(); ++j) master[j] += deltas[j];
+      ++pushes_applied[sender];
+      pushes_seen[sender] = std::max(pushes_seen[sender], seq + 1);
+      latest_clock[sender] = std::max(latest_clock[sender], clock);
+      if (pushes_applied[sender] == pushes_seen[sender]) {
+        sender_clock[sender] = latest_clock[sender];
+      }
+      master_lock.unlock();
+    }
+
+    /// Owner side of a pull
+    range_reply read_range(procid_t requester, size_t begin, size_t end) {
+      const size_t b = begin - owned_begin(rmi.procid());
+      range_reply ret;
+      master_lock.lock();
+      ret.min_clock = *std::min_element(sender_clock.begin(), sender_clock.end());
+      ret.requester_pushes = pushes_applied[requester] == pushes_seen[requester] ?
+        pushes_applied[requester] : 0;
+      ret.values.assign(master.begin() + b, master.begin() + b + (end - begin));
+      master_lock.unlock();
+      return ret;
+    }
+
+    /**
+     * Reads [begin, end) from its owner p once every machine has
+     * reached min_clock there and the owner has applied every push of
+     * this machine, then writes the values plus the deltas buffered
+     * since the push into the cache. Returns the clock every machine
+     * had reached at the owner.
+     */
+    size_t pull_range(procid_t p, size_t begin, size_t end, size_t min_clock) {
+      range_reply result;
+      size_t backoff = 0;
+      while (1) {
+        if (p == rmi.procid()) {
+          result = read_range(rmi.procid(), begin, end);
+        } else {
+          result = rmi.remote_request(p, &ps_type::read_range,
+                                      rmi.procid(), begin, end);
+        }
+        if ((result.min_clock >= min_clock &&
+             result.requester_pushes >= pushes_sent[p]) || interrupted) break;
+        // wait for the slow machines, or for our own push to arrive
+        if (backoff < 10) ++backoff;
+        timer::sleep_ms(backoff);
+      }
+      // hold every buffer so that no add() is half way through
+      for (size_t k = 0; k < buffers.size(); ++k) buffers[k].lock.lock();
+      for (size_t i = begin; i < end; ++i) {
+        T value = result.values[i - begin];
+        for (size_t k = 0; k < buffers.size(); ++k) {
+          value += buffers[k].deltas[i];
+        }
+        cache[i].value = value;
+      }
+      for (size_t k = 0; k < buffers.size(); ++k) buffers[k].lock.unlock();
+      return result.min_clock;
+    }
+  }; // end of parameter_server
+
+} // end of namespace graphlab
+
+#endif
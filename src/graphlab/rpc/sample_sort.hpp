@@ -2,34 +2,250 @@
 #define GRAPHLAB_RPC_SAMPLE_SORT_HPP
 
 #include <vector>
+#include <string>
+#include <queue>
+#include <fstream>
 #include <algorithm>
 #include <utility>
+#include <boost/shared_ptr.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/type_traits/is_integral.hpp>
+#include <boost/type_traits/is_same.hpp>
+#include <boost/type_traits/is_signed.hpp>
+#include <boost/type_traits/make_unsigned.hpp>
 #include <graphlab/rpc/dc_dist_object.hpp>
 #include <graphlab/rpc/buffered_exchange.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/logger/assertions.hpp>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 namespace graphlab {
 
 namespace sample_sort_impl {
   template <typename Key, typename Value>
   struct pair_key_comparator {
     bool operator()(const std::pair<Key,Value>& k1,
-                    const std::pair<Key,Value>& k2) {
+                    const std::pair<Key,Value>& k2) const {
       return k1.first < k2.first;
     }
   };
-}
 
+  inline size_t num_sort_threads() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+  }
+
+  inline size_t sort_thread_id() {
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+  }
+
+  /// Arrays smaller than this are sorted with a single std::sort
+  const size_t PARALLEL_SORT_THRESHOLD = 1 << 16;
+
+  /**
+   * Sorts by key by sorting one block per thread in parallel, and then
+   * merging pairs of blocks in parallel.
+   */
+  template <typename Key, typename Value>
+  void parallel_comparison_sort(std::vector<std::pair<Key, Value> >& data) {
+    pair_key_comparator<Key, Value> comp;
+    const size_t nblocks = num_sort_threads();
+    if (nblocks <= 1 || data.size() < PARALLEL_SORT_THRESHOLD) {
+      std::sort(data.begin(), data.end(), comp);
+      return;
+    }
+    std::vector<size_t> bounds(nblocks + 1);
+    for (size_t i = 0; i <= nblocks; ++i) bounds[i] = data.size() * i / nblocks;
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (ssize_t b = 0; b < ssize_t(nblocks); ++b) {
+      std::sort(data.begin() + bounds[b], data.begin() + bounds[b + 1], comp);
+    }
+    for (size_t width = 1; width < nblocks; width *= 2) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (ssize_t b = 0; b < ssize_t(nblocks); b += 2 * width) {
+        if (size_t(b) + width >= nblocks) continue;
+        const size_t end = std::min(size_t(b) + 2 * width, nblocks);
+        std::inplace_merge(data.begin() + bounds[b],
+                           data.begin() + bounds[b + width],
+                           data.begin() + bounds[end], comp);
+      }
+    }
+  }
+
+  /**
+   * Parallel least significant digit radix sort on integer keys, one
+   * byte per pass. Each thread histograms and scatters its own
+   * contiguous block, so every pass is stable. Passes on bytes which are
+   * the same in all keys are skipped.
+   */
+  template <typename Key, typename Value>
+  void parallel_radix_sort(std::vector<std::pair<Key, Value> >& data) {
+    typedef typename boost::make_unsigned<Key>::type ukey_type;
+    const size_t nthreads = num_sort_threads();
+    if (data.size() < PARALLEL_SORT_THRESHOLD) {
+      std::sort(data.begin(), data.end(), pair_key_comparator<Key, Value>());
+      return;
+    }
+    // flipping the sign bit orders signed keys as unsigned ones
+    const ukey_type flip = boost::is_signed<Key>::value ?
+        ukey_type(ukey_type(1) << (8 * sizeof(Key) - 1)) : ukey_type(0);
+    const size_t n = data.size();
+    std::vector<size_t> bounds(nthreads + 1);
+    for (size_t i = 0; i <= nthreads; ++i) bounds[i] = n * i / nthreads;
+    std::vector<std::pair<Key, Value> > buffer(n);
+    std::vector<size_t> offsets(nthreads * 256);
+
+    for (size_t shift = 0; shift < 8 * sizeof(Key); shift += 8) {
+      std::fill(offsets.begin(), offsets.end(), 0);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (ssize_t t = 0; t < ssize_t(nthreads); ++t) {
+        size_t* count = &offsets[t * 256];
+        for (size_t i = bounds[t]; i < bounds[t + 1]; ++i) {
+          ++count[((ukey_type(data[i].first) ^ flip) >> shift) & 0xff];
+        }
+      }
+      // exclusive prefix sum in (digit, thread) order
+      size_t total = 0;
+      bool single_digit = false;
+      for (size_t d = 0; d < 256; ++d) {
+        const size_t digit_begin = total;
+        for (size_t t = 0; t < nthreads; ++t) {
+          const size_t c = offsets[t * 256 + d];
+          offsets[t * 256 + d] = total;
+          total += c;
+        }
+        if (total - digit_begin == n) single_digit = true;
+      }
+      if (single_digit) continue;
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (ssize_t t = 0; t < ssize_t(nthreads); ++t) {
+        size_t* offset = &offsets[t * 256];
+        for (size_t i = bounds[t]; i < bounds[t + 1]; ++i) {
+          buffer[offset[((ukey_type(data[i].first) ^ flip) >> shift) & 0xff]++] =
+              data[i];
+        }
+      }
+      data.swap(buffer);
+    }
+  }
+
+  template <typename Key, typename Value, bool IsInteger>
+  struct local_sorter {
+    static void sort(std::vector<std::pair<Key, Value> >& data) {
+      parallel_comparison_sort(data);
+    }
+  };
+
+  template <typename Key, typename Value>
+  struct local_sorter<Key, Value, true> {
+    static void sort(std::vector<std::pair<Key, Value> >& data) {
+      parallel_radix_sort(data);
+    }
+  };
+
+  /// Sorts by key, using the radix sort for integer keys.
+  template <typename Key, typename Value>
+  void local_sort(std::vector<std::pair<Key, Value> >& data) {
+    local_sorter<Key, Value,
+                 boost::is_integral<Key>::value &&
+                 !boost::is_same<Key, bool>::value>::sort(data);
+  }
+
+  /**
+   * Sequential reader over a sorted run spilled to disk.
+   */
+  template <typename Key, typename Value>
+  struct run_reader {
+    boost::shared_ptr<std::ifstream> fin;
+    boost::shared_ptr<iarchive> iarc;
+    size_t remaining;
+    std::pair<Key, Value> head;
+
+    run_reader(const std::string& fname, size_t length) :
+        fin(new std::ifstream(fname.c_str(), std::ios_base::binary)),
+        iarc(new iarchive(*fin)), remaining(length) {
+      ASSERT_TRUE(fin->good());
+    }
+    /// Reads the next entry into head. Returns false at the end of the run.
+    bool next() {
+      if (remaining == 0) return false;
+      (*iarc) >> head;
+      --remaining;
+      return true;
+    }
+  };
+} // namespace sample_sort_impl
+
+/**
+ * \ingroup rpc
+ * Distributed sample sort of key/value pairs.
+ *
+ * Splitters are picked from a sample of the keys, and every pair is
+ * shipped to the machine owning its key range. The shuffle runs on all
+ * threads, and the pairs received are drained from the exchange while
+ * the shuffle is still sending. The received pairs are sorted locally in
+ * parallel, with a radix sort when the key is an integer type.
+ *
+ * If a memory budget is given, the received pairs are sorted and spilled
+ * to disk in runs each time they exceed the budget. The runs are merged
+ * lazily: for_each_sorted() streams the merged pairs without holding
+ * them in memory, while result() loads them all back.
+ */
 template <typename Key, typename Value>
 class sample_sort {
  private:
   dc_dist_object<sample_sort<Key, Value> > rmi;
 
   typedef buffered_exchange<std::pair<Key, Value> > key_exchange_type;
+  typedef std::vector<std::pair<Key, Value> > buffer_type;
 
   key_exchange_type key_exchange;
-  std::vector<std::pair<Key, Value> > key_values;
+  buffer_type key_values;
+  mutex key_values_lock;
+
+  /// Maximum number of bytes of pairs to hold before spilling a run
+  size_t memory_budget;
+  std::string spill_directory;
+  /// Files and lengths of the runs spilled to disk
+  std::vector<std::pair<std::string, size_t> > runs;
+
+  /// Number of pairs sent between draining the exchange
+  static const size_t DRAIN_INTERVAL = 65536;
+
  public:
-  sample_sort(distributed_control& dc): rmi(dc, this), key_exchange(dc) { }
+  /**
+   * Constructs a sorter. If memory_budget is not (size_t)(-1), sorted
+   * runs are spilled to spill_directory (the system temporary directory
+   * if empty) whenever more than memory_budget bytes of pairs have been
+   * received.
+   */
+  sample_sort(distributed_control& dc,
+              size_t memory_budget = (size_t)(-1),
+              const std::string& spill_directory = ""):
+      rmi(dc, this),
+      key_exchange(dc, sample_sort_impl::num_sort_threads()),
+      memory_budget(memory_budget),
+      spill_directory(spill_directory) { }
+
+  ~sample_sort() {
+    clear_runs();
+  }
 
   template <typename KeyIterator, typename ValueIterator>
   void sort(KeyIterator kstart, KeyIterator kend,
@@ -41,8 +257,8 @@ class sample_sort {
 
     // we will sample k * p entries
     std::vector<std::vector<Key> > sampled_keys(rmi.numprocs());
-    for (size_t i = 0;i < 100 * rmi.numprocs(); ++i) {
-      size_t idx = (rand() % num_entries); 
+    for (size_t i = 0;num_entries > 0 && i < 100 * rmi.numprocs(); ++i) {
+      size_t idx = (rand() % num_entries);
       sampled_keys[rmi.procid()].push_back(*(kstart + idx));
     }
 
@@ -58,48 +274,149 @@ class sample_sort {
     std::vector<Key> ranges(rmi.numprocs());
     ranges[0] = Key();
     for(size_t i = 1; i < rmi.numprocs(); ++i) {
-      ranges[i] = all_sampled_keys[sampled_keys[0].size() * i];
-    }
-
-    // begin shuffle 
-    KeyIterator kiter = kstart;
-    ValueIterator viter = vstart;
-    if (rmi.numprocs() < 8) {
-      while(kiter != kend) {
-        procid_t target_machine = 0;
-        while (target_machine < rmi.numprocs() - 1  && 
-               ranges[target_machine + 1] < *kiter) ++target_machine;
-        key_exchange.send(target_machine, std::make_pair(*kiter, *viter));
-        ++kiter; ++viter;
-      }
-    } 
-    else {
-      while(kiter != kend) {
-        procid_t target_machine = 
-          std::upper_bound(ranges.begin(), ranges.end(), *kiter) 
-          - ranges.begin() - 1;
-        key_exchange.send(target_machine, std::make_pair(*kiter, *viter));
-        ++kiter; ++viter;
+      if (all_sampled_keys.empty()) ranges[i] = Key();
+      else ranges[i] = all_sampled_keys[all_sampled_keys.size() * i / rmi.numprocs()];
+    }
+
+    // begin shuffle. Each thread sends a contiguous block on its own
+    // lane of the exchange and periodically drains what was received.
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (ssize_t i = 0; i < ssize_t(num_entries); ++i) {
+      const size_t thread_id = sample_sort_impl::sort_thread_id();
+      const Key& key = *(kstart + i);
+      procid_t target_machine = 0;
+      if (rmi.numprocs() < 8) {
+        while (target_machine < rmi.numprocs() - 1  &&
+               ranges[target_machine + 1] < key) ++target_machine;
+      } else {
+        target_machine = std::upper_bound(ranges.begin(), ranges.end(), key)
+            - ranges.begin() - 1;
       }
+      key_exchange.send(target_machine, std::make_pair(key, *(vstart + i)),
+                        thread_id);
+      if (i % DRAIN_INTERVAL == 0) receive(true);
     }
     key_exchange.flush();
- 
-    // read from key exchange 
-    procid_t recvid;
-    typename key_exchange_type::buffer_type buffer;
-    while(key_exchange.recv(recvid, buffer)) {
-      std::copy(buffer.begin(), buffer.end(), 
-          std::inserter(key_values, key_values.end()));
-    }
-    std::sort(key_values.begin(), key_values.end(), 
-        sample_sort_impl::pair_key_comparator<Key,Value>());
+    receive(false);
 
+    if (runs.empty()) {
+      sample_sort_impl::local_sort(key_values);
+    } else {
+      if (!key_values.empty()) spill();
+      logstream(LOG_INFO) << "Spilled " << runs.size() << " sorted runs"
+                          << std::endl;
+    }
     rmi.barrier();
   }
 
+  /// Returns true if the sorted pairs were spilled to disk
+  bool spilled() const {
+    return !runs.empty();
+  }
+
+  /**
+   * Calls f(const std::pair<Key, Value>&) on every pair owned by this
+   * machine in sorted order. If the pairs were spilled, the runs are
+   * merged from disk.
+   */
+  template <typename Fn>
+  void for_each_sorted(Fn f) {
+    if (runs.empty()) {
+      for (size_t i = 0; i < key_values.size(); ++i) f(key_values[i]);
+      return;
+    }
+    typedef sample_sort_impl::run_reader<Key, Value> reader_type;
+    std::vector<reader_type> readers;
+    // min heap on (key, run)
+    typedef std::pair<Key, size_t> heap_entry;
+    std::priority_queue<heap_entry, std::vector<heap_entry>,
+                        std::greater<heap_entry> > heap;
+    for (size_t i = 0; i < runs.size(); ++i) {
+      readers.push_back(reader_type(runs[i].first, runs[i].second));
+      if (readers[i].next()) heap.push(heap_entry(readers[i].head.first, i));
+    }
+    while(!heap.empty()) {
+      const size_t r = heap.top().second;
+      heap.pop();
+      f(readers[r].head);
+      if (readers[r].next()) heap.push(heap_entry(readers[r].head.first, r));
+    }
+  }
+
+  /**
+   * Returns the sorted pairs owned by this machine. If the pairs were
+   * spilled to disk, they are merged back into memory first.
+   */
   std::vector<std::pair<Key, Value> >& result() {
+    if (!runs.empty()) {
+      logstream(LOG_WARNING) << "Loading " << runs.size()
+                             << " spilled runs back into memory" << std::endl;
+      buffer_type merged;
+      for_each_sorted(appender(merged));
+      clear_runs();
+      key_values.swap(merged);
+    }
     return key_values;
   }
+
+ private:
+  struct appender {
+    buffer_type* target;
+    appender(buffer_type& target) : target(&target) { }
+    void operator()(const std::pair<Key, Value>& kv) { target->push_back(kv); }
+  };
+
+  /**
+   * Moves the buffers received into key_values, spilling when the memory
+   * budget is exceeded. With try_lock, returns immediately if another
+   * thread is already receiving.
+   */
+  void receive(bool try_lock) {
+    if (try_lock) {
+      if (key_exchange.empty() || !key_values_lock.try_lock()) return;
+    } else {
+      key_values_lock.lock();
+    }
+    procid_t recvid;
+    typename key_exchange_type::buffer_type buffer;
+    while(key_exchange.recv(recvid, buffer, try_lock)) {
+      key_values.insert(key_values.end(), buffer.begin(), buffer.end());
+      if (memory_budget != (size_t)(-1) &&
+          key_values.size() * sizeof(std::pair<Key, Value>) > memory_budget) {
+        spill();
+      }
+    }
+    key_values_lock.unlock();
+  }
+
+  /// Sorts key_values and writes it to disk as a new run
+  void spill() {
+    namespace fs = boost::filesystem;
+    sample_sort_impl::local_sort(key_values);
+    const fs::path dir = spill_directory.empty() ?
+        fs::temp_directory_path() : fs::path(spill_directory);
+    const std::string fname =
+        (dir / fs::unique_path("graphlab_sort_" + tostr(rmi.procid()) +
+                               "_%%%%-%%%%-%%%%")).string();
+    std::ofstream fout(fname.c_str(), std::ios_base::binary);
+    ASSERT_TRUE(fout.good());
+    oarchive oarc(fout);
+    for (size_t i = 0; i < key_values.size(); ++i) oarc << key_values[i];
+    fout.flush();
+    ASSERT_FALSE(oarc.fail());
+    fout.close();
+    runs.push_back(std::make_pair(fname, key_values.size()));
+    buffer_type().swap(key_values);
+  }
+
+  void clear_runs() {
+    for (size_t i = 0; i < runs.size(); ++i) {
+      boost::filesystem::remove(runs[i].first);
+    }
+    runs.clear();
+  }
 };
 
 
@@ -63,7 +63,8 @@ namespace graphlab {
 
   private:
 
-    atomic_add_vector2<message_type> messages;
+    atomic_add_vector2<message_type,
+                       lock_free_combiner<message_type>::value> messages;
     std::vector<queue_type> queues;
     std::vector<spinlock>   locks;
     size_t multi;
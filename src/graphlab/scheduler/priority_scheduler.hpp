@@ -57,7 +57,8 @@ namespace graphlab {
     typedef mutable_queue<lvid_type, double> queue_type;
 
   private:
-    atomic_add_vector2<message_type> messages;
+    atomic_add_vector2<message_type,
+                       lock_free_combiner<message_type>::value> messages;
     std::vector<queue_type> queues;
     std::vector<spinlock>   locks;
     size_t multi;
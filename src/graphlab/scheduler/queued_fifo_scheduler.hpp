@@ -63,7 +63,8 @@ namespace graphlab {
     typedef std::deque<lvid_type> queue_type;
 
   private:
-    atomic_add_vector2<message_type> messages;
+    atomic_add_vector2<message_type,
+                       lock_free_combiner<message_type>::value> messages;
     std::deque<queue_type> master_queue;
     mutex master_lock;
     size_t sub_queue_size;
@@ -58,7 +58,8 @@ namespace graphlab {
     std::vector<uint16_t>                   vid2cpu;
     std::vector<lvid_type>             cpu2index;
 
-    atomic_add_vector2<message_type>         messages;
+    atomic_add_vector2<message_type,
+                       lock_free_combiner<message_type>::value> messages;
     double                                  min_priority;
     std::string                             ordering;
 
@@ -0,0 +1,345 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_BLOCKED_MULTINOMIAL_HPP
+#define GRAPHLAB_BLOCKED_MULTINOMIAL_HPP
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+#include <algorithm>
+#include <graphlab/util/random.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util_internal
+   * \brief A multinomial over a fixed set of categories whose weights
+   * change over time, stored as a 16-ary sum tree.
+   *
+   * Every node of the tree holds the sums of its 16 children in one
+   * 64 byte block, aligned to a cache line. An update rewrites a leaf
+   * and then recomputes one block per level from its children, and a
+   * sample reads one block per level. With 16 children per node the
+   * tree of a few thousand categories has 3 levels instead of the 12
+   * of a binary tree, so each operation touches 3 cache lines rather
+   * than 12. The sums over a block are simple loops over 16 contiguous
+   * floats which the compiler vectorizes. Since the parents are
+   * recomputed rather than adjusted by a delta, rounding errors never
+   * accumulate in the tree.
+   *
+   * Unlike fast_multinomial, the class is not thread safe. Updates can
+   * be made in batches with set() and add() over arrays, which
+   * recompute each dirty block once. For parallel accumulation, give
+   * each thread its own instance of the same size and periodically
+   * merge() them into a shared instance:
+   *
+   * \code
+   * blocked_multinomial local(ncategories);
+   * // ... local.add(category, weight) ...
+   * shared_lock.lock();
+   * shared.merge(local);
+   * shared_lock.unlock();
+   * local.clear();
+   * \endcode
+   */
+  class blocked_multinomial {
+  public:
+    /// The number of children of each node: one cache line of floats
+    static const size_t FANOUT = 16;
+
+    blocked_multinomial(size_t num_asg = 0) : num_asg(0), data(NULL) {
+      resize(num_asg);
+    }
+
+    blocked_multinomial(const blocked_multinomial& other)
+      : num_asg(0), data(NULL) {
+      *this = other;
+    }
+
+    blocked_multinomial& operator=(const blocked_multinomial& other) {
+      if (this == &other) return *this;
+      resize(other.num_asg);
+      if (total_blocks > 0) {
+        memcpy(data, other.data, total_blocks * FANOUT * sizeof(float));
+      }
+      num_support = other.num_support;
+      return *this;
+    }
+
+    ~blocked_multinomial() { free(data); }
+
+    /// Resizes to num_asg categories, all with weight zero
+    void resize(size_t num_asg) {
+      free(data);
+      data = NULL;
+      this->num_asg = num_asg;
+      level_offset.clear();
+      level_blocks.clear();
+      total_blocks = 0;
+      num_support = 0;
+      if (num_asg == 0) return;
+      // level 0 holds the leaves, and the last level the root block
+      size_t nblocks = (num_asg + FANOUT - 1) / FANOUT;
+      while (true) {
+        level_offset.push_back(total_blocks * FANOUT);
+        level_blocks.push_back(nblocks);
+        total_blocks += nblocks;
+        if (nblocks == 1) break;
+        nblocks = (nblocks + FANOUT - 1) / FANOUT;
+      }
+      void* ptr = NULL;
+      if (posix_memalign(&ptr, FANOUT * sizeof(float),
+                         total_blocks * FANOUT * sizeof(float)) != 0) {
+        throw std::bad_alloc();
+      }
+      data = static_cast<float*>(ptr);
+      dirty.assign(total_blocks, false);
+      clear();
+    }
+
+    /// Sets every weight to zero
+    void clear() {
+      if (total_blocks > 0) {
+        std::fill(data, data + total_blocks * FANOUT, 0.0f);
+      }
+      num_support = 0;
+    }
+
+    /// Returns the number of categories
+    size_t size() const { return num_asg; }
+
+    /// Returns the number of categories with positive weight
+    size_t positive_support() const { return num_support; }
+
+    /// Returns the sum of all the weights
+    float total() const {
+      return num_asg == 0 ? 0 : block_sum(level(levels() - 1));
+    }
+
+    float get_weight(size_t asg) const {
+      ASSERT_LT(asg, num_asg);
+      return data[asg];
+    }
+
+    bool has_support(size_t asg) const { return get_weight(asg) > 0; }
+
+    /// Sets the weight of a category
+    void set(size_t asg, float value) {
+      set_leaf(asg, value);
+      propagate(asg / FANOUT);
+    }
+
+    /// Adds to the weight of a category, which may not become negative
+    void add(size_t asg, float value) {
+      ASSERT_LT(asg, num_asg);
+      set(asg, std::max(data[asg] + value, 0.0f));
+    }
+
+    /**
+     * Sets the weights of n categories. Each block of the tree is
+     * recomputed once however many of its leaves changed.
+     */
+    void set(const size_t* asgs, const float* values, size_t n) {
+      for (size_t i = 0; i < n; ++i) set_leaf(asgs[i], values[i]);
+      propagate_batch(asgs, n);
+    }
+
+    /// Adds to the weights of n categories
+    void add(const size_t* asgs, const float* values, size_t n) {
+      for (size_t i = 0; i < n; ++i) {
+        ASSERT_LT(asgs[i], num_asg);
+        set_leaf(asgs[i], std::max(data[asgs[i]] + values[i], 0.0f));
+      }
+      propagate_batch(asgs, n);
+    }
+
+    /**
+     * Adds the weights of another instance of the same size to this
+     * one. The sums of the whole tree are rebuilt, so a merge costs
+     * about as much as touching every leaf once.
+     */
+    void merge(const blocked_multinomial& other) {
+      ASSERT_EQ(num_asg, other.num_asg);
+      if (num_asg == 0) return;
+      const size_t nleaves = level_blocks[0] * FANOUT;
+      for (size_t i = 0; i < nleaves; ++i) data[i] += other.data[i];
+      num_support = 0;
+      for (size_t i = 0; i < num_asg; ++i) num_support += (data[i] > 0);
+      rebuild();
+    }
+
+    /**
+     * Draws a category with probability proportional to its weight
+     * given a number u uniformly distributed in [0, 1). Returns false
+     * if every weight is zero.
+     */
+    bool sample(double u, size_t& ret_asg) const {
+      if (num_asg == 0) return false;
+      const float root_total = total();
+      if (!(root_total > 0)) return false;
+      float target = float(u * root_total);
+      size_t block = 0;
+      for (size_t l = levels(); l > 0; --l) {
+        const size_t child = choose_child(level(l - 1) + block * FANOUT, target);
+        block = block * FANOUT + child;
+      }
+      ASSERT_LT(block, num_asg);
+      ret_asg = block;
+      return true;
+    }
+
+    /// Draws a category using the thread local random source
+    bool sample(size_t& ret_asg) const {
+      return sample(random::rand01(), ret_asg);
+    }
+
+    /**
+     * Draws n categories, one for each of the uniform numbers in
+     * us. Returns false if every weight is zero.
+     */
+    bool sample(const double* us, size_t* ret_asgs, size_t n) const {
+      for (size_t i = 0; i < n; ++i) {
+        if (!sample(us[i], ret_asgs[i])) return false;
+      }
+      return true;
+    }
+
+    /**
+     * Draws a category and sets its weight to zero. Returns false if
+     * every weight is zero.
+     */
+    bool pop(size_t& ret_asg) {
+      if (!sample(ret_asg)) return false;
+      set(ret_asg, 0);
+      return true;
+    }
+
+  private:
+    size_t num_asg;
+    /// All the levels, one after another, leaves first
+    float* data;
+    /// The offset of each level in data
+    std::vector<size_t> level_offset;
+    /// The number of blocks on each level
+    std::vector<size_t> level_blocks;
+    size_t total_blocks;
+    size_t num_support;
+    /// Scratch space of the batched updates: a flag for every block,
+    /// and the flagged blocks of the current and of the next level
+    std::vector<bool> dirty;
+    std::vector<size_t> dirty_blocks, next_dirty_blocks;
+
+    size_t levels() const { return level_offset.size(); }
+    float* level(size_t l) { return data + level_offset[l]; }
+    const float* level(size_t l) const { return data + level_offset[l]; }
+
+    static float block_sum(const float* block) {
+      float sum = 0;
+      for (size_t i = 0; i < FANOUT; ++i) sum += block[i];
+      return sum;
+    }
+
+    /**
+     * Returns the child of a block in which target falls, and
+     * subtracts the weight of the children before it from target.
+     */
+    static size_t choose_child(const float* block, float& target) {
+      float prefix[FANOUT];
+      float sum = 0;
+      for (size_t i = 0; i < FANOUT; ++i) { sum += block[i]; prefix[i] = sum; }
+      // the number of children whose prefix sum does not exceed target
+      size_t child = 0;
+      for (size_t i = 0; i < FANOUT; ++i) child += (prefix[i] <= target);
+      // rounding can carry target past the last positive child
+      while (child > 0 && (child == FANOUT || block[child] == 0)) --child;
+      while (block[child] == 0 && child + 1 < FANOUT) ++child;
+      target -= (child > 0 ? prefix[child - 1] : 0);
+      target = std::min(std::max(target, 0.0f), block[child]);
+      return child;
+    }
+
+    void set_leaf(size_t asg, float value) {
+      ASSERT_LT(asg, num_asg);
+      ASSERT_GE(value, 0.0f);
+      const float old_value = data[asg];
+      if (old_value == 0 && value > 0) ++num_support;
+      else if (old_value > 0 && value == 0) --num_support;
+      data[asg] = value;
+    }
+
+    /// Recomputes the ancestors of a leaf block
+    void propagate(size_t block) {
+      for (size_t l = 0; l + 1 < levels(); ++l) {
+        level(l + 1)[block] = block_sum(level(l) + block * FANOUT);
+        block /= FANOUT;
+      }
+    }
+
+    /// Recomputes the ancestors of the leaves asgs[0..n)
+    void propagate_batch(const size_t* asgs, size_t n) {
+      if (levels() == 0) return;
+      dirty_blocks.clear();
+      for (size_t i = 0; i < n; ++i) mark_dirty(0, asgs[i] / FANOUT);
+      for (size_t l = 0; l + 1 < levels(); ++l) {
+        const size_t base = level_offset[l] / FANOUT;
+        next_dirty_blocks.clear();
+        for (size_t i = 0; i < dirty_blocks.size(); ++i) {
+          const size_t b = dirty_blocks[i];
+          dirty[base + b] = false;
+          level(l + 1)[b] = block_sum(level(l) + b * FANOUT);
+          mark_dirty(l + 1, b / FANOUT, next_dirty_blocks);
+        }
+        dirty_blocks.swap(next_dirty_blocks);
+      }
+      // the root block has no parent to recompute
+      const size_t root_base = level_offset[levels() - 1] / FANOUT;
+      for (size_t i = 0; i < dirty_blocks.size(); ++i) {
+        dirty[root_base + dirty_blocks[i]] = false;
+      }
+    }
+
+    void mark_dirty(size_t l, size_t b) { mark_dirty(l, b, dirty_blocks); }
+
+    void mark_dirty(size_t l, size_t b, std::vector<size_t>& blocks) {
+      const size_t index = level_offset[l] / FANOUT + b;
+      if (!dirty[index]) {
+        dirty[index] = true;
+        blocks.push_back(b);
+      }
+    }
+
+    /// Recomputes every internal level from the leaves
+    void rebuild() {
+      for (size_t l = 0; l + 1 < levels(); ++l) {
+        for (size_t b = 0; b < level_blocks[l]; ++b) {
+          level(l + 1)[b] = block_sum(level(l) + b * FANOUT);
+        }
+      }
+    }
+  }; // end of blocked_multinomial
+
+} // end of namespace
+
+#endif
@@ -0,0 +1,247 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_UTIL_CONCURRENT_HOPSCOTCH_MAP_HPP
+#define GRAPHLAB_UTIL_CONCURRENT_HOPSCOTCH_MAP_HPP
+
+#include <utility>
+#include <graphlab/util/hopscotch_map.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+
+namespace graphlab {
+
+  /**
+   * A hash map which is safe for concurrent reads, writes and
+   * read-modify-writes from any number of threads.
+   *
+   * The keys are partitioned over a fixed number of shards, each an
+   * unsynchronized hopscotch_map guarded by its own reader-writer
+   * lock. Readers of a shard do not block each other, writers only
+   * block the shard they write to, and a shard which fills up rehashes
+   * under its own write lock while all the other shards remain
+   * available. The locks block rather than spin, so the map degrades
+   * gracefully when there are more threads than cores.
+   * update_sync() applies a functor to a value under the shard lock,
+   * which makes read-modify-write updates (such as adding to a count)
+   * atomic without any external lock.
+   *
+   * Only the functions suffixed with _sync are safe for parallel
+   * access. clear(), for_each() and serialization require exclusive
+   * access to the map.
+   *
+   * \tparam Key The key of the map
+   * \tparam Value The value to store for each key
+   * \tparam Hash The hash functor type. Defaults to boost::hash<Key>
+   * \tparam KeyEqual The functor used to identify object equality.
+   */
+  template <typename Key,
+            typename Value,
+            typename Hash = _HOPSCOTCH_MAP_DEFAULT_HASH,
+            typename KeyEqual = std::equal_to<Key> >
+  class concurrent_hopscotch_map {
+  public:
+    typedef Key                                      key_type;
+    typedef Value                                    mapped_type;
+    typedef std::pair<Key, Value>                    value_type;
+    typedef hopscotch_map<Key, Value, false, Hash, KeyEqual> shard_map_type;
+
+  private:
+    struct shard_type {
+      rwlock lock;
+      shard_map_type map;
+      // keep the locks of neighboring shards on different cache lines
+      char padding[64];
+    };
+
+    shard_type* shards;
+    size_t num_shards;
+    Hash hashfun;
+
+    /**
+     * Selects a shard from the high bits of a multiplicative hash, so
+     * that the shards and the hopscotch tables within each shard use
+     * different bits of the key.
+     */
+    size_t shard_id(const key_type& k) const {
+      const uint64_t h = uint64_t(hashfun(k)) * 0x9E3779B97F4A7C15ULL;
+      return (h >> 32) & (num_shards - 1);
+    }
+
+    /** Not copyable */
+    concurrent_hopscotch_map(const concurrent_hopscotch_map&);
+    void operator=(const concurrent_hopscotch_map&);
+
+    template <typename ValueRef>
+    struct assign_functor {
+      ValueRef value;
+      assign_functor(ValueRef value) : value(value) { }
+      void operator()(mapped_type& v) const { v = value; }
+    };
+
+  public:
+    /**
+     * Constructs a map with num_shards shards. The number is rounded up
+     * to a power of two and bounds the number of writers which can
+     * proceed in parallel.
+     */
+    explicit concurrent_hopscotch_map(size_t num_shards = 64,
+                                      Hash hashfun = Hash()) :
+        hashfun(hashfun) {
+      this->num_shards = 1;
+      while (this->num_shards < num_shards) this->num_shards *= 2;
+      shards = new shard_type[this->num_shards];
+    }
+
+    ~concurrent_hopscotch_map() {
+      delete [] shards;
+    }
+
+    /** Inserts the key, overwriting any existing value. */
+    void put_sync(const key_type& k, const mapped_type& v) {
+      update_sync(k, assign_functor<const mapped_type&>(v));
+    }
+
+    /**
+     * Returns {true, V} where V is the value of the key if the key is in
+     * the map, and {false, Value()} otherwise.
+     */
+    std::pair<bool, mapped_type> get_sync(const key_type& k) const {
+      const shard_type& shard = shards[shard_id(k)];
+      std::pair<bool, mapped_type> ret(false, mapped_type());
+      shard.lock.readlock();
+      typename shard_map_type::const_iterator iter = shard.map.find(k);
+      if (iter != shard.map.end()) {
+        ret.first = true;
+        ret.second = iter->second;
+      }
+      shard.lock.unlock();
+      return ret;
+    }
+
+    /** Returns true if the key is in the map */
+    bool contains_sync(const key_type& k) const {
+      const shard_type& shard = shards[shard_id(k)];
+      shard.lock.readlock();
+      const bool ret = shard.map.count(k) > 0;
+      shard.lock.unlock();
+      return ret;
+    }
+
+    /**
+     * Calls f(Value&) on the value of the key, atomically with respect to
+     * all other _sync accesses of the key. If the key is not in the map,
+     * it is first inserted with a default constructed value. Returns
+     * true if the key was inserted.
+     */
+    template <typename UpdateFunctor>
+    bool update_sync(const key_type& k, UpdateFunctor f) {
+      shard_type& shard = shards[shard_id(k)];
+      shard.lock.writelock();
+      typename shard_map_type::iterator iter = shard.map.find(k);
+      const bool inserted = (iter == shard.map.end());
+      if (inserted) {
+        iter = shard.map.insert(value_type(k, mapped_type())).first;
+      }
+      f(iter->second);
+      shard.lock.unlock();
+      return inserted;
+    }
+
+    /** Removes the key. Returns false if the key was not in the map. */
+    bool erase_sync(const key_type& k) {
+      shard_type& shard = shards[shard_id(k)];
+      shard.lock.writelock();
+      const bool ret = shard.map.erase(k);
+      shard.lock.unlock();
+      return ret;
+    }
+
+    /** Returns the number of entries. Safe under parallel access. */
+    size_t size_sync() const {
+      size_t ret = 0;
+      for (size_t i = 0; i < num_shards; ++i) {
+        shards[i].lock.readlock();
+        ret += shards[i].map.size();
+        shards[i].lock.unlock();
+      }
+      return ret;
+    }
+
+    /** Returns the number of entries */
+    size_t size() const {
+      size_t ret = 0;
+      for (size_t i = 0; i < num_shards; ++i) ret += shards[i].map.size();
+      return ret;
+    }
+
+    /** Returns the total capacity of the shards */
+    size_t capacity() const {
+      size_t ret = 0;
+      for (size_t i = 0; i < num_shards; ++i) ret += shards[i].map.capacity();
+      return ret;
+    }
+
+    float load_factor() const {
+      return float(size()) / capacity();
+    }
+
+    /** Removes all entries. Not safe under parallel access. */
+    void clear() {
+      for (size_t i = 0; i < num_shards; ++i) shards[i].map.clear();
+    }
+
+    /**
+     * Calls f(const Key&, Value&) on every entry. Not safe under
+     * parallel access.
+     */
+    template <typename Functor>
+    void for_each(Functor f) {
+      for (size_t i = 0; i < num_shards; ++i) {
+        typename shard_map_type::iterator iter = shards[i].map.begin();
+        for (; iter != shards[i].map.end(); ++iter) f(iter->first, iter->second);
+      }
+    }
+
+    void save(oarchive& oarc) const {
+      oarc << size();
+      for (size_t i = 0; i < num_shards; ++i) {
+        typename shard_map_type::const_iterator iter = shards[i].map.begin();
+        for (; iter != shards[i].map.end(); ++iter) oarc << *iter;
+      }
+    }
+
+    void load(iarchive& iarc) {
+      clear();
+      size_t s;
+      iarc >> s;
+      for (size_t i = 0; i < s; ++i) {
+        value_type v;
+        iarc >> v;
+        shards[shard_id(v.first)].map.insert(v);
+      }
+    }
+  }; // end of concurrent_hopscotch_map
+
+} // end of graphlab namespace
+
+#endif
@@ -0,0 +1,343 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_UTIL_COUNTER_RANDOM_HPP
+#define GRAPHLAB_UTIL_COUNTER_RANDOM_HPP
+
+#include <stdint.h>
+#include <cmath>
+#include <vector>
+#include <boost/type_traits/is_floating_point.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+  namespace random {
+
+    /**
+     * \ingroup random
+     * \brief The Philox4x32-10 counter based bijection.
+     *
+     * Maps a 128 bit counter and a 64 bit key to 128 random bits
+     * (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3").
+     * There is no state to carry from one draw to the next: the n-th
+     * block of a stream is simply the bijection of n, so any number of
+     * threads can draw from the same stream in any order.
+     */
+    struct philox4x32 {
+      static const uint32_t M0 = 0xD2511F53;
+      static const uint32_t M1 = 0xCD9E8D57;
+      static const uint32_t W0 = 0x9E3779B9;
+      static const uint32_t W1 = 0xBB67AE85;
+      static const size_t ROUNDS = 10;
+
+      /// Writes the bijection of ctr under key to out
+      static inline void bijection(const uint32_t ctr[4],
+                                   const uint32_t key[2],
+                                   uint32_t out[4]) {
+        uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+        uint32_t k0 = key[0], k1 = key[1];
+        for (size_t r = 0; r < ROUNDS; ++r) {
+          const uint64_t p0 = uint64_t(M0) * c0;
+          const uint64_t p1 = uint64_t(M1) * c2;
+          c0 = uint32_t(p1 >> 32) ^ c1 ^ k0;
+          c1 = uint32_t(p1);
+          c2 = uint32_t(p0 >> 32) ^ c3 ^ k1;
+          c3 = uint32_t(p0);
+          k0 += W0; k1 += W1;
+        }
+        out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+      }
+    }; // end of philox4x32
+
+
+    namespace counter_random_impl {
+      /// Converts 64 random bits to a double in [0, 1)
+      inline double to_unit(uint64_t bits) {
+        return double(bits >> 11) * (1.0 / 9007199254740992.0);
+      }
+
+      template <typename NumType, bool IsFloat>
+      struct uniform {
+        template <typename Generator>
+        static NumType sample(Generator& gen, NumType min, NumType max) {
+          const uint64_t range = uint64_t(max - min) + 1;
+          // a range of 0 is the full 64 bits
+          return range == 0 ? NumType(gen.next64()) :
+              NumType(min + NumType(gen.next64() % range));
+        }
+      };
+      template <typename NumType>
+      struct uniform<NumType, true> {
+        template <typename Generator>
+        static NumType sample(Generator& gen, NumType min, NumType max) {
+          return min + NumType((max - min) * gen.rand01());
+        }
+      };
+    } // end of counter_random_impl
+
+
+    /**
+     * \ingroup random
+     * \brief A reproducible random number generator keyed by a seed, a
+     * stream and an iteration.
+     *
+     * The numbers drawn depend only on the (seed, stream, iteration)
+     * triple and on how many numbers were drawn before, never on which
+     * thread or machine draws them or when. Keying the stream by a
+     * vertex or edge id and the iteration by the super-step therefore
+     * makes a sampler reproducible under any schedule and any number of
+     * machines. Construction is a handful of stores, so the generator is
+     * meant to be created on the stack wherever it is needed:
+     *
+     * \code
+     * random::counter_generator gen(random::counter_seed(),
+     *                               vertex.id(), context.iteration());
+     * const size_t topic = table.sample(gen.rand01());
+     * \endcode
+     *
+     * fill_uniform() and fill_normal() generate whole arrays at once.
+     * They compute the counter blocks in structure of arrays form,
+     * which the compiler turns into SIMD code.
+     *
+     * Each (seed, stream, iteration) triple yields 2^34 numbers before
+     * the stream wraps.
+     */
+    class counter_generator {
+    public:
+      /// The number of counter blocks computed together in the batch calls
+      static const size_t BATCH_BLOCKS = 8;
+
+      counter_generator(uint64_t seed, uint64_t stream,
+                        uint32_t iteration = 0) {
+        key[0] = uint32_t(seed); key[1] = uint32_t(seed >> 32);
+        ctr[0] = uint32_t(stream); ctr[1] = uint32_t(stream >> 32);
+        ctr[2] = iteration; ctr[3] = 0;
+        pos = 4;
+        has_spare_normal = false;
+      }
+
+      /// Returns 32 random bits
+      inline uint32_t next32() {
+        if (pos == 4) refill();
+        return buffer[pos++];
+      }
+
+      /// Returns 64 random bits
+      inline uint64_t next64() {
+        const uint64_t hi = next32();
+        return (hi << 32) | next32();
+      }
+
+      /// Returns a double uniformly distributed in [0, 1)
+      inline double rand01() {
+        return counter_random_impl::to_unit(next64());
+      }
+
+      /**
+       * Returns a number uniformly distributed in [min, max) for real
+       * types and in [min, max] for integral types. Integral draws take
+       * a 64 bit draw modulo the range, which is unbiased to within
+       * range / 2^64.
+       */
+      template <typename NumType>
+      inline NumType uniform(const NumType min, const NumType max) {
+        return counter_random_impl::uniform<NumType,
+            boost::is_floating_point<NumType>::value>::sample(*this, min, max);
+      }
+
+      inline bool bernoulli(const double p = double(0.5)) {
+        return rand01() < p;
+      }
+
+      /// Returns a normal draw, generated in pairs by Box-Muller
+      inline double normal(const double mean = double(0),
+                           const double stdev = double(1)) {
+        if (has_spare_normal) {
+          has_spare_normal = false;
+          return mean + stdev * spare_normal;
+        }
+        double z0, z1;
+        box_muller(1.0 - rand01(), rand01(), z0, z1);
+        spare_normal = z1; has_spare_normal = true;
+        return mean + stdev * z0;
+      }
+
+      /// Fills out[0..n) with doubles uniformly distributed in [0, 1)
+      void fill_uniform(double* out, size_t n) {
+        // each block of 4 words yields 2 doubles
+        uint32_t words[4 * BATCH_BLOCKS];
+        size_t i = 0;
+        while (i < n) {
+          next_batch(words);
+          for (size_t j = 0; j < 2 * BATCH_BLOCKS && i < n; ++j, ++i) {
+            const uint64_t bits = (uint64_t(words[2 * j]) << 32) |
+                words[2 * j + 1];
+            out[i] = counter_random_impl::to_unit(bits);
+          }
+        }
+      }
+
+      /// Fills out[0..n) with normal draws of the given mean and stdev
+      void fill_normal(double* out, size_t n,
+                       const double mean = double(0),
+                       const double stdev = double(1)) {
+        fill_uniform(out, n);
+        for (size_t i = 0; i + 1 < n; i += 2) {
+          double z0, z1;
+          box_muller(1.0 - out[i], out[i + 1], z0, z1);
+          out[i] = mean + stdev * z0;
+          out[i + 1] = mean + stdev * z1;
+        }
+        if (n % 2 == 1) out[n - 1] = normal(mean, stdev);
+      }
+
+    private:
+      uint32_t key[2];
+      uint32_t ctr[4];
+      uint32_t buffer[4];
+      size_t pos;
+      double spare_normal;
+      bool has_spare_normal;
+
+      inline void refill() {
+        philox4x32::bijection(ctr, key, buffer);
+        ++ctr[3];
+        pos = 0;
+      }
+
+      /**
+       * Computes the next BATCH_BLOCKS blocks into words. The loops
+       * below run the rounds of all the blocks side by side with no
+       * dependence between the lanes.
+       */
+      void next_batch(uint32_t words[4 * BATCH_BLOCKS]) {
+        uint32_t c0[BATCH_BLOCKS], c1[BATCH_BLOCKS];
+        uint32_t c2[BATCH_BLOCKS], c3[BATCH_BLOCKS];
+        for (size_t b = 0; b < BATCH_BLOCKS; ++b) {
+          c0[b] = ctr[0]; c1[b] = ctr[1]; c2[b] = ctr[2];
+          c3[b] = ctr[3] + uint32_t(b);
+        }
+        uint32_t k0 = key[0], k1 = key[1];
+        for (size_t r = 0; r < philox4x32::ROUNDS; ++r) {
+          for (size_t b = 0; b < BATCH_BLOCKS; ++b) {
+            const uint64_t p0 = uint64_t(philox4x32::M0) * c0[b];
+            const uint64_t p1 = uint64_t(philox4x32::M1) * c2[b];
+            c0[b] = uint32_t(p1 >> 32) ^ c1[b] ^ k0;
+            c1[b] = uint32_t(p1);
+            c2[b] = uint32_t(p0 >> 32) ^ c3[b] ^ k1;
+            c3[b] = uint32_t(p0);
+          }
+          k0 += philox4x32::W0; k1 += philox4x32::W1;
+        }
+        for (size_t b = 0; b < BATCH_BLOCKS; ++b) {
+          words[4 * b] = c0[b]; words[4 * b + 1] = c1[b];
+          words[4 * b + 2] = c2[b]; words[4 * b + 3] = c3[b];
+        }
+        ctr[3] += BATCH_BLOCKS;
+        pos = 4;
+      }
+
+      /// u0 must be in (0, 1]
+      static inline void box_muller(double u0, double u1,
+                                    double& z0, double& z1) {
+        const double r = std::sqrt(-2.0 * std::log(u0));
+        const double theta = 2.0 * M_PI * u1;
+        z0 = r * std::cos(theta);
+        z1 = r * std::sin(theta);
+      }
+    }; // end of counter_generator
+
+
+    /**
+     * \ingroup random
+     * \brief An alias table for O(1) draws from a fixed multinomial.
+     *
+     * Building the table from n weights takes O(n) time (Vose's
+     * method), after which every draw takes a single uniform number, a
+     * table lookup and a comparison, instead of the linear scan of
+     * random::multinomial() or the binary search of
+     * random::multinomial_cdf(). Use it when many draws are made from
+     * the same distribution. The weights need not be normalized.
+     */
+    class alias_table {
+    public:
+      alias_table() { }
+
+      template <typename Double>
+      explicit alias_table(const std::vector<Double>& weights) {
+        build(weights);
+      }
+
+      template <typename Double>
+      void build(const std::vector<Double>& weights) {
+        const size_t n = weights.size();
+        ASSERT_GT(n, size_t(0));
+        double sum = 0;
+        for (size_t i = 0; i < n; ++i) {
+          const double weight = weights[i];
+          ASSERT_GE(weight, 0.0); // Each entry must be P[i] >= 0
+          sum += weight;
+        }
+        ASSERT_GT(sum, 0.0); // Normalizer must be positive
+        prob.resize(n);
+        alias.resize(n);
+        // scale so that the average bucket holds exactly 1
+        std::vector<uint32_t> small, large;
+        for (size_t i = 0; i < n; ++i) {
+          prob[i] = double(weights[i]) * n / sum;
+          alias[i] = uint32_t(i);
+          if (prob[i] < 1.0) small.push_back(uint32_t(i));
+          else large.push_back(uint32_t(i));
+        }
+        while (!small.empty() && !large.empty()) {
+          const uint32_t s = small.back(); small.pop_back();
+          const uint32_t l = large.back();
+          alias[s] = l;
+          prob[l] -= 1.0 - prob[s];
+          if (prob[l] < 1.0) { large.pop_back(); small.push_back(l); }
+        }
+        // whatever remains is 1 up to rounding
+        for (size_t i = 0; i < small.size(); ++i) prob[small[i]] = 1.0;
+        for (size_t i = 0; i < large.size(); ++i) prob[large[i]] = 1.0;
+      }
+
+      /// Returns the number of categories
+      size_t size() const { return prob.size(); }
+
+      /// Draws a category given a number uniformly distributed in [0, 1)
+      inline size_t sample(const double u) const {
+        const double scaled = u * prob.size();
+        size_t bucket = size_t(scaled);
+        if (bucket >= prob.size()) bucket = prob.size() - 1;
+        return (scaled - bucket) < prob[bucket] ? bucket : alias[bucket];
+      }
+
+    private:
+      /// The probability of keeping each bucket rather than its alias
+      std::vector<double> prob;
+      std::vector<uint32_t> alias;
+    }; // end of alias_table
+
+  } // end of random
+} // end of graphlab
+
+#endif
@@ -132,7 +132,7 @@ namespace graphlab {
     }
  
     //! Returns the value of the word containing the bit b 
-    inline size_t containing_word(size_t b) {
+    inline size_t containing_word(size_t b) const {
       size_t arrpos, bitpos;
       bit_to_pos(b, arrpos, bitpos);
       return array[arrpos];
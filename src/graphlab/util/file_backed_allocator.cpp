@@ -0,0 +1,436 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+#include <graphlab/util/file_backed_allocator.hpp>
+#include <graphlab/util/huge_page_allocator.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/logger/logger.hpp>
+
+namespace graphlab {
+  namespace file_backed_memory {
+
+    namespace {
+      static const size_t ALIGNMENT = 16;
+      /// Requests below this many bytes are carved out of chunks
+      static const size_t MAX_SMALL = CHUNK_SIZE / 4;
+      static const size_t NUM_SHARDS = 16;
+      static const size_t NUM_CLASSES = 80;
+      /// The address space reserved for chunks, halved until it fits
+      static const size_t MAX_RESERVE = size_t(1) << 40;
+
+      struct free_block {
+        free_block* next;
+      };
+
+      /**
+       * Rounds a small request up to its size class and returns the
+       * class: multiples of 16 bytes up to 256 bytes, then four classes
+       * per power of two, so at most a quarter of a block is wasted.
+       */
+      size_t size_class(size_t bytes, size_t& length) {
+        if (bytes <= 256) {
+          length = std::max((bytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1), ALIGNMENT);
+          return length / ALIGNMENT - 1;
+        }
+        // 2^p < bytes <= 2^(p + 1)
+        const size_t p = 8 * sizeof(unsigned long) - 1 - __builtin_clzl(bytes - 1);
+        const size_t step = size_t(1) << (p - 2);
+        length = (bytes + step - 1) & ~(step - 1);
+        return 16 + (p - 8) * 4 + (length / step - 5);
+      }
+
+      /// The block length of a size class
+      size_t class_length(size_t c) {
+        if (c < 16) return (c + 1) * ALIGNMENT;
+        const size_t p = 8 + (c - 16) / 4;
+        return (5 + (c - 16) % 4) * (size_t(1) << (p - 2));
+      }
+
+      /**
+       * The chunk small requests of some of the threads are carved
+       * from, and the blocks freed by those threads, one list per size
+       * class.
+       */
+      struct shard_type {
+        mutex lock;
+        char* chunk;
+        size_t chunk_offset;
+        free_block* free_list[NUM_CLASSES];
+        char padding[64];
+        shard_type() : chunk(NULL), chunk_offset(0) {
+          for (size_t c = 0; c < NUM_CLASSES; ++c) free_list[c] = NULL;
+        }
+      };
+
+      struct state_type {
+        /// Protects the directory, the large mappings and the chunk slots
+        mutex lock;
+        std::string directory;
+        /// True while the directory is set, read without the lock
+        volatile bool enabled;
+        volatile readahead_type readahead;
+        /// The mappings of large requests, keyed by their first byte
+        std::map<char*, size_t> large;
+        /**
+         * The address range reserved for the chunks, in CHUNK_SIZE
+         * slots. Set once, so a pointer is in a chunk if it is in the
+         * range.
+         */
+        char* volatile region;
+        size_t num_slots;
+        std::vector<bool> slot_mapped;
+        /// Bytes carved from the chunk of each slot, written under the
+        /// lock of the shard carving it
+        std::vector<size_t> carved;
+        std::vector<size_t> free_slots;
+        size_t next_slot;
+        size_t mapped;
+        volatile size_t nmappings;
+        bool warned;
+        shard_type shards[NUM_SHARDS];
+        state_type() : enabled(false), readahead(RANDOM), region(NULL),
+                       num_slots(0), next_slot(0), mapped(0), nmappings(0),
+                       warned(false) { }
+      };
+
+      state_type& state() {
+        static state_type* s = new state_type;
+        return *s;
+      }
+
+      size_t page_size() {
+        static const size_t size = sysconf(_SC_PAGESIZE);
+        return size;
+      }
+
+      int advice_of(readahead_type readahead) {
+        switch (readahead) {
+        case SEQUENTIAL: return MADV_SEQUENTIAL;
+        case RANDOM: return MADV_RANDOM;
+        default: return MADV_NORMAL;
+        }
+      }
+
+      shard_type& my_shard(state_type& s) {
+        const unsigned long long h =
+            (unsigned long long)pthread_self() * 0x9E3779B97F4A7C15ULL;
+        return s.shards[(h >> 32) % NUM_SHARDS];
+      }
+
+      bool in_region(const state_type& s, const char* ptr) {
+        const char* region = s.region;
+        return region != NULL && ptr >= region &&
+               ptr < region + s.num_slots * CHUNK_SIZE;
+      }
+
+      size_t slot_of(const state_type& s, const char* ptr) {
+        return (ptr - s.region) / CHUNK_SIZE;
+      }
+
+      /// Gives a slot of the region back to the reservation
+      void unmap_slot(state_type& s, size_t slot) {
+        mmap(s.region + slot * CHUNK_SIZE, CHUNK_SIZE, PROT_NONE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+      }
+
+      /**
+       * Maps length bytes of a new unlinked file in the directory, at
+       * fixed if it is not NULL, or returns NULL. Must be called with
+       * the lock held.
+       */
+      char* map_file(state_type& s, size_t length, char* fixed = NULL) {
+        std::string path = s.directory + "/graphlab_mem_XXXXXX";
+        std::vector<char> name(path.begin(), path.end());
+        name.push_back('\0');
+        const int fd = mkstemp(&name[0]);
+        if (fd < 0) return NULL;
+        unlink(&name[0]);
+        void* ptr = MAP_FAILED;
+        if (ftruncate(fd, length) == 0) {
+          ptr = mmap(fixed, length, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | (fixed != NULL ? MAP_FIXED : 0), fd, 0);
+        }
+        // the mapping keeps the file alive
+        close(fd);
+        if (ptr == MAP_FAILED) return NULL;
+        madvise(ptr, length, advice_of(s.readahead));
+        return static_cast<char*>(ptr);
+      }
+
+      /// Reserves the region of the chunks. Must be called with the lock held
+      bool reserve(state_type& s) {
+        for (size_t bytes = MAX_RESERVE; bytes >= 16 * CHUNK_SIZE; bytes /= 2) {
+          void* ptr = mmap(NULL, bytes, PROT_NONE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+          if (ptr == MAP_FAILED) continue;
+          s.num_slots = bytes / CHUNK_SIZE;
+          s.slot_mapped.assign(s.num_slots, false);
+          s.carved.assign(s.num_slots, 0);
+          // the slots are set up before the region is visible to in_region()
+          __sync_synchronize();
+          s.region = static_cast<char*>(ptr);
+          return true;
+        }
+        return false;
+      }
+
+      /// Maps a chunk in a free slot, or returns NULL. Must be called
+      /// with the lock held
+      char* new_chunk(state_type& s) {
+        if (s.region == NULL && !reserve(s)) return NULL;
+        size_t slot;
+        if (!s.free_slots.empty()) {
+          slot = s.free_slots.back();
+          s.free_slots.pop_back();
+        } else if (s.next_slot < s.num_slots) {
+          slot = s.next_slot++;
+        } else {
+          return NULL;
+        }
+        char* chunk = map_file(s, CHUNK_SIZE, s.region + slot * CHUNK_SIZE);
+        if (chunk == NULL) {
+          // a failed fixed mapping may have dropped the reservation
+          unmap_slot(s, slot);
+          s.free_slots.push_back(slot);
+          return NULL;
+        }
+        s.slot_mapped[slot] = true;
+        s.carved[slot] = 0;
+        s.mapped += CHUNK_SIZE;
+        ++s.nmappings;
+        return chunk;
+      }
+
+      /**
+       * Unmaps the chunks all of whose carved blocks are in the free
+       * lists, and drops those blocks from the lists. Must be called
+       * with the lock and all the shard locks held, after the shards
+       * have given up their current chunks.
+       */
+      void release_free_chunks(state_type& s) {
+        if (s.region == NULL) return;
+        std::vector<size_t> free_bytes(s.num_slots, 0);
+        for (size_t i = 0; i < NUM_SHARDS; ++i) {
+          for (size_t c = 0; c < NUM_CLASSES; ++c) {
+            for (free_block* b = s.shards[i].free_list[c]; b != NULL; b = b->next) {
+              free_bytes[slot_of(s, reinterpret_cast<char*>(b))] += class_length(c);
+            }
+          }
+        }
+        std::vector<bool> released(s.num_slots, false);
+        for (size_t slot = 0; slot < s.num_slots; ++slot) {
+          released[slot] = s.slot_mapped[slot] && free_bytes[slot] == s.carved[slot];
+        }
+        // the lists run through the chunks, so drop their blocks first
+        for (size_t i = 0; i < NUM_SHARDS; ++i) {
+          for (size_t c = 0; c < NUM_CLASSES; ++c) {
+            free_block** link = &s.shards[i].free_list[c];
+            while (*link != NULL) {
+              if (released[slot_of(s, reinterpret_cast<char*>(*link))]) {
+                *link = (*link)->next;
+              } else {
+                link = &(*link)->next;
+              }
+            }
+          }
+        }
+        for (size_t slot = 0; slot < s.num_slots; ++slot) {
+          if (!released[slot]) continue;
+          unmap_slot(s, slot);
+          s.slot_mapped[slot] = false;
+          s.free_slots.push_back(slot);
+          s.mapped -= CHUNK_SIZE;
+          --s.nmappings;
+        }
+      }
+
+      void warn_once(state_type& s) {
+        if (!s.warned) {
+          logstream(LOG_WARNING) << "Unable to map a file in " << s.directory
+                                 << ". Falling back to the default allocator."
+                                 << std::endl;
+          s.warned = true;
+        }
+      }
+
+      char* allocate_large(state_type& s, size_t bytes) {
+        s.lock.lock();
+        char* ptr = NULL;
+        if (!s.directory.empty()) {
+          const size_t length = (bytes + page_size() - 1) & ~(page_size() - 1);
+          ptr = map_file(s, length);
+          if (ptr != NULL) {
+            s.large[ptr] = length;
+            s.mapped += length;
+            ++s.nmappings;
+          } else {
+            warn_once(s);
+          }
+        }
+        s.lock.unlock();
+        return ptr;
+      }
+
+      /**
+       * Takes a block of the size class from the free list of the
+       * thread's shard, or carves it from the shard's chunk.
+       */
+      char* allocate_small(state_type& s, size_t bytes) {
+        size_t length;
+        const size_t c = size_class(bytes, length);
+        shard_type& sh = my_shard(s);
+        sh.lock.lock();
+        char* ptr = reinterpret_cast<char*>(sh.free_list[c]);
+        if (ptr != NULL) {
+          sh.free_list[c] = sh.free_list[c]->next;
+          sh.lock.unlock();
+          return ptr;
+        }
+        if (sh.chunk == NULL || sh.chunk_offset + length > CHUNK_SIZE) {
+          s.lock.lock();
+          sh.chunk = NULL;
+          if (!s.directory.empty()) {
+            sh.chunk = new_chunk(s);
+            if (sh.chunk == NULL) warn_once(s);
+          }
+          s.lock.unlock();
+          sh.chunk_offset = 0;
+        }
+        if (sh.chunk != NULL) {
+          ptr = sh.chunk + sh.chunk_offset;
+          sh.chunk_offset += length;
+          s.carved[slot_of(s, ptr)] += length;
+        }
+        sh.lock.unlock();
+        return ptr;
+      }
+    } // end of anonymous namespace
+
+
+    void set_directory(const std::string& directory) {
+      state_type& s = state();
+      for (size_t i = 0; i < NUM_SHARDS; ++i) s.shards[i].lock.lock();
+      s.lock.lock();
+      s.directory = directory;
+      s.enabled = !directory.empty();
+      // new chunks go to the new directory
+      for (size_t i = 0; i < NUM_SHARDS; ++i) s.shards[i].chunk = NULL;
+      release_free_chunks(s);
+      s.lock.unlock();
+      for (size_t i = 0; i < NUM_SHARDS; ++i) s.shards[i].lock.unlock();
+    }
+
+    std::string get_directory() {
+      state_type& s = state();
+      s.lock.lock();
+      const std::string ret = s.directory;
+      s.lock.unlock();
+      return ret;
+    }
+
+    void set_readahead(readahead_type readahead) {
+      state().readahead = readahead;
+    }
+
+    readahead_type get_readahead() {
+      return state().readahead;
+    }
+
+    bool parse_readahead(const std::string& str, readahead_type& readahead) {
+      if (str == "normal") readahead = NORMAL;
+      else if (str == "sequential") readahead = SEQUENTIAL;
+      else if (str == "random") readahead = RANDOM;
+      else return false;
+      return true;
+    }
+
+    void* allocate(size_t bytes) {
+      state_type& s = state();
+      if (!s.enabled || bytes == 0) return huge_pages::allocate(bytes);
+      char* ptr = bytes >= MAX_SMALL ? allocate_large(s, bytes)
+                                     : allocate_small(s, bytes);
+      return ptr != NULL ? ptr : huge_pages::allocate(bytes);
+    }
+
+    void deallocate(void* ptr, size_t bytes) {
+      if (ptr == NULL) return;
+      state_type& s = state();
+      if (s.nmappings > 0) {
+        char* cptr = static_cast<char*>(ptr);
+        if (bytes < MAX_SMALL) {
+          if (in_region(s, cptr)) {
+            size_t length;
+            const size_t c = size_class(bytes, length);
+            shard_type& sh = my_shard(s);
+            free_block* b = reinterpret_cast<free_block*>(cptr);
+            sh.lock.lock();
+            b->next = sh.free_list[c];
+            sh.free_list[c] = b;
+            sh.lock.unlock();
+            return;
+          }
+        } else {
+          s.lock.lock();
+          std::map<char*, size_t>::iterator iter = s.large.find(cptr);
+          if (iter != s.large.end()) {
+            munmap(iter->first, iter->second);
+            s.mapped -= iter->second;
+            --s.nmappings;
+            s.large.erase(iter);
+            s.lock.unlock();
+            return;
+          }
+          s.lock.unlock();
+        }
+      }
+      huge_pages::deallocate(ptr, bytes);
+    }
+
+    void prefetch(const void* ptr, size_t bytes) {
+      if (state().nmappings == 0 || bytes == 0) return;
+      const uintptr_t start = reinterpret_cast<uintptr_t>(ptr);
+      const uintptr_t begin = start & ~uintptr_t(page_size() - 1);
+      madvise(reinterpret_cast<void*>(begin), start + bytes - begin,
+              MADV_WILLNEED);
+    }
+
+    bool has_mappings() {
+      return state().nmappings > 0;
+    }
+
+    size_t mapped_bytes() {
+      state_type& s = state();
+      s.lock.lock();
+      const size_t ret = s.mapped;
+      s.lock.unlock();
+      return ret;
+    }
+
+  } // end of file_backed_memory
+} // end of graphlab namespace
@@ -0,0 +1,162 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_UTIL_FILE_BACKED_ALLOCATOR_HPP
+#define GRAPHLAB_UTIL_FILE_BACKED_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <string>
+
+namespace graphlab {
+
+  /**
+   * \brief Placement of arrays in memory mapped files.
+   *
+   * When a directory is set, memory allocated through
+   * file_backed_memory::allocate() (usually by way of
+   * file_backed_allocator) is a shared mapping of a file created in
+   * that directory and unlinked right away. The kernel then writes the
+   * pages back to the file and drops them under memory pressure instead
+   * of swapping them, so the mapped arrays may exceed the physical
+   * memory. The files disappear when the memory is freed or the
+   * process exits.
+   *
+   * Requests of at least CHUNK_SIZE / 4 bytes get a mapping of their
+   * own. Smaller requests, such as the per edge vectors of the edge
+   * data, are rounded up to a size class and served by one of several
+   * shards, picked by the calling thread, so that threads rarely wait
+   * for each other. A shard first reuses a block of the class from its
+   * free list, and otherwise carves the block out of its current
+   * CHUNK_SIZE byte mapped chunk by advancing an offset. Freed blocks
+   * go to the free list of the freeing thread's shard. The chunks are
+   * kept while the directory is set; when it changes, the chunks all
+   * of whose blocks are free are unmapped.
+   *
+   * Without a directory, which is the default, the requests are passed
+   * on to huge_pages::allocate(). A file which cannot be created or
+   * mapped also falls back to huge_pages::allocate() with a warning.
+   * The directory and the readahead may be changed at any time, and
+   * only apply to the memory allocated afterwards.
+   */
+  namespace file_backed_memory {
+    /**
+     * How the kernel reads ahead the pages of a mapping on a fault.
+     * \li \c NORMAL The default readahead of the kernel.
+     * \li \c SEQUENTIAL Aggressive readahead, and pages are dropped
+     *        soon after they are read. Suits arrays read in the order
+     *        they are stored, such as edge data in CSR order.
+     * \li \c RANDOM No readahead. Suits arrays read in an order
+     *        unrelated to their layout, such as edge data in CSC order,
+     *        when the readahead is issued through prefetch() instead.
+     *        This is the default, since the engines prefetch the edge
+     *        data in both orders, and the readahead of random faults
+     *        evicts more useful pages than it brings in.
+     */
+    enum readahead_type { NORMAL, SEQUENTIAL, RANDOM };
+
+    static const size_t CHUNK_SIZE = 64 * 1024 * 1024;
+
+    /// Sets the directory of the files. An empty string disables them.
+    void set_directory(const std::string& directory);
+    std::string get_directory();
+
+    void set_readahead(readahead_type readahead);
+    readahead_type get_readahead();
+
+    /**
+     * Parses "normal", "sequential" or "random" into readahead.
+     * Returns false if the string is not one of them.
+     */
+    bool parse_readahead(const std::string& str, readahead_type& readahead);
+
+    void* allocate(size_t bytes);
+    /// bytes must be the size passed to allocate()
+    void deallocate(void* ptr, size_t bytes);
+
+    /**
+     * Asks the kernel to start reading the pages of [ptr, ptr + bytes)
+     * which are not resident, without waiting for them. Does nothing if
+     * there are no file backed mappings.
+     */
+    void prefetch(const void* ptr, size_t bytes);
+
+    /// Returns true if any memory is currently file backed
+    bool has_mappings();
+
+    /// Returns the number of bytes currently mapped from files
+    size_t mapped_bytes();
+  } // end of file_backed_memory
+
+
+  /**
+   * \brief An STL allocator placing its memory in memory mapped files
+   * according to the file_backed_memory settings.
+   *
+   * Used for the edge data array of the graph storage, so that graphs
+   * whose edge data exceeds the memory can be loaded, and may also be
+   * used by edge data types which hold containers of their own.
+   */
+  template <typename T>
+  class file_backed_allocator {
+  public:
+    typedef T         value_type;
+    typedef T*        pointer;
+    typedef const T*  const_pointer;
+    typedef T&        reference;
+    typedef const T&  const_reference;
+    typedef size_t    size_type;
+    typedef ptrdiff_t difference_type;
+    template <typename U> struct rebind { typedef file_backed_allocator<U> other; };
+
+    file_backed_allocator() { }
+    template <typename U> file_backed_allocator(const file_backed_allocator<U>&) { }
+
+    pointer address(reference x) const { return &x; }
+    const_pointer address(const_reference x) const { return &x; }
+    size_type max_size() const {
+      return std::numeric_limits<size_type>::max() / sizeof(T);
+    }
+
+    pointer allocate(size_type n, const void* = 0) {
+      return static_cast<pointer>(file_backed_memory::allocate(n * sizeof(T)));
+    }
+    void deallocate(pointer p, size_type n) {
+      file_backed_memory::deallocate(p, n * sizeof(T));
+    }
+    void construct(pointer p, const T& val) { new (p) T(val); }
+    void destroy(pointer p) { p->~T(); }
+  }; // end of file_backed_allocator
+
+  template <typename T, typename U>
+  bool operator==(const file_backed_allocator<T>&, const file_backed_allocator<U>&) {
+    return true;
+  }
+  template <typename T, typename U>
+  bool operator!=(const file_backed_allocator<T>&, const file_backed_allocator<U>&) {
+    return false;
+  }
+
+} // end of graphlab namespace
+
+#endif
@@ -0,0 +1,112 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_FUSED_REDUCTION_HPP
+#define GRAPHLAB_FUSED_REDUCTION_HPP
+
+#include <graphlab/serialization/oarchive.hpp>
+#include <graphlab/serialization/iarchive.hpp>
+
+namespace graphlab {
+
+  /**
+   * \brief The result of two reductions computed in a single pass.
+   *
+   * A fused_reduction sums each of its two members with their own
+   * operator+=. It is the reduction type of the map functions built by
+   * fuse_maps(). Further reductions may be fused by nesting, for
+   * instance fused_reduction<float, fused_reduction<size_t, double> >.
+   */
+  template <typename T1, typename T2>
+  struct fused_reduction {
+    T1 first;
+    T2 second;
+    fused_reduction() : first(), second() { }
+    fused_reduction(const T1& first, const T2& second)
+      : first(first), second(second) { }
+
+    fused_reduction& operator+=(const fused_reduction& other) {
+      first += other.first;
+      second += other.second;
+      return *this;
+    }
+
+    void save(oarchive& oarc) const {
+      oarc << first << second;
+    }
+
+    void load(iarchive& iarc) {
+      iarc >> first >> second;
+    }
+  };
+
+
+  /**
+   * \brief A map function which evaluates two map functions on the same
+   * argument and returns both results in a fused_reduction.
+   *
+   * Both the graph map functions, which take only a vertex or an edge,
+   * and the engine map functions, which also take a context, are
+   * supported.
+   */
+  template <typename T1, typename T2, typename F1, typename F2>
+  struct fused_map {
+    typedef fused_reduction<T1, T2> result_type;
+    F1 f1;
+    F2 f2;
+    fused_map(F1 f1, F2 f2) : f1(f1), f2(f2) { }
+
+    template <typename ArgType>
+    result_type operator()(ArgType& arg) const {
+      return result_type(f1(arg), f2(arg));
+    }
+
+    template <typename ContextType, typename ArgType>
+    result_type operator()(ContextType& context, ArgType& arg) const {
+      return result_type(f1(context, arg), f2(context, arg));
+    }
+  };
+
+
+  /**
+   * \brief Combines two map functions so that both reductions are
+   * computed in a single pass over the graph.
+   *
+   * For instance, to compute the sum and the number of non-zero vertex
+   * values in one call to map_reduce_vertices():
+   * \code
+   * typedef graphlab::fused_reduction<double, size_t> result_type;
+   * result_type r = graph.map_reduce_vertices<result_type>(
+   *                   graphlab::fuse_maps<double, size_t>(vertex_value,
+   *                                                       is_nonzero));
+   * double sum = r.first;
+   * size_t nnz = r.second;
+   * \endcode
+   */
+  template <typename T1, typename T2, typename F1, typename F2>
+  fused_map<T1, T2, F1, F2> fuse_maps(F1 f1, F2 f2) {
+    return fused_map<T1, T2, F1, F2>(f1, f2);
+  }
+
+} // namespace graphlab
+#endif
@@ -41,10 +41,10 @@ namespace graphlab {
  * targets must be the same size as the container
  * Both the container and the targets vector will be modified.
  */
-template <typename Iterator, typename sizetype>
+template <typename Iterator, typename sizetype, typename Alloc>
 void inplace_shuffle(Iterator begin,
                      Iterator end, 
-                     std::vector<sizetype> &targets) {
+                     std::vector<sizetype, Alloc> &targets) {
   size_t len = std::distance(begin, end);
   assert(len == targets.size());
   
@@ -76,9 +76,9 @@ void inplace_shuffle(Iterator begin,
  * newcont[i] = cont[targets[i]]
  * targets must be the same size as the container
  */
-template <typename Container, typename sizetype>
+template <typename Container, typename sizetype, typename Alloc>
 void outofplace_shuffle(Container &c,
-                        const std::vector<sizetype> &targets) {  
+                        const std::vector<sizetype, Alloc> &targets) {  
   Container result(targets.size());
 #ifdef _OPENMP
 #pragma omp parallel for
@@ -0,0 +1,174 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#include <sys/mman.h>
+#include <stdint.h>
+#include <map>
+#include <graphlab/util/huge_page_allocator.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/logger/logger.hpp>
+
+namespace graphlab {
+  namespace huge_pages {
+
+    namespace {
+      /// A mapping made by allocate(): where it starts and how long it is
+      struct mapping_type {
+        void* base;
+        size_t length;
+      };
+
+      struct state_type {
+        volatile policy_type policy;
+        mutex lock;
+        /// The mappings, keyed by the pointer returned to the caller
+        std::map<void*, mapping_type> mappings;
+        size_t mapped;
+        bool warned;
+        state_type() : policy(NONE), mapped(0), warned(false) { }
+      };
+
+      state_type& state() {
+        static state_type* s = new state_type;
+        return *s;
+      }
+
+      size_t round_up(size_t bytes) {
+        return (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+      }
+
+      /// Maps length bytes from the hugetlbfs pool, or returns false
+      bool map_explicit(size_t length, mapping_type& m) {
+#ifdef MAP_HUGETLB
+        void* ptr = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr == MAP_FAILED) return false;
+        m.base = ptr; m.length = length;
+        return true;
+#else
+        return false;
+#endif
+      }
+
+      /**
+       * Maps length bytes aligned to a huge page and advises the kernel
+       * to back them with transparent huge pages, or returns false.
+       */
+      bool map_transparent(size_t length, mapping_type& m) {
+#ifdef MADV_HUGEPAGE
+        // over-allocate by a huge page and trim to an aligned range
+        const size_t padded = length + HUGE_PAGE_SIZE;
+        void* ptr = mmap(NULL, padded, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) return false;
+        const uintptr_t start = reinterpret_cast<uintptr_t>(ptr);
+        const uintptr_t aligned = (start + HUGE_PAGE_SIZE - 1) &
+                                  ~uintptr_t(HUGE_PAGE_SIZE - 1);
+        const size_t head = aligned - start;
+        const size_t tail = padded - head - length;
+        if (head > 0) munmap(ptr, head);
+        if (tail > 0) munmap(reinterpret_cast<void*>(aligned + length), tail);
+        m.base = reinterpret_cast<void*>(aligned); m.length = length;
+        // madvise only fails if THP is compiled out, in which case the
+        // mapping is still perfectly usable
+        madvise(m.base, length, MADV_HUGEPAGE);
+        return true;
+#else
+        return false;
+#endif
+      }
+    } // end of anonymous namespace
+
+
+    void set_policy(policy_type policy) {
+      state().policy = policy;
+    }
+
+    policy_type get_policy() {
+      return state().policy;
+    }
+
+    bool parse_policy(const std::string& str, policy_type& policy) {
+      if (str == "none") policy = NONE;
+      else if (str == "transparent") policy = TRANSPARENT;
+      else if (str == "explicit") policy = EXPLICIT;
+      else return false;
+      return true;
+    }
+
+    void* allocate(size_t bytes) {
+      state_type& s = state();
+      const policy_type policy = s.policy;
+      if (policy == NONE || bytes < HUGE_PAGE_SIZE) {
+        return ::operator new(bytes);
+      }
+      const size_t length = round_up(bytes);
+      mapping_type m;
+      bool mapped = (policy == EXPLICIT) && map_explicit(length, m);
+      if (!mapped) mapped = map_transparent(length, m);
+      if (!mapped) {
+        s.lock.lock();
+        if (!s.warned) {
+          logstream(LOG_WARNING) << "Unable to map huge pages. "
+                                 << "Falling back to the default allocator."
+                                 << std::endl;
+          s.warned = true;
+        }
+        s.lock.unlock();
+        return ::operator new(bytes);
+      }
+      s.lock.lock();
+      s.mappings[m.base] = m;
+      s.mapped += m.length;
+      s.lock.unlock();
+      return m.base;
+    }
+
+    void deallocate(void* ptr, size_t bytes) {
+      if (ptr == NULL) return;
+      if (bytes >= HUGE_PAGE_SIZE) {
+        state_type& s = state();
+        s.lock.lock();
+        std::map<void*, mapping_type>::iterator iter = s.mappings.find(ptr);
+        if (iter != s.mappings.end()) {
+          const mapping_type m = iter->second;
+          s.mappings.erase(iter);
+          s.mapped -= m.length;
+          s.lock.unlock();
+          munmap(m.base, m.length);
+          return;
+        }
+        s.lock.unlock();
+      }
+      ::operator delete(ptr);
+    }
+
+    size_t mapped_bytes() {
+      state_type& s = state();
+      s.lock.lock();
+      const size_t ret = s.mapped;
+      s.lock.unlock();
+      return ret;
+    }
+
+  } // end of huge_pages
+} // end of graphlab namespace
@@ -0,0 +1,126 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_UTIL_HUGE_PAGE_ALLOCATOR_HPP
+#define GRAPHLAB_UTIL_HUGE_PAGE_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <string>
+
+namespace graphlab {
+
+  /**
+   * \brief Placement of large arrays on huge pages.
+   *
+   * Arrays of at least HUGE_PAGE_SIZE bytes allocated through
+   * huge_pages::allocate() (usually by way of huge_page_allocator) are
+   * mapped according to a process wide policy:
+   *
+   * \li \c NONE Plain operator new. This is the default.
+   * \li \c TRANSPARENT A huge page aligned anonymous mapping, marked
+   *        with madvise(MADV_HUGEPAGE) before it is touched, so that the
+   *        kernel backs it with transparent huge pages where it can.
+   * \li \c EXPLICIT A mapping from the hugetlbfs pool (MAP_HUGETLB).
+   *        Falls back to TRANSPARENT when the pool is exhausted.
+   *
+   * Any policy falls back to operator new when the platform does not
+   * support it, so the policy only ever changes performance. Smaller
+   * arrays always use operator new, since they would waste most of a
+   * huge page. The policy may be changed at any time, and only applies
+   * to the arrays allocated afterwards.
+   */
+  namespace huge_pages {
+    enum policy_type { NONE, TRANSPARENT, EXPLICIT };
+
+    static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    void set_policy(policy_type policy);
+    policy_type get_policy();
+
+    /**
+     * Parses "none", "transparent" or "explicit" into policy. Returns
+     * false if the string is not one of them.
+     */
+    bool parse_policy(const std::string& str, policy_type& policy);
+
+    void* allocate(size_t bytes);
+    /// bytes must be the size passed to allocate()
+    void deallocate(void* ptr, size_t bytes);
+
+    /// Returns the number of bytes currently mapped by the policies
+    size_t mapped_bytes();
+  } // end of huge_pages
+
+
+  /**
+   * \brief An STL allocator placing large arrays on huge pages
+   * according to the huge_pages policy.
+   *
+   * Used for the arrays of the graph storage and the per-vertex arrays
+   * of the synchronous engine, which are large, long lived and read at
+   * random, so that their TLB reach covers far more of the array.
+   */
+  template <typename T>
+  class huge_page_allocator {
+  public:
+    typedef T         value_type;
+    typedef T*        pointer;
+    typedef const T*  const_pointer;
+    typedef T&        reference;
+    typedef const T&  const_reference;
+    typedef size_t    size_type;
+    typedef ptrdiff_t difference_type;
+    template <typename U> struct rebind { typedef huge_page_allocator<U> other; };
+
+    huge_page_allocator() { }
+    template <typename U> huge_page_allocator(const huge_page_allocator<U>&) { }
+
+    pointer address(reference x) const { return &x; }
+    const_pointer address(const_reference x) const { return &x; }
+    size_type max_size() const {
+      return std::numeric_limits<size_type>::max() / sizeof(T);
+    }
+
+    pointer allocate(size_type n, const void* = 0) {
+      return static_cast<pointer>(huge_pages::allocate(n * sizeof(T)));
+    }
+    void deallocate(pointer p, size_type n) {
+      huge_pages::deallocate(p, n * sizeof(T));
+    }
+    void construct(pointer p, const T& val) { new (p) T(val); }
+    void destroy(pointer p) { p->~T(); }
+  }; // end of huge_page_allocator
+
+  template <typename T, typename U>
+  bool operator==(const huge_page_allocator<T>&, const huge_page_allocator<U>&) {
+    return true;
+  }
+  template <typename T, typename U>
+  bool operator!=(const huge_page_allocator<T>&, const huge_page_allocator<U>&) {
+    return false;
+  }
+
+} // end of graphlab namespace
+
+#endif
@@ -90,6 +90,9 @@ namespace graphlab {
 
 
 
+    /// Keeps the counter source from sharing the state of the master
+    const size_t COUNTER_SALT = size_t(0x9e3779b97f4a7c15ULL);
+
     /**
      * This class represents a master registery of all active random
      * number generators
@@ -97,22 +100,50 @@ namespace graphlab {
     struct source_registry {
       std::set<generator*> generators;
       generator master;
+      /**
+       * Seeded alongside the master but never drawn from by the thread
+       * generators, so that drawing the counter key does not shift
+       * their streams.
+       */
+      generator counter_source;
+      uint64_t counter_key;
       mutex mut;
 
+      source_registry() { redraw_counter_key(); }
+
       static source_registry& global() {
         static source_registry registry;
         return registry;
       }
+
+      /**
+       * Draw the counter generator seed from the counter source
+       */
+      void redraw_counter_key() {
+        const uint32_t max32 = std::numeric_limits<uint32_t>::max();
+        counter_key =
+            (uint64_t(counter_source.uniform<uint32_t>(0, max32)) << 32) |
+            counter_source.uniform<uint32_t>(0, max32);
+      }
+
+      uint64_t counter_seed() {
+        mut.lock();
+        const uint64_t ret = counter_key;
+        mut.unlock();
+        return ret;
+      }
       /**
        * Seed all threads using the default seed
        */
       void seed() {
         mut.lock();
         master.seed();
+        counter_source.seed(COUNTER_SALT);
         foreach(generator* generator, generators) {
           ASSERT_TRUE(generator != NULL);
           generator->seed(master);
         }
+        redraw_counter_key();
         mut.unlock();
       }
 
@@ -122,10 +153,12 @@ namespace graphlab {
       void nondet_seed() {
         mut.lock();
         master.nondet_seed();
+        counter_source.nondet_seed();
         foreach(generator* generator, generators) {
           ASSERT_TRUE(generator != NULL);
           generator->seed(master);
         }
+        redraw_counter_key();
         mut.unlock();
       }
 
@@ -136,10 +169,12 @@ namespace graphlab {
       void time_seed() {
         mut.lock();
         master.time_seed();
+        counter_source.seed(timer::usec_of_day() ^ COUNTER_SALT);
         foreach(generator* generator, generators) {
           ASSERT_TRUE(generator != NULL);
           generator->seed(master);
         }
+        redraw_counter_key();
         mut.unlock();
       }
 
@@ -150,10 +185,12 @@ namespace graphlab {
       void seed(const size_t number) {
         mut.lock();
         master.seed(number);
+        counter_source.seed(number ^ COUNTER_SALT);
         foreach(generator* generator, generators) {
           ASSERT_TRUE(generator != NULL);
           generator->seed(master);
         }
+        redraw_counter_key();
         mut.unlock();
       }
       
@@ -269,6 +306,8 @@ namespace graphlab {
       source_registry::global().seed(seed_value);  
     } 
 
+    uint64_t counter_seed() { return source_registry::global().counter_seed(); }
+
 
     void generator::nondet_seed() {
       // Get the global nondeterministic random number generator.
@@ -35,6 +35,7 @@
 #include <boost/random.hpp>
 #include <graphlab/util/timer.hpp>
 #include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/util/counter_random.hpp>
 
 namespace graphlab {
 
@@ -350,6 +351,15 @@ namespace graphlab {
     void time_seed();
     
 
+    /**
+     * \ingroup random
+     * Returns a 64 bit seed for counter_generator. It is redrawn
+     * whenever the generators are reseeded, so seed(n) makes the
+     * counter generators reproducible as well, without changing the
+     * streams of the thread generators.
+     */
+    uint64_t counter_seed();
+
     /**
      * \ingroup random
      * Get the local generator
@@ -457,6 +467,15 @@ namespace graphlab {
       return get_source().multinomial_cdf(cdf);
     }
 
+    /**
+     * \ingroup random
+     * Generate a draw from a multinomial in constant time using a
+     * prebuilt alias table.
+     */
+    inline size_t multinomial(const alias_table& table) {
+      return table.sample(rand01());
+    }
+
 
 
     /** 
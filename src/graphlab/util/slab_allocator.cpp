@@ -0,0 +1,318 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#include <pthread.h>
+#include <cstdlib>
+#include <vector>
+#include <graphlab/util/slab_allocator.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/util/branch_hints.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+
+  namespace slab_allocator_impl {
+
+    struct free_block {
+      free_block* next;
+    };
+
+    /// The per thread free lists
+    struct thread_cache {
+      free_block* head[slab_allocator::NUM_CLASSES];
+      size_t length[slab_allocator::NUM_CLASSES];
+      thread_cache() {
+        for (size_t i = 0; i < slab_allocator::NUM_CLASSES; ++i) {
+          head[i] = NULL; length[i] = 0;
+        }
+      }
+    };
+
+    /// The shared depot of batches of BATCH_SIZE blocks, one per class
+    struct depot_type {
+      simple_spinlock lock[slab_allocator::NUM_CLASSES];
+      std::vector<free_block*> batches[slab_allocator::NUM_CLASSES];
+      atomic<size_t> reserved;
+    };
+
+    static depot_type& depot() {
+      static depot_type* d = new depot_type;
+      return *d;
+    }
+
+    /// Returns the cache's blocks to the depot when a thread exits
+    void destroy_thread_cache(void* ptr) {
+      thread_cache* cache = static_cast<thread_cache*>(ptr);
+      if (cache == NULL) return;
+      for (size_t c = 0; c < slab_allocator::NUM_CLASSES; ++c) {
+        if (cache->head[c] == NULL) continue;
+        depot().lock[c].lock();
+        depot().batches[c].push_back(cache->head[c]);
+        depot().lock[c].unlock();
+      }
+      delete cache;
+    }
+
+    struct tls_key_creator {
+      pthread_key_t TLS_KEY;
+      tls_key_creator() : TLS_KEY(0) {
+        pthread_key_create(&TLS_KEY, destroy_thread_cache);
+      }
+    };
+    static pthread_key_t get_cache_key() {
+      static const tls_key_creator key;
+      return key.TLS_KEY;
+    }
+    // create the key before main
+    static pthread_key_t __unused_init_cache_key__(get_cache_key());
+
+    static inline thread_cache& get_thread_cache() {
+      thread_cache* cache =
+          static_cast<thread_cache*>(pthread_getspecific(get_cache_key()));
+      if (cache == NULL) {
+        cache = new thread_cache;
+        pthread_setspecific(get_cache_key(), cache);
+      }
+      return *cache;
+    }
+
+    /**
+     * Refills an empty free list of class c, from the depot if it has
+     * a batch and by carving a new slab otherwise.
+     */
+    static void refill(thread_cache& cache, size_t c) {
+      depot_type& d = depot();
+      d.lock[c].lock();
+      if (!d.batches[c].empty()) {
+        cache.head[c] = d.batches[c].back();
+        d.batches[c].pop_back();
+        d.lock[c].unlock();
+        size_t len = 0;
+        for (free_block* b = cache.head[c]; b != NULL; b = b->next) ++len;
+        cache.length[c] = len;
+        return;
+      }
+      d.lock[c].unlock();
+      const size_t block_size = (c + 1) * slab_allocator::GRANULARITY;
+      const size_t num_blocks = slab_allocator::SLAB_SIZE / block_size;
+      char* slab = static_cast<char*>(malloc(slab_allocator::SLAB_SIZE));
+      if (slab == NULL) throw std::bad_alloc();
+      d.reserved.inc(slab_allocator::SLAB_SIZE);
+      free_block* head = NULL;
+      for (size_t i = num_blocks; i > 0; --i) {
+        free_block* b = reinterpret_cast<free_block*>(slab + (i - 1) * block_size);
+        b->next = head;
+        head = b;
+      }
+      cache.head[c] = head;
+      cache.length[c] = num_blocks;
+    }
+
+    /**
+     * Moves all but BATCH_SIZE blocks of class c from the cache to the
+     * depot, in batches of at most BATCH_SIZE blocks. The cache then
+     * takes another BATCH_SIZE frees before it spills again.
+     */
+    static void spill(thread_cache& cache, size_t c) {
+      free_block* last = cache.head[c];
+      for (size_t i = 1; i < slab_allocator::BATCH_SIZE; ++i) last = last->next;
+      free_block* rest = last->next;
+      last->next = NULL;
+      cache.length[c] = slab_allocator::BATCH_SIZE;
+      std::vector<free_block*> batches;
+      while (rest != NULL) {
+        free_block* batch = rest;
+        free_block* end = batch;
+        for (size_t i = 1; i < slab_allocator::BATCH_SIZE && end->next != NULL;
+             ++i) {
+          end = end->next;
+        }
+        rest = end->next;
+        end->next = NULL;
+        batches.push_back(batch);
+      }
+      depot_type& d = depot();
+      d.lock[c].lock();
+      d.batches[c].insert(d.batches[c].end(), batches.begin(), batches.end());
+      d.lock[c].unlock();
+    }
+
+  } // end of slab_allocator_impl
+
+
+  void* slab_allocator::allocate(size_t bytes) {
+    using namespace slab_allocator_impl;
+    if (bytes > MAX_BLOCK_SIZE) return ::operator new(bytes);
+    const size_t c = bytes == 0 ? 0 : (bytes - 1) / GRANULARITY;
+    thread_cache& cache = get_thread_cache();
+    if (__unlikely__(cache.head[c] == NULL)) refill(cache, c);
+    free_block* b = cache.head[c];
+    cache.head[c] = b->next;
+    --cache.length[c];
+    return b;
+  }
+
+  void slab_allocator::deallocate(void* ptr, size_t bytes) {
+    using namespace slab_allocator_impl;
+    if (ptr == NULL) return;
+    if (bytes > MAX_BLOCK_SIZE) { ::operator delete(ptr); return; }
+    const size_t c = bytes == 0 ? 0 : (bytes - 1) / GRANULARITY;
+    thread_cache& cache = get_thread_cache();
+    free_block* b = static_cast<free_block*>(ptr);
+    b->next = cache.head[c];
+    cache.head[c] = b;
+    if (++cache.length[c] >= 2 * BATCH_SIZE) spill(cache, c);
+  }
+
+  size_t slab_allocator::reserved_bytes() {
+    return slab_allocator_impl::depot().reserved.value;
+  }
+
+
+
+  namespace superstep_arena_impl {
+
+    /// The chunks owned by one thread
+    struct arena_type {
+      std::vector<char*> chunks;
+      /// Chunks of a single large request, freed on release
+      std::vector<char*> large;
+      size_t current;
+      size_t offset;
+      arena_type() : current(0), offset(0) { }
+    };
+
+    /**
+     * All the arenas ever created. Arenas are handed to threads from
+     * the idle list and go back to it when their thread exits.
+     */
+    struct registry_type {
+      mutex lock;
+      std::vector<arena_type*> arenas;
+      std::vector<arena_type*> idle;
+    };
+
+    static registry_type& registry() {
+      static registry_type* r = new registry_type;
+      return *r;
+    }
+
+    void return_arena(void* ptr) {
+      arena_type* arena = static_cast<arena_type*>(ptr);
+      if (arena == NULL) return;
+      registry().lock.lock();
+      registry().idle.push_back(arena);
+      registry().lock.unlock();
+    }
+
+    struct tls_key_creator {
+      pthread_key_t TLS_KEY;
+      tls_key_creator() : TLS_KEY(0) {
+        pthread_key_create(&TLS_KEY, return_arena);
+      }
+    };
+    static pthread_key_t get_arena_key() {
+      static const tls_key_creator key;
+      return key.TLS_KEY;
+    }
+    // create the key before main
+    static pthread_key_t __unused_init_arena_key__(get_arena_key());
+
+    static inline arena_type& get_arena() {
+      arena_type* arena =
+          static_cast<arena_type*>(pthread_getspecific(get_arena_key()));
+      if (arena == NULL) {
+        registry_type& r = registry();
+        r.lock.lock();
+        if (!r.idle.empty()) {
+          arena = r.idle.back();
+          r.idle.pop_back();
+        } else {
+          arena = new arena_type;
+          r.arenas.push_back(arena);
+        }
+        r.lock.unlock();
+        pthread_setspecific(get_arena_key(), arena);
+      }
+      return *arena;
+    }
+
+    static char* new_chunk(size_t bytes) {
+      char* chunk = static_cast<char*>(malloc(bytes));
+      if (chunk == NULL) throw std::bad_alloc();
+      return chunk;
+    }
+
+  } // end of superstep_arena_impl
+
+
+  void* superstep_arena::allocate(size_t bytes) {
+    using namespace superstep_arena_impl;
+    bytes = (bytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    arena_type& arena = get_arena();
+    if (__unlikely__(bytes > CHUNK_SIZE / 4)) {
+      arena.large.push_back(new_chunk(bytes));
+      return arena.large.back();
+    }
+    if (arena.current < arena.chunks.size() &&
+        arena.offset + bytes <= CHUNK_SIZE) {
+      void* ret = arena.chunks[arena.current] + arena.offset;
+      arena.offset += bytes;
+      return ret;
+    }
+    // advance to the next chunk, creating it if this is the last one
+    if (arena.current < arena.chunks.size()) ++arena.current;
+    if (arena.current == arena.chunks.size()) {
+      arena.chunks.push_back(new_chunk(CHUNK_SIZE));
+    }
+    arena.offset = bytes;
+    return arena.chunks[arena.current];
+  }
+
+  void superstep_arena::release() {
+    using namespace superstep_arena_impl;
+    registry_type& r = registry();
+    r.lock.lock();
+    for (size_t i = 0; i < r.arenas.size(); ++i) {
+      arena_type& arena = *r.arenas[i];
+      for (size_t j = 0; j < arena.large.size(); ++j) free(arena.large[j]);
+      arena.large.clear();
+      arena.current = 0;
+      arena.offset = 0;
+    }
+    r.lock.unlock();
+  }
+
+  size_t superstep_arena::reserved_bytes() {
+    using namespace superstep_arena_impl;
+    registry_type& r = registry();
+    size_t ret = 0;
+    r.lock.lock();
+    for (size_t i = 0; i < r.arenas.size(); ++i) {
+      ret += r.arenas[i]->chunks.size() * CHUNK_SIZE;
+    }
+    r.lock.unlock();
+    return ret;
+  }
+
+} // end of graphlab namespace
@@ -0,0 +1,228 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_UTIL_SLAB_ALLOCATOR_HPP
+#define GRAPHLAB_UTIL_SLAB_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <boost/type_traits/integral_constant.hpp>
+
+namespace graphlab {
+
+  /**
+   * \brief A thread caching allocator for small blocks.
+   *
+   * Requests are rounded up to a multiple of GRANULARITY bytes, and
+   * each such size class is carved out of SLAB_SIZE byte slabs. Every
+   * thread keeps a free list per size class, so allocation and
+   * deallocation are a pointer push or pop without any locking or
+   * atomic instruction. A free list which grows to two batches keeps
+   * one batch and returns the rest to a shared depot. An empty free
+   * list refills from the depot before carving a new slab, so blocks
+   * freed by one thread are reused by the others. Slabs are never returned to the
+   * system.
+   *
+   * Requests larger than MAX_BLOCK_SIZE are passed on to operator new.
+   * The size passed to deallocate() must be the size passed to
+   * allocate().
+   */
+  class slab_allocator {
+  public:
+    static const size_t GRANULARITY = 16;
+    static const size_t MAX_BLOCK_SIZE = 512;
+    static const size_t NUM_CLASSES = MAX_BLOCK_SIZE / GRANULARITY;
+    static const size_t SLAB_SIZE = 64 * 1024;
+    /// The number of blocks moved between a thread and the depot at once
+    static const size_t BATCH_SIZE = 32;
+
+    static void* allocate(size_t bytes);
+    static void deallocate(void* ptr, size_t bytes);
+
+    /// Returns the number of bytes of slabs carved so far
+    static size_t reserved_bytes();
+  }; // end of slab_allocator
+
+
+  /**
+   * \brief A bump allocator for values which die at the end of a
+   * superstep.
+   *
+   * Every thread allocates from its own chain of CHUNK_SIZE byte
+   * chunks by advancing an offset. Memory is never freed individually:
+   * release() rewinds all the chunks of all the threads at once,
+   * keeping them for the next superstep, so a steady state superstep
+   * does not allocate from the system at all. Requests larger than a
+   * quarter chunk get a chunk of their own, which release() frees.
+   *
+   * The chunks of a thread which exits stay live and are adopted by the
+   * next thread to allocate, since the values allocated in one phase of
+   * a superstep are read by the threads of the next phase.
+   *
+   * release() must only be called when no thread is allocating and no
+   * value allocated from the arena is alive.
+   */
+  class superstep_arena {
+  public:
+    static const size_t CHUNK_SIZE = 256 * 1024;
+    static const size_t ALIGNMENT = 16;
+
+    static void* allocate(size_t bytes);
+
+    /// Frees everything allocated since the last release()
+    static void release();
+
+    /// Returns the number of bytes of chunks held by all the threads
+    static size_t reserved_bytes();
+  }; // end of superstep_arena
+
+
+  /**
+   * \brief An STL allocator drawing from the slab_allocator.
+   *
+   * Containers of small elements which are created and destroyed at a
+   * high rate, such as the neighbor lists built in a gather, can use
+   * this allocator to stay off the global heap. Blocks larger than
+   * slab_allocator::MAX_BLOCK_SIZE come from operator new as usual.
+   */
+  template <typename T>
+  class pool_allocator {
+  public:
+    typedef T         value_type;
+    typedef T*        pointer;
+    typedef const T*  const_pointer;
+    typedef T&        reference;
+    typedef const T&  const_reference;
+    typedef size_t    size_type;
+    typedef ptrdiff_t difference_type;
+    template <typename U> struct rebind { typedef pool_allocator<U> other; };
+
+    pool_allocator() { }
+    template <typename U> pool_allocator(const pool_allocator<U>&) { }
+
+    pointer address(reference x) const { return &x; }
+    const_pointer address(const_reference x) const { return &x; }
+    size_type max_size() const {
+      return std::numeric_limits<size_type>::max() / sizeof(T);
+    }
+
+    pointer allocate(size_type n, const void* = 0) {
+      return static_cast<pointer>(slab_allocator::allocate(n * sizeof(T)));
+    }
+    void deallocate(pointer p, size_type n) {
+      slab_allocator::deallocate(p, n * sizeof(T));
+    }
+    void construct(pointer p, const T& val) { new (p) T(val); }
+    void destroy(pointer p) { p->~T(); }
+  }; // end of pool_allocator
+
+  template <typename T, typename U>
+  bool operator==(const pool_allocator<T>&, const pool_allocator<U>&) {
+    return true;
+  }
+  template <typename T, typename U>
+  bool operator!=(const pool_allocator<T>&, const pool_allocator<U>&) {
+    return false;
+  }
+
+
+  /**
+   * \brief An STL allocator drawing from the superstep_arena.
+   *
+   * deallocate() does nothing, so a container which grows by doubling
+   * holds about twice its final size until the arena is released. Only
+   * use this allocator for values which are dead by the time the
+   * arena is released, and mark the types holding them with
+   * superstep_scoped.
+   */
+  template <typename T>
+  class arena_allocator {
+  public:
+    typedef T         value_type;
+    typedef T*        pointer;
+    typedef const T*  const_pointer;
+    typedef T&        reference;
+    typedef const T&  const_reference;
+    typedef size_t    size_type;
+    typedef ptrdiff_t difference_type;
+    template <typename U> struct rebind { typedef arena_allocator<U> other; };
+
+    arena_allocator() { }
+    template <typename U> arena_allocator(const arena_allocator<U>&) { }
+
+    pointer address(reference x) const { return &x; }
+    const_pointer address(const_reference x) const { return &x; }
+    size_type max_size() const {
+      return std::numeric_limits<size_type>::max() / sizeof(T);
+    }
+
+    pointer allocate(size_type n, const void* = 0) {
+      return static_cast<pointer>(superstep_arena::allocate(n * sizeof(T)));
+    }
+    void deallocate(pointer, size_type) { }
+    void construct(pointer p, const T& val) { new (p) T(val); }
+    void destroy(pointer p) { p->~T(); }
+  }; // end of arena_allocator
+
+  template <typename T, typename U>
+  bool operator==(const arena_allocator<T>&, const arena_allocator<U>&) {
+    return true;
+  }
+  template <typename T, typename U>
+  bool operator!=(const arena_allocator<T>&, const arena_allocator<U>&) {
+    return false;
+  }
+
+
+  /**
+   * \brief Marks a gather type whose memory comes from the
+   * superstep_arena.
+   *
+   * Specializing superstep_scoped to true for a gather type tells the
+   * synchronous and semi-synchronous engines that every value of the
+   * type is dead once the apply phase completes, so they release the
+   * superstep_arena after each apply phase. The asynchronous engine has
+   * no such point and refuses the type. For instance:
+   *
+   * \code
+   * struct neighbor_list {
+   *   std::vector<vertex_id_type,
+   *               graphlab::arena_allocator<vertex_id_type> > vids;
+   *   ...
+   * };
+   * namespace graphlab {
+   *   template <> struct superstep_scoped<neighbor_list>
+   *     : public boost::true_type { };
+   * }
+   * \endcode
+   *
+   * The apply must copy anything it keeps out of the gather type into
+   * memory of its own. Gather caching keeps gather values across
+   * supersteps and cannot be used with such a type.
+   */
+  template <typename T>
+  struct superstep_scoped : public boost::false_type { };
+
+} // end of graphlab namespace
+
+#endif
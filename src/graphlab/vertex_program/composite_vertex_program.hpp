@@ -0,0 +1,398 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_COMPOSITE_VERTEX_PROGRAM_HPP
+#define GRAPHLAB_COMPOSITE_VERTEX_PROGRAM_HPP
+
+#include <boost/type_traits/is_same.hpp>
+#include <boost/static_assert.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+#include <graphlab/vertex_program/ivertex_program.hpp>
+#include <graphlab/vertex_program/icontext.hpp>
+
+namespace graphlab {
+
+  /**
+   * \brief A pair of values of which either one may be missing, used
+   * as the gather and message type of a composite_vertex_program.
+   *
+   * Adding two pairs adds the values present in both, and keeps the
+   * value present in only one. A default constructed pair holds both
+   * values when DefaultSet is true (so that the default message
+   * signals both programs) and neither otherwise (so that the default
+   * gather is empty).
+   */
+  template<typename First, typename Second, bool DefaultSet>
+  struct composite_pair {
+    typedef First first_type;
+    typedef Second second_type;
+    First first;
+    Second second;
+    bool has_first, has_second;
+
+    explicit composite_pair(bool set = DefaultSet) :
+      first(), second(), has_first(set), has_second(set) { }
+
+    composite_pair& operator+=(const composite_pair& other) {
+      if (other.has_first) {
+        if (has_first) first += other.first;
+        else { first = other.first; has_first = true; }
+      }
+      if (other.has_second) {
+        if (has_second) second += other.second;
+        else { second = other.second; has_second = true; }
+      }
+      return *this;
+    }
+
+    void save(oarchive& oarc) const {
+      oarc << has_first << has_second;
+      if (has_first) oarc << first;
+      if (has_second) oarc << second;
+    }
+
+    void load(iarchive& iarc) {
+      iarc >> has_first >> has_second;
+      if (has_first) iarc >> first;
+      if (has_second) iarc >> second;
+    }
+  }; // end of composite_pair
+
+
+  /**
+   * A cached composite gather misses the slot of a program which was
+   * not running when it was gathered, so composite gathers are never
+   * cached.
+   */
+  template<typename First, typename Second>
+  struct cacheable_gather<composite_pair<First, Second, false> >
+    : public boost::false_type { };
+
+
+  /**
+   * \internal
+   * \brief Builds a pair holding only the value of slot Slot.
+   */
+  template<typename Pair, int Slot>
+  struct composite_slot;
+
+  template<typename Pair>
+  struct composite_slot<Pair, 0> {
+    static Pair wrap(const typename Pair::first_type& value) {
+      Pair pair(false);
+      pair.first = value; pair.has_first = true;
+      return pair;
+    }
+  };
+
+  template<typename Pair>
+  struct composite_slot<Pair, 1> {
+    static Pair wrap(const typename Pair::second_type& value) {
+      Pair pair(false);
+      pair.second = value; pair.has_second = true;
+      return pair;
+    }
+  };
+
+
+  /**
+   * \internal
+   * \brief The context given to one of the programs of a
+   * composite_vertex_program.
+   *
+   * Forwards to the context of the composite program, wrapping the
+   * messages and gather deltas of the program into its slot of the
+   * composite message and gather.
+   */
+  template<typename ParentContext, typename Context, int Slot>
+  class composite_context : public Context {
+  public:
+    typedef typename Context::vertex_type vertex_type;
+    typedef typename Context::vertex_id_type vertex_id_type;
+    typedef typename Context::message_type message_type;
+    typedef typename Context::gather_type gather_type;
+
+    composite_context(ParentContext& parent) : parent(parent) { }
+
+    size_t num_vertices() const { return parent.num_vertices(); }
+    size_t num_edges() const { return parent.num_edges(); }
+    size_t procid() const { return parent.procid(); }
+    std::ostream& cout() const { return parent.cout(); }
+    std::ostream& cerr() const { return parent.cerr(); }
+    size_t num_procs() const { return parent.num_procs(); }
+    float elapsed_seconds() const { return parent.elapsed_seconds(); }
+    int iteration() const { return parent.iteration(); }
+    /// Stops the engine, and so all the programs of the composite
+    void stop() { parent.stop(); }
+
+    void signal(const vertex_type& vertex,
+                const message_type& message = message_type()) {
+      parent.signal(vertex, composite_slot<typename ParentContext::message_type,
+                                           Slot>::wrap(message));
+    }
+    void signal_vid(vertex_id_type gvid,
+                    const message_type& message = message_type()) {
+      parent.signal_vid(gvid, composite_slot<typename ParentContext::message_type,
+                                             Slot>::wrap(message));
+    }
+    void post_delta(const vertex_type& vertex, const gather_type& delta) {
+      parent.post_delta(vertex, composite_slot<typename ParentContext::gather_type,
+                                               Slot>::wrap(delta));
+    }
+    /// Clears the cached gather of all the programs of the composite
+    void clear_gather_cache(const vertex_type& vertex) {
+      parent.clear_gather_cache(vertex);
+    }
+
+  private:
+    ParentContext& parent;
+  }; // end of composite_context
+
+
+  /**
+   * \brief Runs two independent vertex programs on the same graph as
+   * a single vertex program.
+   *
+   * Several analyses of one graph (e.g. pagerank, label propagation
+   * and degree counts, each writing its own field of the vertex data)
+   * usually run one after the other, each with a full engine run. The
+   * composite program runs them together: a vertex is active in a
+   * super-step when either program was signaled on it, the gather and
+   * scatter traverse the union of the edges the active programs ask
+   * for once, calling each program on the edges it asked for, and the
+   * vertex data, vertex program and gather of both programs are
+   * synchronized with the mirrors in a single exchange.
+   *
+   * The message and gather of the composite are composite_pair of the
+   * messages and gathers of the programs. Each program only runs on
+   * the vertices it was signaled on (through its own context, whose
+   * signals only reach its own slot of the message), so each program
+   * terminates independently, and the engine stops once neither
+   * program signals any vertex. The default message signals both
+   * programs, so that engine.signal_all() starts both.
+   *
+   * More programs are combined by nesting:
+   * \code
+   * typedef graphlab::composite_vertex_program<pagerank,
+   *           graphlab::composite_vertex_program<label_propagation,
+   *                                              degree_count> >
+   *         program_type;
+   * graphlab::synchronous_engine<program_type> engine(dc, graph, clopts);
+   * engine.signal_all();
+   * engine.start();
+   * \endcode
+   *
+   * Both programs must be defined on the same graph type. Calling
+   * stop() on the context of either program stops the engine.
+   *
+   * The engines refuse use_cache for a composite program: the gather
+   * cached while only one program was running has nothing in the slot
+   * of the other. With the pull_activation option of the synchronous
+   * engine every vertex next to a changed vertex is signaled with the
+   * default message, which runs both programs on it as if both had
+   * signaled it, so neither program terminates before the other.
+   */
+  template<typename FirstProgram, typename SecondProgram>
+  class composite_vertex_program :
+    public ivertex_program<typename FirstProgram::graph_type,
+                           composite_pair<typename FirstProgram::gather_type,
+                                          typename SecondProgram::gather_type,
+                                          false>,
+                           composite_pair<typename FirstProgram::message_type,
+                                          typename SecondProgram::message_type,
+                                          true> > {
+    BOOST_STATIC_ASSERT((boost::is_same<typename FirstProgram::graph_type,
+                         typename SecondProgram::graph_type>::value));
+  public:
+    typedef ivertex_program<typename FirstProgram::graph_type,
+                            composite_pair<typename FirstProgram::gather_type,
+                                           typename SecondProgram::gather_type,
+                                           false>,
+                            composite_pair<typename FirstProgram::message_type,
+                                           typename SecondProgram::message_type,
+                                           true> > base_type;
+    typedef typename base_type::icontext_type icontext_type;
+    typedef typename base_type::vertex_type vertex_type;
+    typedef typename base_type::edge_type edge_type;
+    typedef typename base_type::gather_type gather_type;
+    typedef typename base_type::message_type message_type;
+
+    typedef composite_context<icontext_type,
+                              typename FirstProgram::icontext_type, 0>
+            first_context_type;
+    typedef composite_context<icontext_type,
+                              typename SecondProgram::icontext_type, 1>
+            second_context_type;
+
+    FirstProgram first;
+    SecondProgram second;
+    /// Whether each program was signaled on this vertex
+    bool first_active, second_active;
+
+    composite_vertex_program() :
+      first_active(false), second_active(false),
+      first_dir(NO_EDGES), second_dir(NO_EDGES) { }
+
+    void init(icontext_type& context, const vertex_type& vertex,
+              const message_type& msg) {
+      first_active = msg.has_first;
+      second_active = msg.has_second;
+      if (first_active) {
+        first_context_type first_context(context);
+        first.init(first_context, vertex, msg.first);
+      }
+      if (second_active) {
+        second_context_type second_context(context);
+        second.init(second_context, vertex, msg.second);
+      }
+    }
+
+    edge_dir_type gather_edges(icontext_type& context,
+                               const vertex_type& vertex) const {
+      first_dir = first_gather_edges(context, vertex);
+      second_dir = second_gather_edges(context, vertex);
+      return merge_dirs();
+    }
+
+    gather_type gather(icontext_type& context, const vertex_type& vertex,
+                       edge_type& edge) const {
+      gather_type total;
+      if (covers(first_dir, vertex, edge)) {
+        first_context_type first_context(context);
+        total.first = first.gather(first_context, vertex, edge);
+        total.has_first = true;
+      }
+      if (covers(second_dir, vertex, edge)) {
+        second_context_type second_context(context);
+        total.second = second.gather(second_context, vertex, edge);
+        total.has_second = true;
+      }
+      return total;
+    }
+
+    void apply(icontext_type& context, vertex_type& vertex,
+               const gather_type& total) {
+      if (first_active) {
+        first_context_type first_context(context);
+        first.apply(first_context, vertex, total.first);
+      }
+      if (second_active) {
+        second_context_type second_context(context);
+        second.apply(second_context, vertex, total.second);
+      }
+    }
+
+    edge_dir_type scatter_edges(icontext_type& context,
+                                const vertex_type& vertex) const {
+      first_dir = first_scatter_edges(context, vertex);
+      second_dir = second_scatter_edges(context, vertex);
+      return merge_dirs();
+    }
+
+    void scatter(icontext_type& context, const vertex_type& vertex,
+                 edge_type& edge) const {
+      if (covers(first_dir, vertex, edge)) {
+        first_context_type first_context(context);
+        first.scatter(first_context, vertex, edge);
+      }
+      if (covers(second_dir, vertex, edge)) {
+        second_context_type second_context(context);
+        second.scatter(second_context, vertex, edge);
+      }
+    }
+
+    void pre_local_gather(gather_type& total) const {
+      if (first_active) first.pre_local_gather(total.first);
+      if (second_active) second.pre_local_gather(total.second);
+    }
+
+    void post_local_gather(gather_type& total) const {
+      if (total.has_first) first.post_local_gather(total.first);
+      if (total.has_second) second.post_local_gather(total.second);
+    }
+
+    void save(oarchive& oarc) const {
+      oarc << first << second << first_active << second_active;
+    }
+
+    void load(iarchive& iarc) {
+      iarc >> first >> second >> first_active >> second_active;
+    }
+
+  private:
+    /**
+     * The edges each program asked for in the last call to
+     * gather_edges() or scatter_edges(). The engines always call these
+     * right before gathering or scattering on the same vertex program.
+     */
+    mutable edge_dir_type first_dir, second_dir;
+
+    edge_dir_type first_gather_edges(icontext_type& context,
+                                     const vertex_type& vertex) const {
+      if (!first_active) return NO_EDGES;
+      first_context_type first_context(context);
+      return first.gather_edges(first_context, vertex);
+    }
+    edge_dir_type second_gather_edges(icontext_type& context,
+                                      const vertex_type& vertex) const {
+      if (!second_active) return NO_EDGES;
+      second_context_type second_context(context);
+      return second.gather_edges(second_context, vertex);
+    }
+    edge_dir_type first_scatter_edges(icontext_type& context,
+                                      const vertex_type& vertex) const {
+      if (!first_active) return NO_EDGES;
+      first_context_type first_context(context);
+      return first.scatter_edges(first_context, vertex);
+    }
+    edge_dir_type second_scatter_edges(icontext_type& context,
+                                       const vertex_type& vertex) const {
+      if (!second_active) return NO_EDGES;
+      second_context_type second_context(context);
+      return second.scatter_edges(second_context, vertex);
+    }
+
+    /**
+     * Returns the union of the edges of both programs. A program asking
+     * for all the edges the engine will visit is marked as asking for
+     * all edges, so that covers() need not look at the edges.
+     */
+    edge_dir_type merge_dirs() const {
+      const edge_dir_type dir = edge_dir_type(int(first_dir) | int(second_dir));
+      if (first_dir == dir) first_dir = ALL_EDGES;
+      if (second_dir == dir) second_dir = ALL_EDGES;
+      return dir;
+    }
+
+    /// Whether the edge set dir of vertex contains edge
+    static bool covers(edge_dir_type dir, const vertex_type& vertex,
+                       const edge_type& edge) {
+      if (dir == ALL_EDGES) return true;
+      if (dir == NO_EDGES) return false;
+      const bool in_edge = edge.target().local_id() == vertex.local_id();
+      return in_edge == (dir == IN_EDGES);
+    }
+  }; // end of composite_vertex_program
+
+} // end of namespace graphlab
+
+#endif
@@ -27,6 +27,7 @@
 #define GRAPHLAB_IVERTEX_PROGRAM_HPP
 
 
+#include <boost/type_traits/integral_constant.hpp>
 #include <graphlab/vertex_program/icontext.hpp>
 #include <graphlab/util/empty.hpp>
 #include <graphlab/graph/graph_basic_types.hpp>
@@ -765,6 +766,23 @@ namespace graphlab {
     }
 
   };  // end of ivertex_program
+
+
+  /**
+   * \brief Tells the engines whether the partial gathers of a gather
+   * type may be cached.
+   *
+   * With use_cache the engines keep the partial gather of each vertex
+   * replica and reuse it instead of calling
+   * \ref ivertex_program::gather_edges and
+   * \ref ivertex_program::gather again. Specializing cacheable_gather
+   * to false for a gather type whose value depends on more than the
+   * neighborhood, such as which parts of the vertex program were
+   * running when it was gathered, makes the engines refuse use_cache
+   * for it.
+   */
+  template <typename GatherType>
+  struct cacheable_gather : public boost::true_type { };
  
 }; //end of namespace graphlab
 #include <graphlab/macros_undef.hpp>
@@ -27,3 +27,4 @@
 #include <graphlab/vertex_program/icontext.hpp>
 
 
+#include <graphlab/vertex_program/composite_vertex_program.hpp>
@@ -207,6 +207,12 @@ void agg_finalize(agg_engine_type::icontext_type& context,
 }
 
 
+void incremental_agg_finalize(agg_engine_type::icontext_type& context,
+                              size_t result) {
+  ASSERT_EQ(result, context.num_vertices());
+}
+
+
 size_t agg_edge_map(agg_engine_type::icontext_type& context,
               const agg_engine_type::edge_type& vtx) {
   return 1;
@@ -273,6 +279,8 @@ void test_aggregator(graphlab::distributed_control& dc,
   agg_engine_type engine(dc, graph, clopts);
   engine.add_vertex_aggregator<size_t>("num_vertices_counter", agg_map, agg_finalize);
   engine.add_edge_aggregator<size_t>("num_edges_counter", agg_edge_map, agg_edge_finalize);
+  engine.add_incremental_vertex_aggregator<size_t>("incremental_vertices_counter",
+                                                   agg_map, incremental_agg_finalize);
   // reset all
   graph.transform_vertices(set_vertex_to_one);
   graph.transform_edges(set_edge_to_one);
@@ -295,6 +303,7 @@ void test_aggregator(graphlab::distributed_control& dc,
   ASSERT_TRUE(engine.aggregate_now("num_edges_counter"));
   ASSERT_TRUE(engine.aggregate_periodic("num_vertices_counter", 0.2));
   ASSERT_TRUE(engine.aggregate_periodic("num_edges_counter", 0.2));
+  ASSERT_TRUE(engine.aggregate_periodic("incremental_vertices_counter", 0.2));
   std::cout << "Scheduling all vertices to count their neighbors" << std::endl;
   engine.signal_all(100);
   std::cout << "Running!" << std::endl;
@@ -28,6 +28,7 @@
 #include <cmath>
 #include <iostream>
 #include <vector>
+#include <algorithm>
 
 #include <graphlab.hpp>
 
@@ -36,10 +37,26 @@
 
 // typedef graphlab::atomic_add_vector<size_t> vector_type;
 typedef graphlab::atomic_add_vector2<size_t> vector_type;
+typedef graphlab::atomic_add_vector2<size_t, true> lock_free_vector_type;
+
+struct min_message {
+  double value;
+  min_message& operator+=(const min_message& other) {
+    value = std::min(value, other.value); return *this;
+  }
+};
+
+namespace graphlab {
+  template <> struct lock_free_combiner<min_message> {
+    static const bool value = true;
+  };
+}
+typedef graphlab::atomic_add_vector2<min_message, true> min_vector_type;
 
 
 
-void add_numbers(vector_type* vec_ptr, size_t count) {
+template <typename VectorType>
+void add_numbers(VectorType* vec_ptr, size_t count) {
   for(size_t i = 0; i < count; ++i) {
     for(size_t j = 0; j < vec_ptr->size(); ++j) {
       vec_ptr->add(j, 1);
@@ -48,7 +65,11 @@ void add_numbers(vector_type* vec_ptr, size_t count) {
 }
 
 
-void add_and_get_numbers(vector_type* vec_ptr,
+/// Counts the messages taken out which hold no add
+graphlab::atomic<size_t> empty_takes;
+
+template <typename VectorType>
+void add_and_get_numbers(VectorType* vec_ptr,
                          graphlab::atomic<size_t>* shared_count_ptr,
                          size_t count) {
   size_t local_count = 0;
@@ -57,18 +78,34 @@ void add_and_get_numbers(vector_type* vec_ptr,
       vec_ptr->add(j, 1);
       if(i % 5 == 0) {
         size_t value;
-        if(vec_ptr->test_and_get(j, value)) local_count += value;
+        if(vec_ptr->test_and_get(j, value)) {
+          local_count += value;
+          if (value == 0) empty_takes.inc();
+        }
       }
     }
   }
   for(size_t j = 0; j < vec_ptr->size(); ++j) {
     size_t value;
-    if(vec_ptr->test_and_get(j, value)) local_count += value;
+    if(vec_ptr->test_and_get(j, value)) {
+      local_count += value;
+      if (value == 0) empty_takes.inc();
+    }
   }
   shared_count_ptr->inc(local_count);
 } // end of add and get numbers
 
 
+void add_minimums(min_vector_type* vec_ptr, size_t thread, size_t count) {
+  for(size_t i = 0; i < count; ++i) {
+    for(size_t j = 0; j < vec_ptr->size(); ++j) {
+      min_message msg; msg.value = double(thread * count + i);
+      vec_ptr->add(j, msg);
+    }
+  }
+}
+
+
 class atomic_add_vector_tests : public CxxTest::TestSuite {
 public:
   void test_many_adds() {
@@ -81,7 +118,7 @@ public:
     threads.resize(num_threads);
     vec.resize(vec_size);
     for(size_t i = 0; i < threads.size(); ++i) {
-      threads.launch(boost::bind(add_numbers, &vec, count));
+      threads.launch(boost::bind(add_numbers<vector_type>, &vec, count));
     }
     threads.join();
     const size_t true_value = num_threads * count;
@@ -110,11 +147,70 @@ public:
     threads.resize(num_threads);
     vec.resize(vec_size);
     for(size_t i = 0; i < threads.size(); ++i) {
-      threads.launch(boost::bind(add_and_get_numbers, &vec, 
+      threads.launch(boost::bind(add_and_get_numbers<vector_type>, &vec, 
                                  &shared_counter, count));
     }
     threads.join();
     const size_t true_value = threads.size() * count * vec.size();
     TS_ASSERT_EQUALS(shared_counter.value, true_value);
   }
+
+  void test_many_adds_and_gets_lock_free() {
+    lock_free_vector_type vec;
+    graphlab::atomic<size_t> shared_counter;
+    graphlab::thread_pool threads;
+    const size_t num_threads = 32;
+    const size_t count = 50000;
+    const size_t vec_size = 10;
+    threads.resize(num_threads);
+    vec.resize(vec_size);
+    empty_takes.value = 0;
+    for(size_t i = 0; i < threads.size(); ++i) {
+      threads.launch(boost::bind(add_and_get_numbers<lock_free_vector_type>,
+                                 &vec, &shared_counter, count));
+    }
+    threads.join();
+    const size_t true_value = threads.size() * count * vec.size();
+    TS_ASSERT_EQUALS(shared_counter.value, true_value);
+    // an add racing with a take is never split from its occupancy flag
+    TS_ASSERT_EQUALS(empty_takes.value, 0);
+    for(size_t i = 0; i < vec.size(); ++i) TS_ASSERT(vec.empty(i));
+  }
+
+  void test_many_adds_lock_free() {
+    lock_free_vector_type vec;
+    graphlab::thread_pool threads;
+    const size_t num_threads = 32;
+    const size_t count = 50000;
+    const size_t vec_size = 10;
+    threads.resize(num_threads);
+    vec.resize(vec_size);
+    for(size_t i = 0; i < threads.size(); ++i) {
+      threads.launch(boost::bind(add_numbers<lock_free_vector_type>, &vec, count));
+    }
+    threads.join();
+    for(size_t i = 0; i < vec.size(); ++i) {
+      size_t value(-1);
+      TS_ASSERT(vec.test_and_get(i, value));
+      TS_ASSERT_EQUALS(value, num_threads * count);
+    }
+  }
+
+  void test_min_combiner() {
+    min_vector_type vec(10);
+    graphlab::thread_pool threads;
+    const size_t num_threads = 16;
+    const size_t count = 10000;
+    threads.resize(num_threads);
+    for(size_t i = 0; i < threads.size(); ++i) {
+      threads.launch(boost::bind(add_minimums, &vec, i, count));
+    }
+    threads.join();
+    for(size_t i = 0; i < vec.size(); ++i) {
+      min_message msg;
+      TS_ASSERT(vec.test_and_get(i, msg));
+      TS_ASSERT_EQUALS(msg.value, 0);
+      TS_ASSERT(vec.empty(i));
+    }
+  }
 }; // end of test suite
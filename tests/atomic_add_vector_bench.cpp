@@ -0,0 +1,134 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+/*
+ * Reports the signal throughput of the locking and the lock-free
+ * atomic_add_vector2: random slots are signaled from many threads, and
+ * a message is taken out every tenth signal. The same is then measured
+ * through the fifo and sweep schedulers, with a size_t message (which
+ * they combine lock-free) and a struct wrapping one (which they lock).
+ *
+ * atomic_add_vector_bench [num_threads] [signals_per_thread] [num_slots]
+ */
+
+#include <cstdlib>
+#include <iostream>
+
+#include <graphlab.hpp>
+#include <graphlab/parallel/atomic_add_vector2.hpp>
+
+typedef graphlab::atomic_add_vector2<size_t> locked_vector_type;
+typedef graphlab::atomic_add_vector2<size_t, true> lock_free_vector_type;
+
+/// A size_t message not declared to lock_free_combiner
+struct locked_message {
+  size_t value;
+  explicit locked_message(size_t value = 0) : value(value) { }
+  locked_message& operator+=(const locked_message& other) {
+    value += other.value; return *this;
+  }
+};
+
+
+template <typename VectorType>
+void signal_random(VectorType* vec_ptr, size_t count) {
+  size_t value;
+  for(size_t i = 0; i < count; ++i) {
+    const size_t j = graphlab::random::fast_uniform<size_t>(0, vec_ptr->size() - 1);
+    vec_ptr->add(j, 1);
+    if (i % 10 == 0) vec_ptr->test_and_get(j, value);
+  }
+}
+
+/// Returns the number of signals per second
+template <typename VectorType>
+double signal_throughput(size_t num_threads, size_t count, size_t vec_size) {
+  VectorType vec(vec_size);
+  graphlab::thread_pool threads;
+  threads.resize(num_threads);
+  graphlab::timer ti; ti.start();
+  for(size_t i = 0; i < threads.size(); ++i) {
+    threads.launch(boost::bind(signal_random<VectorType>, &vec, count));
+  }
+  threads.join();
+  return num_threads * count / ti.current_time();
+}
+
+
+template <typename SchedulerType>
+void schedule_random(SchedulerType* sched_ptr, size_t cpuid,
+                     size_t num_vertices, size_t count) {
+  typename SchedulerType::message_type msg;
+  graphlab::lvid_type vid;
+  for(size_t i = 0; i < count; ++i) {
+    const graphlab::lvid_type j =
+        graphlab::random::fast_uniform<size_t>(0, num_vertices - 1);
+    sched_ptr->schedule(j, typename SchedulerType::message_type(1));
+    if (i % 10 == 0) sched_ptr->get_next(cpuid, vid, msg);
+  }
+}
+
+/// Returns the number of signals per second through the scheduler
+template <typename SchedulerType>
+double schedule_throughput(size_t num_threads, size_t count, size_t vec_size) {
+  graphlab::graphlab_options opts;
+  opts.set_ncpus(num_threads);
+  SchedulerType sched(vec_size, opts);
+  sched.start();
+  graphlab::thread_pool threads;
+  threads.resize(num_threads);
+  graphlab::timer ti; ti.start();
+  for(size_t i = 0; i < threads.size(); ++i) {
+    threads.launch(boost::bind(schedule_random<SchedulerType>, &sched, i,
+                               vec_size, count));
+  }
+  threads.join();
+  return num_threads * count / ti.current_time();
+}
+
+
+int main(int argc, char** argv) {
+  const size_t num_threads = argc > 1 ? atol(argv[1]) : 48;
+  const size_t count = argc > 2 ? atol(argv[2]) : 1000000;
+  const size_t vec_size = argc > 3 ? atol(argv[3]) : 1000000;
+  const double locked =
+      signal_throughput<locked_vector_type>(num_threads, count, vec_size);
+  const double lock_free =
+      signal_throughput<lock_free_vector_type>(num_threads, count, vec_size);
+  std::cout << "Signals/sec with " << num_threads << " threads, locked: "
+            << locked << " lock-free: " << lock_free << std::endl;
+  std::cout << "fifo_scheduler, locked: "
+            << schedule_throughput<graphlab::fifo_scheduler<locked_message> >(
+                   num_threads, count, vec_size)
+            << " lock-free: "
+            << schedule_throughput<graphlab::fifo_scheduler<size_t> >(
+                   num_threads, count, vec_size) << std::endl;
+  std::cout << "sweep_scheduler, locked: "
+            << schedule_throughput<graphlab::sweep_scheduler<locked_message> >(
+                   num_threads, count, vec_size)
+            << " lock-free: "
+            << schedule_throughput<graphlab::sweep_scheduler<size_t> >(
+                   num_threads, count, vec_size) << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,218 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include <boost/bind.hpp>
+#include <graphlab/util/blocked_multinomial.hpp>
+#include <graphlab/util/fast_multinomial.hpp>
+#include <graphlab/util/random.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+using graphlab::blocked_multinomial;
+using graphlab::fast_multinomial;
+
+void check_distribution(const blocked_multinomial& mult,
+                        const std::vector<float>& weights) {
+  double total = 0;
+  for (size_t i = 0; i < weights.size(); ++i) total += weights[i];
+  ASSERT_LT(std::fabs(mult.total() - total), 1e-3 * total);
+  const size_t ndraws = 1000000;
+  std::vector<size_t> counts(weights.size(), 0);
+  graphlab::random::counter_generator gen(1, 2);
+  for (size_t i = 0; i < ndraws; ++i) {
+    size_t asg;
+    ASSERT_TRUE(mult.sample(gen.rand01(), asg));
+    ++counts[asg];
+  }
+  for (size_t i = 0; i < weights.size(); ++i) {
+    const double p = weights[i] / total;
+    if (p == 0) { ASSERT_EQ(counts[i], size_t(0)); }
+    // within 5 standard deviations
+    const double tol = 5 * std::sqrt(p * (1 - p) / ndraws) + 1e-9;
+    ASSERT_LT(std::fabs(double(counts[i]) / ndraws - p), tol);
+  }
+}
+
+void sanity_checks() {
+  // sizes around the block boundaries and with several levels
+  const size_t sizes[] = {1, 15, 16, 17, 300, 5000};
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+    const size_t n = sizes[s];
+    blocked_multinomial mult(n), batched(n);
+    std::vector<float> weights(n);
+    std::vector<size_t> asgs(n);
+    for (size_t i = 0; i < n; ++i) {
+      weights[i] = (i % 7 == 3) ? 0 : float(1 + (i * 2654435761u) % 100);
+      asgs[i] = i;
+      mult.set(i, weights[i]);
+    }
+    batched.set(&asgs[0], &weights[0], n);
+    ASSERT_EQ(mult.positive_support(), batched.positive_support());
+    ASSERT_EQ(mult.total(), batched.total());
+    check_distribution(mult, weights);
+
+    // merging two halves gives back the whole
+    blocked_multinomial lower(n), upper(n);
+    for (size_t i = 0; i < n; ++i) {
+      if (i < n / 2) lower.add(i, weights[i]);
+      else upper.add(i, weights[i]);
+    }
+    lower.merge(upper);
+    ASSERT_EQ(lower.positive_support(), mult.positive_support());
+    check_distribution(lower, weights);
+
+    // popping drains every category with positive weight exactly once
+    std::vector<bool> popped(n, false);
+    size_t asg, npopped = 0;
+    while (mult.pop(asg)) {
+      ASSERT_FALSE(popped[asg]);
+      ASSERT_GT(weights[asg], 0.0f);
+      popped[asg] = true;
+      ++npopped;
+    }
+    ASSERT_EQ(npopped, batched.positive_support());
+    ASSERT_EQ(mult.positive_support(), size_t(0));
+    ASSERT_FALSE(mult.sample(0.5, asg));
+  }
+}
+
+
+/// Accumulates weight additions locally and merges them periodically
+void blocked_worker(blocked_multinomial* shared, graphlab::mutex* lock,
+                    size_t seed, size_t nupdates, size_t merge_interval) {
+  blocked_multinomial local(shared->size());
+  graphlab::random::counter_generator gen(seed, 0);
+  for (size_t i = 0; i < nupdates; ++i) {
+    local.add(gen.uniform<size_t>(0, shared->size() - 1), 1.0f);
+    if ((i + 1) % merge_interval == 0 || i + 1 == nupdates) {
+      lock->lock();
+      shared->merge(local);
+      lock->unlock();
+      local.clear();
+    }
+  }
+}
+
+/// Adds the weights straight into the shared concurrent tree
+void fast_worker(fast_multinomial* shared, size_t ncats,
+                 size_t seed, size_t nupdates) {
+  graphlab::random::counter_generator gen(seed, 0);
+  for (size_t i = 0; i < nupdates; ++i) {
+    shared->add(gen.uniform<size_t>(0, ncats - 1), 1.0);
+  }
+}
+
+void benchmark(size_t ncats) {
+  const size_t nupdates = 2000000, nsamples = 2000000, batch = 256;
+  std::vector<size_t> asgs(nupdates);
+  std::vector<float> values(nupdates);
+  std::vector<double> us(nsamples);
+  graphlab::random::counter_generator gen(7, ncats);
+  for (size_t i = 0; i < nupdates; ++i) {
+    asgs[i] = gen.uniform<size_t>(0, ncats - 1);
+    values[i] = float(gen.uniform<double>(0.1, 10));
+  }
+  gen.fill_uniform(&us[0], nsamples);
+
+  fast_multinomial fast(ncats, 1);
+  blocked_multinomial blocked(ncats), blocked_batched(ncats);
+  graphlab::timer ti;
+  ti.start();
+  for (size_t i = 0; i < nupdates; ++i) fast.set(asgs[i], values[i]);
+  const double fast_update = ti.current_time();
+  ti.start();
+  for (size_t i = 0; i < nupdates; ++i) blocked.set(asgs[i], values[i]);
+  const double blocked_update = ti.current_time();
+  ti.start();
+  for (size_t i = 0; i < nupdates; i += batch) {
+    blocked_batched.set(&asgs[i], &values[i], std::min(batch, nupdates - i));
+  }
+  const double batched_update = ti.current_time();
+
+  size_t checksum = 0, asg = 0;
+  ti.start();
+  for (size_t i = 0; i < nsamples; ++i) {
+    fast.sample(asg, 0);
+    checksum += asg;
+  }
+  const double fast_sample = ti.current_time();
+  ti.start();
+  for (size_t i = 0; i < nsamples; ++i) {
+    blocked.sample(us[i], asg);
+    checksum += asg;
+  }
+  const double blocked_sample = ti.current_time();
+  ASSERT_GT(checksum, size_t(0));
+
+  // four threads adding weights at once
+  const size_t nthreads = 4, nthread_updates = nupdates / nthreads;
+  graphlab::thread_group thrgroup;
+  fast_multinomial fast_shared(ncats, nthreads);
+  ti.start();
+  for (size_t i = 0; i < nthreads; ++i) {
+    thrgroup.launch(boost::bind(fast_worker, &fast_shared, ncats,
+                                i, nthread_updates));
+  }
+  thrgroup.join();
+  const double fast_parallel = ti.current_time();
+  blocked_multinomial blocked_shared(ncats);
+  graphlab::mutex lock;
+  ti.start();
+  for (size_t i = 0; i < nthreads; ++i) {
+    thrgroup.launch(boost::bind(blocked_worker, &blocked_shared, &lock,
+                                i, nthread_updates, 4 * ncats));
+  }
+  thrgroup.join();
+  const double blocked_parallel = ti.current_time();
+  ASSERT_EQ(size_t(blocked_shared.total() + 0.5), nthreads * nthread_updates);
+
+  std::cout << ncats << " categories (updates/s, samples/s):" << std::endl
+            << "  fast_multinomial set:      " << nupdates / fast_update
+            << std::endl
+            << "  blocked_multinomial set:   " << nupdates / blocked_update
+            << std::endl
+            << "  blocked batched set:       " << nupdates / batched_update
+            << std::endl
+            << "  fast_multinomial sample:   " << nsamples / fast_sample
+            << std::endl
+            << "  blocked_multinomial sample:" << nsamples / blocked_sample
+            << std::endl
+            << "  fast_multinomial 4 thread add:    "
+            << nupdates / fast_parallel << std::endl
+            << "  blocked per thread add and merge: "
+            << nupdates / blocked_parallel << std::endl;
+}
+
+
+int main(int argc, char** argv) {
+  std::cout << "Blocked Multinomial Sanity Checks... \n";
+  sanity_checks();
+  std::cout << "Update and Sample Benchmark... \n";
+  benchmark(1000);
+  benchmark(10000);
+  benchmark(100000);
+  std::cout << "Done" << std::endl;
+}
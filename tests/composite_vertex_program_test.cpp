@@ -0,0 +1,200 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+/*
+ * Runs pagerank, label propagation and a degree count on a power law
+ * graph one after the other, then as a single composite vertex
+ * program, checks that both give the same vertex data and the same
+ * number of iterations, and compares the run times. The optional
+ * argument is the number of vertices.
+ */
+
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <iostream>
+#include <graphlab.hpp>
+#include "pagerank_fixture.hpp"
+
+#include <graphlab/macros_def.hpp>
+
+/// Each program writes its own field
+struct vertex_data : public graphlab::IS_POD_TYPE {
+  double pagerank;
+  size_t label;
+  size_t degree;
+};
+
+typedef graphlab::distributed_graph<vertex_data, graphlab::empty> graph_type;
+
+/// The field pagerank_fixture::dynamic_pagerank writes
+double& pagerank_of(vertex_data& data) { return data.pagerank; }
+const double& pagerank_of(const vertex_data& data) { return data.pagerank; }
+
+void init_vertex(graph_type::vertex_type& vertex) {
+  vertex.data().pagerank = 1.0;
+  vertex.data().label = vertex.id();
+  vertex.data().degree = 0;
+}
+
+
+typedef pagerank_fixture::dynamic_pagerank<graph_type> pagerank;
+
+
+struct min_label : public graphlab::IS_POD_TYPE {
+  size_t value;
+  min_label() : value(size_t(-1)) { }
+  explicit min_label(size_t value) : value(value) { }
+  min_label& operator+=(const min_label& other) {
+    value = std::min(value, other.value);
+    return *this;
+  }
+};
+
+/// Propagates the smallest vertex id through each connected component
+class label_propagation :
+  public graphlab::ivertex_program<graph_type, min_label>,
+  public graphlab::IS_POD_TYPE {
+  bool changed;
+public:
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
+  }
+  min_label gather(icontext_type& context, const vertex_type& vertex,
+                   edge_type& edge) const {
+    return min_label(edge.source().id() == vertex.id() ?
+                     edge.target().data().label : edge.source().data().label);
+  }
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& total) {
+    changed = total.value < vertex.data().label;
+    if (changed) vertex.data().label = total.value;
+  }
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return changed ? graphlab::ALL_EDGES : graphlab::NO_EDGES;
+  }
+  void scatter(icontext_type& context, const vertex_type& vertex,
+               edge_type& edge) const {
+    const vertex_type other = edge.source().id() == vertex.id() ?
+        edge.target() : edge.source();
+    if (other.data().label > vertex.data().label) context.signal(other);
+  }
+}; // end of label_propagation
+
+
+/// Counts the neighbors in a single iteration
+class degree_count :
+  public graphlab::ivertex_program<graph_type, size_t>,
+  public graphlab::IS_POD_TYPE {
+public:
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
+  }
+  size_t gather(icontext_type& context, const vertex_type& vertex,
+                edge_type& edge) const {
+    return 1;
+  }
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& total) {
+    ASSERT_EQ(total, vertex.num_in_edges() + vertex.num_out_edges());
+    vertex.data().degree = total;
+  }
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+}; // end of degree_count
+
+
+typedef graphlab::composite_vertex_program<pagerank,
+          graphlab::composite_vertex_program<label_propagation,
+                                             degree_count> >
+        composite_type;
+
+/// Runs the program from all vertices, returns the number of iterations
+template <typename VertexProgram>
+size_t run(graphlab::distributed_control& dc, graph_type& graph) {
+  graphlab::command_line_options clopts("");
+  graphlab::synchronous_engine<VertexProgram> engine(dc, graph, clopts);
+  engine.signal_all();
+  engine.start();
+  return engine.iteration();
+}
+
+
+int main(int argc, char** argv) {
+  graphlab::mpi_tools::init(argc, argv);
+  graphlab::distributed_control dc;
+  global_logger().set_log_level(LOG_WARNING);
+  const size_t nverts = argc > 1 ? atol(argv[1]) : 100000;
+
+  graph_type graph(dc);
+  pagerank_fixture::load_powerlaw(graph, nverts);
+  graph.transform_vertices(init_vertex);
+
+  graphlab::timer ti;
+  ti.start();
+  const size_t pagerank_iterations = run<pagerank>(dc, graph);
+  const size_t label_iterations = run<label_propagation>(dc, graph);
+  const size_t degree_iterations = run<degree_count>(dc, graph);
+  const double sequential_time = ti.current_time();
+  ASSERT_EQ(degree_iterations, size_t(1));
+  ASSERT_NE(pagerank_iterations, label_iterations);
+
+  const graph_type::local_graph_type& lgraph = graph.get_local_graph();
+  std::vector<vertex_data> expected(lgraph.num_vertices());
+  for (size_t v = 0; v < lgraph.num_vertices(); ++v) {
+    expected[v] = graph.l_vertex(v).data();
+  }
+
+  graph.transform_vertices(init_vertex);
+  ti.start();
+  const size_t composite_iterations = run<composite_type>(dc, graph);
+  const double composite_time = ti.current_time();
+  // each program stops signaling on its own, the longest one ends the run
+  ASSERT_EQ(composite_iterations,
+            std::max(pagerank_iterations, label_iterations));
+  for (size_t v = 0; v < lgraph.num_vertices(); ++v) {
+    const vertex_data& data = graph.l_vertex(v).data();
+    ASSERT_EQ(data.pagerank, expected[v].pagerank);
+    ASSERT_EQ(data.label, expected[v].label);
+    ASSERT_EQ(data.degree, expected[v].degree);
+  }
+  dc.cout() << "Composite program agrees with the sequential programs"
+            << std::endl
+            << graph.num_vertices() << " vertices, " << graph.num_edges()
+            << " edges" << std::endl
+            << "  sequential: " << sequential_time << " s ("
+            << pagerank_iterations << " + " << label_iterations << " + "
+            << degree_iterations << " iterations)" << std::endl
+            << "  composite:  " << composite_time << " s ("
+            << composite_iterations << " iterations)" << std::endl;
+
+  // a gather cached while only one program ran has no value for the other
+  ASSERT_TRUE(graphlab::cacheable_gather<pagerank::gather_type>::value);
+  ASSERT_TRUE(!graphlab::cacheable_gather<composite_type::gather_type>::value);
+  graphlab::mpi_tools::finalize();
+}
@@ -23,12 +23,16 @@
 
 // standard C++ headers
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
 
 #include <graphlab/rpc/dc.hpp>
 #include <graphlab/util/mpi_tools.hpp>
 #include <graphlab/rpc/dc_init_from_mpi.hpp>
 #include <graphlab/graph/distributed_graph.hpp>
 #include <graphlab/graph/graph_vertex_join.hpp>
+#include <graphlab/graph/graph_file_join.hpp>
 #include <graphlab/macros_def.hpp>
 
 
@@ -70,6 +74,16 @@ size_t get_vid_half(const VType& t) {
   return t.id() / 2;
 }
 
+template <typename VType>
+size_t get_vid_half_plus_one(const VType& t) {
+  return t.id() / 2 + 1;
+}
+
+template <typename VType>
+size_t get_vid_half_plus_one_sparse(const VType& t) {
+  return (t.id() / 2) % 3 == 0 ? size_t(-1) : t.id() / 2 + 1;
+}
+
 template <typename VType, typename U>
 void assign_data_i_to_i(VType& vtype, const U& u) {
   vtype.data().i = u.i;
@@ -80,6 +94,24 @@ void assign_data_j_to_i(VType& vtype, const U& u) {
   vtype.data().i = u.j;
 }
 
+bool parse_key_value(const std::string& line, size_t& key, size_t& value) {
+  std::stringstream strm(line);
+  strm >> key >> value;
+  return !strm.fail();
+}
+
+void reset_i_to_vid(graph_type::vertex_type& vtx) {
+  vtx.data().i = vtx.id();
+}
+
+void set_i_to_twice_vid(graph_type::vertex_type& vtx) {
+  vtx.data().i = 2 * vtx.id();
+}
+
+void assign_value_to_i(graph_type::vertex_type& vtx, const size_t& value) {
+  vtx.data().i = value;
+}
+
 
 int main(int argc, char** argv) {
   graphlab::mpi_tools::init(argc, argv);
@@ -188,6 +220,33 @@ int main(int argc, char** argv) {
     }
   }
   dc.cout() << "+ Pass test: iterate edgelist and get data. :) \n";
+
+  dc.cout() << "Test global to local vid translation...\n";
+  {
+    // g3 has dense ids and uses the dense table, g4 spreads its ids
+    // over the whole id space and keeps the cuckoo map
+    graph_type g3(dc), g4(dc);
+    const size_t nchain = 100000;
+    if (dc.procid() == 0) {
+      for (size_t i = 0; i + 1 < nchain; ++i) {
+        g3.add_edge(vertex_id_type(i), vertex_id_type(i + 1));
+      }
+      for (size_t i = 0; i + 1 < num_vertices; ++i) {
+        g4.add_edge(vertex_id_type(i * 400000007u), vertex_id_type((i + 1) * 400000007u));
+      }
+    }
+    g3.finalize();
+    g4.finalize();
+    for (graphlab::lvid_type i = 0; i < g3.num_local_vertices(); ++i) {
+      ASSERT_EQ(g3.local_vid(g3.global_vid(i)), i);
+    }
+    for (graphlab::lvid_type i = 0; i < g4.num_local_vertices(); ++i) {
+      ASSERT_EQ(g4.local_vid(g4.global_vid(i)), i);
+    }
+    ASSERT_FALSE(g3.is_master(vertex_id_type(nchain + 5000)));
+    ASSERT_FALSE(g4.is_master(vertex_id_type(1)));
+  }
+  dc.cout() << "+ Pass test: vid translation\n\n";
   std::cout << "-----------End Grid Test--------------------" << std::endl;
 
   
@@ -211,6 +270,58 @@ int main(int argc, char** argv) {
   }
 dc.barrier();
   dc.cout() << "Injective join pass\n";
+
+  dc.cout() << "Testing Injective join refresh\n";
+  g.transform_vertices(reset_i_to_vid);
+  // shift the keys of g2 by one so vertex 2k now matches vertex k + 1 of g
+  join.refresh_injective_join(get_vid<graph_type::vertex_type>,
+                              get_vid_half_plus_one<graph_type2::vertex_type>);
+  join.right_injective_join(assign_data_i_to_i<graph_type2::vertex_type,
+                                               graph_type::vertex_data_type>);
+  for (graphlab::lvid_type i = 0; i < g2.num_local_vertices(); ++i) {
+    const size_t key = g2.l_vertex(i).global_id() / 2 + 1;
+    // the last key has no match and keeps its previous value
+    const size_t expected = key < num_vertices ? key : key - 1;
+    ASSERT_EQ(g2.l_vertex(i).data().i, expected);
+  }
+  // a third of the vertices of g2 stop participating, the rest keep
+  // their keys and must still be matched
+  g.transform_vertices(set_i_to_twice_vid);
+  join.refresh_injective_join(get_vid<graph_type::vertex_type>,
+                              get_vid_half_plus_one_sparse<graph_type2::vertex_type>);
+  join.right_injective_join(assign_data_i_to_i<graph_type2::vertex_type,
+                                               graph_type::vertex_data_type>);
+  for (graphlab::lvid_type i = 0; i < g2.num_local_vertices(); ++i) {
+    const size_t key = g2.l_vertex(i).global_id() / 2 + 1;
+    const size_t previous = key < num_vertices ? key : key - 1;
+    const bool matched = (key - 1) % 3 != 0 && key < num_vertices;
+    ASSERT_EQ(g2.l_vertex(i).data().i, matched ? 2 * key : previous);
+  }
+  dc.barrier();
+  dc.cout() << "Injective join refresh pass\n";
+
+  dc.cout() << "Testing file join\n";
+  const std::string join_prefix = "distributed_graph_test_join";
+  if (dc.procid() == 0) {
+    std::ofstream fout((join_prefix + ".txt").c_str());
+    // vertex 0 has no record and key num_vertices has no vertex
+    for (size_t i = 1; i < num_vertices + 1; ++i) {
+      fout << i << "\t" << 10 * i << "\n";
+    }
+  }
+  dc.full_barrier();
+  graphlab::graph_file_join<graph_type> fjoin(dc, g);
+  fjoin.prepare(get_vid<graph_type::vertex_type>);
+  size_t num_joined = fjoin.join<size_t>(join_prefix, parse_key_value,
+                                         assign_value_to_i);
+  ASSERT_EQ(num_joined, num_vertices - 1);
+  for (graphlab::lvid_type i = 0; i < g.num_local_vertices(); ++i) {
+    const size_t vid = g.l_vertex(i).global_id();
+    ASSERT_EQ(g.l_vertex(i).data().i, vid == 0 ? 0 : 10 * vid);
+  }
+  dc.full_barrier();
+  if (dc.procid() == 0) std::remove((join_prefix + ".txt").c_str());
+  dc.cout() << "File join pass\n";
   graphlab::mpi_tools::finalize();
 }
 
@@ -0,0 +1,251 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+/*
+ * Runs a token resampling program shaped like the collapsed Gibbs
+ * sampler of cgs_lda on a bipartite graph whose edge data holds a
+ * vector of token assignments, once with the edge data in memory and
+ * once in memory mapped files (graph option "edgestore"), checks that
+ * both produce the same counts and that all the files are released,
+ * and reports the runtime of both. The optional arguments are the
+ * number of documents of the benchmark graph and the directory of the
+ * files. Run it under a memory limit (e.g. a memory cgroup) to compare
+ * the two placements when the edge data does not fit.
+ */
+
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <graphlab.hpp>
+#include <graphlab/util/file_backed_allocator.hpp>
+#include <graphlab/macros_def.hpp>
+
+const size_t NTOPICS = 8;
+
+typedef std::vector<uint16_t, graphlab::file_backed_allocator<uint16_t> >
+    assignment_type;
+
+struct token_edge {
+  assignment_type assignment;
+  token_edge(size_t ntokens = 0) : assignment(ntokens, 0) { }
+  void save(graphlab::oarchive& arc) const { arc << assignment; }
+  void load(graphlab::iarchive& arc) { arc >> assignment; }
+};
+
+struct topic_counts {
+  std::vector<int> counts;
+  topic_counts() : counts(NTOPICS, 0) { }
+  topic_counts& operator+=(const topic_counts& other) {
+    for (size_t t = 0; t < NTOPICS; ++t) counts[t] += other.counts[t];
+    return *this;
+  }
+  void save(graphlab::oarchive& arc) const { arc << counts; }
+  void load(graphlab::iarchive& arc) { arc >> counts; }
+};
+
+typedef graphlab::distributed_graph<topic_counts, token_edge> graph_type;
+
+/**
+ * Counts the topics of the tokens of a vertex, then moves every token
+ * of a document to the topic its document and word count the most,
+ * which is deterministic, so that both placements must agree exactly.
+ */
+class resample_tokens :
+  public graphlab::ivertex_program<graph_type, topic_counts>,
+  public graphlab::IS_POD_TYPE {
+public:
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
+  }
+  topic_counts gather(icontext_type& context, const vertex_type& vertex,
+                      edge_type& edge) const {
+    topic_counts ret;
+    for (size_t i = 0; i < edge.data().assignment.size(); ++i) {
+      ++ret.counts[edge.data().assignment[i]];
+    }
+    return ret;
+  }
+  void apply(icontext_type& context, vertex_type& vertex,
+             const topic_counts& total) {
+    vertex.data() = total;
+    context.signal(vertex);
+  }
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return graphlab::OUT_EDGES;
+  }
+  void scatter(icontext_type& context, const vertex_type& vertex,
+               edge_type& edge) const {
+    const std::vector<int>& doc = edge.source().data().counts;
+    const std::vector<int>& word = edge.target().data().counts;
+    assignment_type& assignment = edge.data().assignment;
+    for (size_t i = 0; i < assignment.size(); ++i) {
+      size_t best = (assignment[i] + i) % NTOPICS;
+      for (size_t t = 0; t < NTOPICS; ++t) {
+        if (doc[t] + word[t] > doc[best] + word[best]) best = t;
+      }
+      assignment[i] = uint16_t(best);
+    }
+  }
+}; // end of resample_tokens
+
+void initialize_topics(graph_type::edge_type& edge) {
+  assignment_type& assignment = edge.data().assignment;
+  for (size_t i = 0; i < assignment.size(); ++i) {
+    assignment[i] = uint16_t((edge.source().id() + i) % NTOPICS);
+  }
+}
+
+/// A corpus of ndocs documents of 50 words each, drawn with a skew
+void load_corpus(graph_type& graph, size_t ndocs) {
+  const size_t nwords = ndocs;
+  graphlab::random::counter_generator gen(7, 0);
+  for (size_t doc = 0; doc < ndocs; ++doc) {
+    std::set<size_t> words;
+    while (words.size() < 50) {
+      const double u = gen.rand01();
+      words.insert(std::min(size_t(u * u * nwords), nwords - 1));
+    }
+    foreach(size_t word, words) {
+      graph.add_edge(doc, ndocs + word, token_edge(1 + gen.uniform<size_t>(0, 7)));
+    }
+  }
+  graph.finalize();
+  graph.transform_edges(initialize_topics);
+}
+
+struct count_collector {
+  std::vector<int>* counts;
+  void operator()(graph_type::vertex_type& vertex) {
+    for (size_t t = 0; t < NTOPICS; ++t) {
+      (*counts)[vertex.id() * NTOPICS + t] = vertex.data().counts[t];
+    }
+  }
+};
+
+/**
+ * Runs the program on a new graph with the edge data in directory, or
+ * in memory if it is empty, and returns the final counts of all the
+ * vertices.
+ */
+std::vector<int> run(graphlab::distributed_control& dc, size_t ndocs,
+                     const std::string& directory) {
+  graphlab::graphlab_options opts;
+  if (!directory.empty()) {
+    opts.get_graph_args().set_option("edgestore", directory);
+  }
+  opts.get_engine_args().set_option("max_iterations", 6);
+  std::vector<int> counts;
+  {
+    graphlab::timer ti;
+    ti.start();
+    graph_type graph(dc, opts);
+    load_corpus(graph, ndocs);
+    const double load_time = ti.current_time();
+    if (!directory.empty()) {
+      ASSERT_GT(graphlab::file_backed_memory::mapped_bytes(), size_t(0));
+    }
+    graphlab::synchronous_engine<resample_tokens> engine(dc, graph, opts);
+    engine.signal_all();
+    ti.start();
+    engine.start();
+    const double runtime = ti.current_time();
+    counts.resize(graph.num_vertices() * NTOPICS);
+    count_collector collector = {&counts};
+    graph.transform_vertices(collector);
+    std::cout << (directory.empty() ? "in memory" : "edgestore")
+              << ": " << graph.num_edges() << " edges, "
+              << graphlab::file_backed_memory::mapped_bytes()
+              << " bytes mapped, loaded in " << load_time << " s, "
+              << engine.iteration() << " iterations in " << runtime << " s"
+              << std::endl;
+  }
+  // nothing else is file backed once the graph is gone
+  graphlab::file_backed_memory::set_directory("");
+  ASSERT_EQ(graphlab::file_backed_memory::mapped_bytes(), size_t(0));
+  return counts;
+}
+
+
+/// Reallocates vectors of many sizes, checking their contents
+void churn(size_t rounds) {
+  std::vector<assignment_type> vectors(1000);
+  for (size_t round = 0; round < rounds; ++round) {
+    for (size_t i = 0; i < vectors.size(); ++i) {
+      vectors[i].assign(1 + (i * 7 + round) % 300, uint16_t(i + round));
+    }
+    for (size_t i = 0; i < vectors.size(); ++i) {
+      ASSERT_EQ(vectors[i].size(), 1 + (i * 7 + round) % 300);
+      ASSERT_EQ(vectors[i].front(), uint16_t(i + round));
+      ASSERT_EQ(vectors[i].back(), uint16_t(i + round));
+    }
+  }
+}
+
+void test_allocator(const std::string& directory) {
+  namespace fbm = graphlab::file_backed_memory;
+  fbm::set_directory(directory);
+  std::vector<assignment_type> small(1000);
+  for (size_t i = 0; i < small.size(); ++i) small[i].assign(i + 1, uint16_t(i));
+  assignment_type large(fbm::CHUNK_SIZE / 2, 3);
+  ASSERT_EQ(fbm::mapped_bytes(), fbm::CHUNK_SIZE + large.size() * sizeof(uint16_t));
+  for (size_t i = 0; i < small.size(); ++i) {
+    ASSERT_EQ(small[i].size(), i + 1);
+    ASSERT_EQ(small[i].back(), uint16_t(i));
+  }
+  ASSERT_EQ(large.back(), uint16_t(3));
+  assignment_type().swap(large);
+  ASSERT_EQ(fbm::mapped_bytes(), fbm::CHUNK_SIZE);
+  // a freed block is reused by the next request of its size
+  const uint16_t* freed = &small[10][0];
+  assignment_type().swap(small[10]);
+  small[10].assign(11, uint16_t(10));
+  ASSERT_TRUE(&small[10][0] == freed);
+  ASSERT_EQ(fbm::mapped_bytes(), fbm::CHUNK_SIZE);
+  std::vector<assignment_type>().swap(small);
+  graphlab::thread_pool threads(8);
+  for (size_t i = 0; i < 8; ++i) threads.launch(boost::bind(churn, 20));
+  threads.join();
+  // the chunks are kept until the directory changes
+  fbm::set_directory("");
+  ASSERT_EQ(fbm::mapped_bytes(), size_t(0));
+  std::cout << "File backed allocations are released" << std::endl;
+}
+
+
+int main(int argc, char** argv) {
+  graphlab::mpi_tools::init(argc, argv);
+  graphlab::distributed_control dc;
+  const size_t ndocs = argc > 1 ? atol(argv[1]) : 20000;
+  const char* tmpdir = getenv("TMPDIR");
+  const std::string directory = argc > 2 ? argv[2] : tmpdir ? tmpdir : "/tmp";
+  test_allocator(directory);
+  const std::vector<int> in_memory = run(dc, ndocs, "");
+  const std::vector<int> file_backed = run(dc, ndocs, directory);
+  ASSERT_TRUE(in_memory == file_backed);
+  std::cout << "Both placements agree" << std::endl;
+  graphlab::mpi_tools::finalize();
+}
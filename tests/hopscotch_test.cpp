@@ -1,6 +1,7 @@
 #include <graphlab/util/hopscotch_table.hpp>
 #include <graphlab/util/hopscotch_map.hpp>
 #include <graphlab/util/cuckoo_map_pow2.hpp>
+#include <graphlab/util/concurrent_hopscotch_map.hpp>
 #include <boost/unordered_set.hpp>
 #include <boost/bind.hpp>
 #include <graphlab/logger/assertions.hpp>
@@ -284,6 +285,114 @@ void benchmark() {
 
 
 
+struct add_count {
+  uint32_t delta;
+  add_count(uint32_t delta): delta(delta) { }
+  void operator()(uint32_t& v) const { v += delta; }
+};
+
+void parallel_counter(graphlab::concurrent_hopscotch_map<uint32_t, uint32_t>* cm,
+                      size_t num_keys, size_t num_ops, size_t seed) {
+  for (size_t i = 0; i < num_ops; ++i) {
+    // every key receives the same number of increments from every thread
+    const uint32_t key = 17 * ((i + seed) % num_keys);
+    if (i % 4 == 3) cm->get_sync(key);
+    else cm->update_sync(key, add_count(1));
+  }
+}
+
+typedef graphlab::hopscotch_map<uint32_t, uint32_t, false> unsync_map_type;
+
+void parallel_locked_counter(unsync_map_type* cm, graphlab::mutex* lock,
+                             size_t num_keys, size_t num_ops, size_t seed) {
+  for (size_t i = 0; i < num_ops; ++i) {
+    const uint32_t key = 17 * ((i + seed) % num_keys);
+    lock->lock();
+    if (i % 4 == 3) cm->count(key);
+    else (*cm)[key] += 1;
+    lock->unlock();
+  }
+}
+
+void concurrent_map_sanity_checks() {
+  graphlab::concurrent_hopscotch_map<uint32_t, uint32_t> cm;
+  const size_t num_keys = 100000;
+  const size_t num_ops = 4 * num_keys;
+  graphlab::thread_group thrgroup;
+  for (size_t i = 0; i < 8; ++i) {
+    thrgroup.launch(boost::bind(parallel_counter, &cm, num_keys, num_ops, i));
+  }
+  thrgroup.join();
+  ASSERT_EQ(cm.size(), num_keys);
+  for (size_t i = 0; i < num_keys; ++i) {
+    std::pair<bool, uint32_t> res = cm.get_sync(17 * i);
+    ASSERT_TRUE(res.first);
+    ASSERT_EQ(res.second, 8 * 3);
+  }
+  for (size_t i = 0; i < num_keys; i += 2) ASSERT_TRUE(cm.erase_sync(17 * i));
+  ASSERT_FALSE(cm.erase_sync(0));
+  ASSERT_EQ(cm.size_sync(), num_keys / 2);
+  cm.put_sync(0, 5);
+  ASSERT_EQ(cm.get_sync(0).second, 5);
+  ASSERT_FALSE(cm.get_sync(1).first);
+
+  std::stringstream strm;
+  graphlab::oarchive oarc(strm);
+  oarc << cm;
+  strm.flush();
+  graphlab::concurrent_hopscotch_map<uint32_t, uint32_t> cm2(4);
+  graphlab::iarchive iarc(strm);
+  iarc >> cm2;
+  ASSERT_EQ(cm2.size(), num_keys / 2 + 1);
+  ASSERT_EQ(cm2.get_sync(17).second, 8 * 3);
+}
+
+/*
+ * Degree counting style contention: 3 updates for every lookup over a
+ * key set which grows from empty, so that the shards resize while being
+ * updated. Compares against a single hopscotch_map behind one mutex.
+ * The total number of operations is fixed and split over the threads.
+ */
+void contention_benchmark() {
+  const size_t num_keys = 1000000;
+  const size_t total_ops = 8000000;
+  graphlab::timer ti;
+  for (size_t nthreads = 1; nthreads <= 64; nthreads *= 2) {
+    const size_t ops_per_thread = total_ops / nthreads;
+    double concurrent_time, locked_time;
+    {
+      graphlab::concurrent_hopscotch_map<uint32_t, uint32_t> cm;
+      graphlab::thread_group thrgroup;
+      ti.start();
+      for (size_t i = 0; i < nthreads; ++i) {
+        thrgroup.launch(boost::bind(parallel_counter, &cm, num_keys,
+                                    ops_per_thread, i * 7919));
+      }
+      thrgroup.join();
+      concurrent_time = ti.current_time();
+    }
+    {
+      unsync_map_type cm;
+      graphlab::mutex lock;
+      graphlab::thread_group thrgroup;
+      ti.start();
+      for (size_t i = 0; i < nthreads; ++i) {
+        thrgroup.launch(boost::bind(parallel_locked_counter, &cm, &lock,
+                                    num_keys, ops_per_thread, i * 7919));
+      }
+      thrgroup.join();
+      locked_time = ti.current_time();
+    }
+    const double num_ops = double(nthreads * ops_per_thread);
+    std::cout << nthreads << " threads: concurrent hopscotch "
+              << num_ops / concurrent_time / 1e6 << "M ops/s, "
+              << "locked hopscotch " << num_ops / locked_time / 1e6
+              << "M ops/s" << std::endl;
+  }
+}
+
+
+
 int main(int argc, char** argv) {
   std::cout << "Hopscotch Table Parallel Access Sanity Checks... \n";
   sanity_checks();
@@ -291,7 +400,13 @@ int main(int argc, char** argv) {
   std::cout << "Hopscotch Map Sequential Access Sanity Checks... \n";
   hopscotch_map_sanity_checks();
 
+  std::cout << "Concurrent Hopscotch Map Sanity Checks... \n";
+  concurrent_map_sanity_checks();
+
   std::cout << "Map Benchmarks... \n";
   benchmark();
+
+  std::cout << "Concurrent Map Contention Benchmark... \n";
+  contention_benchmark();
   std::cout << "Done" << std::endl;
 }
@@ -0,0 +1,210 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+/*
+ * Runs pagerank and a triangle count on the same synthetic power law
+ * graph under each huge page policy, and reports the runtime and the
+ * data TLB misses of each run. The TLB misses are read from the
+ * hardware counters through perf_event_open and are reported as n/a
+ * where the counters are not available.
+ */
+
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <graphlab.hpp>
+#include <graphlab/util/huge_page_allocator.hpp>
+#include "pagerank_fixture.hpp"
+
+/// Counts the data TLB read misses of this process and its new threads
+class dtlb_counter {
+  int fd;
+public:
+  dtlb_counter() {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB |
+        (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+  ~dtlb_counter() { if (fd >= 0) close(fd); }
+  void start() {
+    if (fd < 0) return;
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+  /// Returns the misses since start(), or -1 if not available
+  long long stop() {
+    if (fd < 0) return -1;
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    long long count = 0;
+    if (read(fd, &count, sizeof(count)) != sizeof(count)) return -1;
+    return count;
+  }
+};
+
+
+typedef graphlab::distributed_graph<double, graphlab::empty> pr_graph_type;
+/// Stopped by the max_iterations of the engine
+typedef pagerank_fixture::fixed_pagerank<pr_graph_type, 0> pagerank;
+
+
+typedef std::vector<graphlab::vertex_id_type> vid_list;
+typedef graphlab::distributed_graph<vid_list, size_t> tc_graph_type;
+
+struct neighbor_gather {
+  vid_list vids;
+  neighbor_gather& operator+=(const neighbor_gather& other) {
+    vids.insert(vids.end(), other.vids.begin(), other.vids.end());
+    return *this;
+  }
+  void save(graphlab::oarchive& oarc) const { oarc << vids; }
+  void load(graphlab::iarchive& iarc) { iarc >> vids; }
+};
+
+/// Counts, for every edge, the neighbors its two ends have in common
+class triangle_count :
+  public graphlab::ivertex_program<tc_graph_type, neighbor_gather>,
+  public graphlab::IS_POD_TYPE {
+public:
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
+  }
+  gather_type gather(icontext_type& context, const vertex_type& vertex,
+                     edge_type& edge) const {
+    neighbor_gather ret;
+    ret.vids.push_back(edge.source().id() == vertex.id() ?
+                       edge.target().id() : edge.source().id());
+    return ret;
+  }
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& total) {
+    vid_list& vids = vertex.data();
+    vids = total.vids;
+    std::sort(vids.begin(), vids.end());
+    vids.erase(std::unique(vids.begin(), vids.end()), vids.end());
+  }
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return graphlab::OUT_EDGES;
+  }
+  void scatter(icontext_type& context, const vertex_type& vertex,
+               edge_type& edge) const {
+    const vid_list& a = edge.source().data();
+    const vid_list& b = edge.target().data();
+    size_t common = 0;
+    vid_list::const_iterator i = a.begin(), j = b.begin();
+    while (i != a.end() && j != b.end()) {
+      if (*i < *j) ++i;
+      else if (*j < *i) ++j;
+      else { ++common; ++i; ++j; }
+    }
+    edge.data() = common;
+  }
+}; // end of triangle_count
+
+size_t edge_triangles(const tc_graph_type::edge_type& edge) {
+  return edge.data();
+}
+
+
+void report(graphlab::distributed_control& dc, const std::string& name,
+            double elapsed, long long misses) {
+  dc.cout() << name << ": " << elapsed << " s, dTLB read misses: ";
+  if (misses < 0) dc.cout() << "n/a";
+  else dc.cout() << misses;
+  dc.cout() << std::endl;
+}
+
+/// Runs both programs under a policy and returns the triangle count
+size_t run_policy(graphlab::distributed_control& dc,
+                  const std::string& policy, size_t nverts,
+                  size_t niters) {
+  graphlab::command_line_options clopts("Huge page benchmark.");
+  clopts.get_graph_args().set_option("hugepages", policy);
+  clopts.get_engine_args().set_option("max_iterations", niters);
+  dtlb_counter counter;
+  graphlab::timer ti;
+  {
+    pr_graph_type graph(dc, clopts);
+    pagerank_fixture::load_powerlaw(graph, nverts);
+    graphlab::synchronous_engine<pagerank> engine(dc, graph, clopts);
+    engine.signal_all();
+    ti.start(); counter.start();
+    engine.start();
+    const long long misses = counter.stop();
+    report(dc, policy + " pagerank", ti.current_time(), misses);
+  }
+  size_t triangles;
+  {
+    clopts.get_engine_args().set_option("max_iterations", 1);
+    tc_graph_type graph(dc, clopts);
+    graph.load_synthetic_powerlaw(nverts);
+    graph.finalize();
+    graphlab::synchronous_engine<triangle_count> engine(dc, graph, clopts);
+    engine.signal_all();
+    ti.start(); counter.start();
+    engine.start();
+    const long long misses = counter.stop();
+    report(dc, policy + " triangle count", ti.current_time(), misses);
+    triangles = graph.map_reduce_edges<size_t>(edge_triangles);
+    dc.cout() << policy << " bytes on huge pages: "
+              << graphlab::huge_pages::mapped_bytes() << std::endl;
+  }
+  return triangles;
+}
+
+
+int main(int argc, char** argv) {
+  graphlab::mpi_tools::init(argc, argv);
+  graphlab::distributed_control dc;
+  const size_t nverts = argc > 1 ? atol(argv[1]) : 200000;
+  const size_t niters = 5;
+
+  // the power law generator draws from the shared random source, so
+  // reseed it for every policy to build the same graph
+  graphlab::random::seed(1);
+  const size_t none_triangles = run_policy(dc, "none", nverts, niters);
+  graphlab::random::seed(1);
+  const size_t thp_triangles = run_policy(dc, "transparent", nverts, niters);
+  graphlab::random::seed(1);
+  const size_t explicit_triangles = run_policy(dc, "explicit", nverts, niters);
+  ASSERT_EQ(none_triangles, thp_triangles);
+  ASSERT_EQ(none_triangles, explicit_triangles);
+  // everything was freed with the graphs and the engines
+  ASSERT_EQ(graphlab::huge_pages::mapped_bytes(), 0);
+  graphlab::huge_pages::set_policy(graphlab::huge_pages::NONE);
+  graphlab::mpi_tools::finalize();
+}
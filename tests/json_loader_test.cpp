@@ -0,0 +1,205 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+/*
+ * Dumps the local graph of a random graph in the json format read by
+ * distributed_graph::load_json(), loads it back, checks that the
+ * loaded graph has the same vertices, edges and data, and compares the
+ * load time with the ingress of the same edges from a tsv file. The
+ * optional arguments are the number of vertices and edges and the
+ * directory of the files.
+ */
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <boost/lexical_cast.hpp>
+#include <boost/filesystem.hpp>
+#include <graphlab.hpp>
+
+#include <graphlab/macros_def.hpp>
+
+typedef graphlab::distributed_graph<double, double> graph_type;
+typedef graph_type::local_graph_type local_graph_type;
+typedef graph_type::lvid_type lvid_type;
+
+bool parse_double(double& value, const std::string& str) {
+  value = strtod(str.c_str(), NULL);
+  return true;
+}
+
+/// Writes the lvid array as a json array
+template <typename ArrayType>
+void write_array(std::ostream& out, const ArrayType& array) {
+  out << "[";
+  for (size_t i = 0; i < array.size(); ++i) {
+    if (i > 0) out << ",";
+    out << array[i];
+  }
+  out << "]";
+}
+
+/**
+ * Writes the four files of the local graph of processor 0 under prefix.
+ * The edge data are written as json numbers and the vertex data as
+ * strings, so that both are handed to the parsers.
+ */
+void save_json(const graph_type& graph, const std::string& prefix) {
+  const local_graph_type& lgraph = graph.get_local_graph();
+  boost::filesystem::create_directories(prefix + "/graph");
+  boost::filesystem::create_directories(prefix + "/vrecord");
+
+  std::ofstream fgraph((prefix + "/graph/graph0-r-00000").c_str());
+  fgraph << "{\"numEdges\":" << lgraph.num_edges()
+         << ",\"numVertices\":" << lgraph.num_vertices()
+         << ",\"csr\":{\"rowIndex\":";
+  write_array(fgraph, lgraph.get_out_index_storage());
+  fgraph << ",\"colIndex\":";
+  write_array(fgraph, lgraph.get_out_edge_storage());
+  fgraph << "},\"csc\":{\"rowIndex\":";
+  write_array(fgraph, lgraph.get_in_index_storage());
+  fgraph << ",\"colIndex\":";
+  write_array(fgraph, lgraph.get_in_edge_storage());
+  // the in edges in CSC order carry their CSR edge ids
+  std::vector<size_t> c2r;
+  c2r.reserve(lgraph.num_edges());
+  for (lvid_type v = 0; v < lgraph.num_vertices(); ++v) {
+    foreach(const local_graph_type::edge_type& e, lgraph.in_edges(v)) {
+      c2r.push_back(e.id());
+    }
+  }
+  fgraph << "},\"c2rMap\":";
+  write_array(fgraph, c2r);
+  fgraph << "}\n";
+
+  std::ofstream fvid((prefix + "/graph/vid2lvid0-r-00000").c_str());
+  fvid << "{\"vid2lvid\":{";
+  for (lvid_type v = 0; v < lgraph.num_vertices(); ++v) {
+    if (v > 0) fvid << ",";
+    fvid << "\"" << graph.global_vid(v) << "\":" << v;
+  }
+  fvid << "}}\n";
+
+  std::ofstream fedata((prefix + "/graph/edata0-r-00000").c_str());
+  fedata.precision(17);
+  fedata << "{\"edataList\":";
+  write_array(fedata, lgraph.get_edge_data_storage());
+  fedata << "}\n";
+
+  std::ofstream fvdata((prefix + "/vrecord/vdata0-r-00000").c_str());
+  fvdata.precision(17);
+  for (lvid_type v = 0; v < lgraph.num_vertices(); ++v) {
+    const graph_type::vertex_record& record = graph.l_get_vertex_record(v);
+    fvdata << "{\"gvid\":" << record.gvid << ",\"owner\":" << record.owner
+           << ",\"inEdges\":" << record.num_in_edges
+           << ",\"outEdges\":" << record.num_out_edges
+           << ",\"mirrors\":[],\"VertexData\":\""
+           << graph.l_vertex(v).data() << "\"}\n";
+  }
+}
+
+void check_same(const graph_type& expected, const graph_type& graph) {
+  const local_graph_type& elgraph = expected.get_local_graph();
+  const local_graph_type& lgraph = graph.get_local_graph();
+  ASSERT_EQ(graph.num_vertices(), expected.num_vertices());
+  ASSERT_EQ(graph.num_edges(), expected.num_edges());
+  ASSERT_EQ(lgraph.num_vertices(), elgraph.num_vertices());
+  for (lvid_type v = 0; v < lgraph.num_vertices(); ++v) {
+    const lvid_type ev = expected.local_vid(graph.global_vid(v));
+    ASSERT_EQ(ev, v);
+    ASSERT_EQ(graph.l_vertex(v).data(), expected.l_vertex(v).data());
+    ASSERT_EQ(graph.l_get_vertex_record(v).owner,
+              expected.l_get_vertex_record(v).owner);
+    ASSERT_EQ(graph.l_get_vertex_record(v).num_in_edges,
+              expected.l_get_vertex_record(v).num_in_edges);
+    ASSERT_EQ(lgraph.num_out_edges(v), elgraph.num_out_edges(v));
+    ASSERT_EQ(lgraph.num_in_edges(v), elgraph.num_in_edges(v));
+    local_graph_type::edge_list_type out = lgraph.out_edges(v);
+    local_graph_type::edge_list_type eout = elgraph.out_edges(v);
+    for (size_t i = 0; i < out.size(); ++i) {
+      ASSERT_EQ(out[i].target().id(), eout[i].target().id());
+      ASSERT_EQ(out[i].data(), eout[i].data());
+    }
+    local_graph_type::edge_list_type in = lgraph.in_edges(v);
+    local_graph_type::edge_list_type ein = elgraph.in_edges(v);
+    for (size_t i = 0; i < in.size(); ++i) {
+      ASSERT_EQ(in[i].source().id(), ein[i].source().id());
+      ASSERT_EQ(in[i].data(), ein[i].data());
+    }
+  }
+}
+
+
+int main(int argc, char** argv) {
+  graphlab::mpi_tools::init(argc, argv);
+  graphlab::distributed_control dc;
+  const size_t nverts = argc > 1 ? atol(argv[1]) : 100000;
+  const size_t nedges = argc > 2 ? atol(argv[2]) : 1000000;
+  const char* tmpdir = getenv("TMPDIR");
+  const std::string dir = (argc > 3 ? std::string(argv[3]) :
+                           std::string(tmpdir != NULL ? tmpdir : "/tmp")) +
+      "/json_loader_test";
+  boost::filesystem::remove_all(dir);
+  boost::filesystem::create_directories(dir);
+
+  graph_type graph(dc);
+  graphlab::random::counter_generator gen(7, 0);
+  std::ofstream ftsv((dir + "/edges.tsv").c_str());
+  for (size_t i = 0; i < nedges; ++i) {
+    const size_t source = gen.uniform<size_t>(0, nverts - 1);
+    const size_t target = gen.uniform<size_t>(0, nverts - 1);
+    if (source == target) continue;
+    graph.add_edge(source, target, double(i % 1000) / 8);
+    ftsv << source << "\t" << target << "\n";
+  }
+  ftsv.close();
+  graph.finalize();
+  for (lvid_type v = 0; v < graph.get_local_graph().num_vertices(); ++v) {
+    graph.l_vertex(v).data() = double(graph.global_vid(v)) / 4;
+  }
+  save_json(graph, dir + "/json");
+
+  graphlab::timer ti;
+  ti.start();
+  graph_type tsv_graph(dc);
+  tsv_graph.load_format(dir + "/edges.tsv", "tsv");
+  tsv_graph.finalize();
+  const double tsv_time = ti.current_time();
+  ASSERT_EQ(tsv_graph.num_edges(), graph.num_edges());
+
+  ti.start();
+  graph_type json_graph(dc);
+  json_graph.load_json(dir + "/json", false, parse_double, parse_double);
+  const double json_time = ti.current_time();
+  check_same(graph, json_graph);
+  std::cout << "Loaded graph agrees with the saved graph" << std::endl;
+
+  std::cout << graph.num_vertices() << " vertices, " << graph.num_edges()
+            << " edges" << std::endl
+            << "  tsv ingress: " << tsv_time << " s" << std::endl
+            << "  json load:   " << json_time << " s" << std::endl;
+  boost::filesystem::remove_all(dir);
+  graphlab::mpi_tools::finalize();
+}
@@ -0,0 +1,141 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+/*
+ * The pagerank vertex programs and power law fixture shared by the
+ * engine tests. The programs read and write the rank of a vertex
+ * through pagerank_of(), which tests whose vertex data holds more than
+ * the rank overload for their vertex data type.
+ */
+#ifndef GRAPHLAB_PAGERANK_FIXTURE_HPP
+#define GRAPHLAB_PAGERANK_FIXTURE_HPP
+
+#include <cmath>
+#include <graphlab.hpp>
+
+namespace pagerank_fixture {
+
+  /// The rank of a vertex whose data is the rank
+  inline double& pagerank_of(double& data) { return data; }
+  inline const double& pagerank_of(const double& data) { return data; }
+
+  /// The change of rank above which dynamic_pagerank signals
+  const double TOLERANCE = 1e-3;
+
+  /**
+   * Dynamic pagerank, whose scatter only signals the out neighbors of
+   * the vertices which changed by more than TOLERANCE.
+   */
+  template <typename Graph>
+  class dynamic_pagerank :
+    public graphlab::ivertex_program<Graph, double>,
+    public graphlab::IS_POD_TYPE {
+    double change;
+  public:
+    typedef graphlab::ivertex_program<Graph, double> base;
+    typedef typename base::icontext_type icontext_type;
+    typedef typename base::vertex_type vertex_type;
+    typedef typename base::edge_type edge_type;
+
+    graphlab::edge_dir_type gather_edges(icontext_type& context,
+                                         const vertex_type& vertex) const {
+      return graphlab::IN_EDGES;
+    }
+    double gather(icontext_type& context, const vertex_type& vertex,
+                  edge_type& edge) const {
+      return pagerank_of(edge.source().data()) / edge.source().num_out_edges();
+    }
+    void apply(icontext_type& context, vertex_type& vertex,
+               const double& total) {
+      const double newval = 0.15 + 0.85 * total;
+      change = std::fabs(newval - pagerank_of(vertex.data()));
+      pagerank_of(vertex.data()) = newval;
+    }
+    graphlab::edge_dir_type scatter_edges(icontext_type& context,
+                                          const vertex_type& vertex) const {
+      return change > TOLERANCE ? graphlab::OUT_EDGES : graphlab::NO_EDGES;
+    }
+    void scatter(icontext_type& context, const vertex_type& vertex,
+                 edge_type& edge) const {
+      context.signal(edge.target());
+    }
+  }; // end of dynamic_pagerank
+
+
+  /**
+   * Pagerank which updates every vertex for Iterations iterations, or
+   * until the engine stops at its max_iterations if Iterations is 0.
+   */
+  template <typename Graph, int Iterations>
+  class fixed_pagerank :
+    public graphlab::ivertex_program<Graph, double>,
+    public graphlab::IS_POD_TYPE {
+  public:
+    typedef graphlab::ivertex_program<Graph, double> base;
+    typedef typename base::icontext_type icontext_type;
+    typedef typename base::vertex_type vertex_type;
+    typedef typename base::edge_type edge_type;
+
+    graphlab::edge_dir_type gather_edges(icontext_type& context,
+                                         const vertex_type& vertex) const {
+      return graphlab::IN_EDGES;
+    }
+    double gather(icontext_type& context, const vertex_type& vertex,
+                  edge_type& edge) const {
+      return pagerank_of(edge.source().data()) / edge.source().num_out_edges();
+    }
+    void apply(icontext_type& context, vertex_type& vertex,
+               const double& total) {
+      pagerank_of(vertex.data()) = 0.15 + 0.85 * total;
+      if (Iterations == 0 || context.iteration() + 1 < Iterations) {
+        context.signal(vertex);
+      }
+    }
+    graphlab::edge_dir_type scatter_edges(icontext_type& context,
+                                          const vertex_type& vertex) const {
+      return graphlab::NO_EDGES;
+    }
+  }; // end of fixed_pagerank
+
+
+  template <typename Graph>
+  void init_pagerank(typename Graph::vertex_type& vertex) {
+    pagerank_of(vertex.data()) = 1;
+  }
+
+  template <typename Graph>
+  double pagerank_value(const typename Graph::vertex_type& vertex) {
+    return pagerank_of(vertex.data());
+  }
+
+  /// Loads and finalizes a synthetic power law graph with unit ranks
+  template <typename Graph>
+  void load_powerlaw(Graph& graph, size_t nverts) {
+    graph.load_synthetic_powerlaw(nverts);
+    graph.finalize();
+    graph.transform_vertices(init_pagerank<Graph>);
+  }
+
+} // end of namespace pagerank_fixture
+
+#endif
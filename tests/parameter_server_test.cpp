@@ -0,0 +1,129 @@
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/rpc/parameter_server.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/util/timer.hpp>
+#include <boost/bind.hpp>
+
+using namespace graphlab;
+
+const size_t NUM_PARAMS = 1000;
+const size_t NUM_ADDS = 1000000;
+
+void adder(parameter_server<int>* ps, size_t seed) {
+  for (size_t i = 0; i < NUM_ADDS; ++i) {
+    const size_t p = (i * 7919 + seed) % NUM_PARAMS;
+    ps->add(p, 1);
+    // reads see at least our own update
+    ASSERT_GE(ps->get(p), 1);
+  }
+}
+
+void clocker(parameter_server<int>* ps, size_t nclocks) {
+  for (size_t i = 0; i < nclocks; ++i) ps->clock();
+}
+
+const size_t STALENESS = 1;
+const size_t NUM_CLOCKS = 20;
+
+/// Adds 1 to the slot of this machine per clock. Machine 1 is slow.
+void slot_clocker(parameter_server<int>* ps, procid_t procid,
+                  volatile bool* done) {
+  for (size_t c = 0; c < NUM_CLOCKS; ++c) {
+    ps->add(procid, 1);
+    if (procid == 1) timer::sleep_ms(20);
+    ps->clock();
+  }
+  *done = true;
+}
+
+/**
+ * Reads the cache while another thread clocks. Whenever the cache is
+ * fresh, it holds the adds every machine made before its
+ * (clock - staleness)-th clock.
+ */
+void fresh_reader(parameter_server<int>* ps, size_t numprocs,
+                  volatile bool* done, size_t* stalls) {
+  while (!*done) {
+    const size_t c = ps->current_clock();
+    if (!ps->fresh()) {
+      ++(*stalls);
+      sched_yield();
+      continue;
+    }
+    for (size_t q = 0; q < numprocs; ++q) {
+      if (c > STALENESS) ASSERT_GE(size_t(ps->get(q)), c - STALENESS);
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  mpi_tools::init(argc, argv);
+  distributed_control dc;
+  const size_t nthreads = 4;
+  parameter_server<int> ps(dc, NUM_PARAMS, 1);
+
+  // concurrent adds while one thread keeps clocking
+  timer ti;
+  ti.start();
+  thread_group group;
+  for (size_t i = 0; i < nthreads; ++i) {
+    group.launch(boost::bind(adder, &ps, dc.procid() * nthreads + i));
+  }
+  group.launch(boost::bind(clocker, &ps, 10));
+  group.join();
+  const double elapsed = ti.current_time();
+  dc.cout() << nthreads * NUM_ADDS << " adds per machine from " << nthreads
+            << " threads in " << elapsed << " s: "
+            << nthreads * NUM_ADDS / elapsed << " adds/s" << std::endl;
+
+  // once synchronized every replica holds every update
+  ps.synchronize();
+  size_t total = 0;
+  for (size_t i = 0; i < NUM_PARAMS; ++i) total += ps.get(i);
+  ASSERT_EQ(total, nthreads * NUM_ADDS * dc.numprocs());
+  ASSERT_EQ(ps.get(0), ps.get(NUM_PARAMS - 1));
+
+  // range access and pull
+  std::vector<int> deltas(10, 2);
+  ps.add_range(NUM_PARAMS - 10, deltas);
+  std::vector<int> values;
+  ps.get_range(NUM_PARAMS - 10, NUM_PARAMS, values);
+  ASSERT_EQ(values.size(), 10);
+  ASSERT_EQ(values[0], ps.get(0) + 2);
+  ps.push();
+  dc.full_barrier();
+  ps.pull(0, NUM_PARAMS);
+  ASSERT_EQ(ps.get(NUM_PARAMS - 1), ps.get(0) + 2 * int(dc.numprocs()));
+
+  // with no staleness every clock is a global step. A faster machine
+  // may already have made its next add.
+  parameter_server<int> bsp(dc, 16, 0);
+  for (size_t c = 1; c <= 5; ++c) {
+    bsp.add(dc.procid() % 16, 1);
+    bsp.clock();
+    ASSERT_EQ(bsp.current_clock(), c);
+    size_t sum = 0;
+    for (size_t i = 0; i < 16; ++i) sum += bsp.get(i);
+    ASSERT_GE(sum, c * dc.numprocs());
+    ASSERT_LE(sum, (c + 1) * dc.numprocs());
+  }
+
+  // readers on other threads respect the staleness bound
+  parameter_server<int> ssp(dc, dc.numprocs(), STALENESS);
+  volatile bool done = false;
+  size_t stalls = 0;
+  thread_group ssp_group;
+  ssp_group.launch(boost::bind(slot_clocker, &ssp, dc.procid(), &done));
+  ssp_group.launch(boost::bind(fresh_reader, &ssp, size_t(dc.numprocs()),
+                               &done, &stalls));
+  ssp_group.join();
+  ASSERT_TRUE(ssp.fresh());
+  ssp.synchronize();
+  for (size_t q = 0; q < dc.numprocs(); ++q) {
+    ASSERT_EQ(size_t(ssp.get(q)), NUM_CLOCKS);
+  }
+  dc.cout() << "Reads held back while stale: " << stalls << std::endl;
+
+  dc.cout() << "Parameter server tests passed" << std::endl;
+  mpi_tools::finalize();
+}
@@ -66,6 +66,20 @@ public:
   }
 };
 
+/// Draws the streams [begin, end) of a counter generator into values
+class counter_worker {
+public:
+  uint64_t seed;
+  size_t begin, end;
+  std::vector<uint32_t>* values;
+  void run() {
+    for(size_t stream = begin; stream < end; ++stream) {
+      graphlab::random::counter_generator gen(seed, stream);
+      (*values)[stream] = gen.next32();
+    }
+  }
+};
+
 template<typename T>
 std::ostream& operator<<(std::ostream& out, const std::vector<T>& values) {
   out << "{";
@@ -152,6 +166,171 @@ class RandomTestSuite: public CxxTest::TestSuite {
 
 
 
+  void test_philox_known_answers() {
+    // the known answer tests of the Random123 distribution
+    const uint32_t zero[4] = {0, 0, 0, 0};
+    const uint32_t zero_key[2] = {0, 0};
+    const uint32_t ones[4] = {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff};
+    const uint32_t ones_key[2] = {0xffffffff, 0xffffffff};
+    const uint32_t pi[4] = {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344};
+    const uint32_t pi_key[2] = {0xa4093822, 0x299f31d0};
+    const uint32_t expected[3][4] = {
+      {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8},
+      {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd},
+      {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}};
+    const uint32_t* ctrs[3] = {zero, ones, pi};
+    const uint32_t* keys[3] = {zero_key, ones_key, pi_key};
+    for(size_t i = 0; i < 3; ++i) {
+      uint32_t out[4];
+      graphlab::random::philox4x32::bijection(ctrs[i], keys[i], out);
+      for(size_t j = 0; j < 4; ++j) TS_ASSERT_EQUALS(out[j], expected[i][j]);
+    }
+  }
+
+
+  void test_counter_generator() {
+    namespace random = graphlab::random;
+    // the scalar and the batch paths produce the same stream
+    random::counter_generator scalar(42, 7, 3), batch(42, 7, 3);
+    std::vector<double> values(1001);
+    batch.fill_uniform(&values[0], values.size());
+    for(size_t i = 0; i < values.size(); ++i) {
+      TS_ASSERT_EQUALS(scalar.rand01(), values[i]);
+      TS_ASSERT(values[i] >= 0 && values[i] < 1);
+    }
+    // different iterations give different streams
+    random::counter_generator next_iteration(42, 7, 4);
+    TS_ASSERT_DIFFERS(next_iteration.rand01(), values[0]);
+
+    // the moments of the normal draws
+    random::counter_generator gen(1, 2);
+    std::vector<double> normals(1000001);
+    gen.fill_normal(&normals[0], normals.size(), 1.0, 2.0);
+    double sum = 0, sumsq = 0;
+    for(size_t i = 0; i < normals.size(); ++i) {
+      sum += normals[i]; sumsq += normals[i] * normals[i];
+    }
+    const double mean = sum / normals.size();
+    const double var = sumsq / normals.size() - mean * mean;
+    TS_ASSERT_DELTA(mean, 1.0, 0.01);
+    TS_ASSERT_DELTA(var, 4.0, 0.02);
+    for(size_t i = 0; i < 1000; ++i) {
+      const int r = gen.uniform<int>(-3, 3);
+      TS_ASSERT(r >= -3 && r <= 3);
+    }
+
+    // the draws do not depend on which thread makes them
+    random::seed(12345);
+    const uint64_t seed = random::counter_seed();
+    const size_t nstreams = 10000;
+    std::vector<uint32_t> sequential(nstreams), parallel(nstreams);
+    for(size_t stream = 0; stream < nstreams; ++stream) {
+      random::counter_generator gen(seed, stream);
+      sequential[stream] = gen.next32();
+    }
+    std::vector<counter_worker> workers(7);
+    graphlab::thread_group threads;
+    for(size_t i = 0; i < workers.size(); ++i) {
+      workers[i].seed = seed;
+      workers[i].begin = nstreams * i / workers.size();
+      workers[i].end = nstreams * (i + 1) / workers.size();
+      workers[i].values = &parallel;
+      threads.launch(boost::bind(&counter_worker::run, &(workers[i])));
+    }
+    threads.join();
+    TS_ASSERT(sequential == parallel);
+    // reseeding reproduces the counter seed
+    random::seed(12345);
+    TS_ASSERT_EQUALS(random::counter_seed(), seed);
+  }
+
+
+  void test_alias_table() {
+    namespace random = graphlab::random;
+    std::vector<double> weights(50);
+    double total = 0;
+    for(size_t i = 0; i < weights.size(); ++i) {
+      weights[i] = std::pow(double(i + 1), -2.1);
+      total += weights[i];
+    }
+    weights[10] = 0; total -= std::pow(11.0, -2.1);
+    random::alias_table table(weights);
+    TS_ASSERT_EQUALS(table.size(), weights.size());
+    const size_t ndraws = 2000000;
+    std::vector<size_t> counts(weights.size(), 0);
+    random::counter_generator gen(3, 4);
+    for(size_t i = 0; i < ndraws; ++i) ++counts[table.sample(gen.rand01())];
+    TS_ASSERT_EQUALS(counts[10], 0);
+    for(size_t i = 0; i < weights.size(); ++i) {
+      const double p = weights[i] / total;
+      // within 5 standard deviations
+      const double tol = 5 * std::sqrt(p * (1 - p) / ndraws) + 1e-9;
+      TS_ASSERT_DELTA(double(counts[i]) / ndraws, p, tol);
+    }
+    // the edges of the unit interval
+    TS_ASSERT(table.sample(0) < weights.size());
+    TS_ASSERT(table.sample(0.9999999999999999) < weights.size());
+    TS_ASSERT(random::multinomial(table) < weights.size());
+  }
+
+
+  void test_counter_speed() {
+    namespace random = graphlab::random;
+    const size_t n = 10000000;
+    std::vector<double> values(n);
+    double sum = 0;
+    graphlab::timer ti;
+
+    ti.start();
+    for(size_t i = 0; i < n; ++i) sum += random::rand01();
+    const double generator_time = ti.current_time();
+
+    random::counter_generator gen(1, 2);
+    ti.start();
+    for(size_t i = 0; i < n; ++i) sum += gen.rand01();
+    const double counter_time = ti.current_time();
+
+    ti.start();
+    gen.fill_uniform(&values[0], n);
+    const double batch_time = ti.current_time();
+    sum += values[n - 1];
+
+    ti.start();
+    gen.fill_normal(&values[0], n);
+    const double normal_time = ti.current_time();
+    sum += values[n - 1];
+
+    // multinomial draws from a power law over 10000 categories
+    const size_t ncats = 10000, ndraws = 1000000;
+    std::vector<double> prob(ncats);
+    for(size_t i = 0; i < ncats; ++i) prob[i] = std::pow(double(i + 1), -2.1);
+    random::alias_table table(prob);
+    size_t index_sum = 0;
+    ti.start();
+    for(size_t i = 0; i < ndraws; ++i) index_sum += random::multinomial(prob);
+    const double linear_time = ti.current_time();
+    ti.start();
+    for(size_t i = 0; i < ndraws; ++i) index_sum += table.sample(gen.rand01());
+    const double alias_time = ti.current_time();
+
+    std::cout << std::endl
+              << "generator uniform:      " << n / generator_time
+              << " samples/s" << std::endl
+              << "counter uniform:        " << n / counter_time
+              << " samples/s" << std::endl
+              << "counter batch uniform:  " << n / batch_time
+              << " samples/s" << std::endl
+              << "counter batch normal:   " << n / normal_time
+              << " samples/s" << std::endl
+              << "linear multinomial:     " << ndraws / linear_time
+              << " samples/s" << std::endl
+              << "alias multinomial:      " << ndraws / alias_time
+              << " samples/s" << std::endl;
+    TS_ASSERT(sum > 0);
+    TS_ASSERT(index_sum > 0);
+  }
+
+
   // void test_speed() {
   //   namespace random = graphlab::random;
   //   std::cout << "speed test run: " << std::endl;
@@ -0,0 +1,413 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+/*
+ * Runs dynamic pagerank and loopy belief propagation to convergence
+ * on the semi synchronous engine with fixed numbers of active vertices
+ * per super-step and with the adaptive controller, checks that all the
+ * runs agree, and reports the time to convergence of each. Then runs
+ * residual pagerank with and without priority selection, and checks
+ * that a superstep scoped gather does not grow the superstep arena.
+ */
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <graphlab.hpp>
+#include <graphlab/engine/semi_synchronous_engine.hpp>
+#include "pagerank_fixture.hpp"
+
+typedef graphlab::distributed_graph<double, graphlab::empty> pr_graph_type;
+typedef pagerank_fixture::dynamic_pagerank<pr_graph_type> pagerank;
+
+
+/*
+ * Pagerank pushing residuals: each vertex adds the residual in its
+ * message to its rank and forwards a share of it to its out
+ * neighbors. The priority of a message is the size of its residual.
+ */
+const double RESIDUAL_TOLERANCE = 1e-4;
+
+struct residual_message : public graphlab::IS_POD_TYPE {
+  double value;
+  residual_message(double value = 0) : value(value) { }
+  double priority() const { return std::fabs(value); }
+  residual_message& operator+=(const residual_message& other) {
+    value += other.value;
+    return *this;
+  }
+};
+
+class residual_pagerank :
+  public graphlab::ivertex_program<pr_graph_type, graphlab::empty,
+                                   residual_message>,
+  public graphlab::IS_POD_TYPE {
+  double residual;
+public:
+  void init(icontext_type& context, const vertex_type& vertex,
+            const message_type& msg) {
+    residual = msg.value;
+  }
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& total) {
+    vertex.data() += residual;
+  }
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return std::fabs(residual) > RESIDUAL_TOLERANCE ? graphlab::OUT_EDGES :
+                                                      graphlab::NO_EDGES;
+  }
+  void scatter(icontext_type& context, const vertex_type& vertex,
+               edge_type& edge) const {
+    context.signal(edge.target(), residual_message(
+        0.85 * residual / vertex.num_out_edges()));
+  }
+}; // end of residual_pagerank
+
+
+/*
+ * Loopy belief propagation on a binary Potts model. The edge holds
+ * the message in each direction.
+ */
+const double LBP_TOLERANCE = 1e-4;
+const double LBP_COUPLING = 0.8;
+const double LBP_DAMPING = 0.5;
+
+struct lbp_vertex : public graphlab::IS_POD_TYPE {
+  double unary[2];
+  double belief[2];
+};
+
+struct lbp_edge : public graphlab::IS_POD_TYPE {
+  double to_target[2];
+  double to_source[2];
+  lbp_edge() {
+    to_target[0] = to_target[1] = to_source[0] = to_source[1] = 0.5;
+  }
+};
+
+typedef graphlab::distributed_graph<lbp_vertex, lbp_edge> lbp_graph_type;
+
+struct log_message : public graphlab::IS_POD_TYPE {
+  double value[2];
+  log_message() { value[0] = value[1] = 0; }
+  log_message& operator+=(const log_message& other) {
+    value[0] += other.value[0]; value[1] += other.value[1];
+    return *this;
+  }
+};
+
+class belief_propagation :
+  public graphlab::ivertex_program<lbp_graph_type, log_message>,
+  public graphlab::IS_POD_TYPE {
+public:
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
+  }
+  log_message gather(icontext_type& context, const vertex_type& vertex,
+                     edge_type& edge) const {
+    const double* in = edge.target().id() == vertex.id() ?
+        edge.data().to_target : edge.data().to_source;
+    log_message ret;
+    ret.value[0] = std::log(in[0]); ret.value[1] = std::log(in[1]);
+    return ret;
+  }
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& total) {
+    lbp_vertex& v = vertex.data();
+    const double shift = std::max(total.value[0], total.value[1]);
+    double sum = 0;
+    for (size_t i = 0; i < 2; ++i) {
+      v.belief[i] = v.unary[i] * std::exp(total.value[i] - shift);
+      sum += v.belief[i];
+    }
+    v.belief[0] /= sum; v.belief[1] /= sum;
+  }
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
+  }
+  void scatter(icontext_type& context, const vertex_type& vertex,
+               edge_type& edge) const {
+    const bool is_source = edge.source().id() == vertex.id();
+    double* out = is_source ? edge.data().to_target : edge.data().to_source;
+    const double* in = is_source ? edge.data().to_source : edge.data().to_target;
+    const double* belief = vertex.data().belief;
+    // the belief without the message from the neighbor
+    const double cavity[2] = {belief[0] / in[0], belief[1] / in[1]};
+    const double same = std::exp(LBP_COUPLING);
+    double msg[2] = {same * cavity[0] + cavity[1], cavity[0] + same * cavity[1]};
+    const double sum = msg[0] + msg[1];
+    // damped, since undamped synchronous updates oscillate on a grid
+    msg[0] = LBP_DAMPING * out[0] + (1 - LBP_DAMPING) * msg[0] / sum;
+    msg[1] = 1 - msg[0];
+    const double change = std::fabs(msg[0] - out[0]);
+    out[0] = msg[0]; out[1] = msg[1];
+    if (change > LBP_TOLERANCE) {
+      context.signal(is_source ? edge.target() : edge.source());
+    }
+  }
+}; // end of belief_propagation
+
+
+/*
+ * Gathers the in neighbor list of each vertex into the superstep
+ * arena, which the engine releases after every batch.
+ */
+struct arena_neighbors {
+  std::vector<graphlab::vertex_id_type,
+              graphlab::arena_allocator<graphlab::vertex_id_type> > vids;
+  arena_neighbors& operator+=(const arena_neighbors& other) {
+    vids.insert(vids.end(), other.vids.begin(), other.vids.end());
+    return *this;
+  }
+  void save(graphlab::oarchive& oarc) const { oarc << vids; }
+  void load(graphlab::iarchive& iarc) { iarc >> vids; }
+};
+
+namespace graphlab {
+  template <>
+  struct superstep_scoped<arena_neighbors> : public boost::true_type { };
+}
+
+class collect_in_neighbors :
+  public graphlab::ivertex_program<pr_graph_type, arena_neighbors>,
+  public graphlab::IS_POD_TYPE {
+public:
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return graphlab::IN_EDGES;
+  }
+  arena_neighbors gather(icontext_type& context, const vertex_type& vertex,
+                         edge_type& edge) const {
+    arena_neighbors ret;
+    ret.vids.push_back(edge.source().id());
+    return ret;
+  }
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& total) {
+    ASSERT_EQ(total.vids.size(), vertex.num_in_edges());
+  }
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+}; // end of collect_in_neighbors
+
+
+double belief_value(const lbp_graph_type::vertex_type& vertex) {
+  return vertex.data().belief[0];
+}
+
+void init_unary(lbp_graph_type::vertex_type& vertex) {
+  graphlab::random::counter_generator gen(1, vertex.id());
+  const double p = gen.uniform<double>(0.2, 0.8);
+  vertex.data().unary[0] = p;
+  vertex.data().unary[1] = 1 - p;
+  vertex.data().belief[0] = vertex.data().belief[1] = 0.5;
+}
+
+void init_residual(pr_graph_type::vertex_type& vertex) {
+  vertex.data() = 0;
+}
+
+void init_messages(lbp_graph_type::edge_type& edge) {
+  edge.data() = lbp_edge();
+}
+
+/// Restores the initial edge data of each problem before every run
+void reset_edges(pr_graph_type& graph) { }
+void reset_edges(lbp_graph_type& graph) { graph.transform_edges(init_messages); }
+
+
+struct run_result {
+  double runtime;
+  size_t updates;
+  int supersteps;
+  std::vector<size_t> history;
+  std::vector<double> values;
+};
+
+std::string describe(const std::vector<size_t>& history) {
+  std::stringstream strm;
+  const size_t shown = std::min<size_t>(history.size(), 12);
+  for (size_t i = 0; i < shown; ++i) strm << history[i] << " ";
+  if (shown < history.size()) strm << "... " << history.back();
+  return strm.str();
+}
+
+void report(graphlab::distributed_control& dc, const std::string& name,
+            const run_result& r) {
+  dc.cout() << "  " << name << ": " << r.runtime << " s, "
+            << r.updates << " updates, " << r.supersteps << " super-steps"
+            << std::endl
+            << "    batch sizes: " << describe(r.history) << std::endl;
+}
+
+template <typename Graph, typename ValueFn>
+struct value_collector {
+  std::vector<double>* values;
+  ValueFn value_fn;
+  void operator()(typename Graph::vertex_type& vertex) {
+    (*values)[vertex.id()] = value_fn(vertex);
+  }
+};
+
+graphlab::graphlab_options batch_options(const std::string& batch_option,
+                                         const std::string& value) {
+  graphlab::graphlab_options opts;
+  opts.get_engine_args().set_option(batch_option, value);
+  if (batch_option == "adaptive_active_vertices") {
+    opts.get_engine_args().set_option("max_active_fraction", 0.01);
+  }
+  return opts;
+}
+
+/**
+ * Runs VertexProgram to convergence with the given engine options,
+ * starting with the message on every vertex
+ */
+template <typename VertexProgram, typename Graph, typename InitFn,
+          typename ValueFn>
+run_result run(graphlab::distributed_control& dc, Graph& graph,
+               const graphlab::graphlab_options& opts,
+               InitFn init, ValueFn value_fn,
+               const typename VertexProgram::message_type& message =
+                   typename VertexProgram::message_type()) {
+  graph.transform_vertices(init);
+  reset_edges(graph);
+  graphlab::semi_synchronous_engine<VertexProgram> engine(dc, graph, opts);
+  engine.signal_all(message);
+  graphlab::timer ti;
+  ti.start();
+  engine.start();
+  run_result r;
+  r.runtime = ti.current_time();
+  r.updates = engine.num_updates();
+  r.supersteps = engine.iteration();
+  r.history = engine.active_vertices_history();
+  ASSERT_EQ(r.history.size(), size_t(r.supersteps));
+  // collect the converged values of the local vertices in id order
+  r.values.resize(graph.num_vertices());
+  value_collector<Graph, ValueFn> collector = {&r.values, value_fn};
+  graph.transform_vertices(collector);
+  return r;
+}
+
+template <typename VertexProgram, typename Graph, typename InitFn,
+          typename ValueFn>
+void compare(graphlab::distributed_control& dc, Graph& graph,
+             const std::string& name, double tolerance,
+             InitFn init, ValueFn value_fn) {
+  dc.cout() << name << ":" << std::endl;
+  const char* fractions[] = {"0.01", "0.1", "1"};
+  std::vector<run_result> results;
+  for (size_t i = 0; i < 3; ++i) {
+    results.push_back(run<VertexProgram>(
+        dc, graph, batch_options("max_active_fraction", fractions[i]),
+        init, value_fn));
+    report(dc, std::string("max_active_fraction=") + fractions[i],
+           results.back());
+  }
+  results.push_back(run<VertexProgram>(
+      dc, graph, batch_options("adaptive_active_vertices", "true"),
+      init, value_fn));
+  report(dc, "adaptive", results.back());
+  // the batch size changes the schedule, not the fixed point
+  for (size_t i = 1; i < results.size(); ++i) {
+    for (size_t v = 0; v < results[0].values.size(); ++v) {
+      ASSERT_LT(std::fabs(results[i].values[v] - results[0].values[v]),
+                tolerance);
+    }
+  }
+}
+
+
+int main(int argc, char** argv) {
+  graphlab::mpi_tools::init(argc, argv);
+  graphlab::distributed_control dc;
+  const size_t nverts = argc > 1 ? atol(argv[1]) : 50000;
+  const size_t side = argc > 2 ? atol(argv[2]) : 100;
+
+  graphlab::random::seed(1);
+  pr_graph_type pr_graph(dc);
+  pagerank_fixture::load_powerlaw(pr_graph, nverts);
+  compare<pagerank>(dc, pr_graph, "Dynamic pagerank", 0.05,
+                    pagerank_fixture::init_pagerank<pr_graph_type>,
+                    pagerank_fixture::pagerank_value<pr_graph_type>);
+
+  // activating the largest residuals first needs fewer updates
+  dc.cout() << "Residual pagerank:" << std::endl;
+  const char* fractions[] = {"0.01", "0.1"};
+  for (size_t i = 0; i < 2; ++i) {
+    graphlab::graphlab_options opts =
+        batch_options("max_active_fraction", fractions[i]);
+    const run_result fifo = run<residual_pagerank>(
+        dc, pr_graph, opts, init_residual,
+        pagerank_fixture::pagerank_value<pr_graph_type>, residual_message(0.15));
+    report(dc, std::string("max_active_fraction=") + fractions[i], fifo);
+    opts.get_engine_args().set_option("priority_selection", true);
+    const run_result prioritized = run<residual_pagerank>(
+        dc, pr_graph, opts, init_residual,
+        pagerank_fixture::pagerank_value<pr_graph_type>, residual_message(0.15));
+    report(dc, std::string("max_active_fraction=") + fractions[i] +
+           " with priority_selection", prioritized);
+    for (size_t v = 0; v < fifo.values.size(); ++v) {
+      ASSERT_LT(std::fabs(prioritized.values[v] - fifo.values[v]), 0.05);
+    }
+  }
+
+  // the arena is rewound after every batch, so a second run reuses the
+  // chunks of the first instead of growing it
+  size_t arena_bytes[2];
+  for (size_t i = 0; i < 2; ++i) {
+    graphlab::semi_synchronous_engine<collect_in_neighbors> engine(
+        dc, pr_graph, batch_options("max_active_fraction", "0.01"));
+    engine.signal_all();
+    engine.start();
+    arena_bytes[i] = graphlab::superstep_arena::reserved_bytes();
+  }
+  dc.cout() << "Arena bytes after one run: " << arena_bytes[0]
+            << ", after two: " << arena_bytes[1] << std::endl;
+  ASSERT_EQ(arena_bytes[0], arena_bytes[1]);
+
+  lbp_graph_type lbp_graph(dc);
+  if (dc.procid() == 0) {
+    for (size_t i = 0; i < side; ++i) {
+      for (size_t j = 0; j < side; ++j) {
+        const size_t v = i * side + j;
+        if (j + 1 < side) lbp_graph.add_edge(v, v + 1);
+        if (i + 1 < side) lbp_graph.add_edge(v, v + side);
+      }
+    }
+  }
+  lbp_graph.finalize();
+  compare<belief_propagation>(dc, lbp_graph, "Loopy belief propagation",
+                              0.01, init_unary, belief_value);
+  graphlab::mpi_tools::finalize();
+}
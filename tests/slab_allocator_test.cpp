@@ -0,0 +1,182 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <new>
+#include <boost/bind.hpp>
+#include <graphlab/util/slab_allocator.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+// Count every call to the global operator new, so that the benchmark
+// can report how many heap allocations each allocator leaves behind.
+graphlab::atomic<size_t> num_heap_allocs;
+
+void* operator new(size_t bytes) {
+  num_heap_allocs.inc();
+  void* ret = malloc(bytes == 0 ? 1 : bytes);
+  if (ret == NULL) throw std::bad_alloc();
+  return ret;
+}
+void operator delete(void* ptr) { free(ptr); }
+void* operator new[](size_t bytes) {
+  return operator new(bytes);
+}
+void operator delete[](void* ptr) { free(ptr); }
+
+
+typedef std::vector<size_t, graphlab::pool_allocator<size_t> > pool_vector;
+typedef std::vector<size_t, graphlab::arena_allocator<size_t> > arena_vector;
+
+void fill_and_check(size_t seed) {
+  std::vector<pool_vector> vecs(100);
+  for (size_t i = 0; i < vecs.size(); ++i) {
+    for (size_t j = 0; j < (i * seed) % 300; ++j) vecs[i].push_back(i + j);
+  }
+  for (size_t i = 0; i < vecs.size(); ++i) {
+    ASSERT_EQ(vecs[i].size(), (i * seed) % 300);
+    for (size_t j = 0; j < vecs[i].size(); ++j) ASSERT_EQ(vecs[i][j], i + j);
+  }
+}
+
+void destroy_vectors(std::vector<pool_vector>* vecs) {
+  vecs->clear();
+}
+
+void superstep_arena_check() {
+  for (size_t round = 0; round < 3; ++round) {
+    std::vector<arena_vector> vecs(1000);
+    for (size_t i = 0; i < vecs.size(); ++i) vecs[i].resize(100, i);
+    for (size_t i = 0; i < vecs.size(); ++i) ASSERT_EQ(vecs[i][99], i);
+    vecs.clear();
+    graphlab::superstep_arena::release();
+  }
+  const size_t reserved = graphlab::superstep_arena::reserved_bytes();
+  std::vector<arena_vector> vecs(1000);
+  for (size_t i = 0; i < vecs.size(); ++i) vecs[i].resize(100, i);
+  vecs.clear();
+  graphlab::superstep_arena::release();
+  ASSERT_EQ(graphlab::superstep_arena::reserved_bytes(), reserved);
+}
+
+void sanity_checks() {
+  // many threads allocating and freeing at once
+  graphlab::thread_group thrgroup;
+  for (size_t i = 0; i < 8; ++i) {
+    thrgroup.launch(boost::bind(fill_and_check, i + 1));
+  }
+  thrgroup.join();
+
+  // blocks freed by a thread other than the one which allocated them
+  std::vector<pool_vector> vecs(1000, pool_vector(10, 1));
+  thrgroup.launch(boost::bind(destroy_vectors, &vecs));
+  thrgroup.join();
+  ASSERT_TRUE(vecs.empty());
+
+  // serialization of vectors with a custom allocator
+  pool_vector pv;
+  for (size_t i = 0; i < 100; ++i) pv.push_back(i * i);
+  std::stringstream strm;
+  graphlab::oarchive oarc(strm);
+  oarc << pv;
+  strm.flush();
+  graphlab::iarchive iarc(strm);
+  arena_vector av;
+  iarc >> av;
+  ASSERT_EQ(av.size(), pv.size());
+  for (size_t i = 0; i < av.size(); ++i) ASSERT_EQ(av[i], i * i);
+
+  // arena memory is recycled on release
+  superstep_arena_check();
+}
+
+/*
+ * A triangle counting style gather: every vertex appends the ids of its
+ * neighbors one edge at a time, and the neighbor list is dropped at the
+ * end of the super-step.
+ */
+template <typename VidVector>
+void gather_neighbors(size_t num_vertices, size_t seed, size_t* checksum) {
+  std::vector<VidVector> accum(num_vertices);
+  for (size_t v = 0; v < num_vertices; ++v) {
+    const size_t degree = 1 + (v * 2654435761u + seed) % 64;
+    for (size_t e = 0; e < degree; ++e) {
+      VidVector edge_value(1, v + e);
+      accum[v].insert(accum[v].end(), edge_value.begin(), edge_value.end());
+    }
+    *checksum += accum[v].size();
+  }
+}
+
+template <typename VidVector>
+void run_gather_benchmark(const std::string& name, size_t nthreads,
+                          size_t num_supersteps, size_t num_vertices,
+                          bool release_arena) {
+  std::vector<size_t> checksums(nthreads, 0);
+  const size_t allocs_before = num_heap_allocs.value;
+  graphlab::timer ti;
+  ti.start();
+  for (size_t step = 0; step < num_supersteps; ++step) {
+    graphlab::thread_group thrgroup;
+    for (size_t i = 0; i < nthreads; ++i) {
+      thrgroup.launch(boost::bind(gather_neighbors<VidVector>,
+                                  num_vertices, i, &checksums[i]));
+    }
+    thrgroup.join();
+    if (release_arena) graphlab::superstep_arena::release();
+  }
+  const double elapsed = ti.current_time();
+  // the thread launches allocate too; they are the same for all runs
+  std::cout << name << ": " << elapsed << " s, "
+            << num_heap_allocs.value - allocs_before << " heap allocations"
+            << std::endl;
+  size_t total = 0;
+  for (size_t i = 0; i < nthreads; ++i) total += checksums[i];
+  ASSERT_GT(total, 0);
+}
+
+void gather_benchmark() {
+  const size_t nthreads = 4, num_supersteps = 10, num_vertices = 20000;
+  run_gather_benchmark<std::vector<size_t> >
+      ("std::allocator  ", nthreads, num_supersteps, num_vertices, false);
+  run_gather_benchmark<pool_vector>
+      ("pool_allocator  ", nthreads, num_supersteps, num_vertices, false);
+  run_gather_benchmark<arena_vector>
+      ("arena_allocator ", nthreads, num_supersteps, num_vertices, true);
+  std::cout << "slab bytes: " << graphlab::slab_allocator::reserved_bytes()
+            << ", arena bytes: " << graphlab::superstep_arena::reserved_bytes()
+            << std::endl;
+}
+
+
+int main(int argc, char** argv) {
+  std::cout << "Slab Allocator Sanity Checks... \n";
+  sanity_checks();
+  std::cout << "Gather Allocation Benchmark... \n";
+  gather_benchmark();
+  std::cout << "Done" << std::endl;
+}
@@ -1,39 +1,102 @@
 #include <graphlab/rpc/dc.hpp>
 #include <graphlab/rpc/sample_sort.hpp>
+#include <graphlab/util/timer.hpp>
 #include <algorithm>
+#include <cstdlib>
 
 using namespace graphlab;
 
-int main(int argc, char** argv) {
-  mpi_tools::init(argc, argv);
-  distributed_control dc;
-  std::vector<size_t> keys;
-  std::vector<size_t> values;
-  for (size_t i = 0;i < 1000000; ++i) {
-    size_t s = rand();
-    keys.push_back(s); values.push_back(s);
+struct check_sorted {
+  size_t* last;
+  size_t* count;
+  check_sorted(size_t& last, size_t& count): last(&last), count(&count) { }
+  void operator()(const std::pair<size_t, size_t>& kv) {
+    ASSERT_EQ(kv.first, kv.second);
+    ASSERT_GE(kv.first, *last);
+    *last = kv.first;
+    ++(*count);
   }
+};
 
-  sample_sort<size_t, size_t> sorter(dc);
-  sorter.sort(keys.begin(), keys.end(),
-              values.begin(), values.end());
-
-  std::vector<std::vector<std::pair<size_t, size_t> > > result(dc.numprocs());
-  
-  std::swap(result[dc.procid()], sorter.result());
+template <typename Key>
+void check_result(distributed_control& dc,
+                  std::vector<std::pair<Key, size_t> >& local_result) {
+  std::vector<std::vector<std::pair<Key, size_t> > > result(dc.numprocs());
+  std::swap(result[dc.procid()], local_result);
   dc.gather(result, 0);
   if (dc.procid() == 0) {
     // test that it is sorted and the values are correct
-    size_t last = 0;
+    Key last = Key();
+    bool first = true;
     for (size_t i = 0;i < result.size(); ++i) {
       dc.cout() << result[i].size() << ",";
       for (size_t j = 0; j < result[i].size(); ++j) {
-        ASSERT_EQ(result[i][j].first, result[i][j].second);
-        ASSERT_GE(result[i][j].first, last);
+        ASSERT_EQ(size_t(result[i][j].first), result[i][j].second);
+        if (!first) {
+          ASSERT_FALSE(result[i][j].first < last);
+        }
         last = result[i][j].first;
+        first = false;
       }
     }
     dc.cout() << std::endl;
   }
+}
+
+int main(int argc, char** argv) {
+  mpi_tools::init(argc, argv);
+  distributed_control dc;
+  const size_t num_keys = argc > 1 ? atol(argv[1]) : 1000000;
+  std::vector<size_t> keys;
+  std::vector<size_t> values;
+  for (size_t i = 0;i < num_keys; ++i) {
+    size_t s = rand();
+    keys.push_back(s); values.push_back(s);
+  }
+
+  // integer keys, sorted with the radix sort
+  {
+    sample_sort<size_t, size_t> sorter(dc);
+    timer ti; ti.start();
+    sorter.sort(keys.begin(), keys.end(),
+                values.begin(), values.end());
+    const double elapsed = ti.current_time();
+    dc.cout() << "Sorted " << num_keys << " integer keys per machine in "
+              << elapsed << " s: " << num_keys / elapsed
+              << " keys/sec per machine" << std::endl;
+    check_result(dc, sorter.result());
+  }
+
+  // floating point keys, sorted with the parallel comparison sort
+  {
+    std::vector<double> dkeys(keys.begin(), keys.end());
+    sample_sort<double, size_t> sorter(dc);
+    timer ti; ti.start();
+    sorter.sort(dkeys.begin(), dkeys.end(),
+                values.begin(), values.end());
+    const double elapsed = ti.current_time();
+    dc.cout() << "Sorted " << num_keys << " double keys per machine in "
+              << elapsed << " s: " << num_keys / elapsed
+              << " keys/sec per machine" << std::endl;
+    check_result(dc, sorter.result());
+  }
+
+  // a memory budget of a tenth of the data forces spilling to disk
+  {
+    const size_t budget = num_keys * sizeof(std::pair<size_t, size_t>) / 10;
+    sample_sort<size_t, size_t> sorter(dc, budget);
+    timer ti; ti.start();
+    sorter.sort(keys.begin(), keys.end(),
+                values.begin(), values.end());
+    size_t last = 0, count = 0;
+    sorter.for_each_sorted(check_sorted(last, count));
+    const double elapsed = ti.current_time();
+    dc.cout() << "Sorted " << num_keys << " integer keys per machine "
+              << "out of core in " << elapsed << " s: " << num_keys / elapsed
+              << " keys/sec per machine" << std::endl;
+    ASSERT_TRUE(num_keys == 0 || sorter.spilled());
+    dc.all_reduce(count);
+    ASSERT_EQ(count, num_keys * dc.numprocs());
+  }
   mpi_tools::finalize();
 }
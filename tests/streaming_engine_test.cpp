@@ -0,0 +1,209 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+/*
+ * Checks the streaming engine against the synchronous engine on
+ * pagerank, checks that edge data changed by scatters is written back
+ * to disk, and reports the streaming throughput. The optional
+ * arguments are the number of vertices and edges of the benchmark
+ * graph and the directory of its partition files.
+ */
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <graphlab.hpp>
+#include <graphlab/engine/streaming_engine.hpp>
+#include "pagerank_fixture.hpp"
+
+const int PAGERANK_ITERATIONS = 10;
+
+
+typedef graphlab::streaming_graph<double, int> counting_graph_type;
+
+/// Counts its scatters on the out edges, then sums them on the in edges
+class count_scatters :
+  public graphlab::ivertex_program<counting_graph_type, int>,
+  public graphlab::IS_POD_TYPE {
+public:
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return context.iteration() == 3 ? graphlab::IN_EDGES : graphlab::NO_EDGES;
+  }
+  int gather(icontext_type& context, const vertex_type& vertex,
+             edge_type& edge) const {
+    return edge.data();
+  }
+  void apply(icontext_type& context, vertex_type& vertex, const int& total) {
+    if (context.iteration() == 3) {
+      ASSERT_EQ(size_t(total), 3 * vertex.num_in_edges());
+      vertex.data() = total;
+    } else {
+      context.signal(vertex);
+    }
+  }
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return context.iteration() < 3 ? graphlab::OUT_EDGES : graphlab::NO_EDGES;
+  }
+  void scatter(icontext_type& context, const vertex_type& vertex,
+               edge_type& edge) const {
+    ++edge.data();
+  }
+}; // end of count_scatters
+
+
+/// A reproducible skewed random edge
+std::pair<size_t, size_t> make_edge(graphlab::random::counter_generator& gen,
+                                    size_t nverts) {
+  const size_t source = gen.uniform<size_t>(0, nverts - 1);
+  const double u = gen.rand01();
+  const size_t target = std::min(size_t(u * u * nverts), nverts - 1);
+  return std::make_pair(source, target);
+}
+
+struct value_collector {
+  std::vector<double>* values;
+  void operator()(graphlab::distributed_graph<double,
+                  graphlab::empty>::vertex_type& vertex) {
+    (*values)[vertex.id()] = vertex.data();
+  }
+};
+
+void test_pagerank(graphlab::distributed_control& dc) {
+  typedef graphlab::distributed_graph<double, graphlab::empty> dgraph_type;
+  typedef graphlab::streaming_graph<double, graphlab::empty> sgraph_type;
+  typedef pagerank_fixture::fixed_pagerank<dgraph_type, PAGERANK_ITERATIONS>
+      dpagerank_type;
+  typedef pagerank_fixture::fixed_pagerank<sgraph_type, PAGERANK_ITERATIONS>
+      spagerank_type;
+  const size_t nverts = 20000, nedges = 200000;
+  dgraph_type dgraph(dc);
+  // small partitions so that most updates cross partitions
+  sgraph_type sgraph(dc, "", 1000);
+  graphlab::random::counter_generator gen(3, 0);
+  for (size_t i = 0; i < nedges; ++i) {
+    const std::pair<size_t, size_t> e = make_edge(gen, nverts);
+    if (e.first == e.second) continue;
+    dgraph.add_edge(e.first, e.second);
+    sgraph.add_edge(e.first, e.second);
+  }
+  // make sure both graphs have every vertex
+  for (size_t v = 0; v < nverts; ++v) {
+    dgraph.add_vertex(v);
+    sgraph.add_vertex(v);
+  }
+  dgraph.finalize();
+  sgraph.finalize();
+  ASSERT_EQ(sgraph.num_edges(), dgraph.num_edges());
+  ASSERT_GT(sgraph.num_partitions(), size_t(1));
+
+  dgraph.transform_vertices(pagerank_fixture::init_pagerank<dgraph_type>);
+  graphlab::synchronous_engine<dpagerank_type> dengine(dc, dgraph);
+  dengine.signal_all();
+  dengine.start();
+
+  sgraph.transform_vertices(pagerank_fixture::init_pagerank<sgraph_type>);
+  graphlab::graphlab_options opts;
+  // flush the update buffers many times per pass
+  opts.get_engine_args().set_option("update_buffer_size", 1000);
+  graphlab::streaming_engine<spagerank_type> sengine(dc, sgraph, opts);
+  sengine.signal_all();
+  sengine.start();
+  ASSERT_EQ(sengine.iteration(), dengine.iteration());
+  ASSERT_EQ(sengine.num_updates(), dengine.num_updates());
+
+  std::vector<double> expected(nverts);
+  value_collector collector = {&expected};
+  dgraph.transform_vertices(collector);
+  for (size_t v = 0; v < nverts; ++v) {
+    const double value = sgraph.vertex(v).data();
+    ASSERT_LT(std::fabs(value - expected[v]), 1e-9 * expected[v]);
+  }
+  std::cout << "Pagerank agrees with the synchronous engine" << std::endl;
+}
+
+void test_edge_write_back(graphlab::distributed_control& dc) {
+  counting_graph_type graph(dc, "", 1000);
+  graphlab::random::counter_generator gen(4, 0);
+  for (size_t i = 0; i < 100000; ++i) {
+    const std::pair<size_t, size_t> e = make_edge(gen, 10000);
+    graph.add_edge(e.first, e.second, 0);
+  }
+  graph.finalize();
+  graphlab::graphlab_options opts;
+  // several blocks per partition
+  opts.get_engine_args().set_option("block_size", 4096);
+  graphlab::streaming_engine<count_scatters> engine(dc, graph, opts);
+  engine.signal_all();
+  engine.start();
+  ASSERT_EQ(engine.iteration(), 4);
+  std::cout << "Scattered edge data is written back" << std::endl;
+}
+
+
+void benchmark(graphlab::distributed_control& dc, size_t nverts,
+               size_t nedges, const std::string& path) {
+  typedef graphlab::streaming_graph<double, graphlab::empty> sgraph_type;
+  typedef pagerank_fixture::fixed_pagerank<sgraph_type, PAGERANK_ITERATIONS>
+      spagerank_type;
+  sgraph_type graph(dc, path);
+  graphlab::random::counter_generator gen(5, 0);
+  graphlab::timer ti;
+  ti.start();
+  for (size_t i = 0; i < nedges; ++i) {
+    const std::pair<size_t, size_t> e = make_edge(gen, nverts);
+    graph.add_edge(e.first, e.second);
+  }
+  graph.add_vertex(nverts - 1);
+  graph.finalize();
+  const double load_time = ti.current_time();
+  graph.transform_vertices(pagerank_fixture::init_pagerank<sgraph_type>);
+  graphlab::streaming_engine<spagerank_type> engine(dc, graph);
+  engine.signal_all();
+  ti.start();
+  engine.start();
+  const double runtime = ti.current_time();
+  const double bytes = double(engine.num_edges_streamed()) *
+      sizeof(sgraph_type::edge_record);
+  std::cout << nedges << " edges (" << nedges * sizeof(sgraph_type::edge_record)
+            << " bytes) in " << graph.num_partitions() << " partitions"
+            << std::endl
+            << "  written in " << load_time << " s" << std::endl
+            << "  " << engine.iteration() << " iterations in " << runtime
+            << " s: " << engine.num_edges_streamed() / runtime
+            << " edges/s, " << bytes / runtime / (1 << 20) << " MB/s"
+            << std::endl;
+}
+
+
+int main(int argc, char** argv) {
+  graphlab::mpi_tools::init(argc, argv);
+  graphlab::distributed_control dc;
+  test_pagerank(dc);
+  test_edge_write_back(dc);
+  const size_t nverts = argc > 1 ? atol(argv[1]) : 1000000;
+  const size_t nedges = argc > 2 ? atol(argv[2]) : 10000000;
+  const std::string path = argc > 3 ? argv[3] : "";
+  benchmark(dc, nverts, nedges, path);
+  graphlab::mpi_tools::finalize();
+}
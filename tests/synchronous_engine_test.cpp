@@ -20,6 +20,7 @@
  *
  */
 
+#include <cmath>
 #include <vector>
 #include <algorithm>
 #include <iostream>
@@ -28,6 +29,7 @@
 // #include <cxxtest/TestSuite.h>
 
 #include <graphlab.hpp>
+#include "pagerank_fixture.hpp"
 
 typedef graphlab::distributed_graph<int,int> graph_type;
 
@@ -148,6 +150,124 @@ void test_all_neighbors(graphlab::distributed_control& dc,
 
 
 
+/*
+ * A neighbor list gather type. With the arena allocator it draws from
+ * the superstep arena, which the engines release after every apply
+ * phase.
+ */
+template <typename Allocator>
+struct neighbor_list {
+  std::vector<graphlab::vertex_id_type, Allocator> vids;
+  neighbor_list& operator+=(const neighbor_list& other) {
+    vids.insert(vids.end(), other.vids.begin(), other.vids.end());
+    return *this;
+  }
+  void save(graphlab::oarchive& oarc) const { oarc << vids; }
+  void load(graphlab::iarchive& iarc) { iarc >> vids; }
+};
+
+typedef neighbor_list<graphlab::arena_allocator<graphlab::vertex_id_type> >
+  arena_neighbors;
+typedef neighbor_list<std::allocator<graphlab::vertex_id_type> >
+  heap_neighbors;
+
+namespace graphlab {
+  template <>
+  struct superstep_scoped<arena_neighbors> : public boost::true_type { };
+}
+
+/*
+ * Adds a hash of the sorted neighbor list to the vertex data in every
+ * super-step, so that a neighbor list corrupted in any super-step
+ * changes the result.
+ */
+template <typename NeighborList>
+class collect_all_neighbors : 
+  public graphlab::ivertex_program<graph_type, NeighborList>,
+  public graphlab::IS_POD_TYPE {
+public:
+  typedef graphlab::ivertex_program<graph_type, NeighborList> base_type;
+  typedef typename base_type::icontext_type icontext_type;
+  typedef typename base_type::vertex_type vertex_type;
+  typedef typename base_type::edge_type edge_type;
+  typedef typename base_type::gather_type gather_type;
+  typedef graphlab::edge_dir_type edge_dir_type;
+
+  edge_dir_type 
+  gather_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
+  }
+  gather_type 
+  gather(icontext_type& context, const vertex_type& vertex, 
+         edge_type& edge) const {
+    gather_type ret;
+    ret.vids.push_back(edge.source().id() == vertex.id() ?
+                       edge.target().id() : edge.source().id());
+    return ret;
+  }
+  void apply(icontext_type& context, vertex_type& vertex, 
+             const gather_type& total) {
+    ASSERT_EQ(total.vids.size(),
+              vertex.num_in_edges() + vertex.num_out_edges());
+    std::vector<graphlab::vertex_id_type> vids(total.vids.begin(),
+                                               total.vids.end());
+    std::sort(vids.begin(), vids.end());
+    int hash = 0;
+    for (size_t i = 0; i < vids.size(); ++i) hash = hash * 31 + vids[i];
+    vertex.data() += hash;
+    context.signal(vertex);
+  }
+  edge_dir_type 
+  scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+}; // end of collect all neighbors
+
+void clear_vertex_data(graph_type::vertex_type& vertex) { vertex.data() = 0; }
+
+struct vertex_data_collector {
+  std::vector<int>* data;
+  void operator()(const graph_type::vertex_type& vertex) {
+    (*data)[vertex.id()] = vertex.data();
+  }
+};
+
+template <typename NeighborList>
+std::vector<int> run_collect_all_neighbors(graphlab::distributed_control& dc,
+                                           graphlab::command_line_options& clopts,
+                                           graph_type& graph) {
+  typedef graphlab::synchronous_engine<collect_all_neighbors<NeighborList> >
+    engine_type;
+  graph.transform_vertices(clear_vertex_data);
+  engine_type engine(dc, graph, clopts);
+  engine.signal_all();
+  std::cout << "Running!" << std::endl;
+  engine.start();
+  std::vector<int> data(graph.num_vertices());
+  vertex_data_collector collector;
+  collector.data = &data;
+  graph.transform_vertices(collector);
+  return data;
+}
+
+void test_arena_gather(graphlab::distributed_control& dc,
+                       graphlab::command_line_options& clopts,
+                       graph_type& graph) {
+  std::cout << "Constructing a syncrhonous engine for an arena gather" << std::endl;
+  const std::vector<int> arena_data =
+    run_collect_all_neighbors<arena_neighbors>(dc, clopts, graph);
+  std::cout << "Arena bytes: " << graphlab::superstep_arena::reserved_bytes()
+            << std::endl;
+  const std::vector<int> heap_data =
+    run_collect_all_neighbors<heap_neighbors>(dc, clopts, graph);
+  ASSERT_TRUE(arena_data == heap_data);
+  // the tests which follow expect the vertex data to be zero
+  graph.transform_vertices(clear_vertex_data);
+  std::cout << "Finished" << std::endl;
+}
+
+
+
 
 class basic_messages : 
   public graphlab::ivertex_program<graph_type, int, int>,
@@ -270,6 +390,117 @@ void test_count_aggregators(graphlab::distributed_control& dc,
 }
 
 
+int incremental_finalize_iter = 0;
+void incremental_iteration_finalize(count_aggregators::icontext_type& context,
+                                    const int& total) {
+  ASSERT_EQ(total, context.num_vertices() * (context.iteration()+1));
+  ASSERT_EQ(incremental_finalize_iter++, context.iteration());
+}
+
+void set_vertex_to_zero(graph_type::vertex_type& vertex) {
+  vertex.data() = 0;
+}
+
+void test_incremental_aggregators(graphlab::distributed_control& dc,
+                                  graphlab::command_line_options& clopts,
+                                  graph_type& graph) {
+  std::cout << "Constructing a syncrhonous engine for incremental aggregators"
+            << std::endl;
+  typedef graphlab::synchronous_engine<count_aggregators> engine_type;
+  graph.transform_vertices(set_vertex_to_zero);
+  engine_type engine(dc, graph, clopts);
+  engine.add_incremental_vertex_aggregator<int>("iteration_counter",
+                                                iteration_counter,
+                                                incremental_iteration_finalize);
+  engine.aggregate_periodic("iteration_counter", 0);
+  engine.signal_all();
+  engine.start();
+  ASSERT_EQ(incremental_finalize_iter, engine.iteration());
+}
+
+
+
+
+typedef graphlab::distributed_graph<double, graphlab::empty> pr_graph_type;
+typedef pagerank_fixture::dynamic_pagerank<pr_graph_type> pagerank;
+
+void test_pull_activation(graphlab::distributed_control& dc) {
+  std::cout << "Comparing scatter and pull activation" << std::endl;
+  pr_graph_type graph(dc);
+  pagerank_fixture::load_powerlaw(graph, 100000);
+  typedef graphlab::synchronous_engine<pagerank> engine_type;
+  size_t updates[2];
+  int iterations[2];
+  double total[2], runtime[2];
+  for (size_t i = 0; i < 2; ++i) {
+    graph.transform_vertices(pagerank_fixture::init_pagerank<pr_graph_type>);
+    graphlab::graphlab_options opts;
+    opts.get_engine_args().set_option("pull_activation", i == 1);
+    engine_type engine(dc, graph, opts);
+    engine.signal_all();
+    graphlab::timer ti;
+    ti.start();
+    engine.start();
+    runtime[i] = ti.current_time();
+    updates[i] = engine.num_updates();
+    iterations[i] = engine.iteration();
+    total[i] = graph.map_reduce_vertices<double>(
+        pagerank_fixture::pagerank_value<pr_graph_type>);
+    std::cout << (i == 0 ? "  scatter: " : "  pull: ") << runtime[i]
+              << " s, " << updates[i] << " updates, " << iterations[i]
+              << " iterations" << std::endl;
+  }
+  // pulling activates exactly the vertices the scatter signals
+  ASSERT_EQ(updates[0], updates[1]);
+  ASSERT_EQ(iterations[0], iterations[1]);
+  ASSERT_LT(std::fabs(total[0] - total[1]), 1e-6 * total[0]);
+}
+
+
+void test_reset(graphlab::distributed_control& dc) {
+  std::cout << "Comparing a new engine per phase with reset" << std::endl;
+  pr_graph_type graph(dc);
+  pagerank_fixture::load_powerlaw(graph, 100000);
+  typedef graphlab::synchronous_engine<pagerank> engine_type;
+  graphlab::graphlab_options opts;
+  // stop while vertices are still signaled, which reset must drop
+  opts.get_engine_args().set_option("max_iterations", 3);
+  const size_t NPHASES = 4;
+  size_t updates[NPHASES];
+  double total[NPHASES];
+  graphlab::timer ti;
+  double setup_time = 0;
+  for (size_t i = 0; i < NPHASES; ++i) {
+    graph.transform_vertices(pagerank_fixture::init_pagerank<pr_graph_type>);
+    ti.start();
+    engine_type engine(dc, graph, opts);
+    setup_time += ti.current_time();
+    engine.signal_all();
+    engine.start();
+    updates[i] = engine.num_updates();
+    total[i] = graph.map_reduce_vertices<double>(
+        pagerank_fixture::pagerank_value<pr_graph_type>);
+  }
+  std::cout << "  new engine: " << setup_time / NPHASES
+            << " s setup per phase" << std::endl;
+  setup_time = 0;
+  engine_type engine(dc, graph, opts);
+  for (size_t i = 0; i < NPHASES; ++i) {
+    graph.transform_vertices(pagerank_fixture::init_pagerank<pr_graph_type>);
+    ti.start();
+    engine.reset();
+    setup_time += ti.current_time();
+    engine.signal_all();
+    engine.start();
+    ASSERT_EQ(engine.num_updates(), updates[i]);
+    ASSERT_EQ(engine.iteration(), 3);
+    const double phase_total = graph.map_reduce_vertices<double>(
+        pagerank_fixture::pagerank_value<pr_graph_type>);
+    ASSERT_LT(std::fabs(phase_total - total[i]), 1e-9 * total[i]);
+  }
+  std::cout << "  reset:      " << setup_time / NPHASES
+            << " s setup per phase" << std::endl;
+}
 
 
 int main(int argc, char** argv) {
@@ -288,8 +519,12 @@ int main(int argc, char** argv) {
   test_in_neighbors(dc, clopts, graph);
   test_out_neighbors(dc, clopts, graph);
   test_all_neighbors(dc, clopts, graph);
+  test_arena_gather(dc, clopts, graph);
   test_messages(dc, clopts, graph);
   test_count_aggregators(dc, clopts, graph);
+  test_incremental_aggregators(dc, clopts, graph);
+  test_pull_activation(dc);
+  test_reset(dc);
 
   graphlab::mpi_tools::finalize();
 } // end of main
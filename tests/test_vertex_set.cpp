@@ -62,6 +62,101 @@ int vertex_data_identity(graph_type::vertex_type vtx) {
   return vtx.data();
 }
 
+size_t count_vertices(graph_type::vertex_type vtx) {
+  return 1;
+}
+
+double vertex_id_value(graph_type::vertex_type vtx) {
+  return vtx.id();
+}
+
+class noop_program :
+  public graphlab::ivertex_program<graph_type, int>,
+  public graphlab::IS_POD_TYPE {
+public:
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& total) { }
+}; // end of noop_program
+
+/**
+ * Reports the time and the bytes sent to compute the neighborhood of a
+ * vertex set, and the time to select from the set and to signal the set
+ * in an engine.
+ */
+void time_vset_sync(graphlab::distributed_control& dc, graph_type& graph,
+                    const graphlab::vertex_set& vset, const std::string& name) {
+  const size_t reps = 10;
+  const size_t setsize = graph.vertex_set_size(vset);
+  dc.full_barrier();
+  const size_t bytes_before = dc.bytes_sent();
+  graphlab::timer ti; ti.start();
+  for (size_t i = 0; i < reps; ++i) {
+    graphlab::vertex_set nbrs = graph.neighbors(vset, graphlab::ALL_EDGES);
+  }
+  const double sync_time = ti.current_time() / reps;
+  dc.full_barrier();
+  const size_t sync_bytes = (dc.bytes_sent() - bytes_before) / reps;
+
+  ti.start();
+  for (size_t i = 0; i < reps; ++i) {
+    graphlab::vertex_set even = 
+      graph.select(boost::bind(select_vid_modulo, _1, 2), vset);
+  }
+  const double select_time = ti.current_time() / reps;
+
+  graphlab::synchronous_engine<noop_program> engine(dc, graph);
+  ti.start();
+  for (size_t i = 0; i < reps; ++i) engine.signal_vset(vset);
+  const double signal_time = ti.current_time() / reps;
+  dc.cout() << name << " set of " << setsize << " vertices: "
+            << "neighbors " << sync_time << " s, " 
+            << sync_bytes << " bytes sent per machine, "
+            << "select " << select_time << " s, "
+            << "signal_vset " << signal_time << " s\n";
+}
+
+/**
+ * Times repeated map reduces over a vertex set, once with the two
+ * reductions computed separately and once fused into a single pass.
+ */
+void time_map_reduce(graphlab::distributed_control& dc, graph_type& graph,
+                     const graphlab::vertex_set& vset, const std::string& name) {
+  const size_t reps = 10;
+  const size_t setsize = graph.vertex_set_size(vset);
+  size_t count = 0;
+  double total = 0;
+  graphlab::timer ti; ti.start();
+  for (size_t i = 0; i < reps; ++i) {
+    count = graph.map_reduce_vertices<size_t>(count_vertices, vset);
+    total = graph.map_reduce_vertices<double>(vertex_id_value, vset);
+  }
+  const double separate_time = ti.current_time() / reps;
+  ASSERT_EQ(count, setsize);
+
+  typedef graphlab::fused_reduction<size_t, double> fused_type;
+  fused_type fused;
+  ti.start();
+  for (size_t i = 0; i < reps; ++i) {
+    fused = graph.map_reduce_vertices<fused_type>(
+        graphlab::fuse_maps<size_t, double>(count_vertices, vertex_id_value),
+        vset);
+  }
+  const double fused_time = ti.current_time() / reps;
+  ASSERT_EQ(fused.first, setsize);
+  ASSERT_EQ(fused.second, total);
+
+  ti.start();
+  for (size_t i = 0; i < reps; ++i) {
+    count = graph.map_reduce_edges<size_t>(count_edges, vset,
+                                           graphlab::ALL_EDGES);
+  }
+  const double edge_time = ti.current_time() / reps;
+  dc.cout() << name << " set of " << setsize << " vertices: "
+            << "2 map reduces " << separate_time << " s, "
+            << "fused " << fused_time << " s, "
+            << "edges " << edge_time << " s\n";
+}
+
 
 
 int main(int argc, char** argv) {
@@ -139,6 +234,59 @@ int main(int argc, char** argv) {
   dc.cout() << graph.vertex_set_size(out_nbrs_in_nbrs) << " nbr nbr size\n";
   // this set must contain the original out_deg_one set
   ASSERT_TRUE(graph.vertex_set_empty((out_deg_one & out_nbrs_in_nbrs) - out_deg_one));
+
+  // fused reductions must agree with the separate ones
+  typedef graphlab::fused_reduction<size_t, int> fused_type;
+  fused_type fused = graph.map_reduce_vertices<fused_type>(
+      graphlab::fuse_maps<size_t, int>(boost::bind(is_divisible, _1, 6),
+                                       vertex_data_identity), out_deg_one);
+  ASSERT_EQ(fused.first, graph.map_reduce_vertices<size_t>(
+      boost::bind(is_divisible, _1, 6), out_deg_one));
+  ASSERT_EQ(fused.second, total);
+  ASSERT_EQ(graph.map_reduce_vertices<size_t>(count_vertices, graph.empty_set()), 0);
+
+  // set operations mixing sparse and dense sets
+  graphlab::vertex_set div_1000_id = graph.select(boost::bind(select_vid_modulo, _1, 1000));
+  const size_t num_div_1000 = 1 + (graph.num_vertices() - 1) / 1000;
+  ASSERT_EQ(graph.vertex_set_size(div_1000_id), num_div_1000);
+  ASSERT_EQ(graph.vertex_set_size(div_1000_id & even_id), num_div_1000);
+  ASSERT_EQ(graph.vertex_set_size(even_id & div_1000_id), num_div_1000);
+  ASSERT_EQ(graph.vertex_set_size(div_1000_id | even_id), 
+            graph.vertex_set_size(even_id));
+  ASSERT_EQ(graph.vertex_set_size(even_id - div_1000_id),
+            graph.vertex_set_size(even_id) - num_div_1000);
+  ASSERT_EQ(graph.vertex_set_size(~div_1000_id), 
+            graph.num_vertices() - num_div_1000);
+  graphlab::vertex_set div_3000_id = div_1000_id & div_3_id;
+  ASSERT_EQ(graph.vertex_set_size(div_1000_id - div_3000_id),
+            num_div_1000 - graph.vertex_set_size(div_3000_id));
+  ASSERT_EQ(graph.vertex_set_size(div_3000_id | div_1000_id), num_div_1000);
+  ASSERT_EQ(graph.map_reduce_vertices<size_t>(boost::bind(is_divisible, _1, 1000),
+                                              div_1000_id), num_div_1000);
+  // the neighborhoods of a sparse set and of the same set made dense
+  // must agree
+  graphlab::vertex_set div_1000_dense = small - small;
+  div_1000_dense |= div_1000_id;
+  ASSERT_EQ(graph.vertex_set_size(div_1000_dense), num_div_1000);
+  graphlab::vertex_set sparse_nbrs = graph.neighbors(div_1000_id, graphlab::ALL_EDGES);
+  graphlab::vertex_set dense_nbrs = graph.neighbors(div_1000_dense, graphlab::ALL_EDGES);
+  ASSERT_EQ(graph.vertex_set_size(sparse_nbrs), graph.vertex_set_size(dense_nbrs));
+  ASSERT_TRUE(graph.vertex_set_empty(sparse_nbrs - dense_nbrs));
+  ASSERT_TRUE(graph.vertex_set_empty(dense_nbrs - sparse_nbrs));
+  graph.transform_vertices(set_to_one, div_1000_id);
+  ASSERT_EQ(graph.map_reduce_vertices<size_t>(vertex_data_identity, div_1000_id),
+            num_div_1000);
+
+  // synchronization and signalling on dense and sparse sets
+  time_vset_sync(dc, graph, graph.complete_set(), "Complete");
+  time_vset_sync(dc, graph, even_id, "Dense");
+  time_vset_sync(dc, graph, div_1000_id, "Sparse");
+
+  // map reduce time on dense and sparse sets
+  time_map_reduce(dc, graph, graph.complete_set(), "Complete");
+  time_map_reduce(dc, graph, even_id, "Dense");
+  graphlab::vertex_set sparse = graph.select(boost::bind(select_vid_modulo, _1, 1000));
+  time_map_reduce(dc, graph, sparse, "Sparse");
   graphlab::mpi_tools::finalize();
 }
 
@@ -25,6 +25,7 @@
 #include <graphlab.hpp>
 #include <graphlab/ui/metrics_server.hpp>
 #include <graphlab/util/hopscotch_set.hpp>
+#include <graphlab/util/slab_allocator.hpp>
 #include <graphlab/macros_def.hpp>
 /**
  *  
@@ -192,7 +193,8 @@ struct vid_vector{
   // If the assigned values has length >= HASH_THRESHOLD,
   // we will allocate a cuckoo set to store it. Otherwise,
   // we just store a sorted vector
-  void assign(const std::vector<graphlab::vertex_id_type>& vec) {
+  template <typename VidVector>
+  void assign(const VidVector& vec) {
     clear();
     if (vec.size() >= HASH_THRESHOLD) {
         // move to cset
@@ -202,7 +204,7 @@ struct vid_vector{
         }
     }
     else {
-      vid_vec = vec;
+      vid_vec.assign(vec.begin(), vec.end());
       if (vid_vec.size() > 64) {
         radix_sort(&(vid_vec[0]), 0, vid_vec.size(), 24);
       }
@@ -358,7 +360,10 @@ bool PER_VERTEX_COUNT = false;
  */
 struct set_union_gather {
   graphlab::vertex_id_type v;
-  std::vector<graphlab::vertex_id_type> vid_vec;
+  // The neighbor lists only live for one super-step, so they are
+  // bump allocated from the superstep arena rather than the heap
+  std::vector<graphlab::vertex_id_type,
+              graphlab::arena_allocator<graphlab::vertex_id_type> > vid_vec;
 
   set_union_gather():v(-1) {
   }
@@ -415,6 +420,11 @@ struct set_union_gather {
   }
 };
 
+namespace graphlab {
+  template <>
+  struct superstep_scoped<set_union_gather> : public boost::true_type { };
+}
+
 /*
  * Define the type of the graph
  */
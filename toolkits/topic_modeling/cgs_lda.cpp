@@ -85,6 +85,8 @@ inline factor_type& operator+=(factor_type& lvalue,
 // We include the rest of GraphLab after we define the operator+= for
 // vector.
 #include <graphlab.hpp>
+#include <graphlab/rpc/parameter_server.hpp>
+#include <graphlab/util/file_backed_allocator.hpp>
 #include <graphlab/macros_def.hpp>
 
 
@@ -107,8 +109,14 @@ typedef uint16_t topic_id_type;
  * assignments of each token.  There can be several occurrences of the
  * same word in a given document and so a vector is used to store the
  * assignments of each occurrence.
+ *
+ * The assignments are placed with the edge data array itself, so with
+ * --graph_opts="edgestore=<dir>" they are kept in memory mapped files
+ * too.
  */
-typedef std::vector< topic_id_type > assignment_type;
+typedef std::vector< topic_id_type,
+                     graphlab::file_backed_allocator<topic_id_type> >
+assignment_type;
 
 
 // Global Variables
@@ -159,10 +167,23 @@ size_t TOPK = 5;
 size_t INTERVAL = 10;
 
 /**
- * \brief The global variable storing the global topic count across
- * all machines.  This is maintained periodically using aggregation.
+ * \brief The global topic counts across all machines.  Samplers update
+ * them directly and the machines exchange the updates each time the
+ * parameter server is clocked (see \ref clock_driver).
  */
-factor_type GLOBAL_TOPIC_COUNT;
+graphlab::parameter_server<count_type>* GLOBAL_TOPIC_COUNT = NULL;
+
+/**
+ * \brief The number of clocks the clock driver of a machine may run
+ * ahead of the slowest machine before waiting for it.
+ */
+size_t STALENESS = 2;
+
+/**
+ * \brief The interval in milliseconds between clocks of the global
+ * topic counts.
+ */
+size_t CLOCK_INTERVAL = 100;
 
 /**
  * \brief A dictionary of words used to print the top words during
@@ -489,11 +510,21 @@ public:
    * \brief Scatter on all edges if the computation is on-going.
    * Computation stops after bunrin or when disable sampling is set to
    * true.
+   *
+   * While the global topic counts are more than STALENESS clocks
+   * behind (see \ref clock_driver) the vertex does not sample and is
+   * signaled again instead.
    */
   edge_dir_type scatter_edges(icontext_type& context,
                               const vertex_type& vertex) const {
-    return (DISABLE_SAMPLING || (BURNIN > 0 && context.elapsed_seconds() > BURNIN))? 
-      graphlab::NO_EDGES : graphlab::ALL_EDGES;
+    if (DISABLE_SAMPLING || (BURNIN > 0 && context.elapsed_seconds() > BURNIN))
+      return graphlab::NO_EDGES;
+    if (!GLOBAL_TOPIC_COUNT->fresh()) {
+      context.signal(vertex);
+      sched_yield();
+      return graphlab::NO_EDGES;
+    }
+    return graphlab::ALL_EDGES;
   }; // end of scatter edges
 
 
@@ -528,7 +559,7 @@ public:
       if(asg != NULL_TOPIC) { // construct the cavity
         --doc_topic_count[asg];
         --word_topic_count[asg];
-        --GLOBAL_TOPIC_COUNT[asg];
+        GLOBAL_TOPIC_COUNT->add(asg, -1);
       }
       for(size_t t = 0; t < NTOPICS; ++t) {
         const double n_dt =
@@ -536,14 +567,14 @@ public:
         const double n_wt =
           std::max(count_type(word_topic_count[t]), count_type(0));
         const double n_t  =
-          std::max(count_type(GLOBAL_TOPIC_COUNT[t]), count_type(0));
+          std::max(GLOBAL_TOPIC_COUNT->get(t), count_type(0));
         prob[t] = (ALPHA + n_dt) * (BETA + n_wt) / (BETA * NWORDS + n_t);
       }
       asg = graphlab::random::multinomial(prob);
       // asg = std::max_element(prob.begin(), prob.end()) - prob.begin();
       ++doc_topic_count[asg];
       ++word_topic_count[asg];
-      ++GLOBAL_TOPIC_COUNT[asg];
+      GLOBAL_TOPIC_COUNT->add(asg, 1);
       if(asg != old_asg) {
         ++edge.data().nchanges;
         INCREMENT_EVENT(TOKEN_CHANGES,1);
@@ -663,27 +694,67 @@ public:
 
 
 /**
- * \brief The global counts aggregator computes the total number of
- * tokens in each topic across all words and documents and then
- * updates the \ref GLOBAL_TOPIC_COUNT variable.
- *
+ * \brief Returns the topic counts of a vertex.
  */
-struct global_counts_aggregator {
-  typedef graph_type::vertex_type vertex_type;
-  static factor_type map(icontext_type& context, const vertex_type& vertex) {
-    return vertex.data().factor;
-  } // end of map function
+factor_type vertex_topic_counts(const graph_type::vertex_type& vertex) {
+  return vertex.data().factor;
+}
 
-  static void finalize(icontext_type& context, const factor_type& total) {
-    size_t sum = 0;
-    for(size_t t = 0; t < total.size(); ++t) {
-      GLOBAL_TOPIC_COUNT[t] =
-        std::max(count_type(total[t]/2), count_type(0));
-      sum += GLOBAL_TOPIC_COUNT[t];
+/**
+ * \brief Sets the global topic counts to the totals of the current
+ * token assignments, which are counted once by the word and once by
+ * the document of each token.  Must be called by all machines.
+ */
+void initialize_global_counts(graphlab::distributed_control& dc,
+                              graph_type& graph) {
+  const factor_type total =
+    graph.map_reduce_vertices<factor_type>(vertex_topic_counts);
+  std::vector<count_type> deltas(NTOPICS, 0);
+  for(size_t t = 0; t < total.size(); ++t) 
+    deltas[t] = total[t].value/2 - GLOBAL_TOPIC_COUNT->get(t);
+  if(dc.procid() == 0) GLOBAL_TOPIC_COUNT->add_range(0, deltas);
+  GLOBAL_TOPIC_COUNT->synchronize();
+} // end of initialize global counts
+
+
+
+/**
+ * \brief The clock driver advances the clock of the global topic
+ * counts at a fixed interval while the sampler runs, which exchanges
+ * the count updates between machines.
+ *
+ * While the driver waits in clock() for a machine more than STALENESS
+ * clocks behind, the samplers find the counts not fresh and put their
+ * vertices back on the scheduler instead of sampling. They must not
+ * block, since the engine handles incoming RPC calls on its own
+ * threads and a blocked sampler would stop the updates of the slow
+ * machine from being received.
+ */
+struct clock_driver {
+  volatile bool done;
+  graphlab::thread thr;
+  clock_driver() : done(false) { }
+
+  void run() {
+    while(!done) {
+      graphlab::timer::sleep_ms(CLOCK_INTERVAL);
+      GLOBAL_TOPIC_COUNT->clock();
     }
-    context.cout() << "Total Tokens: " << sum << std::endl;
-  } // end of finalize
-}; // end of global_counts_aggregator struct
+  } // end of run
+
+  void start() {
+    done = false;
+    thr.launch(boost::bind(&clock_driver::run, this));
+  } // end of start
+
+  /** Must be called by all machines. Leaves the counts synchronized. */
+  void stop() {
+    done = true;
+    GLOBAL_TOPIC_COUNT->interrupt();
+    thr.join();
+    GLOBAL_TOPIC_COUNT->synchronize();
+  } // end of stop
+}; // end of clock_driver struct
 
 
 
@@ -741,7 +812,7 @@ public:
     // Address the global sum terms
     double denominator = 0;
     for(size_t t = 0; t < NTOPICS; ++t) {
-      denominator += lgamma(GLOBAL_TOPIC_COUNT[t] + NWORDS * BETA);
+      denominator += lgamma(GLOBAL_TOPIC_COUNT->get(t) + NWORDS * BETA);
     } // end of for loop
 
     const double lik_words_given_topics =
@@ -1049,6 +1120,12 @@ int main(int argc, char** argv) {
                        "The number of words to report");
   clopts.attach_option("interval", INTERVAL,
                        "statistics reporting interval");
+  clopts.attach_option("staleness", STALENESS,
+                       "The number of clocks a machine may run ahead of the "
+                       "slowest machine when sharing the global topic counts.");
+  clopts.attach_option("clock_interval", CLOCK_INTERVAL,
+                       "The interval in milliseconds between exchanges of "
+                       "the global topic counts.");
   clopts.attach_option("max_count", MAX_COUNT,
                        "The maximum number of occurences of a word in a document.");
   clopts.attach_option("format", format,
@@ -1083,7 +1160,8 @@ int main(int argc, char** argv) {
 
 
   ///! Initialize global variables
-  GLOBAL_TOPIC_COUNT.resize(NTOPICS);
+  graphlab::parameter_server<count_type> global_topic_count(dc, NTOPICS, STALENESS);
+  GLOBAL_TOPIC_COUNT = &global_topic_count;
   if(!dictionary_fname.empty()) {
     const bool success = load_dictionary(dictionary_fname);
     if(!success) {
@@ -1119,16 +1197,6 @@ int main(int argc, char** argv) {
     ASSERT_TRUE(success);
   }
 
-  { // Add the Global counts aggregator
-    const bool success =
-      engine.add_vertex_aggregator<factor_type>
-      ("global_counts", 
-       global_counts_aggregator::map, 
-       global_counts_aggregator::finalize) &&
-      engine.aggregate_periodic("global_counts", 5);
-    ASSERT_TRUE(success);
-  }
-  
 /*  { // Add the likelihood aggregator
     const bool success =
       engine.add_vertex_aggregator<likelihood_aggregator>
@@ -1145,8 +1213,17 @@ int main(int argc, char** argv) {
   graphlab::timer timer;
   // Enable sampling
   cgs_lda_vertex_program::DISABLE_SAMPLING = false;
-  // Run the engine
+  // Run the engine, exchanging the global topic counts as it runs
+  initialize_global_counts(dc, graph);
+  clock_driver clocks;
+  clocks.start();
   engine.start();
+  clocks.stop();
+  {
+    size_t sum = 0;
+    for(size_t t = 0; t < NTOPICS; ++t) sum += GLOBAL_TOPIC_COUNT->get(t);
+    dc.cout() << "Total Tokens: " << sum << std::endl;
+  }
   // Finalize the counts
   cgs_lda_vertex_program::DISABLE_SAMPLING = true;
   engine.signal_all();